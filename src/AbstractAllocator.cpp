@@ -35,6 +35,11 @@
 #include "Error.h"
 #include "AbstractAllocator.h"
 #include "AbstractAllocatorPlugCallback.h"
+#include "UnusedParameter.h"
+
+#ifdef HAS_UNITEX_NAMESPACE
+using namespace unitex;
+#endif
 
 //#ifndef HAS_UNITEX_NAMESPACE
 //#define HAS_UNITEX_NAMESPACE 1
@@ -148,6 +153,240 @@ const AllocatorSpace * GetAllocatorSpaceForParam(const char*creator,int flagAllo
 }
 
 
+/*
+ * Built-in arena allocator
+ *
+ * It is used when no installed allocator space accepts a request made with
+ * an AllocatorCreationFlagAutoFree* flag or with an expected item size, so
+ * that these callers get an allocator even in the default build.
+ * Items are carved out of chunks by moving a position: free does nothing,
+ * clean_allocator keeps only the first chunk and rewinds it, and deleting
+ * the allocator releases every chunk at once.
+ */
+
+#define ARENA_CHUNK_SIZE (1024*64)
+#define ARENA_ALIGN (0x10)
+#define arena_round(v,round) ((((v)+((round)-1)) / (round)) * (round))
+
+/* the buffer of a chunk follows its header */
+struct arena_chunk {
+    struct arena_chunk* previous;
+    size_t size_buf;
+    size_t pos_buf;
+} ;
+
+#define ARENA_CHUNK_HEADER_SIZE arena_round(sizeof(struct arena_chunk),ARENA_ALIGN)
+#define arena_chunk_buf(chunk) (((char*)(chunk))+ARENA_CHUNK_HEADER_SIZE)
+
+struct arena_allocator {
+    struct arena_chunk* first;
+    struct arena_chunk* last;
+    size_t chunk_size;
+    size_t nb_byte_allocated;
+    size_t nb_living_allocation;
+    size_t nb_allocation_made;
+} ;
+
+
+static struct arena_chunk* build_arena_chunk(size_t size_buf)
+{
+    struct arena_chunk* chunk = (struct arena_chunk*)malloc(ARENA_CHUNK_HEADER_SIZE + size_buf);
+    if (chunk == NULL) {
+        fatal_alloc_error("build_arena_chunk");
+    }
+    chunk->previous = NULL;
+    chunk->size_buf = size_buf;
+    chunk->pos_buf = 0;
+    return chunk;
+}
+
+static size_t arena_item_size(size_t size)
+{
+    if (size == 0)
+        return ARENA_ALIGN;
+    return arena_round(size,ARENA_ALIGN);
+}
+
+static void* ABSTRACT_CALLBACK_UNITEX arena_alloc_cb(size_t size,void* pa)
+{
+    struct arena_allocator* arena = (struct arena_allocator*)pa;
+    size_t rounded_size = arena_item_size(size);
+    struct arena_chunk* work_chunk = arena->last;
+
+    if ((work_chunk->pos_buf + rounded_size) > work_chunk->size_buf) {
+        if (rounded_size > (arena->chunk_size / 4)) {
+            /* a big item gets its own chunk, inserted behind the current
+             * one, so that the room left in the current chunk is not lost */
+            struct arena_chunk* big_chunk = build_arena_chunk(rounded_size);
+            big_chunk->previous = work_chunk->previous;
+            work_chunk->previous = big_chunk;
+            work_chunk = big_chunk;
+        } else {
+            struct arena_chunk* new_chunk = build_arena_chunk(arena->chunk_size);
+            new_chunk->previous = work_chunk;
+            arena->last = new_chunk;
+            work_chunk = new_chunk;
+        }
+    }
+
+    void* ret = (void*)(arena_chunk_buf(work_chunk) + work_chunk->pos_buf);
+    work_chunk->pos_buf += rounded_size;
+    arena->nb_byte_allocated += rounded_size;
+    arena->nb_living_allocation++;
+    arena->nb_allocation_made++;
+    return ret;
+}
+
+static void ABSTRACT_CALLBACK_UNITEX arena_free_cb(void*,void*)
+{
+}
+
+static void* ABSTRACT_CALLBACK_UNITEX arena_realloc_cb(void* oldptr,size_t oldsize,size_t newsize,void* pa)
+{
+    struct arena_allocator* arena = (struct arena_allocator*)pa;
+    if (oldptr == NULL)
+        return arena_alloc_cb(newsize,pa);
+    if (oldsize >= newsize)
+        return oldptr;
+
+    /* the last item of the current chunk can grow in place */
+    struct arena_chunk* work_chunk = arena->last;
+    size_t old_rounded_size = arena_item_size(oldsize);
+    size_t new_rounded_size = arena_item_size(newsize);
+    if ((work_chunk->pos_buf >= old_rounded_size) &&
+        (oldptr == (void*)(arena_chunk_buf(work_chunk) + work_chunk->pos_buf - old_rounded_size)) &&
+        ((work_chunk->pos_buf - old_rounded_size + new_rounded_size) <= work_chunk->size_buf)) {
+        work_chunk->pos_buf += new_rounded_size - old_rounded_size;
+        arena->nb_byte_allocated += new_rounded_size - old_rounded_size;
+        return oldptr;
+    }
+
+    void* ret = arena_alloc_cb(newsize,pa);
+    memcpy(ret,oldptr,oldsize);
+    return ret;
+}
+
+static int ABSTRACT_CALLBACK_UNITEX arena_get_flag_cb(void*)
+{
+    return AllocatorGetFlagAutoFreePresent | AllocatorCleanPresent;
+}
+
+static void ABSTRACT_CALLBACK_UNITEX arena_clean_cb(void* pa)
+{
+    struct arena_allocator* arena = (struct arena_allocator*)pa;
+    struct arena_chunk* browse = arena->last;
+    while (browse != NULL)
+    {
+        struct arena_chunk* tmp = browse->previous;
+        if (browse != arena->first)
+            free(browse);
+        browse = tmp;
+    }
+    arena->first->previous = NULL;
+    arena->first->pos_buf = 0;
+    arena->last = arena->first;
+    arena->nb_byte_allocated = 0;
+    arena->nb_living_allocation = 0;
+}
+
+static int ABSTRACT_CALLBACK_UNITEX arena_get_statistic_info_cb(int iStatNum,size_t* p_value,void* pa)
+{
+    struct arena_allocator* arena = (struct arena_allocator*)pa;
+    switch (iStatNum)
+    {
+        case STATISTIC_NB_TOTAL_BYTE_ALLOCATED:
+            *p_value = arena->nb_byte_allocated;
+            return 1;
+        case STATISTIC_NB_TOTAL_CURRENT_LIVING_ALLOCATION:
+            *p_value = arena->nb_living_allocation;
+            return 1;
+        case STATISTIC_NB_TOTAL_ALLOCATION_MADE:
+            *p_value = arena->nb_allocation_made;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int ABSTRACT_CALLBACK_UNITEX is_param_allocator_arena_compatible(const char* creator,int flagAllocator,size_t expected_size_item,
+                                                                       const void* private_create_ptr,void* privateAllocatorSpacePtr)
+{
+    DISCARD_UNUSED_PARAMETER(creator)
+    DISCARD_UNUSED_PARAMETER(private_create_ptr)
+    DISCARD_UNUSED_PARAMETER(privateAllocatorSpacePtr)
+    /* recycled objects are better served by malloc, which reuses freed blocks */
+    if ((flagAllocator & (AllocatorTipOftenRecycledObject | AllocatorTipGrowingOftenRecycledObject)) != 0)
+        return 0;
+    if (((flagAllocator & AllocatorCreationFlagAutoFreeMask) == 0) && (expected_size_item == 0))
+        return 0;
+    return 1;
+}
+
+static int ABSTRACT_CALLBACK_UNITEX create_abstract_allocator_arena(abstract_allocator_info_public_with_allocator* aa,
+                                                                   const char* creator,int flagAllocator,size_t expected_size_item,
+                                                                   const void* private_create_ptr,void* privateAllocatorSpacePtr)
+{
+    DISCARD_UNUSED_PARAMETER(creator)
+    DISCARD_UNUSED_PARAMETER(flagAllocator)
+    DISCARD_UNUSED_PARAMETER(private_create_ptr)
+    DISCARD_UNUSED_PARAMETER(privateAllocatorSpacePtr)
+
+    struct arena_allocator* arena = (struct arena_allocator*)malloc(sizeof(struct arena_allocator));
+    if (arena == NULL)
+        return 0;
+
+    /* allocators of fixed size items (hash tables...) are often numerous and
+     * small: they start with a chunk of 0x20 items */
+    size_t first_chunk_size = ARENA_CHUNK_SIZE;
+    if ((expected_size_item != 0) && ((expected_size_item * 0x20) < ARENA_CHUNK_SIZE))
+        first_chunk_size = arena_round(expected_size_item * 0x20,ARENA_ALIGN);
+
+    arena->first = arena->last = build_arena_chunk(first_chunk_size);
+    arena->chunk_size = ARENA_CHUNK_SIZE;
+    arena->nb_byte_allocated = 0;
+    arena->nb_living_allocation = 0;
+    arena->nb_allocation_made = 0;
+
+#ifdef IS_ASTRACT_ALLOCATOR_EXTENSIBLE
+    aa->size_abstract_allocator_info_size = sizeof(abstract_allocator_info_public_with_allocator);
+#endif
+    aa->fnc_alloc = arena_alloc_cb;
+    aa->fnc_free = arena_free_cb;
+    aa->fnc_realloc = arena_realloc_cb;
+    aa->fnc_get_flag_allocator = arena_get_flag_cb;
+    aa->fnc_clean_allocator = arena_clean_cb;
+    aa->fnc_get_statistic_allocator_info = arena_get_statistic_info_cb;
+    aa->abstract_allocator_ptr = arena;
+    return 1;
+}
+
+static void ABSTRACT_CALLBACK_UNITEX delete_abstract_allocator_arena(abstract_allocator_info_public_with_allocator* aa,void* privateAllocatorSpacePtr)
+{
+    DISCARD_UNUSED_PARAMETER(privateAllocatorSpacePtr)
+    struct arena_allocator* arena = (struct arena_allocator*)aa->abstract_allocator_ptr;
+    if (arena == NULL)
+        return;
+    struct arena_chunk* browse = arena->last;
+    while (browse != NULL)
+    {
+        struct arena_chunk* tmp = browse->previous;
+        free(browse);
+        browse = tmp;
+    }
+    free(arena);
+}
+
+static const t_allocator_func_array arena_allocator_func_array =
+{
+    sizeof(t_allocator_func_array),
+    NULL,
+    NULL,
+    is_param_allocator_arena_compatible,
+    create_abstract_allocator_arena,
+    delete_abstract_allocator_arena
+};
+
+
 Abstract_allocator build_Abstract_allocator_from_AllocatorSpace(const t_allocator_func_array *p_func_array,void* privateAllocatorSpacePtr,const char*creator,int creation_flagAllocator,size_t expected_size_item,const void* private_create_ptr)
 {
     Abstract_allocator aas;
@@ -182,7 +421,13 @@ Abstract_allocator create_abstract_allocator(const char*creator,int flagAllocato
 {
     const AllocatorSpace * paas = GetAllocatorSpaceForParam(creator,flagAllocator,expected_size_item,private_create_ptr) ;
     if (paas == NULL)
-        return NULL;
+    {
+        /* no installed allocator space wants this request: we fall back on
+         * the built-in arena if it suits, or on malloc/free (NULL) */
+        if (is_param_allocator_arena_compatible(creator,flagAllocator,expected_size_item,private_create_ptr,NULL) == 0)
+            return NULL;
+        return build_Abstract_allocator_from_AllocatorSpace(&arena_allocator_func_array,NULL,creator,flagAllocator,expected_size_item,private_create_ptr);
+    }
 
     return build_Abstract_allocator_from_AllocatorSpace(&(paas->func_array),paas->privateAllocatorSpacePtr,creator,flagAllocator,expected_size_item,private_create_ptr);
 }
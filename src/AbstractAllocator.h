@@ -123,6 +123,9 @@ typedef abstract_allocator* Abstract_allocator;
  creationFlagAllocator : can contain a AllocatorCreationFlag* value
  expected_size_item : if non zero, the size of item which be allocated.
  This mean we will always request object of same size
+ When no installed allocator space accepts the request, an AutoFree request
+ or one with expected_size_item gets the built-in arena (free does nothing,
+ clean_allocator rewinds it); any other request gets NULL, that is malloc/free.
  */
 
 
@@ -154,6 +154,14 @@ Fst2* fst2, struct FST2_free_info* p_inf_free_info, void* privateSpacePtr)
   free_pack_fst2(fst2,NULL);
 }
 
+static void ABSTRACT_CALLBACK_UNITEX free_image_abstract_fst2(
+Fst2* fst2, struct FST2_free_info* p_inf_free_info, void* privateSpacePtr)
+{
+  DISCARD_UNUSED_PARAMETER(p_inf_free_info);
+  DISCARD_UNUSED_PARAMETER(privateSpacePtr);
+  free_image_fst2(fst2);
+}
+
 Fst2* load_abstract_fst2_infos(const VersatileEncodingConfig* vec,const char* filename,int read_names,
                                struct FST2_free_info* p_fst2_free_info,bool* is_persistent, bool* is_packed)
 {
@@ -161,6 +169,23 @@ Fst2* load_abstract_fst2_infos(const VersatileEncodingConfig* vec,const char* fi
     const AbstractFst2Space * pads = GetFst2SpaceForFileName(filename) ;
     if (pads == NULL)
     {
+        res = read_image_fst2_from_file(filename);
+        if (res != NULL)
+        {
+          if (p_fst2_free_info != NULL) {
+            p_fst2_free_info->must_be_free   = 1;
+            p_fst2_free_info->func_free_fst2 = (void*)&free_image_abstract_fst2;
+            p_fst2_free_info->private_ptr    = res;
+          }
+          if (is_persistent != NULL) {
+            *is_persistent = false;
+          }
+          if (is_packed != NULL) {
+            *is_packed = false;
+          }
+          return res;
+        }
+
         res = read_pack_fst2_from_file(filename, NULL);
         if (res != NULL)
         {
@@ -237,6 +262,18 @@ int is_abstract_or_persistent_fst2_filename(const char* filename)
 }
 
 
+/**
+ * Returns 1 if the fst2 described by the given free information was loaded
+ * from a binary image, which must then be freed with free_image_fst2
+ * (see PackFst2.cpp); 0 otherwise.
+ */
+int is_image_abstract_fst2(const struct FST2_free_info* p_fst2_free_info)
+{
+    return (p_fst2_free_info != NULL) &&
+           (p_fst2_free_info->func_free_fst2 == (void*)&free_image_abstract_fst2);
+}
+
+
 void free_abstract_Fst2(Fst2* fst2,struct FST2_free_info* p_fst2_free_info)
 {
     if (fst2 != NULL)
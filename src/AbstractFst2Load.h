@@ -59,6 +59,7 @@ Fst2* load_abstract_fst2_infos(const VersatileEncodingConfig*,const char* filena
                                struct FST2_free_info*,bool* is_persistent, bool* is_packed);
 Fst2* load_abstract_fst2(const VersatileEncodingConfig*,const char* filename,int read_names,struct FST2_free_info*);
 void free_abstract_Fst2(Fst2*,struct FST2_free_info*);
+int is_image_abstract_fst2(const struct FST2_free_info*);
 
 //} // namespace unitex
 
@@ -277,7 +277,8 @@ void explore_bin_simple_words(struct dico_application_info* info,
 int final,n_transitions,inf_number;
 /* We compute the number of transitions that outgo from the current node */
 int z=save_output(ustr);
-int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number);
+int index_pos;
+int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number,&index_pos);
 if (token[pos]=='\0') {
    /* If we are at the end of the token */
    inflected[pos]='\0';
@@ -324,6 +325,18 @@ if (final) {
 offset=new_offset;
 unichar c;
 int offset_dest;
+int positions[BIN_MAX_CASE_VARIANTS];
+int n_positions=find_dictionary_transitions(info->d,index_pos,n_transitions,token[pos],info->case_variants,positions);
+if (n_positions!=-1) {
+   /* If the state has an index, we only look at the matching transitions */
+   for (int i=0;i<n_positions;i++) {
+      read_dictionary_transition(info->d,positions[i],&c,&offset_dest,ustr);
+      inflected[pos]=c;
+      explore_bin_simple_words(info,offset_dest,token,inflected,pos+1,token_number,priority,ustr,base);
+      restore_output(z,ustr);
+   }
+   return;
+}
 for (int i=0;i<n_transitions;i++) {
    /* For each outgoing transition, we look if the transition character is
     * compatible with the token's one */
@@ -393,7 +406,8 @@ void explore_bin_compound_words(struct dico_application_info* info,
                                 int current_start_pos,Ustring* line_buf,Ustring* ustr,int base) {
 int final,n_transitions,inf_number;
 int z=save_output(ustr);
-int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number);
+int index_pos;
+int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number,&index_pos);
 if (current_token[pos_in_current_token]=='\0') {
    /* If we are at the end of the current token, we look for the
     * corresponding node in the token tree */
@@ -471,6 +485,20 @@ if (final) {
 unichar c;
 int adr;
 offset=new_offset;
+int positions[BIN_MAX_CASE_VARIANTS];
+int n_positions=find_dictionary_transitions(info->d,index_pos,n_transitions,current_token[pos_in_current_token],
+                                            info->case_variants,positions);
+if (n_positions!=-1) {
+   /* If the state has an index, we only look at the matching transitions */
+   for (int i=0;i<n_positions;i++) {
+      read_dictionary_transition(info->d,positions[i],&c,&adr,ustr);
+      inflected[pos_in_inflected]=c;
+      explore_bin_compound_words(info,adr,current_token,inflected,pos_in_current_token+1,pos_in_inflected+1,ws,
+        pos_offset,token_sequence,pos_token_sequence,priority,current_start_pos,line_buf,ustr,base);
+      restore_output(z,ustr);
+   }
+   return;
+}
 for (int i=0;i<n_transitions;i++) {
    offset=read_dictionary_transition(info->d,offset,&c,&adr,ustr);
    if (is_equal_or_uppercase(c,current_token[pos_in_current_token],info->alphabet)) {
@@ -486,6 +514,65 @@ for (int i=0;i<n_transitions;i++) {
 }
 
 
+/**
+ * This function looks for the compound words of the current dictionary that
+ * start at the position 'current_start_pos' of the text buffer. 'inflected',
+ * 'token_sequence', 'line_buf' and 'ustr' are work buffers provided by the caller.
+ */
+static void look_for_compound_words_at(struct dico_application_info* info,int current_start_pos,int priority,
+                                       unichar* inflected,int* token_sequence,Ustring* line_buf,Ustring* ustr) {
+int token_number=info->text_cod_buf[current_start_pos];
+/* We look for compound words that start with the current token */
+struct word_struct* w=info->word_array->element[token_number];
+if (w==NULL) {
+   return;
+}
+/* If there are some */
+struct word_transition* trans;
+int no_more_word_transition=0;
+/* 'pos_offset' is the number to add to 'current_start_pos' in order
+ * to have the current position in the text buffer */
+int pos_offset=1;
+/* We put the first token in the token sequence */
+int current_token_in_compound=0;
+token_sequence[current_token_in_compound++]=token_number;
+/* We try to go in the text as far as possible, using the information cached
+ * in info->word_array to avoid some computation */
+while (!no_more_word_transition) {
+   trans=NULL;
+   if (current_start_pos+pos_offset < info->text_cod_size_nb_int)
+     trans=get_word_transition(w->trans,info->text_cod_buf[current_start_pos+pos_offset]);
+   if (trans==NULL) {
+      /* If there is no more possibility to go on */
+      no_more_word_transition=1;
+   }
+   else {
+      w=trans->node;
+      /* If we can go on, we add the current token to our token sequence */
+      token_sequence[current_token_in_compound++]=info->text_cod_buf[current_start_pos+pos_offset];
+      /* We add -1 at the end in the case this token would be the last
+       * of the compound word */
+      token_sequence[current_token_in_compound]=-1;
+      pos_offset++;
+   }
+}
+struct offset_list* l=w->list;
+
+if (current_start_pos+pos_offset < info->text_cod_size_nb_int) {
+  while (l!=NULL) {
+     /* If there are dictionary nodes to explore, we do so. For each node
+      * we copy into 'entry' the sequence of character that leads to it in
+      * the .bin */
+     u_strcpy_sized(inflected,DIC_WORD_SIZE,l->content);
+     u_strcpy(ustr,l->output);
+     explore_bin_compound_words(info,l->offset,info->tokens->token[info->text_cod_buf[current_start_pos+pos_offset]],inflected,0,u_strlen(inflected),w,
+       pos_offset,token_sequence,current_token_in_compound,priority,current_start_pos,line_buf,ustr,l->base);
+     l=l->next;
+  }
+}
+}
+
+
 /**
  * This function looks for compound words in the text file set in 'info'.
  * When a compound word is found, the corresponding DELAF lines are saved in
@@ -502,7 +589,6 @@ int* token_sequence=(int*)malloc(sizeof(int)*TOKENS_IN_A_COMPOUND);
 if (token_sequence==NULL) {
    fatal_alloc_error("look_for_simple_words");
 }
-struct word_struct* w;
 /* We go at the beginning of the file and we fill the buffer */
 /*
 fseek(info->text_cod,0,SEEK_SET);
@@ -520,54 +606,7 @@ while (current_start_pos<info->text_cod_size_nb_int) {/*
       fill_buffer(info->buffer,current_start_pos,info->text_cod);
       current_start_pos=0;
    }*/
-   int token_number=info->text_cod_buf[current_start_pos];
-   /* We look for compound words that start with the current token */
-   w=info->word_array->element[token_number];
-   if (w!=NULL) {
-      /* If there are some */
-      struct word_transition* trans;
-      int no_more_word_transition=0;
-      /* 'pos_offset' is the number to add to 'current_start_pos' in order
-       * to have the current position in the text buffer */
-      int pos_offset=1;
-      /* We put the first token in the token sequence */
-      int current_token_in_compound=0;
-      token_sequence[current_token_in_compound++]=token_number;
-      /* We try to go in the text as far as possible, using the information cached
-       * in info->word_array to avoid some computation */
-      while (!no_more_word_transition) {
-         trans=NULL;
-         if (current_start_pos+pos_offset < info->text_cod_size_nb_int)
-           trans=get_word_transition(w->trans,info->text_cod_buf[current_start_pos+pos_offset]);
-         if (trans==NULL) {
-            /* If there is no more possibility to go on */
-            no_more_word_transition=1;
-         }
-         else {
-            w=trans->node;
-            /* If we can go on, we add the current token to our token sequence */
-            token_sequence[current_token_in_compound++]=info->text_cod_buf[current_start_pos+pos_offset];
-            /* We add -1 at the end in the case this token would be the last
-             * of the compound word */
-            token_sequence[current_token_in_compound]=-1;
-            pos_offset++;
-         }
-      }
-      struct offset_list* l=w->list;
-
-      if (current_start_pos+pos_offset < info->text_cod_size_nb_int) {
-        while (l!=NULL) {
-           /* If there are dictionary nodes to explore, we do so. For each node
-            * we copy into 'entry' the sequence of character that leads to it in
-            * the .bin */
-           u_strcpy_sized(inflected,DIC_WORD_SIZE,l->content);
-           u_strcpy(ustr,l->output);
-           explore_bin_compound_words(info,l->offset,info->tokens->token[info->text_cod_buf[current_start_pos+pos_offset]],inflected,0,u_strlen(inflected),w,
-             pos_offset,token_sequence,current_token_in_compound,priority,current_start_pos,line_buf,ustr,l->base);
-           l=l->next;
-        }
-      }
-   }
+   look_for_compound_words_at(info,current_start_pos,priority,inflected,token_sequence,line_buf,ustr);
    current_start_pos++;
 }
 u_printf("\n");
@@ -634,6 +673,7 @@ info->morpho=morpho;
 info->dic_name[0]='\0';
 strcpy(info->tags_ind,tags);
 info->alphabet=alphabet;
+info->case_variants=new_bin_case_variants(alphabet);
 info->d=NULL;
 info->word_array=NULL;
 info->part_of_a_word=new_bit_array(tokens->N,ONE_BIT);
@@ -677,6 +717,7 @@ free_bit_array(info->simple_word);
 free(info->n_occurrences);
 free_tct_hash(info->tct_h);
 free_tct_hash(info->tct_h_tags_ind);
+free_bin_case_variants(info->case_variants);
 for (int i=0;i<info->n_tag_sequences;i++) {
     free_match_list_element(info->tag_sequences[i]);
 }
@@ -727,6 +768,106 @@ return 0;
 }
 
 
+/* Tokens and text positions are processed by blocks of this size by
+ * 'dico_application_single_pass': each dictionary is applied to a whole block
+ * before the next one, which keeps its data in the CPU cache */
+#define SINGLE_PASS_BLOCK_SIZE 65536
+
+
+/**
+ * A dictionary applied by 'dico_application_single_pass', with its own
+ * token tree.
+ */
+struct single_pass_dic {
+   Dictionary* d;
+   struct word_struct_array* word_array;
+   int priority;
+};
+
+
+/**
+ * This function applies several .bin dictionaries in a single pass over the
+ * text. Tokens, and then positions of the text buffer when looking for compound
+ * words, are processed by blocks, and all the dictionaries are applied to a
+ * block before we go on with the next one. Dictionaries must be given in the
+ * order in which they would be applied one by one with 'dico_application', so
+ * that priorities are resolved in the same way.
+ *
+ * The dlf and dlc files get the same lines as with 'dico_application', but
+ * not in the same order, since the entries of the different dictionaries
+ * are interleaved.
+ *
+ * Returns 0 in case of success; 1 if a dictionary could not be loaded.
+ */
+int dico_application_single_pass(const VersatileEncodingConfig* vec,int n_dics,char* const* name_bins,
+                                 const int* priorities,struct dico_application_info* info) {
+int ret=0;
+struct single_pass_dic* dics=(struct single_pass_dic*)malloc(n_dics*sizeof(struct single_pass_dic));
+if (dics==NULL) {
+   fatal_alloc_error("dico_application_single_pass");
+}
+int n=0;
+for (int i=0;i<n_dics;i++) {
+   char name_inf[FILENAME_MAX];
+   remove_extension(name_bins[i],name_inf);
+   strcat(name_inf,".inf");
+   Dictionary* d=new_Dictionary(vec,name_bins[i],name_inf);
+   if (d==NULL) {
+      error("Cannot open dictionary %s\n",name_bins[i]);
+      ret=1;
+      continue;
+   }
+   dics[n].d=d;
+   dics[n].word_array=new_word_struct_array(info->tokens->N);
+   dics[n].priority=priorities[i];
+   n++;
+}
+unichar* inflected=(unichar*)malloc(sizeof(unichar)*DIC_WORD_SIZE);
+int* token_sequence=(int*)malloc(sizeof(int)*TOKENS_IN_A_COMPOUND);
+if (inflected==NULL || token_sequence==NULL) {
+   fatal_alloc_error("dico_application_single_pass");
+}
+Ustring* line_buf=new_Ustring(4096);
+Ustring* ustr=new_Ustring();
+/* As with 'dico_application', simple words must be looked for first */
+u_printf("Looking for simple words...\n");
+for (int start=0;start<info->tokens->N;start+=SINGLE_PASS_BLOCK_SIZE) {
+   int end=(start+SINGLE_PASS_BLOCK_SIZE<info->tokens->N) ? start+SINGLE_PASS_BLOCK_SIZE : info->tokens->N;
+   for (int j=0;j<n;j++) {
+      info->d=dics[j].d;
+      info->word_array=dics[j].word_array;
+      for (int i=start;i<end;i++) {
+         explore_bin_simple_words(info,info->d->initial_state_offset,info->tokens->token[i],inflected,0,i,
+                                  dics[j].priority,ustr,0);
+      }
+   }
+}
+u_printf("Looking for compound words...\n");
+for (int start=0;start<info->text_cod_size_nb_int;start+=SINGLE_PASS_BLOCK_SIZE) {
+   int end=(start+SINGLE_PASS_BLOCK_SIZE<info->text_cod_size_nb_int) ? start+SINGLE_PASS_BLOCK_SIZE : info->text_cod_size_nb_int;
+   for (int j=0;j<n;j++) {
+      info->d=dics[j].d;
+      info->word_array=dics[j].word_array;
+      for (int pos=start;pos<end;pos++) {
+         look_for_compound_words_at(info,pos,dics[j].priority,inflected,token_sequence,line_buf,ustr);
+      }
+   }
+}
+free_Ustring(line_buf);
+free_Ustring(ustr);
+free(inflected);
+free(token_sequence);
+info->d=NULL;
+info->word_array=NULL;
+for (int j=0;j<n;j++) {
+   free_word_struct_array(dics[j].word_array);
+   free_Dictionary(dics[j].d);
+}
+free(dics);
+return ret;
+}
+
+
 /**
  * This function launches the application of the given .bin dictionary.
  *
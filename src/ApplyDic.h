@@ -115,6 +115,9 @@ struct dico_application_info {
    //struct buffer* buffer;
    /* The alphabet to use */
    Alphabet* alphabet;
+   /* The lowercase variants of each char, used to follow transitions of
+    * indexed dictionary states */
+   struct bin_case_variants* case_variants;
    /* The dictionary to use */
    Dictionary* d;
 #if 0
@@ -172,6 +175,8 @@ struct dico_application_info* init_dico_application(struct text_tokens*,U_FILE*,
                                                     U_FILE*,const char*,const char*,Alphabet*,
                                                     const VersatileEncodingConfig*);
 int dico_application(const VersatileEncodingConfig*,const char*,struct dico_application_info*,int);
+int dico_application_single_pass(const VersatileEncodingConfig*,int,char* const*,const int*,
+                                 struct dico_application_info*);
 int dico_application_simplified(const VersatileEncodingConfig*,const unichar*,const char*,struct dico_application_info*);
 void free_dico_application(struct dico_application_info*);
 void count_token_occurrences(struct dico_application_info*);
@@ -75,6 +75,50 @@ while (tmp!=NULL) {
 }
 
 
+/**
+ * Returns a non-zero value if the given node must be saved with a char index.
+ */
+static int has_state_index(const struct dictionary_node* node,BinStateEncoding state_encoding) {
+return is_indexed_state_encoding(state_encoding) && node->n_trans>=BIN_INDEXED_STATE_MIN_TRANSITIONS;
+}
+
+
+/**
+ * Returns the number of bytes needed by the given transition. The offset
+ * of its destination state must be known.
+ */
+static int get_transition_length(const struct dictionary_node_transition* t,BinType bin_type,
+        t_fnc_bin_write_bytes char_write_function,t_fnc_bin_write_bytes offset_write_function) {
+int length=bin_get_value_length(t->letter,char_write_function);
+if (bin_type!=BIN_BIN2) {
+    return length+bin_get_value_length(t->node->offset,offset_write_function);
+}
+/* For a .bin2 transition, we use an extra bit to note if there is an output */
+length+=bin_get_value_length(t->node->offset<<1,offset_write_function);
+if (t->output && t->output[0]!='\0') {
+    length+=bin_get_string_length(t->output,char_write_function);
+}
+return length;
+}
+
+
+/**
+ * Stores in 'letters' the letters of the transitions of the given node, and
+ * in 'offsets' their positions relative to the first transition.
+ */
+static void get_transition_offsets(const struct dictionary_node* node,BinType bin_type,
+        t_fnc_bin_write_bytes char_write_function,t_fnc_bin_write_bytes offset_write_function,
+        unichar* letters,int* offsets) {
+int offset=0;
+int i=0;
+for (const struct dictionary_node_transition* tmp=node->trans;tmp!=NULL;tmp=tmp->next,i++) {
+    letters[i]=tmp->letter;
+    offsets[i]=offset;
+    offset+=get_transition_length(tmp,bin_type,char_write_function,offset_write_function);
+}
+}
+
+
 /**
  * This function computes node offsets in a new way, taking into account
  * the fact that information may be encoded in variable ways.
@@ -93,7 +137,7 @@ if (node->trans==NULL) {
     if (state_encoding==BIN_CLASSIC_STATE) {
         /* A classic final state with no transition takes 5 bytes */
         (*bin_size)+=5;
-    } else if (state_encoding==BIN_NEW_STATE) {
+    } else if (state_encoding==BIN_NEW_STATE || state_encoding==BIN_NEW_INDEXED_STATE) {
         /* A new style final state starts with a variable length value
          * representing the finality and the number of transitions.
          * Since there is no transition, this means 1 byte.
@@ -120,33 +164,33 @@ if (state_encoding==BIN_CLASSIC_STATE) {
     (*bin_size)+=2;
     /* Plus 3 bytes if it's final */
     if (node->single_INF_code_list!=NULL) (*bin_size)+=3;
-} else if (state_encoding==BIN_NEW_STATE) {
+} else {
     /* A new style state starts with a variable length value
      * representing the finality and the number of transitions.
-     * Since there is no transition, this means 1 byte.
-     * We then add the space needed by the inf number, if any */
-    int value=node->n_trans<<1;
-    (*bin_size)+=bin_get_value_length(value,BIN_VARIABLE);
-    if (node->single_INF_code_list!=NULL) (*bin_size)+=bin_get_value_length(inf_indirection[node->INF_code],inf_number_write_function);
-} else {
-    /* A .bin2 state has no inf number */
-    int value=node->n_trans<<1;
-    (*bin_size)+=bin_get_value_length(value,BIN_VARIABLE);
+     * We then add the space needed by the inf number, if any.
+     * A .bin2 state has no inf number */
+    int has_index=has_state_index(node,state_encoding);
+    (*bin_size)+=bin_get_state_length(state_encoding,node->n_trans,has_index);
+    if (node->single_INF_code_list!=NULL && (state_encoding==BIN_NEW_STATE || state_encoding==BIN_NEW_INDEXED_STATE)) {
+        (*bin_size)+=bin_get_value_length(inf_indirection[node->INF_code],inf_number_write_function);
+    }
+    if (has_index) {
+        unichar* letters=(unichar*)malloc(node->n_trans*sizeof(unichar));
+        if (letters==NULL) {
+            fatal_alloc_error("number_node_new_style");
+        }
+        int i=0;
+        for (tmp=node->trans;tmp!=NULL;tmp=tmp->next) letters[i++]=tmp->letter;
+        (*bin_size)+=bin_get_state_index_length(letters,node->n_trans);
+        free(letters);
+    }
 }
 /* Finally, we update the bin size by taking into account the space
  * needed by the outgoing transitions */
+BinType bin_type=(state_encoding==BIN_BIN2_STATE || state_encoding==BIN_BIN2_INDEXED_STATE) ? BIN_BIN2 : BIN_CLASSIC;
 tmp=node->trans;
 while (tmp!=NULL) {
-    (*bin_size)+=bin_get_value_length(tmp->letter,char_write_function);
-    if (state_encoding!=BIN_BIN2_STATE) {
-        (*bin_size)+=bin_get_value_length(tmp->node->offset,offset_write_function);
-    } else {
-        /* For a .bin2 transition, we use an extra bit to note if there is an output */
-        (*bin_size)+=bin_get_value_length(tmp->node->offset<<1,offset_write_function);
-        if (tmp->output && tmp->output[0]!='\0') {
-            (*bin_size)+=bin_get_string_length(tmp->output,char_write_function);
-        }
-    }
+    (*bin_size)+=get_transition_length(tmp,bin_type,char_write_function,offset_write_function);
     tmp=tmp->next;
 }
 }
@@ -200,7 +244,20 @@ if (final && bin_type==BIN_CLASSIC) {
         fatal_error("fill_bin_array: Invalid INF line number redirection for code #%d\n",node->INF_code);
     }
 }
-write_dictionary_state(bin,state_encoding,inf_number_write_function,&pos,final,node->n_trans,inf_code);
+if (has_state_index(node,state_encoding)) {
+    unichar* letters=(unichar*)malloc(node->n_trans*sizeof(unichar));
+    int* offsets=(int*)malloc(node->n_trans*sizeof(int));
+    if (letters==NULL || offsets==NULL) {
+        fatal_alloc_error("fill_bin_array");
+    }
+    get_transition_offsets(node,bin_type,char_write_function,offset_write_function,letters,offsets);
+    write_dictionary_indexed_state(bin,state_encoding,inf_number_write_function,&pos,final,node->n_trans,inf_code,
+            letters,offsets);
+    free(letters);
+    free(offsets);
+} else {
+    write_dictionary_state(bin,state_encoding,inf_number_write_function,&pos,final,node->n_trans,inf_code);
+}
 /* Then, we assign -1 to 'node->INF_code' in order to mark that the node
  * has been dumped */
 node->INF_code=-1;
@@ -225,11 +282,12 @@ while (tmp!=NULL) {
  * in a .bin file named 'output'.
  * The parameters 'n_states' and 'n_transitions' are used to count the states
  * and transitions of the dictionary automaton. 'bin_size' represents the size
- * of the resulting .bin file.
+ * of the resulting .bin file. If 'indexed' is non-zero, states with many
+ * transitions are given a char index (see read_dictionary_state).
  */
 void create_and_save_bin(struct dictionary_node* root,const char* output,int *n_states,
                         int *n_transitions,int *bin_size,int* inf_indirection,int new_style_bin,
-                        BinType bin_type) {
+                        BinType bin_type,int indexed) {
 U_FILE* f;
 /* The output file must be opened as a binary one */
 f=u_fopen(BINARY,output,U_WRITE);
@@ -255,6 +313,9 @@ if (new_style_bin) {
 if (bin_type==BIN_BIN2) {
     state_encoding=BIN_BIN2_STATE;
 }
+if (indexed && new_style_bin) {
+    state_encoding=(bin_type==BIN_BIN2) ? BIN_BIN2_INDEXED_STATE : BIN_NEW_INDEXED_STATE;
+}
 
 
 t_fnc_bin_write_bytes char_write_function=get_bin_write_function_for_encoding(char_encoding) ;
@@ -31,7 +31,7 @@
 
 namespace unitex {
 
-void create_and_save_bin(struct dictionary_node*,const char*,int*,int*,int*,int*,int,BinType);
+void create_and_save_bin(struct dictionary_node*,const char*,int*,int*,int*,int*,int,BinType,int indexed=0);
 
 } // namespace unitex
 
@@ -2550,6 +2550,26 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     int previous_transducer_number = 0;
     int previous_iteration = 0;
     int iteration = 0;
+
+    /* Name of the labeled text whose snt directory contains the tokenization
+     * of the current text, or NULL if the text has been modified since its
+     * last tokenization. A stage without any match leaves the text as it
+     * was, so that the next stage does not need to tokenize it again */
+    char* tokenized_text_name = NULL;
+
+    /* The alphabet is used by each stage to tokenize the outputs */
+    Alphabet* cascade_alphabet = load_alphabet(vec, alphabet);
+
+    /* Unless Tokenize or Concord have additional arguments, the tokenization
+     * of the text is kept in memory from one stage to the next. The outputs
+     * of a stage are merged with it, and only the rewritten parts of the text
+     * are tokenized again */
+    int keep_text_in_memory = (cascade_alphabet != NULL)
+        && (tokenize_args == NULL || tokenize_args->nbelems == 0)
+        && (concord_args == NULL || concord_args->nbelems == 0);
+    /* NULL when the next stage must call Tokenize */
+    struct tokenized_text* text_in_memory = NULL;
+
     while (!is_empty(transducer_list)) {
 
         transducer *current_transducer =
@@ -2560,6 +2580,9 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
         if ((!is_template_grf) && is_debug_mode(current_transducer, vec) == true) {
             error("graph %s has been compiled in debug mode. Please recompile it in normal mode\n", current_transducer->transducer_file_name);
             free(labeled_text_name);
+            free(tokenized_text_name);
+            free_tokenized_text(text_in_memory);
+            free_alphabet(cascade_alphabet);
             free_text_tokens(tokens);
             free_snt_files(snt_text_files);
             free(build_text);
@@ -2586,8 +2609,41 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     transducer_number, previous_iteration, iteration, must_create_directory, 1);
             }
 
-            launch_tokenize_in_Cassys(labeled_text_name, alphabet,
-                snt_text_files->tokens_txt, vec, tokenize_args, display_perf, display_perf ? &time_tokenize : NULL);
+            int must_tokenize = 1;
+            if (tokenized_text_name != NULL && strcmp(tokenized_text_name, labeled_text_name) == 0) {
+                /* In place: the tokenization files are already there */
+                must_tokenize = 0;
+                u_printf("Text unchanged, reusing its tokenization\n");
+            } else if (text_in_memory != NULL) {
+                must_tokenize = (save_tokenized_text(vec, text_in_memory, labeled_text_name) != SUCCESS_RETURN_CODE);
+                if (!must_tokenize) {
+                    u_printf("Saving the tokenization kept in memory\n");
+                }
+            } else if (tokenized_text_name != NULL) {
+                char tokenized_snt_directory[UNITEX_FULLPATH_MAX];
+                char labeled_snt_directory[UNITEX_FULLPATH_MAX];
+                get_snt_path(tokenized_text_name, tokenized_snt_directory);
+                get_snt_path(labeled_text_name, labeled_snt_directory);
+                must_tokenize = !copy_tokenization_snt_content(labeled_snt_directory, tokenized_snt_directory);
+                if (!must_tokenize) {
+                    u_printf("Text unchanged, reusing its tokenization\n");
+                }
+            }
+            if (must_tokenize) {
+                int tokenize_result = launch_tokenize_in_Cassys(labeled_text_name, alphabet,
+                    snt_text_files->tokens_txt, vec, tokenize_args, display_perf, display_perf ? &time_tokenize : NULL);
+                free_tokenized_text(text_in_memory);
+                text_in_memory = NULL;
+                if (keep_text_in_memory && tokenize_result == SUCCESS_RETURN_CODE) {
+                    text_in_memory = load_tokenized_text(vec, labeled_text_name, cascade_alphabet);
+                }
+            }
+            free(tokenized_text_name);
+            tokenized_text_name = strdup(labeled_text_name);
+            if (tokenized_text_name == NULL) {
+                fatal_alloc_error("cascade");
+            }
+            int n_concordances = -1;
 
             //int entity = 0;
             char* updated_grf_file_name = NULL;
@@ -2702,6 +2758,9 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                         } else {
                             alloc_error("cascade");
                             free(labeled_text_name);
+                            free(tokenized_text_name);
+                            free_tokenized_text(text_in_memory);
+                            free_alphabet(cascade_alphabet);
                             free_text_tokens(tokens);
                             free_snt_files(snt_text_files);
                             free(build_text);
@@ -2728,14 +2787,28 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 //u_printf("labeled_text_name = %s *******\n", labeled_text_name);
                 free_snt_files(snt_text_files);
                 snt_text_files = new_snt_files(labeled_text_name);
-                protect_lexical_tag_in_concord(snt_text_files->concord_ind, current_transducer->output_policy, vec);
-                // generate concordance for this transducer
-                launch_concord_in_Cassys(labeled_text_name,
-                    snt_text_files->concord_ind, alphabet, NULL, NULL, NULL, vec, concord_args, display_perf, display_perf ? &time_concord : NULL);
+                n_concordances = count_concordance(snt_text_files->concord_ind, vec);
+                if (n_concordances != 0) {
+                    protect_lexical_tag_in_concord(snt_text_files->concord_ind, current_transducer->output_policy, vec);
+                    // generate concordance for this transducer
+                    if (text_in_memory == NULL
+                            || !merge_concord_in_memory(snt_text_files->concord_ind, labeled_text_name, &text_in_memory, vec)) {
+                        free_tokenized_text(text_in_memory);
+                        text_in_memory = NULL;
+                        launch_concord_in_Cassys(labeled_text_name,
+                            snt_text_files->concord_ind, alphabet, NULL, NULL, NULL, vec, concord_args, display_perf, display_perf ? &time_concord : NULL);
+                    }
 
-                //
-                add_replaced_text(labeled_text_name, tokens_list, previous_transducer_number, previous_iteration,
-                    transducer_number, iteration, alphabet, vec, tokens_allocation_tool);
+                    //
+                    add_replaced_text(labeled_text_name, tokens_list, previous_transducer_number, previous_iteration,
+                        transducer_number, iteration, cascade_alphabet, vec, tokens_allocation_tool);
+
+                    /* The text has been rewritten */
+                    free(tokenized_text_name);
+                    tokenized_text_name = NULL;
+                }
+                /* else, merging an empty concordance would give the same text
+                 * and add no output to the token list */
 
 
                 previous_transducer_number = transducer_number;
@@ -2760,7 +2833,10 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
             }
 
 
-            if (count_concordance(snt_text_files->concord_ind, vec) == 0) {
+            if (n_concordances < 0) {
+                n_concordances = count_concordance(snt_text_files->concord_ind, vec);
+            }
+            if (n_concordances == 0) {
                 break;
             }
             else {
@@ -2768,7 +2844,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     current_transducer->transducer_file_name,
                     transducer_number,
                     iteration,
-                    count_concordance(snt_text_files->concord_ind, vec));
+                    n_concordances);
                 //              char graph_file_name_n[FILENAME_MAX];
                 //                  sprintf(graph_file_name_n,"%s.dot", last_labeled_text_name);
                 //                  u_printf("writing graph = %s\n",graph_file_name_n);
@@ -2789,6 +2865,9 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     }
 
     free_snt_files(snt_text_files);
+    free(tokenized_text_name);
+    free_tokenized_text(text_in_memory);
+    free_alphabet(cascade_alphabet);
 
     // create the concord file with XML
     construct_cascade_concord(tokens_list,text,transducer_number, iteration, vec);
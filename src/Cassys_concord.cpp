@@ -34,6 +34,8 @@
 #include "UnitexRevisionInfo.h"
 #include "List_int.h"
 #include "UnusedParameter.h"
+#include "LocateMatches.h"
+#include "Cassys_external_program.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -52,6 +54,30 @@ void display_lu(struct list_ustring *l){
 }
 
 
+/**
+ * \brief Builds a locate_pos from a match of a binary concord.ind
+ *
+ * \param[in] m the match; matches without output get an empty label
+ *
+ * \return the locate_pos, to be freed as the ones built by read_concord_line
+ */
+static locate_pos *new_locate_pos(const struct match_list *m) {
+    locate_pos *l = (locate_pos*) malloc(sizeof(locate_pos));
+    if (l == NULL) {
+        fatal_alloc_error("new_locate_pos");
+    }
+    l->token_start_offset = m->m.start_pos_in_token;
+    l->character_start_offset = m->m.start_pos_in_char;
+    l->logical_start_offset = m->m.start_pos_in_letter;
+    l->token_end_offset = m->m.end_pos_in_token;
+    l->character_end_offset = m->m.end_pos_in_char;
+    l->logical_end_offset = m->m.end_pos_in_letter;
+    const unichar empty[] = { 0 };
+    l->label = u_strdup((m->output != NULL) ? m->output : empty);
+    return l;
+}
+
+
 /**
  * \brief Reads a 'concord.ind' file and returns a fifo list of all matches found and their replacement
  *
@@ -73,6 +99,19 @@ struct fifo *read_concord_file(const char *concord_file_name, const VersatileEnc
         exit(1);
     }
 
+    if (is_binary_match_list(concord_desc_file)) {
+        /* A binary concord.ind is read without parsing any line */
+        struct match_list* matches = load_match_list(concord_desc_file, NULL, NULL);
+        u_fclose(concord_desc_file);
+        struct match_list* m = matches;
+        while (m != NULL) {
+            put_ptr(f, new_locate_pos(m));
+            m = m->next;
+        }
+        free_match_list(matches);
+        return f;
+    }
+
     if (u_fgets_dynamic_buffer(&line, &size_buffer_line, concord_desc_file) == EOF){
         error("Malformed concordance file %s",concord_file_name);
     }
@@ -111,6 +150,61 @@ int count_concordance(const char *concord_file_name, const VersatileEncodingConf
 
 
 
+/**
+ * Merges the outputs of the matches with the text, like Concord --merge does, using the
+ * tokenization of the text kept in memory. The same matches as in Concord are applied: a
+ * match that overlaps a previous one is ignored.
+ */
+int merge_concord_in_memory(const char *concord_file_name, const char *text_name,
+    struct tokenized_text **text, const VersatileEncodingConfig *vec) {
+
+    U_FILE *concord_desc_file = u_fopen(vec, concord_file_name, U_READ);
+    if (concord_desc_file == NULL) {
+        return 0;
+    }
+    struct match_list* matches = load_match_list(concord_desc_file, NULL, NULL);
+    u_fclose(concord_desc_file);
+
+    const struct tokenized_text *t = *text;
+    vector_int *spans = new_vector_int();
+    vector_ptr *outputs = new_vector_ptr();
+    int whole_tokens = 1;
+    int current_token = 0;
+    for (struct match_list *l = matches; l != NULL; l = l->next) {
+        if (l->m.start_pos_in_token < current_token) {
+            continue;
+        }
+        int start = l->m.start_pos_in_token;
+        int end = l->m.end_pos_in_token;
+        if (start < 0 || end < start || end >= t->codes->nbelems || l->m.start_pos_in_char != 0
+                || l->m.end_pos_in_char + 1 != (int)u_strlen((const unichar*)t->tokens->tab[t->codes->tab[end]])) {
+            // only Concord knows how to merge a match that starts or ends inside a token
+            whole_tokens = 0;
+            break;
+        }
+        vector_int_add(spans, start);
+        vector_int_add(spans, end);
+        vector_ptr_add(outputs, l->output);
+        current_token = end + 1;
+    }
+
+    if (whole_tokens) {
+        check_concord_braces(concord_file_name, vec);
+        u_printf("Merging outputs with text in memory\n");
+        if (replace_in_tokenized_text(vec, *text, spans, outputs, text_name) != SUCCESS_RETURN_CODE) {
+            // the text has been written, but it must be tokenized by Tokenize
+            free_tokenized_text(*text);
+            *text = NULL;
+        }
+    }
+    free_vector_ptr(outputs);
+    free_vector_int(spans);
+    free_match_list(matches);
+    return whole_tokens;
+}
+
+
+
 void protect_lexical_tag_in_concord(const char *concord_file_name, const OutputPolicy op, const VersatileEncodingConfig *vec) {
 
     struct fifo *stage_concord = read_concord_file(concord_file_name, vec);
@@ -32,6 +32,7 @@
 #include "FileEncoding.h"
 #include "Cassys_tokens.h"
 #include "LocateConstants.h"
+#include "Tokenize.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -110,6 +111,23 @@ void protect_lexical_tag_in_concord(const char *concord_file_name, const Versati
 
 void protect_lexical_tag_in_concord(const char *concord_file_name, const OutputPolicy op, const VersatileEncodingConfig *vec);
 
+/**
+ * \brief Merges the outputs of 'concord.ind' with the text kept in memory, as Concord --merge does
+ *
+ * The merged text is written to 'text_name' and the tokenization '*text' is updated to the one of
+ * the merged text, without calling Tokenize. If the merged text could not be tokenized in memory,
+ * '*text' is freed and set to NULL, so that the text must be tokenized by Tokenize.
+ *
+ * \param[in] concord_file_name the concordance of the current stage
+ * \param[in] text_name the text to write
+ * \param[in/out] text the tokenization of the text before the merge
+ *
+ * \return 1 if the text has been written, 0 if the concordance contains matches that do not cover
+ * whole tokens, in which case Concord must be used
+ */
+int merge_concord_in_memory(const char *concord_file_name, const char *text_name,
+    struct tokenized_text **text, const VersatileEncodingConfig *vec);
+
 void construct_xml_concord(const char *text_name, VersatileEncodingConfig* vec);
 
 void construct_istex_token(const char *, VersatileEncodingConfig*, const char*);
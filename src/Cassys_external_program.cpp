@@ -282,6 +282,49 @@ int launch_grf2fst2_in_Cassys(const char *text_name, const char *alphabet_name,
     return result;
 }
 
+/**
+ * \brief Prints a warning for each line of the concordance whose braces
+ * are not balanced
+ *
+ * \param [in] index_file file containing all the matches found by locate
+ */
+void check_concord_braces(const char *index_file, const VersatileEncodingConfig* vec) {
+    U_FILE *concord;
+    unichar* line = NULL;
+    size_t size_buffer_line = 0;
+    int brace_level;
+    int i;
+    int l;
+
+    concord = u_fopen(vec, index_file, U_READ);
+    if( concord == NULL){
+        fatal_error("Cannot open file %s\n",index_file);
+        exit(1);
+    }
+    while (u_fgets_dynamic_buffer(&line, &size_buffer_line, concord) != EOF) {
+
+
+        brace_level = 0;
+        i=0;
+        l=u_strlen(line);
+        while(i<l) {
+            if(line[i]=='{')
+                brace_level++;
+            else if(line[i]=='}')
+                brace_level--;
+            i++;
+        }
+        if( brace_level!=0){
+            error("File %s\nProblem of brackets in line %S\n", index_file, line);
+            error("cassys_tokenize_word_by_word : correct the current graph if possible.\n");
+        }
+    }
+    u_fclose(concord);
+    if (line != NULL) {
+        free(line);
+    }
+}
+
 /**
  * \brief Calls the Concord program in Cassys
  *
@@ -307,40 +350,7 @@ int launch_concord_in_Cassys(const char *text_name, const char *index_file, cons
         exit(1);
     }
 
-    // verify the braces in concordance
-            U_FILE *concord;
-            unichar* line = NULL;
-            size_t size_buffer_line = 0;
-            int brace_level;
-            int i;
-            int l;
-
-            concord = u_fopen(vec, index_file, U_READ);
-            if( concord == NULL){
-                fatal_error("Cannot open file %s\n",index_file);
-                exit(1);
-            }
-            while (u_fgets_dynamic_buffer(&line, &size_buffer_line, concord) != EOF) {
-
-
-                brace_level = 0;
-                i=0;
-                l=u_strlen(line);
-                while(i<l) {
-                    if(line[i]=='{')
-                        brace_level++;
-                    else if(line[i]=='}')
-                        brace_level--;
-                    i++;
-                }
-                if( brace_level!=0){
-                    error("File %s\nProblem of brackets in line %S\n", index_file, line);
-                    error("cassys_tokenize_word_by_word : correct the current graph if possible.\n");
-                }
-            }
-            u_fclose(concord);
-
-    // end of veifying braces
+    check_concord_braces(index_file, vec);
 
     add_argument(invoker,index_file);
 
@@ -392,9 +402,6 @@ int launch_concord_in_Cassys(const char *text_name, const char *index_file, cons
     int result = cassys_invoke(invoker, display_perf, time_elapsed);
 
     free_ProgramInvoker(invoker);
-    if (line != NULL) {
-        free(line);
-    }
 
     free(tmp);
     return result;
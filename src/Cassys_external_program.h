@@ -56,6 +56,16 @@ int launch_locate_in_Cassys(const char *text_name,
 
 
 
+/**
+ * brief Warns about the lines of a concordance whose braces are not balanced
+ *
+ * This check is done before the outputs of the concordance are merged with the text.
+ *
+ * \param index_file name of the file containing the matches
+ */
+void check_concord_braces(const char *index_file, const VersatileEncodingConfig* vec);
+
+
 /**
  * brief Calls the concord program
  *
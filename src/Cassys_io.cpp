@@ -81,7 +81,9 @@ void cleanup_work_directory_content(char* path)
     remove_file_in_path(path, "concord.n", 0);
     remove_file_in_path(path, "concord.txt", 0);
     remove_file_in_path(path, "dlc", 0);
+    remove_file_in_path(path, "dlc.cache", 0);
     remove_file_in_path(path, "dlf", 0);
+    remove_file_in_path(path, "dlf.cache", 0);
     remove_file_in_path(path, "enter.pos", 1);
     remove_file_in_path(path, "err", 0);
     remove_file_in_path(path, "stat_dic.n", 0);
@@ -120,6 +122,22 @@ int copy_directory_snt_content(const char*dest_snt_dir, const char*src_snd_dir,
 }
 
 
+int copy_tokenization_snt_content(const char*dest_snt_dir, const char*src_snd_dir)
+{
+    int result=1;
+
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"text.cod",1);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"tokens.txt",1);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"enter.pos",1);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"stats.n",0);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"tok_by_alph.txt",0);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"tok_by_freq.txt",0);
+    result = result && copy_directory_snt_item(dest_snt_dir,src_snd_dir,"snt_offsets.pos",0);
+
+    return result;
+}
+
+
 void get_csc_path(const char* filename, char* result) {
 
     get_path(filename, result);
@@ -119,6 +119,17 @@ char* create_labeled_files_and_directory(
  */
 int copy_directory_snt_content(const char *dest, const char *src, int contain_mandatory_files);
 
+/**
+ * \brief Copies the files produced by Tokenize from the snt directory \b src
+ * into the snt directory \b dest
+ *
+ * This allows a stage of the cascade to reuse the tokenization of a text that
+ * has not been modified since it was tokenized.
+ *
+ * @return 1 on success, 0 if one of text.cod, tokens.txt or enter.pos could not be copied
+ */
+int copy_tokenization_snt_content(const char *dest, const char *src);
+
 
 
 
@@ -322,11 +322,10 @@ cassys_tokens_list *add_replaced_text(
             const char *text, cassys_tokens_list *list,
             int previous_transducer, int previous_iteration,
             int transducer_id, int iteration,
-            const char *alphabet_name,
+            const Alphabet *alphabet,
             const VersatileEncodingConfig* vec, cassys_tokens_allocation_tool * allocation_tool) {
 
     locate_pos *prev_l=NULL;
-    Alphabet *alphabet = load_alphabet(vec,alphabet_name);
 
     struct snt_files *snt_text_files = new_snt_files(text);
 
@@ -395,7 +394,6 @@ cassys_tokens_list *add_replaced_text(
     }
     free_fifo(stage_concord);
     free_snt_files(snt_text_files);
-    free_alphabet(alphabet);
 
     return list;
 }
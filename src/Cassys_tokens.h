@@ -30,6 +30,7 @@
 #include "List_ustring.h"
 #include "Vector.h"
 #include "Text_tokens.h"
+#include "Alphabet.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -115,7 +116,7 @@ cassys_tokens_list *cassys_load_text(const VersatileEncodingConfig*,const char *
          struct text_tokens **tokens, const vector_int* uima_offset, cassys_tokens_allocation_tool * allocation_tool);
 
 cassys_tokens_list *add_replaced_text(const char *text, cassys_tokens_list *list, int previous_transducer, int previous_iteration,
-         int transducer_id, int iteration, const char *alphabet, const VersatileEncodingConfig*, cassys_tokens_allocation_tool * allocation_tool);
+         int transducer_id, int iteration, const Alphabet *alphabet, const VersatileEncodingConfig*, cassys_tokens_allocation_tool * allocation_tool);
 
 //void free_cassys_tokens_list(cassys_tokens_list *l);
 
@@ -31,19 +31,19 @@
 namespace unitex {
 
 void increment_reference_DLC_tree_node(struct DLC_tree_node*);
-void decrement_reference_DLC_tree_node(struct DLC_tree_node*);
+void decrement_reference_DLC_tree_node(struct DLC_tree_node*,Abstract_allocator);
 static void quicksort(int*,int);
 static void quicksort2(int*,void**,int);
-IntSequence clone_IntSequence(IntSequence);
+IntSequence clone_IntSequence(IntSequence,Abstract_allocator);
 int compare_IntSequence(IntSequence,IntSequence);
 
 
 /**
  * Allocates, initializes and returns a compound word tree node.
  */
-struct DLC_tree_node* new_DLC_tree_node() {
+struct DLC_tree_node* new_DLC_tree_node(Abstract_allocator prv_alloc) {
 struct DLC_tree_node* n;
-n=(struct DLC_tree_node*)malloc(sizeof(struct DLC_tree_node));
+n=(struct DLC_tree_node*)malloc_cb(sizeof(struct DLC_tree_node),prv_alloc);
 if (n==NULL) {
     fatal_alloc_error("new_DLC_tree_node");
 }
@@ -62,9 +62,9 @@ return n;
 /**
  * Allocates, initializes and returns a compound word tree transition.
  */
-struct DLC_tree_transition* new_DLC_tree_transition() {
+struct DLC_tree_transition* new_DLC_tree_transition(Abstract_allocator prv_alloc) {
 struct DLC_tree_transition* t;
-t=(struct DLC_tree_transition*)malloc(sizeof(struct DLC_tree_transition));
+t=(struct DLC_tree_transition*)malloc_cb(sizeof(struct DLC_tree_transition),prv_alloc);
 if (t==NULL) {
     fatal_alloc_error("new_DLC_tree_transition");
 }
@@ -88,7 +88,9 @@ struct DLC_tree_info* DLC_tree=(struct DLC_tree_info*)malloc(sizeof(struct DLC_t
 if (DLC_tree==NULL) {
     fatal_alloc_error("new_DLC_tree");
 }
-DLC_tree->root=new_DLC_tree_node();
+DLC_tree->prv_alloc=create_abstract_allocator("new_DLC_tree",
+                                              AllocatorCreationFlagAutoFreePrefered | AllocatorFreeOnlyAtAllocatorDelete);
+DLC_tree->root=new_DLC_tree_node(DLC_tree->prv_alloc);
 DLC_tree->index=(struct DLC_tree_node**)malloc(number_of_tokens*sizeof(struct DLC_tree_node*));
 if (DLC_tree->index==NULL) {
    fatal_alloc_error("new_DLC_tree");
@@ -104,13 +106,13 @@ return DLC_tree;
  * Frees a transition list. For each transition, the destination node is
  * also freed.
  */
-void free_DLC_tree_transitions(struct DLC_tree_transition* transitions) {
+void free_DLC_tree_transitions(struct DLC_tree_transition* transitions,Abstract_allocator prv_alloc) {
 struct DLC_tree_transition* tmp;
 while (transitions!=NULL) {
-    decrement_reference_DLC_tree_node(transitions->node);
-    if (transitions->token_sequence!=NULL) free(transitions->token_sequence);
+    decrement_reference_DLC_tree_node(transitions->node,prv_alloc);
+    if (transitions->token_sequence!=NULL) free_cb(transitions->token_sequence,prv_alloc);
     tmp=transitions->next;
-    free(transitions);
+    free_cb(transitions,prv_alloc);
     transitions=tmp;
 }
 }
@@ -131,32 +133,36 @@ node->count_reference++;
  *          so, in order to avoid double freeing, the programmer must take care not
  *          to have a same node referenced in both 'transitions' and 'destination_nodes'.
  */
-void decrement_reference_DLC_tree_node(struct DLC_tree_node* node) {
+void decrement_reference_DLC_tree_node(struct DLC_tree_node* node,Abstract_allocator prv_alloc) {
 if (node==NULL) return;
 node->count_reference--;
 if (node->count_reference>0) return ;
 
-free_list_int(node->patterns);
-if (node->array_of_patterns!=NULL) free(node->array_of_patterns);
-free_DLC_tree_transitions(node->transitions);
-if (node->destination_tokens!=NULL) free(node->destination_tokens);
+free_list_int(node->patterns,prv_alloc);
+if (node->array_of_patterns!=NULL) free_cb(node->array_of_patterns,prv_alloc);
+free_DLC_tree_transitions(node->transitions,prv_alloc);
+if (node->destination_tokens!=NULL) free_cb(node->destination_tokens,prv_alloc);
 if (node->destination_nodes!=NULL) {
     for (int i=0;i<node->number_of_transitions;i++) {
-                decrement_reference_DLC_tree_node(node->destination_nodes[i]);
+                decrement_reference_DLC_tree_node(node->destination_nodes[i],prv_alloc);
     }
-    free(node->destination_nodes);
+    free_cb(node->destination_nodes,prv_alloc);
 }
-free(node);
+free_cb(node,prv_alloc);
 }
 
 
 /**
- * Frees a compound word tree.
+ * Frees a compound word tree. If its allocator auto frees, the nodes
+ * are not visited: they are all released with the allocator.
  */
 void free_DLC_tree(struct DLC_tree_info* DLC_tree) {
 if (DLC_tree==NULL) return;
 if (DLC_tree->index!=NULL) free(DLC_tree->index);
-decrement_reference_DLC_tree_node(DLC_tree->root);
+if ((get_allocator_cb_flag(DLC_tree->prv_alloc) & AllocatorGetFlagAutoFreePresent)==0) {
+   decrement_reference_DLC_tree_node(DLC_tree->root,DLC_tree->prv_alloc);
+}
+close_abstract_allocator(DLC_tree->prv_alloc);
 free(DLC_tree);
 }
 
@@ -224,11 +230,11 @@ tokens[n_token]=END_TOKEN_LIST;
  * This function adds a pattern number to the pattern list of a given
  * compound word tree node.
  */
-void add_pattern_to_DLC_tree_node(struct DLC_tree_node* node,int pattern) {
+void add_pattern_to_DLC_tree_node(struct DLC_tree_node* node,int pattern,Abstract_allocator prv_alloc) {
 struct list_int *previous;
 if (node->patterns==NULL) {
   /* If the list is empty, we add the pattern */
-  node->patterns=new_list_int(pattern);
+  node->patterns=new_list_int(pattern,prv_alloc);
   /* We update the length of the list */
   (node->number_of_patterns)++;
   return;
@@ -239,7 +245,7 @@ if (node->patterns->n==pattern)
   return;
 if (node->patterns->n>pattern) {
   /* If we must insert 'pattern' at the beginning of the list */
-  node->patterns=head_insert(pattern,node->patterns);
+  node->patterns=head_insert(pattern,node->patterns,prv_alloc);
   /* We update the length of the list */
   (node->number_of_patterns)++;
   return;
@@ -256,7 +262,7 @@ while (!stop && previous->next!=NULL) {
     else stop=1;
 }
 /* If must insert the pattern */
-previous->next=head_insert(pattern,previous->next);
+previous->next=head_insert(pattern,previous->next,prv_alloc);
 /* We update the length of the list */
 (node->number_of_patterns)++;
 return;
@@ -269,18 +275,19 @@ return;
  * tagged by 'token' is found. Otherwise, a transition is created, and the destination
  * node of this transition is created and returned.
  */
-struct DLC_tree_node* get_DLC_tree_node(struct DLC_tree_node* node,IntSequence token_sequence,int create_if_necessary) {
+struct DLC_tree_node* get_DLC_tree_node(struct DLC_tree_node* node,IntSequence token_sequence,int create_if_necessary,
+                                        Abstract_allocator prv_alloc) {
 struct DLC_tree_transition* l;
 if (node->transitions==NULL) {
   /* If the list is empty */
   /* We return if the function must not create the node */
   if (!create_if_necessary) return NULL;
   /* Otherwise, we create a transition */
-  l=new_DLC_tree_transition();
-  l->token_sequence=clone_IntSequence(token_sequence);
+  l=new_DLC_tree_transition(prv_alloc);
+  l->token_sequence=clone_IntSequence(token_sequence,prv_alloc);
   l->next=node->transitions;
   /* And we create the destination node of this transition */
-  l->node=new_DLC_tree_node();
+  l->node=new_DLC_tree_node(prv_alloc);
   node->transitions=l;
   /* Finally we return the created node */
   return l->node;
@@ -295,11 +302,11 @@ if (compare<0) {
   /* We return if the function must not create the node */
   if (!create_if_necessary) return NULL;
   /* Otherwise, we create a transition */
-  l=new_DLC_tree_transition();
-  l->token_sequence=clone_IntSequence(token_sequence);
+  l=new_DLC_tree_transition(prv_alloc);
+  l->token_sequence=clone_IntSequence(token_sequence,prv_alloc);
   l->next=node->transitions;
   /* And we create the destination node of this transition */
-  l->node=new_DLC_tree_node();
+  l->node=new_DLC_tree_node(prv_alloc);
   node->transitions=l;
   /* Finally we return the created node */
   return l->node;
@@ -319,10 +326,10 @@ while (!stop && previous->next!=NULL) {
 /* We return if the function must not create the node */
 if (!create_if_necessary) return NULL;
 /* Otherwise, we create a transition */
-l=new_DLC_tree_transition();
-l->token_sequence=clone_IntSequence(token_sequence);
+l=new_DLC_tree_transition(prv_alloc);
+l->token_sequence=clone_IntSequence(token_sequence,prv_alloc);
 /* And we create the destination node of this transition */
-l->node=new_DLC_tree_node();
+l->node=new_DLC_tree_node(prv_alloc);
 l->next=previous->next;
 previous->next=l;
 (node->number_of_transitions)++;
@@ -349,12 +356,12 @@ return l->node;
  *
  * 'DLC_tree' represents the tree and the compound word index.
  */
-void associate_pattern_to_compound_word(int* token_list,int pos,struct DLC_tree_node* node,
+void associate_pattern_to_compound_word(const int* token_list,int pos,struct DLC_tree_node* node,
                 int pattern,struct DLC_tree_info* DLC_tree) {
 if (token_list[pos]==END_TOKEN_LIST) {
    /* If we are at the end of the token list, we
     * add the pattern number to the current node */
-   add_pattern_to_DLC_tree_node(node,pattern);
+   add_pattern_to_DLC_tree_node(node,pattern,DLC_tree->prv_alloc);
    return;
 }
 int int_sequence[256];
@@ -379,7 +386,7 @@ if (token_list[pos]!=BEGIN_CASE_VARIANT_LIST) {
    quicksort(int_sequence,j-1);
 }
 /* Then, we look for the node that we can reach with our int sequence */
-struct DLC_tree_node* ptr=get_DLC_tree_node(node,int_sequence,1);
+struct DLC_tree_node* ptr=get_DLC_tree_node(node,int_sequence,1,DLC_tree->prv_alloc);
 associate_pattern_to_compound_word(token_list,pos,ptr,pattern,DLC_tree);
 }
 
@@ -408,15 +415,26 @@ associate_pattern_to_compound_word(token_list,0,DLC_tree->root,pattern,DLC_tree)
 }
 
 
+/**
+ * Adds a compound word to the tree 'DLC_tree' with the pattern
+ * number 'pattern'. The compound word is given as a token list that
+ * has already been computed by 'tokenize_compound_word'.
+ */
+void add_compound_word_token_list_with_pattern(const int* token_list,int pattern,
+                            struct DLC_tree_info* DLC_tree) {
+associate_pattern_to_compound_word(token_list,0,DLC_tree->root,pattern,DLC_tree);
+}
+
+
 
 /**
  * This function inserts 'pattern2' in the pattern list of 'node' if and
  * only if the liste contains 'pattern1'. It returns 1 on success, 0
  * otherwise.
  */
-int conditional_pattern_insertion(struct DLC_tree_node* node,int pattern1,int pattern2) {
+int conditional_pattern_insertion(struct DLC_tree_node* node,int pattern1,int pattern2,Abstract_allocator prv_alloc) {
 if (is_in_list(pattern1,node->patterns)) {
-  add_pattern_to_DLC_tree_node(node,pattern2);
+  add_pattern_to_DLC_tree_node(node,pattern2,prv_alloc);
   return 1;
 }
 return 0;
@@ -444,13 +462,13 @@ return 0;
 
  * 'pattern2' is the pattern number to add.
  *
- * 'DLC_tree' represents the tree and the compound word index.
+ * 'prv_alloc' is the allocator of the tree.
  */
 int conditional_insertion_in_DLC_tree_node(int* token_list,int pos,struct DLC_tree_node* node,
-                                        int pattern1,int pattern2) {
+                                        int pattern1,int pattern2,Abstract_allocator prv_alloc) {
 if (token_list[pos]==END_TOKEN_LIST) {
    /* If we are at the end of the token list */
-   return conditional_pattern_insertion(node,pattern1,pattern2);
+   return conditional_pattern_insertion(node,pattern1,pattern2,prv_alloc);
 }
 int int_sequence[256];
 if (token_list[pos]!=BEGIN_CASE_VARIANT_LIST) {
@@ -472,8 +490,8 @@ if (token_list[pos]!=BEGIN_CASE_VARIANT_LIST) {
    quicksort(int_sequence,j);
 }
 /* Then, we look for the node that we can reach with our int sequence */
-struct DLC_tree_node* ptr=get_DLC_tree_node(node,int_sequence,0);
-if (ptr!=NULL) return conditional_insertion_in_DLC_tree_node(token_list,pos,ptr,pattern1,pattern2);
+struct DLC_tree_node* ptr=get_DLC_tree_node(node,int_sequence,0,prv_alloc);
+if (ptr!=NULL) return conditional_insertion_in_DLC_tree_node(token_list,pos,ptr,pattern1,pattern2,prv_alloc);
 return 0;
 }
 
@@ -491,7 +509,7 @@ int conditional_insertion_in_DLC_tree(unichar* word,int pattern1,int pattern2,co
                         struct string_hash* tok,struct DLC_tree_info* infos,TokenizationPolicy tokenization_mode) {
 int token_list[MAX_TOKEN_IN_A_COMPOUND_WORD];
 tokenize_compound_word(word,token_list,alph,tok,tokenization_mode);
-return conditional_insertion_in_DLC_tree_node(token_list,0,infos->root,pattern1,pattern2);
+return conditional_insertion_in_DLC_tree_node(token_list,0,infos->root,pattern1,pattern2,infos->prv_alloc);
 }
 
 
@@ -525,14 +543,14 @@ return res;
  * arrays that correspond to the 'token' and 'node' fields of the
  * DLC_tree_transition structure.
  */
-void optimize_DLC_node(struct DLC_tree_node* n) {
+void optimize_DLC_node(struct DLC_tree_node* n,Abstract_allocator prv_alloc) {
 struct list_int* tmp;
 struct DLC_tree_transition* t;
 int i;
 if (n==NULL) return;
 if (n->number_of_patterns!=0) {
    /* We allocate the array for pattern numbers and we fill it */
-   n->array_of_patterns=(int*)malloc(sizeof(int)*n->number_of_patterns);
+   n->array_of_patterns=(int*)malloc_cb(sizeof(int)*n->number_of_patterns,prv_alloc);
    if (n->array_of_patterns==NULL) {
       fatal_alloc_error("optimize_DLC_node");
    }
@@ -541,18 +559,18 @@ if (n->number_of_patterns!=0) {
      n->array_of_patterns[i++]=n->patterns->n;
      tmp=n->patterns;
      n->patterns=n->patterns->next;
-     free(tmp);
+     free_cb(tmp,prv_alloc);
    }
 }
 n->number_of_transitions=count_actual_transitions(n);
 if (n->transitions!=NULL) {
    /* We allocate the arrays for representing (token,node) pairs of
     * transitions and fill them */
-   n->destination_tokens=(int*)malloc(sizeof(int)*n->number_of_transitions);
+   n->destination_tokens=(int*)malloc_cb(sizeof(int)*n->number_of_transitions,prv_alloc);
    if (n->destination_tokens==NULL) {
       fatal_alloc_error("optimize_DLC_node");
    }
-   n->destination_nodes=(struct DLC_tree_node**)malloc(sizeof(struct DLC_tree_node*)*n->number_of_transitions);
+   n->destination_nodes=(struct DLC_tree_node**)malloc_cb(sizeof(struct DLC_tree_node*)*n->number_of_transitions,prv_alloc);
    if (n->destination_nodes==NULL) {
       fatal_alloc_error("optimize_DLC_node");
    }
@@ -560,7 +578,7 @@ if (n->transitions!=NULL) {
    i=0;
    while (n->transitions!=NULL) {
      /* Recursively, we optimize the destination node */
-     optimize_DLC_node(n->transitions->node);
+     optimize_DLC_node(n->transitions->node,prv_alloc);
      int* token_sequence=n->transitions->token_sequence;
      for (int j=0;token_sequence[j]!=-1;j++) {
         n->destination_nodes[i]=n->transitions->node;
@@ -572,9 +590,9 @@ if (n->transitions!=NULL) {
      n->transitions=n->transitions->next;
      /* WARNING: don't call free_DLC_tree_transitions(t), because it would
       *          free the destination node that is still used. */
-     free(t->token_sequence);
-     decrement_reference_DLC_tree_node(t->node);
-     free(t);
+     free_cb(t->token_sequence,prv_alloc);
+     decrement_reference_DLC_tree_node(t->node,prv_alloc);
+     free_cb(t,prv_alloc);
    }
    /* Finally, we sort the n->destination_nodes and n->destination_tokens
     * arrays according to the tokens' numbers. */
@@ -588,7 +606,7 @@ if (n->transitions!=NULL) {
  * all transition and pattern lists by sorted arrays.
  */
 void optimize_DLC(struct DLC_tree_info* DLC_tree) {
-optimize_DLC_node(DLC_tree->root);
+optimize_DLC_node(DLC_tree->root,DLC_tree->prv_alloc);
 }
 
 
@@ -696,11 +714,11 @@ quicksort2(0,size-1,array1,array2);
 /**
  * Allocates and returns a copy of the given IntSequence.
  */
-IntSequence clone_IntSequence(IntSequence src) {
+IntSequence clone_IntSequence(IntSequence src,Abstract_allocator prv_alloc) {
 if (src==NULL) return NULL;
 int l;
 for (l=0;src[l]!=-1;l++) {}
-IntSequence dst=(IntSequence)malloc((l+1)*sizeof(int));
+IntSequence dst=(IntSequence)malloc_cb((l+1)*sizeof(int),prv_alloc);
 if (dst==NULL) {
    fatal_alloc_error("clone_IntSequence");
 }
@@ -27,6 +27,7 @@
 #include "String_hash.h"
 #include "List_int.h"
 #include "LocateConstants.h"
+#include "AbstractAllocator.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -152,6 +153,9 @@ struct DLC_tree_transition {
 struct DLC_tree_info {
     struct DLC_tree_node* root;
     struct DLC_tree_node** index;
+    /* Nodes, transitions and their arrays come from this allocator, so
+     * that a big tree can be dropped at once when it auto frees */
+    Abstract_allocator prv_alloc;
 };
 
 
@@ -160,6 +164,7 @@ void free_DLC_tree(struct DLC_tree_info*);
 void tokenize_compound_word(const unichar*,int*,const Alphabet*,struct string_hash*,TokenizationPolicy);
 void add_compound_word_with_no_pattern(const unichar*,const Alphabet*,struct string_hash*,struct DLC_tree_info*,TokenizationPolicy);
 void add_compound_word_with_pattern(const unichar*,int,const Alphabet*,struct string_hash*,struct DLC_tree_info*,TokenizationPolicy);
+void add_compound_word_token_list_with_pattern(const int*,int,struct DLC_tree_info*);
 int conditional_insertion_in_DLC_tree(const unichar*,int,int,const Alphabet*,struct string_hash*,struct DLC_tree_info*,TokenizationPolicy);
 void optimize_DLC(struct DLC_tree_info*);
 
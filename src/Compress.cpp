@@ -62,6 +62,18 @@ const char* usage_Compress =
 "  -s, --semitic                   uses the semitic compression algorithm. This\n"
 "                                  option is useful to reduce the size of the\n"
 "                                  output when dealing with semitic languages\n"
+"  --sorted                        specifies that the entries are sorted by\n"
+"                                  inflected form, as done by SortTxt. The\n"
+"                                  minimal automaton is then built while reading\n"
+"                                  the entries, which needs much less memory.\n"
+"                                  The output is the same as without this\n"
+"                                  option. Entries with = compounds, such as\n"
+"                                  pomme=de=terre, cannot be built in this way,\n"
+"                                  because their forms with a space and with a\n"
+"                                  hyphen do not sort where SortTxt puts the\n"
+"                                  line: if one is found, a warning is printed\n"
+"                                  and the dictionaries are read again as\n"
+"                                  without --sorted\n"
 " \n"
 "Output options:\n"
 "  -t TYPE, --output_type=TYPE     specifies the type of the output file.\n"
@@ -73,6 +85,15 @@ const char* usage_Compress =
 "                                  [default: bin1]\n"
 "  -o BINFILE, --output=BINFILE    filename used to write the produced automaton\n"
 "  -p, --pack-inf                  create a packed inf file (.inp)\n"
+"  -j N, --threads=N               minimizes the dictionary tree with N threads,\n"
+"                                  each one taking the entries that start with\n"
+"                                  a given letter. The output is the same as\n"
+"                                  with a single thread [default: 1]\n"
+"  -i, --indexed                   adds a char index to the states that have many\n"
+"                                  transitions, in order to speed up dictionary\n"
+"                                  lookups. The output can only be read by a\n"
+"                                  Unitex version that supports indexed states.\n"
+"                                  Not compatible with --v1\n"
 " \n"
 "Deprecated options:\n"
 "  --v1                            produces an old style .bin file with a size\n"
@@ -94,15 +115,18 @@ const char* usage_Compress =
 "  --version                       show version and exit\n"
 "";
 
-const char* optstring_Compress = ":fpo:hk:t:Vq:s";
+const char* optstring_Compress = ":fpio:hk:t:Vq:sj:";
 
 const struct option_TS lopts_Compress[] = {
   { (char *) "bin2"                 , no_argument_TS       , NULL,   2  },
   { (char *) "pack-inf"             , no_argument_TS       , NULL,  'p' },
+  { (char *) "indexed"              , no_argument_TS       , NULL,  'i' },
   { (char *) "flip"                 , no_argument_TS       , NULL,  'f' },
   { (char *) "help"                 , no_argument_TS       , NULL,  'h' },
   { (char *) "only-verify-arguments", no_argument_TS       , NULL,  'V' },
   { (char *) "semitic"              , no_argument_TS       , NULL,  's' },
+  { (char *) "sorted"               , no_argument_TS       , NULL,   5  },
+  { (char *) "threads"              , required_argument_TS , NULL,  'j' },
   { (char *) "v1"                   , no_argument_TS       , NULL,   3  },
   { (char *) "v2"                   , no_argument_TS       , NULL,   4  },
   { (char *) "version"              , no_argument_TS       , NULL,   1  },
@@ -121,10 +145,15 @@ static void usage() {
 static const size_t step_filename_buffer =
                     ((((DIC_WORD_SIZE * sizeof(unichar)) / 0x10) + 1) * 0x10);
 
+// returned while building the sorted automaton when an entry with = compounds
+// is found, so that the dictionaries are read again without --sorted
+static const int UNSORTED_ENTRY_CODE = -1;
+
 // function used to minimize a dictionary tree, i.e. to construct a minimal ADFA
 typedef void(*minimize_func)(struct dictionary_node* root,
                              struct bit_array* used_inf_values,
-                             Abstract_allocator prv_alloc);
+                             Abstract_allocator prv_alloc,
+                             int n_threads);
 
 /**
  * This function writes the number of INF codes 'n' at the beginning
@@ -150,6 +179,30 @@ static void write_INF_file_header(const VersatileEncodingConfig* vec,
   u_fclose(f);
 }
 
+/**
+ * Inserts an entry in the dictionary tree or, if \a sorted is not NULL,
+ * in the minimal automaton being built. Returns 0 if the entry breaks
+ * the order required by \a sorted; 1 otherwise
+ */
+static int insert_entry(unichar* inflected,
+                        unichar* compress_line,
+                        struct dictionary_node* root,
+                        struct string_hash* inf_codes,
+                        int line,
+                        struct sorted_dictionary* sorted,
+                        Abstract_allocator compress_abstract_allocator) {
+  if (sorted != NULL) {
+    return add_entry_to_sorted_dictionary(sorted, inflected, compress_line);
+  }
+  add_entry_to_dictionary_tree(inflected,
+                               compress_line,
+                               root,
+                               inf_codes,
+                               line,
+                               compress_abstract_allocator);
+  return 1;
+}
+
 /**
  * @brief Builds a tree representation of a DELAF dictionary
  *
@@ -169,6 +222,9 @@ static void write_INF_file_header(const VersatileEncodingConfig* vec,
  * @param[out] n_lines total lines scanned including comments
  * @param[out] n_line_errors total lines errors including comments
  * @param[out] n_file_includes total files included from \a filename
+ * @param[in,out] sorted if not NULL, the automaton to which entries are added
+ *                instead of \a root. UNSORTED_ENTRY_CODE is returned if an
+ *                entry with = compounds is found
  * @return SUCCESS_RETURN_CODE or other status code. See Error.h for details
  * @author Cristian Martinez (based in a previous version of Sébastien Paumier)
  */
@@ -184,6 +240,7 @@ static int build_tree_from_dictionary(
                      int* n_lines,
                      int* n_line_errors,
                      int* n_file_includes,
+                     struct sorted_dictionary* sorted,
                      Abstract_allocator compress_abstract_allocator,
                      Abstract_allocator compress_tokenize_abstract_allocator) {
   // reserve some heap memory to manipule strings
@@ -239,6 +296,9 @@ static int build_tree_from_dictionary(
   // represents an entry of the current dictionary
   struct dela_entry* entry = NULL;
 
+  // set to 0 when an entry could not be added to the sorted automaton
+  int inserted = 1;
+
   // set to 1 when the abstract allocator
   int tokenize_allocator_has_clean = ((get_allocator_flag(
                                        compress_tokenize_abstract_allocator) &
@@ -393,6 +453,25 @@ static int build_tree_from_dictionary(
           entry->inflected = entry->lemma;
           entry->lemma     = o;
         }
+        if (sorted != NULL &&
+            (contains_unprotected_equal_sign(entry->inflected)
+             || contains_unprotected_equal_sign(entry->lemma))) {
+          /* SortTxt places pomme=de=terre after pomme-de-terre..., but
+           * "pomme de terre" must be added before them: the sorted
+           * automaton cannot take this entry, so we give up --sorted */
+          error("%s:%d: entry with = compounds, ignoring --sorted\n",
+                filename_without_path(filename_as_char),
+                current_line+1);
+#         if (defined(UNITEX_LIBRARY) || defined(UNITEX_RELEASE_MEMORY_AT_EXIT))
+          if (tokenize_allocator_has_clean == 0) {
+            free_dela_entry(entry, compress_tokenize_abstract_allocator);
+          }
+#         endif
+          free_Ustring(line);
+          u_fclose(file_handler);
+          free(heap_buffer);
+          return UNSORTED_ENTRY_CODE;
+        }
         if (contains_unprotected_equal_sign(entry->inflected)
             || contains_unprotected_equal_sign(entry->lemma)) {
           /* If the inflected form or lemma contains any unprotected = sign,
@@ -429,12 +508,13 @@ static int build_tree_from_dictionary(
 
           // we insert "pomme de terre, pomme de terre.N"
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          inserted = insert_entry(entry->inflected,
+                                  compress_line,
+                                  root,
+                                  inf_codes,
+                                  current_line,
+                                  sorted,
+                                  compress_abstract_allocator);
 
           // and then we insert "pomme-de-terre, pomme-de-terre.N"
           u_strcpy(entry->inflected, inf_tmp);
@@ -448,20 +528,22 @@ static int build_tree_from_dictionary(
           replace_unprotected_equal_sign(entry->inflected, (unichar)'-');
           replace_unprotected_equal_sign(entry->lemma, (unichar)'-');
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          inserted = inserted && insert_entry(entry->inflected,
+                                              compress_line,
+                                              root,
+                                              inf_codes,
+                                              current_line,
+                                              sorted,
+                                              compress_abstract_allocator);
         } else {
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          inserted = insert_entry(entry->inflected,
+                                  compress_line,
+                                  root,
+                                  inf_codes,
+                                  current_line,
+                                  sorted,
+                                  compress_abstract_allocator);
         }
 
         // and last, but not least: don't forget to free your memory
@@ -471,6 +553,19 @@ static int build_tree_from_dictionary(
         } else {
           clean_allocator(compress_tokenize_abstract_allocator);
         }
+
+        // with --sorted, an entry that breaks the order cannot be added
+        if (!inserted) {
+          error("%s:%d: entry is not sorted by inflected form, "
+                "cannot use --sorted\n",
+                filename_without_path(filename_as_char),
+                current_line+1);
+          (*n_line_errors)++;
+          free_Ustring(line);
+          u_fclose(file_handler);
+          free(heap_buffer);
+          return DEFAULT_ERROR_CODE;
+        }
         // only increment if the entry is well-formed
         current_entry++;
         break;
@@ -521,6 +616,9 @@ static int build_tree_from_dictionary(
  * @param[out] root initial state of the dictionary tree
  * @param[out] inf_codes all the INF codes used by the dictionary tree
  * @param[out] n_files total file read
+ * @param[in,out] sorted if not NULL, the automaton to which entries are added
+ *                instead of \a root. UNSORTED_ENTRY_CODE is returned if an
+ *                entry with = compounds is found
  * @param[out] n_lines total lines scanned including commentaries
  * @param[out] n_entries total entries processed without file commentaries
  * @return SUCCESS_RETURN_CODE or other status code. See Error.h for details
@@ -537,6 +635,7 @@ static int build_tree_from_dictionary_list(
                      int* n_lines,
                      int* n_line_errors,
                      int* n_files,
+                     struct sorted_dictionary* sorted,
                      Abstract_allocator compress_abstract_allocator,
                      Abstract_allocator compress_tokenize_abstract_allocator) {
   // number of entries that were processed in the file that is being read
@@ -579,6 +678,7 @@ static int build_tree_from_dictionary_list(
        &current_file_total_lines,              // lines scanned
        &current_file_total_line_errors,        // lines with errors
        &current_file_total_includes,           // total includes
+       sorted,                                 // NULL or the sorted automaton
        compress_abstract_allocator,
        compress_tokenize_abstract_allocator);
 
@@ -689,13 +789,17 @@ static int create_and_save_inf(const VersatileEncodingConfig* vec,
  * @param[in] bin_filename null-terminated string, with the output .bin filename
  * @param[in] inf_filename null-terminated string, with the output .inf filename
  * @param[in] new_style_bin  set 0: old style, 1: new style (bin > 16Mb)
+ * @param[in] indexed  set 1 to add a char index to wide states
  * @param[in] inf_codes all the INF codes used by the dictionary tree
  * @param[in] minimize function that minimizes the dictionary tree
  * @param[in,out] root initial state of the dictionary tree
+ * @param[in,out] sorted if not NULL, the automaton that was built instead of
+ *                the tree, which only needs to be finished
  * @param[out] n_inf_codes total number of inflectional codes used
  * @param[out] n_states total number of states of the automaton
  * @param[out] n_transitions total number of transitions of the automaton
  * @param[out] bin_size  size of the resulting .bin file
+ * @param[in] n_threads number of threads used to minimize the tree
  * @return SUCCESS_RETURN_CODE or other status code. See Error.h for details
  * @author Cristian Martinez
  */
@@ -704,14 +808,17 @@ static int minimize_and_save_tree_as_bin_classic(
                                     const char* bin_filename,
                                     const char* inf_filename,
                                     int new_style_bin,
+                                    int indexed,
                                     const struct string_hash* INF_codes,
                                     minimize_func minimize,
                                     struct dictionary_node* root,
+                                    struct sorted_dictionary* sorted,
                                     int* n_inf_codes,
                                     int* n_states,
                                     int* n_transitions,
                                     int* bin_size,
-                                    Abstract_allocator prv_alloc = NULL) {
+                                    int n_threads,
+                                   Abstract_allocator prv_alloc = NULL) {
   // Array to iterate in order through INF_codes using indirect references
   int* inf_indirection = (int*) malloc(sizeof(int) * INF_codes->size);
   if (!inf_indirection) {
@@ -723,7 +830,11 @@ static int minimize_and_save_tree_as_bin_classic(
   struct bit_array* used_inf_values = new_bit_array(INF_codes->size, ONE_BIT);
 
   // we build a minimal acyclic automaton
-  minimize(root, used_inf_values, prv_alloc);
+  if (sorted != NULL) {
+    finish_sorted_dictionary(sorted, used_inf_values);
+  } else {
+    minimize(root, used_inf_values, prv_alloc, n_threads);
+  }
 
   // for a classic .bin, we need to create an associated .inf file
   int return_value = create_and_save_inf(
@@ -744,7 +855,8 @@ static int minimize_and_save_tree_as_bin_classic(
                         bin_size,          // size of the resulting .bin file
                         inf_indirection,   // references to reordered INF codes
                         new_style_bin,     // 0: old style, 1: new style (>16Mb)
-                        BIN_CLASSIC);      // a classic .bin type
+                        BIN_CLASSIC,       // a classic .bin type
+                        indexed);          // 1: add a char index to wide states
   }
 
   free_bit_array(used_inf_values);
@@ -756,34 +868,46 @@ static int minimize_and_save_tree_as_bin_classic(
  * @brief Minimizes and save a DELAF dictionary tree into a bin2 file
  *
  * @param[in] bin_filename null-terminated string, with the output .bin2 filename
+ * @param[in] indexed  set 1 to add a char index to wide states
  * @param[in] inf_codes all the INF codes used by the dictionary tree
  * @param[in] minimize function that minimizes the dictionary tree
  * @param[in,out] root initial state of the dictionary tree
+ * @param[in,out] sorted if not NULL, the automaton that was built instead of
+ *                the tree, with outputs already on transitions
  * @param[out] n_inf_codes total number of inflectional codes used
  * @param[out] n_states total number of states of the automaton
  * @param[out] n_transitions total number of transitions of the automaton
  * @param[out] bin_size  size of the resulting .bin file
+ * @param[in] n_threads number of threads used to minimize the tree
  * @return SUCCESS_RETURN_CODE or other status code. See Error.h for details
  * @author Cristian Martinez
  */
 static int minimize_and_save_tree_as_bin_two(
                                    const char* bin_filename,
+                                   int indexed,
                                    struct string_hash* INF_codes,
                                    minimize_func minimize,
                                    struct dictionary_node* root,
+                                   struct sorted_dictionary* sorted,
                                    int* n_states,
                                    int* n_transitions,
                                    int* bin_size,
+                                   int n_threads,
                                    Abstract_allocator prv_alloc = NULL) {
-  // for a .bin2 dictionary, we need to place first the inf codes on
-  // the transitions outputs
-  move_outputs_on_transitions(root, INF_codes);
-
   // bit array to track INF codes that are actually referenced in the .bin file
   struct bit_array* used_inf_values = new_bit_array(INF_codes->size, ONE_BIT);
 
-  // we build a minimal acyclic automaton
-  minimize(root, used_inf_values, prv_alloc);
+  if (sorted != NULL) {
+    // the sorted automaton has moved the inf codes while it was built
+    finish_sorted_dictionary(sorted, used_inf_values);
+  } else {
+    // for a .bin2 dictionary, we need to place first the inf codes on
+    // the transitions outputs
+    move_outputs_on_transitions(root, INF_codes);
+
+    // we build a minimal acyclic automaton
+    minimize(root, used_inf_values, prv_alloc, n_threads);
+  }
 
   // now, try to dump the minimal transducer into a .bin2 file
   create_and_save_bin(root,              // automaton initial state
@@ -793,7 +917,8 @@ static int minimize_and_save_tree_as_bin_two(
                       bin_size,          // size of the resulting .bin file
                       NULL,              // bin2 no use references to INF codes
                       1,                 // always use the new dictionary style
-                      BIN_BIN2);         // a .bin2 dictionary type
+                      BIN_BIN2,          // a .bin2 dictionary type
+                      indexed);          // 1: add a char index to wide states
 
   free_bit_array(used_inf_values);
 
@@ -887,9 +1012,20 @@ int pack_inp = 0;
 //  1 : produces a new style  .bin file, with no file size limitation to 16Mb
 int new_style_bin       = 1;
 
+// 1 : adds a char index to the states that have many transitions
+int indexed             = 0;
+
 // specifies if the semitic compression algorithm will be used
 int semitic             = 0;
 
+// number of threads used to minimize the dictionary tree
+int n_threads           = 1;
+char foo;
+
+// 1 : the entries are sorted, so that the minimal automaton can be
+//     built while reading them
+int sorted_input        = 0;
+
 // describes the encoding configuration for I/O
 VersatileEncodingConfig vec = VEC_DEFAULT;
 
@@ -901,6 +1037,7 @@ while (EOF != (val = options.parse_long(argc, argv, optstring_Compress, lopts_Co
   switch (val) {
     case 'f': FLIP    = 1; break;
     case 'p': pack_inp = 1; break;
+    case 'i': indexed = 1; break;
     case 's': semitic = 1; break;
     case  1 : // this is according to the "Standards for Command Line Interfaces"
               // https://goo.gl/7UgLC8
@@ -909,6 +1046,15 @@ while (EOF != (val = options.parse_long(argc, argv, optstring_Compress, lopts_Co
     case  2 : new_style_bin = 1; bin_type = BIN_BIN2;    break;
     case  3 : new_style_bin = 0; bin_type = BIN_CLASSIC; break;
     case  4 : new_style_bin = 1; bin_type = BIN_CLASSIC; break;
+    case  5 : sorted_input = 1; break;
+    case 'j': if (1 != sscanf(options.vars()->optarg, "%d%c", &n_threads, &foo) ||
+                  n_threads <= 0) {
+                // foo is used to check that the param is not like "45gjh"
+                error("Invalid thread number argument: %s\n", options.vars()->optarg);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+              }
+              break;
     case 'V': only_verify_arguments = true;
               break;
     case 'h': usage();
@@ -990,6 +1136,13 @@ if (output_type[0] != '\0') {
   }
 }
 
+// old style .bin files have no room for indexed states
+if (indexed && !new_style_bin) {
+  error("--indexed cannot be used with --v1\n");
+  free(buffer_filename);
+  return USAGE_ERROR_CODE;
+}
+
 // returns here if we're only verifying the arguments syntax
 if (only_verify_arguments) {
   // freeing all allocated memory
@@ -1047,21 +1200,34 @@ if(!dictionary_list) {
   return DEFAULT_ERROR_CODE;
 }
 
+// the tree goes to an arena, unless nodes are freed while reading
+// (--sorted) or the tree is minimized by several threads, which cannot
+// share an allocator
 Abstract_allocator compress_abstract_allocator =
     create_abstract_allocator("main_Compress",
-    AllocatorCreationFlagAutoFreePrefered);
+    (sorted_input || n_threads > 1) ? AllocatorCreationFlagAutoFreeUnused
+                                    : AllocatorCreationFlagAutoFreePrefered);
 
 Abstract_allocator compress_tokenize_abstract_allocator =
     create_abstract_allocator("main_Compress_tokenize_first",
     AllocatorCreationFlagAutoFreePrefered |
     AllocatorCreationFlagCleanPrefered);
 
-// root of the dictionary tree
-struct dictionary_node* root  = new_dictionary_node(compress_abstract_allocator);
-
 // structure that will contain all the INF codes
 struct string_hash* INF_codes = new_string_hash();
 
+// with sorted entries, we build the minimal automaton directly
+struct sorted_dictionary* sorted = NULL;
+if (sorted_input) {
+  sorted = new_sorted_dictionary(INF_codes,
+                                 bin_type == BIN_BIN2,
+                                 compress_abstract_allocator);
+}
+
+// root of the dictionary tree
+struct dictionary_node* root  = (sorted != NULL) ? sorted->root :
+                                new_dictionary_node(compress_abstract_allocator);
+
 int return_value  = SUCCESS_RETURN_CODE; // default return code
 int n_entries     = 0;                   // number of entries processed
 int n_lines       = 0;                   // number of lines scanned
@@ -1071,6 +1237,7 @@ int n_inf_codes   = 0;                   // number of inflectional codes used
 int n_states      = 0;                   // number of states of the automaton
 int n_transitions = 0;                   // number of transitions of the automaton
 int bin_size      = 0;                   // size of the resulting .bin file
+int n_dictionaries = length(dictionary_list); // dictionaries given as arguments
 
 // build a tree representation of all the DELAF entries pointed
 // by the files in the dictionary list
@@ -1085,9 +1252,48 @@ return_value = build_tree_from_dictionary_list(
                        &n_lines,         // number of lines scanned
                        &n_line_errors,   // number of line errors
                        &n_files,         // number of files read
+                       sorted,           // NULL or the sorted automaton
                        compress_abstract_allocator,
                        compress_tokenize_abstract_allocator);
 
+// the sorted automaton cannot take = compounds: we drop it and read the
+// dictionaries again to build the tree as without --sorted
+if (return_value == UNSORTED_ENTRY_CODE) {
+  free_dictionary_node(root, compress_abstract_allocator);
+  free_sorted_dictionary(sorted);
+  sorted = NULL;
+  free_string_hash(INF_codes);
+  INF_codes = new_string_hash();
+  root = new_dictionary_node(compress_abstract_allocator);
+
+  // forget the dictionaries that were included, they will be found again
+  list_ustring_ptr last_dictionary = dictionary_list;
+  for (int i = 1; i < n_dictionaries; ++i) {
+    last_dictionary = last_dictionary->next;
+  }
+  free_list_ustring(last_dictionary->next);
+  last_dictionary->next = NULL;
+
+  n_entries     = 0;
+  n_lines       = 0;
+  n_line_errors = 0;
+  n_files       = 0;
+  return_value = build_tree_from_dictionary_list(
+                         &vec,             // I/O encoding
+                         FLIP,             // inflected and lemma must be swapped
+                         semitic,          // semitic compression algorithm
+                         dictionary_list,  // dictionaries filenames
+                         root,             // automaton initial state
+                         INF_codes,        // all the INF codes
+                         &n_entries,       // number of entries processed
+                         &n_lines,         // number of lines scanned
+                         &n_line_errors,   // number of line errors
+                         &n_files,         // number of files read
+                         NULL,             // no sorted automaton
+                         compress_abstract_allocator,
+                         compress_tokenize_abstract_allocator);
+}
+
 // minimize and save the tree in a binary file always that there are
 // at least one entry to process
 if (return_value == SUCCESS_RETURN_CODE) {
@@ -1099,25 +1305,31 @@ if (return_value == SUCCESS_RETURN_CODE) {
                        bin_filename,     // output .bin filename
                        inf_filename,     // output .inf filename
                        new_style_bin,    // 0: old style, 1: new style (>16Mb)
+                       indexed,          // 1: add a char index to wide states
                        INF_codes,        // all the INF codes
                        minimize_tree,    // function to construct a minimal ADFA
                        root,             // automaton initial state
+                       sorted,           // NULL or the sorted automaton
                        &n_inf_codes,     // inflectional codes used
                        &n_states,        // states of the automaton
                        &n_transitions,   // transitions of the automaton
                        &bin_size,        // size of the resulting .bin file
+                       n_threads,        // threads used to minimize the tree
                        compress_abstract_allocator);
       break;
     // .bin2 style, with outputs included in the transducer
     case BIN_BIN2:
       return_value = minimize_and_save_tree_as_bin_two(
                        bin_filename,     // output .bin filename
+                       indexed,          // 1: add a char index to wide states
                        INF_codes,        // all the INF codes
                        minimize_tree,    // function to construct a minimal ADFA
                        root,             // automaton initial state
+                       sorted,           // NULL or the sorted automaton
                        &n_states,        // states of the automaton
                        &n_transitions,   // transitions of the automaton
                        &bin_size,        // size of the resulting .bin file
+                       n_threads,        // threads used to minimize the tree
                        compress_abstract_allocator);
       break;
   }
@@ -1152,6 +1364,7 @@ close_abstract_allocator(compress_tokenize_abstract_allocator);
 free_string_hash(INF_codes);
 # endif
 
+free_sorted_dictionary(sorted);
 free_list_ustring(dictionary_list);
 if (pack_inp && (bin_type!=BIN_BIN2) && (return_value==SUCCESS_RETURN_CODE)) {
   if (!convert_inf_to_inp_pack_file(inf_filename, inp_filename)) {
@@ -303,13 +303,77 @@ default: fatal_error("Illegal encoding value in get_bin_write_function_for_encod
 return NULL;
 }
 
+/**
+ * Returns a non-zero value if the given state encoding allows states to have
+ * a char index.
+ */
+int is_indexed_state_encoding(BinStateEncoding state_encoding) {
+return state_encoding==BIN_NEW_INDEXED_STATE || state_encoding==BIN_BIN2_INDEXED_STATE;
+}
+
+
+/**
+ * With indexed state encodings, a state starts with a variable length value
+ * (n_transitions<<2)|(has_index<<1)|final, followed by the inf number for a
+ * final .bin state. If the state has an index, it comes just before the
+ * transitions. It starts with one byte giving its kind:
+ *
+ * - BIN_SORTED_INDEX: n_transitions entries sorted by char, each one made of
+ *   the char on 2 bytes and the offset of the transition on 4 bytes
+ * - BIN_DIRECT_INDEX: the first char on 2 bytes, the number of slots on 2 bytes
+ *   and one transition offset on 4 bytes for each char from the first one.
+ *   BIN_NO_TRANSITION is used for chars with no transition. This kind of index
+ *   is used when the chars of the transitions are close to each other
+ *
+ * All values are big-endian, and transition offsets are relative to the first
+ * transition of the state. As the transitions themselves are unchanged, a
+ * reader that does not use the index just skips it.
+ */
+#define BIN_SORTED_INDEX 0
+#define BIN_DIRECT_INDEX 1
+#define BIN_NO_TRANSITION -1
+
+
+/**
+ * Returns the length in bytes of the index of a state whose transitions are
+ * tagged by the given letters.
+ */
+int bin_get_state_index_length(const unichar* letters,int n_transitions) {
+int min=0xFFFF,max=0;
+for (int i=0;i<n_transitions;i++) {
+    if (letters[i]<min) min=letters[i];
+    if (letters[i]>max) max=letters[i];
+}
+int range=max-min+1;
+if (range<=2*n_transitions && range<=0xFFFF) {
+    return 1+4+4*range;
+}
+return 1+6*n_transitions;
+}
+
+
+/**
+ * Returns the length in bytes of the index that starts at 'pos'.
+ */
+static int read_state_index_length(const Dictionary* d,int pos,int n_transitions) {
+if (d->bin[pos]==BIN_DIRECT_INDEX) {
+    int offset=pos+3;
+    return 1+4+4*bin_read_2bytes(d->bin,&offset);
+}
+return 1+6*n_transitions;
+}
+
+
 /**
  * Reads the information associated to the current state in the dictionary, i.e.
- * finality and number of outgoing transitions. Returns the new position.
+ * finality and number of outgoing transitions. Returns the new position, which
+ * is the one of the first transition.
  * If the state is final and if it is a classic .bin, we store the inf code
- * in *code.
+ * in *code. If 'index_pos' is not NULL, we store in it the position of the
+ * char index of the state, or -1 if it has none.
  */
-int read_dictionary_state(const Dictionary* d,int pos,int *final,int *n_transitions,int *code) {
+int read_dictionary_state(const Dictionary* d,int pos,int *final,int *n_transitions,int *code,int* index_pos) {
+if (index_pos!=NULL) *index_pos=-1;
 if (d->state_encoding==BIN_CLASSIC_STATE) {
     *final=!(d->bin[pos] & 128);
     *n_transitions=((d->bin[pos] & 127)<<8) | (d->bin[pos+1]);
@@ -334,10 +398,47 @@ if (*final && d->state_encoding==BIN_NEW_STATE) {
 return pos;
 }
 
+if (is_indexed_state_encoding(d->state_encoding)) {
+int value=bin_read_variable_length(d->bin,&pos);
+*final=value & 1;
+*n_transitions=value>>2;
+if (*final && d->state_encoding==BIN_NEW_INDEXED_STATE) {
+    *code=(d->inf_number_read_bin_func)(d->bin,&pos);
+} else {
+    *code=-1;
+}
+if (value & 2) {
+    if (index_pos!=NULL) *index_pos=pos;
+    pos=pos+read_state_index_length(d,pos,*n_transitions);
+}
+return pos;
+}
+
 fatal_error("read_dictionary_state: unsupported state encoding");
 return 0;
 }
 
+
+int read_dictionary_state(const Dictionary* d,int pos,int *final,int *n_transitions,int *code) {
+return read_dictionary_state(d,pos,final,n_transitions,code,NULL);
+}
+
+
+/**
+ * Returns the number of bytes used by the first value of a state, without
+ * the inf number and the index.
+ */
+int bin_get_state_length(BinStateEncoding state_encoding,int n_transitions,int has_index) {
+if (state_encoding==BIN_CLASSIC_STATE) {
+    return 2;
+}
+if (is_indexed_state_encoding(state_encoding)) {
+    return bin_get_value_variable_length((n_transitions<<2)|(has_index?2:0));
+}
+return bin_get_value_variable_length(n_transitions<<1);
+}
+
+
 /**
  * Writes the information associated to the current state in the dictionary, i.e.
  * finality and number of outgoing transitions. Updates the position.
@@ -353,6 +454,10 @@ if (state_encoding==BIN_CLASSIC_STATE) {
     }
     return;
 }
+if (is_indexed_state_encoding(state_encoding)) {
+    write_dictionary_indexed_state(bin,state_encoding,inf_number_write_function,pos,final,n_transitions,code,NULL,NULL);
+    return;
+}
 if (state_encoding!=BIN_NEW_STATE && state_encoding!=BIN_BIN2_STATE) {
     fatal_error("read_dictionary_state: unsupported state encoding\n");
 }
@@ -365,6 +470,219 @@ if (final && state_encoding==BIN_NEW_STATE) {
 }
 
 
+struct bin_index_entry {
+    unichar letter;
+    int offset;
+};
+
+
+static int compare_bin_index_entries(const void* a,const void* b) {
+const struct bin_index_entry* x=(const struct bin_index_entry*)a;
+const struct bin_index_entry* y=(const struct bin_index_entry*)b;
+if (x->letter!=y->letter) return (x->letter<y->letter) ? -1 : 1;
+return (x->offset<y->offset) ? -1 : (x->offset>y->offset);
+}
+
+
+/**
+ * Writes a state with an indexed state encoding. If 'letters' is not NULL,
+ * the state gets an index built from the letters of its transitions and from
+ * their offsets relative to the first transition. Updates the position.
+ */
+void write_dictionary_indexed_state(unsigned char* bin,BinStateEncoding state_encoding,
+                            t_fnc_bin_write_bytes inf_number_write_function,int *pos,int final,int n_transitions,int code,
+                            const unichar* letters,const int* transition_offsets) {
+int value=(n_transitions<<2);
+if (letters!=NULL) value=value | 2;
+if (final) value=value | 1;
+bin_write_variable_length(bin,value,pos);
+if (final && state_encoding==BIN_NEW_INDEXED_STATE) {
+    (*inf_number_write_function)(bin,code,pos);
+}
+if (letters==NULL) {
+    return;
+}
+struct bin_index_entry* entries=(struct bin_index_entry*)malloc(n_transitions*sizeof(struct bin_index_entry));
+if (entries==NULL) {
+    fatal_alloc_error("write_dictionary_indexed_state");
+}
+for (int i=0;i<n_transitions;i++) {
+    entries[i].letter=letters[i];
+    entries[i].offset=transition_offsets[i];
+}
+qsort(entries,n_transitions,sizeof(struct bin_index_entry),compare_bin_index_entries);
+int first=entries[0].letter;
+int range=entries[n_transitions-1].letter-first+1;
+if (bin_get_state_index_length(letters,n_transitions)==1+4+4*range) {
+    bin[(*pos)++]=BIN_DIRECT_INDEX;
+    bin_write_2bytes(bin,first,pos);
+    bin_write_2bytes(bin,range,pos);
+    int k=0;
+    for (int c=first;c<first+range;c++) {
+        if (k<n_transitions && entries[k].letter==c) {
+            bin_write_4bytes(bin,entries[k].offset,pos);
+            /* If a letter appears twice, the direct index only knows its first
+             * transition. This cannot happen in a dictionary, which is deterministic */
+            while (k<n_transitions && entries[k].letter==c) k++;
+        } else {
+            bin_write_4bytes(bin,BIN_NO_TRANSITION,pos);
+        }
+    }
+} else {
+    bin[(*pos)++]=BIN_SORTED_INDEX;
+    for (int i=0;i<n_transitions;i++) {
+        bin_write_2bytes(bin,entries[i].letter,pos);
+        bin_write_4bytes(bin,entries[i].offset,pos);
+    }
+}
+free(entries);
+}
+
+
+/**
+ * Builds the table that gives, for each char, the chars of which it is an
+ * uppercase variant according to the given alphabet. Returns NULL if there is
+ * no alphabet.
+ */
+struct bin_case_variants* new_bin_case_variants(const Alphabet* alphabet) {
+if (alphabet==NULL) {
+    return NULL;
+}
+struct bin_case_variants* v=(struct bin_case_variants*)malloc(sizeof(struct bin_case_variants));
+if (v==NULL) {
+    fatal_alloc_error("new_bin_case_variants");
+}
+v->start=(int*)calloc(0x10000+1,sizeof(int));
+if (v->start==NULL) {
+    fatal_alloc_error("new_bin_case_variants");
+}
+/* First, we count the variants of each char in start[c+1]. A char may be
+ * listed twice as an uppercase of the same letter, so we skip duplicates */
+int n=0;
+for (int lower=0;lower<0x10000;lower++) {
+    int i_pos_in_array_of_string=alphabet->pos_in_represent_list[lower];
+    if (i_pos_in_array_of_string==0) continue;
+    const unichar* uppers=alphabet->t_array_collection[i_pos_in_array_of_string];
+    for (int i=0;uppers[i]!='\0';i++) {
+        if (uppers[i]==lower || u_strchr(uppers,uppers[i])!=uppers+i) continue;
+        v->start[uppers[i]+1]++;
+        n++;
+    }
+}
+for (int c=0;c<0x10000;c++) {
+    v->start[c+1]+=v->start[c];
+}
+v->variants=(unichar*)malloc((n+1)*sizeof(unichar));
+if (v->variants==NULL) {
+    fatal_alloc_error("new_bin_case_variants");
+}
+/* Then we fill the variant lists, using a copy of the start positions */
+int* fill=(int*)malloc(0x10000*sizeof(int));
+if (fill==NULL) {
+    fatal_alloc_error("new_bin_case_variants");
+}
+memcpy(fill,v->start,0x10000*sizeof(int));
+for (int lower=0;lower<0x10000;lower++) {
+    int i_pos_in_array_of_string=alphabet->pos_in_represent_list[lower];
+    if (i_pos_in_array_of_string==0) continue;
+    const unichar* uppers=alphabet->t_array_collection[i_pos_in_array_of_string];
+    for (int i=0;uppers[i]!='\0';i++) {
+        if (uppers[i]==lower || u_strchr(uppers,uppers[i])!=uppers+i) continue;
+        v->variants[fill[uppers[i]]++]=(unichar)lower;
+    }
+}
+free(fill);
+return v;
+}
+
+
+void free_bin_case_variants(struct bin_case_variants* v) {
+if (v==NULL) return;
+free(v->start);
+free(v->variants);
+free(v);
+}
+
+
+/**
+ * Adds to 'positions' the positions of the transitions tagged by 'c' in the
+ * index that starts at 'index_pos'. Returns 0 if there are too many of them.
+ */
+static int add_indexed_transitions(const Dictionary* d,int index_pos,int n_transitions,int transitions_pos,
+                                   unichar c,int* positions,int *n) {
+const unsigned char* bin=d->bin;
+int pos=index_pos+1;
+if (bin[index_pos]==BIN_DIRECT_INDEX) {
+    int first=bin_read_2bytes(bin,&pos);
+    int range=bin_read_2bytes(bin,&pos);
+    if (c<first || c>=first+range) return 1;
+    pos=pos+4*(c-first);
+    int offset=bin_read_4bytes(bin,&pos);
+    if (offset==BIN_NO_TRANSITION) return 1;
+    if (*n==BIN_MAX_CASE_VARIANTS) return 0;
+    positions[(*n)++]=transitions_pos+offset;
+    return 1;
+}
+/* We look for the first entry whose letter is not lower than c */
+int start=0,end=n_transitions;
+while (start<end) {
+    int middle=start+(end-start)/2;
+    pos=index_pos+1+6*middle;
+    if (bin_read_2bytes(bin,&pos)<c) {
+        start=middle+1;
+    } else {
+        end=middle;
+    }
+}
+for (;start<n_transitions;start++) {
+    pos=index_pos+1+6*start;
+    if (bin_read_2bytes(bin,&pos)!=c) break;
+    if (*n==BIN_MAX_CASE_VARIANTS) return 0;
+    positions[(*n)++]=transitions_pos+bin_read_4bytes(bin,&pos);
+}
+return 1;
+}
+
+
+/**
+ * Uses the index of a state to find the transitions that can be followed with
+ * the text char 'c', i.e. the ones tagged by 'c' or by a char of which 'c' is an
+ * uppercase variant. 'index_pos' and 'n_transitions' are the ones given by
+ * 'read_dictionary_state'. The positions of the matching transitions are stored
+ * in 'positions', which must be able to contain BIN_MAX_CASE_VARIANTS values,
+ * in the order of the transitions of the state.
+ * Returns the number of matching transitions, or -1 if the index cannot be used;
+ * in that case, the caller must look at all the transitions of the state.
+ */
+int find_dictionary_transitions(const Dictionary* d,int index_pos,int n_transitions,unichar c,
+                                const struct bin_case_variants* variants,int* positions) {
+if (index_pos==-1 || variants==NULL) {
+    return -1;
+}
+int transitions_pos=index_pos+read_state_index_length(d,index_pos,n_transitions);
+int n=0;
+if (!add_indexed_transitions(d,index_pos,n_transitions,transitions_pos,c,positions,&n)) {
+    return -1;
+}
+for (int i=variants->start[c];i<variants->start[c+1];i++) {
+    if (!add_indexed_transitions(d,index_pos,n_transitions,transitions_pos,variants->variants[i],positions,&n)) {
+        return -1;
+    }
+}
+/* Transitions must be explored in the same order as without index */
+for (int i=1;i<n;i++) {
+    int tmp=positions[i];
+    int j=i-1;
+    while (j>=0 && positions[j]>tmp) {
+        positions[j+1]=positions[j];
+        j--;
+    }
+    positions[j+1]=tmp;
+}
+return n;
+}
+
+
 /**
  * Reads the information associated to the current transition in the dictionary.
  * Returns the new position.
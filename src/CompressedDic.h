@@ -25,6 +25,7 @@
 #include "Unicode.h"
 #include "AbstractDelaLoad.h"
 #include "Ustring.h"
+#include "Alphabet.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -58,10 +59,33 @@ typedef enum {
 typedef enum {
     BIN_CLASSIC_STATE,   /* old style .bin state encoding on 2 bytes */
     BIN_NEW_STATE,       /* variable length state encoding */
-    BIN_BIN2_STATE       /* .bin2 state encoding */
+    BIN_BIN2_STATE,      /* .bin2 state encoding */
+    BIN_NEW_INDEXED_STATE, /* BIN_NEW_STATE with a char index on wide states */
+    BIN_BIN2_INDEXED_STATE /* BIN_BIN2_STATE with a char index on wide states */
 } BinStateEncoding;
 
 
+/* With indexed state encodings, states that have at least this number of
+ * transitions are given a char index */
+#define BIN_INDEXED_STATE_MIN_TRANSITIONS 16
+
+/* Maximum number of transitions of a state that can be followed with a given
+ * text char, i.e. the char itself and its lowercase variants */
+#define BIN_MAX_CASE_VARIANTS 16
+
+
+/**
+ * For each char c, this structure gives the chars of which c is an uppercase
+ * variant according to an alphabet. It is used to look for the transitions that
+ * can be followed with c in indexed states.
+ */
+struct bin_case_variants {
+    /* The variants of c are variants[start[c]] ... variants[start[c+1]-1] */
+    int* start;
+    unichar* variants;
+};
+
+
 
 /**
  * This function type define a function that reads a byte-value. Updates the offset.
@@ -104,9 +128,19 @@ Dictionary* new_Dictionary(const VersatileEncodingConfig*,const char* bin,const
 Dictionary* new_Dictionary(const VersatileEncodingConfig*,const char* bin,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
 void free_Dictionary(Dictionary* d,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
 int read_dictionary_state(const Dictionary*,int,int*,int*,int*);
+int read_dictionary_state(const Dictionary*,int,int*,int*,int*,int*);
 t_fnc_bin_write_bytes get_bin_write_function_for_encoding(BinEncoding e) ;
 void write_dictionary_state(unsigned char* bin,BinStateEncoding state_encoding,
                             t_fnc_bin_write_bytes inf_number_write_function,int *pos,int final,int n_transitions,int code);
+int is_indexed_state_encoding(BinStateEncoding state_encoding);
+int bin_get_state_length(BinStateEncoding state_encoding,int n_transitions,int has_index);
+int bin_get_state_index_length(const unichar* letters,int n_transitions);
+void write_dictionary_indexed_state(unsigned char* bin,BinStateEncoding state_encoding,
+                            t_fnc_bin_write_bytes inf_number_write_function,int *pos,int final,int n_transitions,int code,
+                            const unichar* letters,const int* transition_offsets);
+struct bin_case_variants* new_bin_case_variants(const Alphabet*);
+void free_bin_case_variants(struct bin_case_variants*);
+int find_dictionary_transitions(const Dictionary*,int,int,unichar,const struct bin_case_variants*,int*);
 int read_dictionary_transition(const Dictionary*,int,unichar*,int*,Ustring*);
 void write_dictionary_transition(unsigned char* bin,int *pos,t_fnc_bin_write_bytes char_write_function,
                                 t_fnc_bin_write_bytes offset_write_function,unichar c,int dest,
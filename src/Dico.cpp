@@ -80,6 +80,10 @@ const char* usage_Dico =
          "                         separate several .bin with semi-colons.\n"
          "  -K/--korean: tells Dico that it works on Korean\n"
          "  -s/--semitic: tells Dico that it works on a semitic language\n"
+         "  -p/--single_pass: applies consecutive .bin dictionaries in a single pass over\n"
+         "                    the text instead of one pass per dictionary. All these\n"
+         "                    dictionaries are loaded at the same time, and their\n"
+         "                    entries are interleaved in the dlf and dlc files\n"
          "  -u X/--arabic_rules=X: Arabic typographic rule configuration file\n"
          "  -r X/--raw=X: indicates that Dico should just produce one output file X containing\n"
          "                both simple and compound words, without requiring a text directory.\n"
@@ -205,7 +209,7 @@ if (len==0 || s[len]!='-') {
 
 
 
-const char* optstring_Dico=":t:a:m:KVhk:q:u:g:sr::";
+const char* optstring_Dico=":t:a:m:KVhk:q:u:g:sr::p";
 const struct option_TS lopts_Dico[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -219,10 +223,40 @@ const struct option_TS lopts_Dico[]= {
   {"arabic_rules",required_argument_TS,NULL,'u'},
   {"raw",optional_argument_TS,NULL,'r'},
   {"semitic",no_argument_TS,NULL,'s'},
+  {"single_pass",no_argument_TS,NULL,'p'},
   {NULL,no_argument_TS,NULL,0}
 };
 
 
+/**
+ * Applies the given .bin dictionaries in a single pass over the text.
+ * Returns 0 in case of success; 1 otherwise.
+ */
+static int apply_dictionaries_in_single_pass(const VersatileEncodingConfig* vec,const struct snt_files* snt_files,
+                                             struct dico_application_info* info,int n,char* const* names,
+                                             const int* priorities) {
+if (n==0) {
+   return 0;
+}
+for (int i=0;i<n;i++) {
+   u_printf("Applying dico  %s...\n",names[i]);
+}
+/* We open output files as when dictionaries are applied one at a time */
+info->dlf=u_fopen(vec,snt_files->dlf,U_APPEND);
+info->dlc=u_fopen(vec,snt_files->dlc,U_APPEND);
+info->err=u_fopen(vec,snt_files->err,U_WRITE);
+int ret=dico_application_single_pass(vec,n,names,priorities,info);
+save_unknown_words(info);
+u_fclose(info->dlf);
+u_fclose(info->dlc);
+u_fclose(info->err);
+info->dlf=NULL;
+info->dlc=NULL;
+info->err=NULL;
+return ret;
+}
+
+
 int main_Dico(int argc,char* const argv[]) {
 if (argc==1) {
    usage();
@@ -252,6 +286,7 @@ char negation_operator[0x20]="";
 char* morpho_dic=NULL;
 int is_korean=0;
 int semitic=0;
+int single_pass=0;
 U_FILE* f_raw_output=NULL;
 VersatileEncodingConfig vec=VEC_DEFAULT;
 bool only_verify_arguments = false;
@@ -331,6 +366,8 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Dico,lopts_Dico,&index))
              break;
    case 's': semitic=1;
              break;
+   case 'p': single_pass=1;
+             break;
    case 'r': if (options.vars()->optarg==NULL) {
               /* No argument ? We display on stdout */
               f_raw_output=U_STDOUT;
@@ -511,6 +548,14 @@ struct dico_application_info* info=init_dico_application(tokens,NULL,NULL,NULL,N
 /* First of all, we compute the number of occurrences of each token */
 u_printf("Counting tokens...\n");
 count_token_occurrences(info);
+/* In single pass mode, consecutive .bin dictionaries are stored here
+ * and applied together just before the next .fst2 or at the end */
+char** pending_dics=(char**)malloc(argc*sizeof(char*));
+int* pending_priorities=(int*)malloc(argc*sizeof(int));
+if (pending_dics==NULL || pending_priorities==NULL) {
+   fatal_alloc_error("main_Dico");
+}
+int n_pending_dics=0;
 /* We all dictionaries according their priority */
 for (int priority=1;priority<4;priority++) {
    /* For a given priority, we apply all concerned dictionaries
@@ -523,7 +568,11 @@ for (int priority=1;priority<4;priority++) {
          /* If we must must process a dictionary, we check its type */
          char* tmp2 = (buffer_filename + (step_filename_buffer * 5));
          get_extension(argv[i],tmp2);
-         if (!strcmp(tmp2,".bin") || !strcmp(tmp2,".bin2"))    {
+         if (single_pass && (!strcmp(tmp2,".bin") || !strcmp(tmp2,".bin2"))) {
+            pending_dics[n_pending_dics]=argv[i];
+            pending_priorities[n_pending_dics++]=priority;
+         }
+         else if (!strcmp(tmp2,".bin") || !strcmp(tmp2,".bin2"))    {
             /*
              * If it is a .bin dictionary
              */
@@ -556,6 +605,10 @@ for (int priority=1;priority<4;priority++) {
             /*
              * If it is a .fst2 dictionary
              */
+            if (apply_dictionaries_in_single_pass(&vec,snt_files,info,n_pending_dics,pending_dics,pending_priorities)) {
+               ret=1;
+            }
+            n_pending_dics=0;
             int l=(int)(strlen(tmp)-((priority==2)?1:2));
             OutputPolicy outputPolicy=MERGE_OUTPUTS;
             int export_in_morpho_dic=DONT_PRODUCE_MORPHO_DIC;
@@ -594,6 +647,8 @@ for (int priority=1;priority<4;priority++) {
                      free_alphabet(alphabet);
                      free(morpho_dic);
                      free(buffer_filename);
+                     free(pending_dics);
+                     free(pending_priorities);
                      return DEFAULT_ERROR_CODE;
                   }
                }
@@ -626,6 +681,8 @@ for (int priority=1;priority<4;priority++) {
                  free_alphabet(alphabet);
                  free(morpho_dic);
                  free(buffer_filename);
+                 free(pending_dics);
+                 free(pending_priorities);
                  return DEFAULT_ERROR_CODE;
                }
             }
@@ -641,6 +698,11 @@ for (int priority=1;priority<4;priority++) {
     }
    }
 }
+if (apply_dictionaries_in_single_pass(&vec,snt_files,info,n_pending_dics,pending_dics,pending_priorities)) {
+   ret=1;
+}
+free(pending_dics);
+free(pending_priorities);
 /* We process the tag sequences, if any */
 u_printf("Sorting and saving tag sequences...\n");
 save_and_sort_tag_sequences(info);
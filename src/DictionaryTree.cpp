@@ -22,6 +22,8 @@
 #include "DictionaryTree.h"
 #include "Error.h"
 #include "Ustring.h"
+#include "HashTable.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -177,6 +179,31 @@ static int get_value_index_for_string_colon_string(const unichar* str1,const uni
    return value;
 }
 
+/**
+ * Adds the given INF code to the INF codes of 'node', which becomes a final one.
+ */
+static void add_INF_code_to_node(struct dictionary_node* node,const unichar* INF_code,
+                                 struct string_hash* INF_code_list,Abstract_allocator prv_alloc) {
+int N=get_value_index(INF_code,INF_code_list);
+if (node->single_INF_code_list==NULL) {
+   /* If there is no INF code in the node, then
+    * we add one and we return */
+   node->single_INF_code_list=new_list_int(N,prv_alloc);
+   node->INF_code=N;
+   return;
+}
+/* If there is an INF code list in the node ...*/
+if (is_in_list(N,node->single_INF_code_list)) {
+   /* If the INF code has already been taken into account for this node
+    * (case of duplicates), we do nothing */
+   return;
+}
+/* Otherwise, we add it to the INF code list */
+node->single_INF_code_list=head_insert(N,node->single_INF_code_list,prv_alloc);
+ /* And we update the global INF line for this node */
+node->INF_code=get_value_index_for_string_colon_string(INF_code_list->value[node->INF_code],INF_code,INF_code_list);
+}
+
 /**
  * This function explores a dictionary tree in order to insert an entry.
  * 'inflected' is the inflected form to insert, and 'pos' is the current position
@@ -189,24 +216,7 @@ for (;;) {
 if (inflected[pos]=='\0') {
    /* If we have reached the end of 'inflected', then we are in the
     * node where the INF code must be inserted */
-   int N=get_value_index(infos->INF_code,infos->INF_code_list);
-   if (node->single_INF_code_list==NULL) {
-      /* If there is no INF code in the node, then
-       * we add one and we return */
-      node->single_INF_code_list=new_list_int(N,prv_alloc);
-      node->INF_code=N;
-      return;
-   }
-   /* If there is an INF code list in the node ...*/
-   if (is_in_list(N,node->single_INF_code_list)) {
-      /* If the INF code has already been taken into account for this node
-       * (case of duplicates), we do nothing */
-      return;
-   }
-   /* Otherwise, we add it to the INF code list */
-   node->single_INF_code_list=head_insert(N,node->single_INF_code_list,prv_alloc);
-    /* And we update the global INF line for this node */
-   node->INF_code=get_value_index_for_string_colon_string(infos->INF_code_list->value[node->INF_code],infos->INF_code,infos->INF_code_list);
+   add_INF_code_to_node(node,infos->INF_code,infos->INF_code_list,prv_alloc);
    return;
 }
 /* If we are not at the end of 'inflected', then we look for
@@ -272,11 +282,13 @@ struct transition_list {
 };
 
 static inline int compare_nodes(const struct dictionary_node_transition*,const struct dictionary_node_transition*);
+static int compare_node_contents(const struct dictionary_node*,const struct dictionary_node*);
 //void init_minimize_arrays(struct transition_list***,struct dictionary_node_transition***);
 static void init_minimize_arrays_transition_list(struct transition_list***);
 static void init_minimize_arrays_dictionary_node_transition(struct dictionary_node_transition***,unsigned int nb);
 static void free_minimize_arrays(struct transition_list**,struct dictionary_node_transition**);
 static int sort_by_height(struct dictionary_node*,struct transition_list**,struct bit_array*,Abstract_allocator);
+static int sort_dag_by_height(struct dictionary_node*,struct transition_list**,struct bit_array*,Abstract_allocator);
 static struct transition_list* new_transition_list(struct dictionary_node_transition*,struct transition_list*,Abstract_allocator);
 static int convert_list_to_array(unsigned int,struct transition_list**,
                           struct dictionary_node_transition**,unsigned int,Abstract_allocator);
@@ -288,12 +300,13 @@ static inline void check_nodes(const struct dictionary_node_transition* a);
 
 
 /**
- * This function takes a dictionary tree and minimizes it using
- * Dominique Revuz's algorithm. 'used_inf_values' is used to mark
- * INF codes that are actually used in the .bin.
+ * This function minimizes the automaton whose root is 'root' using
+ * Dominique Revuz's algorithm. If 'dag' is non-zero, some nodes may already
+ * be shared, so that they must be visited only once. If 'verbose' is
+ * non-zero, the progress is printed.
  */
-void minimize_tree(struct dictionary_node* root,struct bit_array* used_inf_values,Abstract_allocator prv_alloc) {
-u_printf("Minimizing...                      \n");
+static void minimize_from_node(struct dictionary_node* root,struct bit_array* used_inf_values,
+                               Abstract_allocator prv_alloc,int dag,int verbose) {
 struct transition_list** transitions_by_height;
 struct dictionary_node_transition** transitions;
 //init_minimize_arrays(&transitions_by_height,&transitions);
@@ -301,7 +314,8 @@ struct dictionary_node_transition** transitions;
 init_minimize_arrays_transition_list(&transitions_by_height);
 
 
-unsigned int H=sort_by_height(root,transitions_by_height,used_inf_values,prv_alloc);
+unsigned int H=dag ? sort_dag_by_height(root,transitions_by_height,used_inf_values,prv_alloc)
+                   : sort_by_height(root,transitions_by_height,used_inf_values,prv_alloc);
 
 unsigned int nb=0;
 for (unsigned int k1=0;k1<=H;k1++) {
@@ -316,18 +330,98 @@ for (unsigned int k=0;k<=H;k++) {
    int size=convert_list_to_array(k,transitions_by_height,transitions,nb,prv_alloc);
    for (int l=0;l<size;l++) {
        check_nodes(transitions[l]);
+       if (dag) {
+          /* We don't need the height of the node anymore */
+          transitions[l]->node->offset=-1;
+       }
    }
    quicksort(0,size-1,transitions);
    merge(size,transitions,prv_alloc);
-   z=(float)(100.0*(float)(k)/(float)H);
-   if (z>100.0) z=(float)100.0;
-   u_printf("%2.0f%% completed...    \r",z);
+   if (verbose) {
+      z=(float)(100.0*(float)(k)/(float)H);
+      if (z>100.0) z=(float)100.0;
+      u_printf("%2.0f%% completed...    \r",z);
+   }
 }
-u_printf("Minimization done.                     \n");
+root->offset=-1;
 free_minimize_arrays(transitions_by_height,transitions);
 }
 
 
+/**
+ * This structure is shared by the threads that minimize the subtrees of
+ * the root. Each thread takes the next transition of the root until there
+ * is none left.
+ */
+struct minimize_shards {
+   struct dictionary_node_transition* next;
+   Abstract_allocator prv_alloc;
+   SYNC_Mutex_OBJECT mutex;
+};
+
+
+static void ABSTRACT_CALLBACK_UNITEX minimize_worker_thread(void* private_data,unsigned int) {
+struct minimize_shards* shards=(struct minimize_shards*)private_data;
+for (;;) {
+   SyncGetMutex(shards->mutex);
+   struct dictionary_node_transition* t=shards->next;
+   if (t!=NULL) {
+      shards->next=t->next;
+   }
+   SyncReleaseMutex(shards->mutex);
+   if (t==NULL) {
+      return;
+   }
+   if (t->node->trans!=NULL) {
+      /* INF codes will be marked when minimizing the whole automaton */
+      minimize_from_node(t->node,NULL,shards->prv_alloc,0,0);
+   }
+}
+}
+
+
+/**
+ * This function takes a dictionary tree and minimizes it using
+ * Dominique Revuz's algorithm. 'used_inf_values' is used to mark
+ * INF codes that are actually used in the .bin.
+ *
+ * If n_threads>1, the subtrees of the root, i.e. the entries that share
+ * the same first letter, are minimized by n_threads threads. Then, the
+ * resulting automata, which are much smaller than the tree, are minimized
+ * together in order to share the nodes that are equivalent across subtrees.
+ * The result is the same minimal automaton.
+ */
+void minimize_tree(struct dictionary_node* root,struct bit_array* used_inf_values,Abstract_allocator prv_alloc,
+                   int n_threads) {
+u_printf("Minimizing...                      \n");
+if (prv_alloc!=NULL) {
+   /* Allocators are not supposed to be shared by threads */
+   n_threads=1;
+}
+if (n_threads<=1) {
+   minimize_from_node(root,used_inf_values,prv_alloc,0,1);
+   u_printf("Minimization done.                     \n");
+   return;
+}
+struct minimize_shards shards;
+shards.next=root->trans;
+shards.prv_alloc=prv_alloc;
+shards.mutex=SyncBuildMutex();
+void** w_ptr=(void**)malloc(n_threads*sizeof(void*));
+if (w_ptr==NULL) {
+   fatal_alloc_error("minimize_tree");
+}
+for (int i=0;i<n_threads;i++) {
+   w_ptr[i]=&shards;
+}
+SyncRunThreads((unsigned int)n_threads,minimize_worker_thread,w_ptr);
+SyncDeleteMutex(shards.mutex);
+free(w_ptr);
+minimize_from_node(root,used_inf_values,prv_alloc,1,1);
+u_printf("Minimization done.                     \n");
+}
+
+
 static inline void check_nodes(const struct dictionary_node_transition* a) {
 if (a==NULL || a->node==NULL) {
    fatal_error("Internal error in check_nodes\n");
@@ -341,10 +435,17 @@ if (a==NULL || a->node==NULL) {
  * 3) by the transition that get out of them
  */
 static inline int compare_nodes(const struct dictionary_node_transition* a,const struct dictionary_node_transition* b) {
-/* If the nodes have not the same INF codes, they are different */
+return compare_node_contents(a->node,b->node);
+}
+
 
-    struct dictionary_node* a_node = a->node;
-    struct dictionary_node* b_node = b->node;
+/**
+ * Compares two nodes by their INF codes and their outgoing transitions.
+ */
+static int compare_node_contents(const struct dictionary_node* a_node,const struct dictionary_node* b_node) {
+/* If the nodes have not the same INF codes, they are different */
+    const struct dictionary_node_transition* a;
+    const struct dictionary_node_transition* b;
 
     if (a_node->single_INF_code_list!=b_node->single_INF_code_list) {
         if (a_node->single_INF_code_list!=NULL && b_node->single_INF_code_list==NULL) return -1;
@@ -431,7 +532,8 @@ free(transitions);
 /**
  * This function explores the dictionary and puts its transitions into the
  * 'transitions' array. For a given height, the transitions are not sorted,
- * they will be later in the 'minimize_tree' function.
+ * they will be later in the 'minimize_tree' function. If 'used_inf_values'
+ * is NULL, INF codes are not marked.
  * The function returns the height of the given node.
  */
 static int sort_by_height(struct dictionary_node* n,struct transition_list** transitions_by_height,
@@ -440,7 +542,7 @@ if (n==NULL) {
    fatal_error("NULL error in sort_by_height\n");
 }
 /* We mark used INF codes */
-if (n->single_INF_code_list!=NULL) {
+if (n->single_INF_code_list!=NULL && used_inf_values!=NULL) {
     set_value(used_inf_values,n->INF_code,1);
 }
 if (n->trans==NULL) {
@@ -467,6 +569,38 @@ return 1+height;
 }
 
 
+/**
+ * Same as 'sort_by_height', for an automaton whose nodes may be shared.
+ * Since the 'offset' field is not used before the automaton is saved,
+ * we use it to store the height of the nodes that have already been
+ * visited, so that their transitions are inserted only once.
+ */
+static int sort_dag_by_height(struct dictionary_node* n,struct transition_list** transitions_by_height,
+                    struct bit_array* used_inf_values,Abstract_allocator prv_alloc) {
+if (n==NULL) {
+   fatal_error("NULL error in sort_dag_by_height\n");
+}
+if (n->offset!=-1) {
+   return n->offset;
+}
+if (n->single_INF_code_list!=NULL) {
+    set_value(used_inf_values,n->INF_code,1);
+}
+int height=-1;
+int k;
+for (struct dictionary_node_transition* trans=n->trans;trans!=NULL;trans=trans->next) {
+   k=sort_dag_by_height(trans->node,transitions_by_height,used_inf_values,prv_alloc);
+   if (k==MAXIMUM_HEIGHT) {
+      fatal_error("Maximum height reached in sort_dag_by_height\n");
+   }
+   transitions_by_height[k]=new_transition_list(trans,transitions_by_height[k],prv_alloc);
+   if (height<k) height=k;
+}
+n->offset=1+height;
+return n->offset;
+}
+
+
 /**
  * Allocates, initializes and returns a new transition list element.
  */
@@ -691,4 +825,224 @@ subsequential_to_normal_transducer(root,root,inf_codes,pos,z,normalizedOutput);
 free_Ustring(normalizedOutput);
 }
 
+
+
+/******************************************************************
+ *
+ *
+ * The following code builds the minimal automaton directly from
+ * entries given in sorted order (Daciuk et al.'s incremental
+ * algorithm), so that the whole tree never has to be in memory.
+ *
+ *
+ ******************************************************************/
+
+
+static unsigned int hash_dictionary_node(const void* ptr) {
+const struct dictionary_node* node=(const struct dictionary_node*)ptr;
+unsigned int h=(node->single_INF_code_list!=NULL) ? (unsigned int)(1+node->INF_code) : 0;
+for (const struct dictionary_node_transition* t=node->trans;t!=NULL;t=t->next) {
+   h=h*31+t->letter;
+   h=h*31+(unsigned int)(((size_t)t->node)>>3);
+   if (t->output!=NULL) {
+      for (int i=0;t->output[i]!='\0';i++) {
+         h=h*31+t->output[i];
+      }
+   }
+}
+return h;
+}
+
+
+static int equal_dictionary_nodes(const void* a,const void* b) {
+return compare_node_contents((const struct dictionary_node*)a,(const struct dictionary_node*)b)==0;
+}
+
+
+/**
+ * Registered nodes belong to the automaton, not to the register.
+ */
+static void dont_free_dictionary_node(void*) {
+}
+
+
+/**
+ * Allocates, initializes and returns a builder for a dictionary whose
+ * entries will be given in sorted order. If 'move_outputs' is non-zero,
+ * INF codes are moved on transitions as done by 'move_outputs_on_transitions'
+ * for .bin2 dictionaries.
+ */
+struct sorted_dictionary* new_sorted_dictionary(struct string_hash* INF_code_list,int move_outputs,
+                                                Abstract_allocator prv_alloc) {
+struct sorted_dictionary* d=(struct sorted_dictionary*)malloc(sizeof(struct sorted_dictionary));
+if (d==NULL) {
+   fatal_alloc_error("new_sorted_dictionary");
+}
+d->root=new_dictionary_node(prv_alloc);
+d->INF_code_list=INF_code_list;
+d->move_outputs=move_outputs;
+d->states=new_hash_table(hash_dictionary_node,equal_dictionary_nodes,dont_free_dictionary_node,NULL,NULL);
+d->capacity=256;
+d->path=(struct dictionary_node**)malloc((d->capacity+1)*sizeof(struct dictionary_node*));
+d->last=(struct dictionary_node_transition**)malloc((d->capacity+1)*sizeof(struct dictionary_node_transition*));
+d->word=(unichar*)malloc((d->capacity+1)*sizeof(unichar));
+if (d->path==NULL || d->last==NULL || d->word==NULL) {
+   fatal_alloc_error("new_sorted_dictionary");
+}
+d->path[0]=d->root;
+d->last[0]=NULL;
+d->word[0]='\0';
+d->length=0;
+d->used_INF_codes=new_vector_int();
+d->prefix=new_Ustring();
+d->prv_alloc=prv_alloc;
+return d;
+}
+
+
+/**
+ * Frees the builder. The automaton is not freed.
+ */
+void free_sorted_dictionary(struct sorted_dictionary* d) {
+if (d==NULL) return;
+free_hash_table(d->states);
+free(d->path);
+free(d->last);
+free(d->word);
+free_vector_int(d->used_INF_codes);
+free_Ustring(d->prefix);
+free(d);
+}
+
+
+/**
+ * Does for the transitions of 'node' what 'subsequential_to_normal_transducer'
+ * does, and sets the output of 't', the transition that leads to 'node'.
+ * The outputs of the transitions of 'node' are supposed to be already set.
+ */
+static void move_outputs_to_incoming_transition(struct sorted_dictionary* d,struct dictionary_node* node,
+                                                struct dictionary_node_transition* t) {
+if (node->single_INF_code_list!=NULL) {
+   /* A final node keeps the outputs of its transitions */
+   t->output=u_strdup(d->INF_code_list->value[node->INF_code]);
+   return;
+}
+Ustring* prefix=d->prefix;
+int prefix_set=0;
+struct dictionary_node_transition* tmp;
+for (tmp=node->trans;tmp!=NULL;tmp=tmp->next) {
+   if (!prefix_set) {
+      prefix_set=1;
+      u_strcpy(prefix,tmp->output);
+   } else {
+      get_longest_common_prefix(prefix,tmp->output);
+   }
+}
+for (tmp=node->trans;tmp!=NULL;tmp=tmp->next) {
+   remove_prefix(prefix->len,tmp->output);
+}
+if (prefix->len!=0) {
+   t->output=u_strdup(prefix->str);
+}
+}
+
+
+/**
+ * The node at position 'pos' of the current path will not get any other
+ * transition. We replace it by an equivalent node of the automaton, if any,
+ * or we register it.
+ */
+static void replace_or_register(struct sorted_dictionary* d,int pos) {
+struct dictionary_node* node=d->path[pos];
+struct dictionary_node_transition* t=d->last[pos-1];
+if (d->move_outputs) {
+   move_outputs_to_incoming_transition(d,node,t);
+}
+int ret;
+struct any* value=get_value(d->states,node,HT_INSERT_IF_NEEDED,&ret);
+if (ret==HT_KEY_ALREADY_THERE) {
+   struct dictionary_node* equivalent=(struct dictionary_node*)value->_ptr;
+   t->node=equivalent;
+   (equivalent->incoming)++;
+   free_dictionary_node(node,d->prv_alloc);
+   return;
+}
+value->_ptr=node;
+if (node->single_INF_code_list!=NULL) {
+   vector_int_add(d->used_INF_codes,node->INF_code);
+}
+}
+
+
+/**
+ * Inserts an entry in the automaton. 'inflected' must not be lower than
+ * the inflected form of the previous entry, according to the Unicode order;
+ * otherwise, the function returns 0 and the automaton is left unchanged.
+ * Returns 1 on success.
+ */
+int add_entry_to_sorted_dictionary(struct sorted_dictionary* d,const unichar* inflected,const unichar* INF_code) {
+int i=0;
+while (i<d->length && inflected[i]==d->word[i]) {
+   i++;
+}
+if (inflected[i]!='\0' && d->last[i]!=NULL && d->last[i]->letter>=inflected[i]) {
+   /* The transition that we should follow leads to a node that may have
+    * been shared yet, or the entry is lower than the previous one */
+   return 0;
+}
+/* Nothing can be added anymore after the common prefix */
+for (int k=d->length;k>i;k--) {
+   replace_or_register(d,k);
+}
+int length=i+u_strlen(inflected+i);
+if (length>d->capacity) {
+   while (length>d->capacity) d->capacity*=2;
+   d->path=(struct dictionary_node**)realloc(d->path,(d->capacity+1)*sizeof(struct dictionary_node*));
+   d->last=(struct dictionary_node_transition**)realloc(d->last,(d->capacity+1)*sizeof(struct dictionary_node_transition*));
+   d->word=(unichar*)realloc(d->word,(d->capacity+1)*sizeof(unichar));
+   if (d->path==NULL || d->last==NULL || d->word==NULL) {
+      fatal_alloc_error("add_entry_to_sorted_dictionary");
+   }
+}
+for (;i<length;i++) {
+   /* The new transition is the last one of the node */
+   struct dictionary_node_transition* t=new_dictionary_node_transition(d->prv_alloc);
+   t->letter=inflected[i];
+   t->node=new_dictionary_node(d->prv_alloc);
+   (t->node->incoming)++;
+   if (d->last[i]==NULL) {
+      d->path[i]->trans=t;
+   } else {
+      d->last[i]->next=t;
+   }
+   d->last[i]=t;
+   d->word[i]=inflected[i];
+   d->path[i+1]=t->node;
+   d->last[i+1]=NULL;
+}
+d->word[length]='\0';
+d->length=length;
+add_INF_code_to_node(d->path[length],INF_code,d->INF_code_list,d->prv_alloc);
+return 1;
+}
+
+
+/**
+ * Registers the nodes of the last entry, so that 'd->root' is the initial
+ * state of the minimal automaton, and marks INF codes that are used in it.
+ */
+void finish_sorted_dictionary(struct sorted_dictionary* d,struct bit_array* used_inf_values) {
+for (int k=d->length;k>0;k--) {
+   replace_or_register(d,k);
+}
+d->length=0;
+d->word[0]='\0';
+if (d->root->single_INF_code_list!=NULL) {
+   set_value(used_inf_values,d->root->INF_code,1);
+}
+for (int i=0;i<d->used_INF_codes->nbelems;i++) {
+   set_value(used_inf_values,d->used_INF_codes->tab[i],1);
+}
+}
+
 } // namespace unitex
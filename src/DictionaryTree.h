@@ -27,6 +27,9 @@
 #include "String_hash.h"
 #include "List_int.h"
 #include "BitArray.h"
+#include "HashTable.h"
+#include "Vector.h"
+#include "Ustring.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -99,9 +102,44 @@ void add_entry_to_dictionary_tree(unichar*,unichar*,struct dictionary_node*,stru
         int,Abstract_allocator);
 struct dictionary_node* new_dictionary_node(Abstract_allocator);
 
-void minimize_tree(struct dictionary_node*,struct bit_array*,Abstract_allocator);
+void minimize_tree(struct dictionary_node*,struct bit_array*,Abstract_allocator,int n_threads = 1);
 void move_outputs_on_transitions(struct dictionary_node* root,struct string_hash* inf_codes);
 
+
+/**
+ * This structure is used to build the minimal automaton of a dictionary
+ * whose entries are given sorted by inflected form. Only the nodes of the
+ * last inserted entry can still be modified: the other ones are minimized
+ * as soon as we know that no entry will reach them, and they are stored in
+ * 'states', so that the memory needed depends on the size of the minimal
+ * automaton instead of the size of the tree.
+ */
+struct sorted_dictionary {
+    struct dictionary_node* root;
+    struct string_hash* INF_code_list;
+    /* 1 if INF codes must be moved on transitions, as in .bin2 dictionaries */
+    int move_outputs;
+    /* The nodes that are already minimized */
+    struct hash_table* states;
+    /* 'path[i]' is the node reached by the i first letters of 'word', the
+     * last inserted inflected form, and 'last[i]' is the last transition
+     * of 'path[i]' */
+    struct dictionary_node** path;
+    struct dictionary_node_transition** last;
+    unichar* word;
+    int length;
+    int capacity;
+    /* INF codes of the final nodes that have been registered */
+    vector_int* used_INF_codes;
+    Ustring* prefix;
+    Abstract_allocator prv_alloc;
+};
+
+struct sorted_dictionary* new_sorted_dictionary(struct string_hash*,int,Abstract_allocator);
+void free_sorted_dictionary(struct sorted_dictionary*);
+int add_entry_to_sorted_dictionary(struct sorted_dictionary*,const unichar*,const unichar*);
+void finish_sorted_dictionary(struct sorted_dictionary*,struct bit_array*);
+
 } // namespace unitex
 
 #endif
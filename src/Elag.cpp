@@ -58,6 +58,8 @@ const char* usage_Elag =
          "  -r RULES/--rules=RULES: compiled elag rules file\n"
          "  -o OUT/--output=OUT: resulting output .tfst file\n"
          "  -S/--no_statistics: do not produce statistics file\n"
+         "  -j N/--threads=N: disambiguates the sentences with N threads (default: 1). The\n"
+         "                    result is the same as with a single thread\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -70,7 +72,7 @@ static void usage() {
 }
 
 
-const char* optstring_Elag=":l:r:o:Vhk:q:S";
+const char* optstring_Elag=":l:r:o:Vhk:q:Sj:";
 const struct option_TS lopts_Elag[]= {
   {"language",required_argument_TS,NULL,'l'},
   {"rules",required_argument_TS,NULL,'r'},
@@ -79,6 +81,7 @@ const struct option_TS lopts_Elag[]= {
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
   {"no_statistics",no_argument_TS,NULL,'S'},
+  {"threads",required_argument_TS,NULL,'j'},
   {"help",no_argument_TS,NULL,'h'},
   {NULL,no_argument_TS,NULL,0}
 };
@@ -93,6 +96,8 @@ if (argc==1) {
 VersatileEncodingConfig vec=VEC_DEFAULT;
 int val,index=-1;
 int save_statistics=1;
+int n_threads=1;
+char foo;
 char language[FILENAME_MAX]="";
 char rule_file[FILENAME_MAX]="";
 char output_tfst[FILENAME_MAX]="";
@@ -134,6 +139,12 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Elag,lopts_Elag,&index))
              break;
    case 'S': save_statistics = 0;
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'V': only_verify_arguments = true;
              break;
    case 'h': usage();
@@ -187,7 +198,7 @@ if ((grammars=load_elag_grammars(&vec,rule_file,lang,directory)) == NULL) {
 }
 u_printf("Grammars are loaded.\n");
 
-remove_ambiguities(input_tfst,grammars,output_tfst,&vec,lang,save_statistics);
+remove_ambiguities(input_tfst,grammars,output_tfst,&vec,lang,save_statistics,n_threads);
 free_vector_ptr(grammars,(release_f)free_Fst2Automaton_including_symbols);
 free_language_t(lang);
 return SUCCESS_RETURN_CODE;
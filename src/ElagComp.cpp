@@ -57,6 +57,9 @@ const char* usage_ElagComp =
          "  -l LANG/--language=LANG: Elag language description file\n"
          "  -o OUT/--output=OUT: output file where the resulting compiled grammar is stored\n"
          "                       The default name is same as RULES except for the .rul extension\n"
+         "  -m N/--max_states=N: when compiling a rule list, the rules are intersected into\n"
+         "                       automata of at most about N states (default: 128). Fewer and\n"
+         "                       bigger automata make Elag faster but ElagComp slower\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -71,12 +74,13 @@ static void usage() {
 }
 
 
-const char* optstring_ElagComp=":l:r:o:g:Vhk:q:";
+const char* optstring_ElagComp=":l:r:o:g:Vhk:q:m:";
 const struct option_TS lopts_ElagComp[]= {
   {"language",required_argument_TS,NULL,'l'},
   {"rulelist",required_argument_TS,NULL,'r'},
   {"grammar",required_argument_TS,NULL,'g'},
   {"output",required_argument_TS,NULL,'o'},
+  {"max_states",required_argument_TS,NULL,'m'},
   {"input_encoding",required_argument_TS,NULL,'k'},
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
@@ -98,6 +102,8 @@ char directory[UNITEX_DIRNAME_MAX]="";
 char grammar[UNITEX_FULLPATH_MAX]="";
 char rule_file[UNITEX_FULLPATH_WOEXT_MAX]="";
 char lang[UNITEX_FULLPATH_MAX]="";
+int max_states=MAX_GRAM_SIZE;
+char foo;
 bool only_verify_arguments = false;
 UnitexGetOpt options;
 while (EOF!=(val=options.parse_long(argc,argv,optstring_ElagComp,lopts_ElagComp,&index))) {
@@ -128,6 +134,12 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_ElagComp,lopts_ElagComp,
              }
              strcpy(compilename,options.vars()->optarg);
              break;
+   case 'm': if (1!=sscanf(options.vars()->optarg,"%d%c",&max_states,&foo) || max_states<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid maximum number of states: %s\n",options.vars()->optarg);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'k': if (options.vars()->optarg[0]=='\0') {
                 error("Empty input_encoding argument\n");
                 return USAGE_ERROR_CODE;
@@ -195,7 +207,7 @@ if (rule_file[0]!='\0') {
          sprintf(compilename,"%s.rul",rule_file);
       }
    }
-   if (compile_elag_rules(rule_file,compilename,&vec,language)==-1) {
+   if (compile_elag_rules(rule_file,compilename,&vec,language,max_states)==-1) {
       error("An error occurred while compiling %s\n",compilename);
       free_language_t(language);
       return DEFAULT_ERROR_CODE;
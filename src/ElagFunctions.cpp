@@ -43,6 +43,7 @@
 #include "Symbol.h"
 #include "Ustring.h"
 #include "TfstStats.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -52,14 +53,130 @@ namespace unitex {
 
 static void add_sentence_delimiters(Tfst* tfst,language_t*);
 static void remove_sentence_delimiters(Tfst* tfst,language_t*);
-vector_ptr* convert_elag_symbols_to_tfst_tags(Elag_Tfst_file_in*);
+vector_ptr* convert_elag_symbols_to_tfst_tags(Tfst*);
+
+static const unichar SENTENCE_DELIMITER[] = { '{', 'S', '}', 0 };
+
+/* When Elag runs with several threads, the sentences are given to the
+ * workers by rounds of ELAG_SENTENCES_PER_WORKER sentences per worker,
+ * after which the main thread saves them in sentence order */
+#define ELAG_SENTENCES_PER_WORKER 16
+
+
+/**
+ * A sentence being disambiguated. 'tfst' holds the per-sentence fields
+ * detached from the input text automaton, so that several sentences can
+ * be loaded at the same time. The other fields are the statistics that
+ * the main thread accumulates in sentence order.
+ */
+struct elag_sentence {
+   Tfst tfst;
+   int empty;
+   int unloadable;
+   int rejected;
+   double before;
+   double after;
+   double length_before;
+   double length_after;
+};
+
+
+/**
+ * The sentences of a round, shared by all the workers. Each worker takes
+ * the next unprocessed sentence until there is none left.
+ */
+struct elag_round {
+   struct elag_sentence* sentences;
+   int n_sentences;
+   int next_sentence;
+   vector_ptr* gramms;
+   language_t* language;
+   SYNC_Mutex_OBJECT mutex;
+};
+
+
+/**
+ * Applies all the grammars to the given sentence. This function does not
+ * print anything and only reads the language, so that it can be called by
+ * several threads at the same time, provided that {S} has already been
+ * added to the language forms.
+ */
+static void disambiguate_sentence(struct elag_sentence* s,vector_ptr* gramms,language_t* language) {
+Tfst* tfst=&(s->tfst);
+s->empty=0;
+s->unloadable=0;
+s->rejected=0;
+elag_determinize(language,tfst->automaton,free_symbol);
+elag_minimize(tfst->automaton);
+if (tfst->automaton->number_of_states<2) {
+   /* If the sentence is empty, we replace the sentence automaton
+    * by a 1-state automaton with no transition. */
+   free_SingleGraph(tfst->automaton,free_symbol);
+   tfst->automaton=new_SingleGraph(1,PTR_TAGS);
+   SingleGraphState initial_state=add_state(tfst->automaton);
+   set_initial_state(initial_state);
+   s->empty=1;
+   s->unloadable=1;
+   return;
+}
+int min,max;
+s->before=evaluate_ambiguity(tfst->automaton,&min,&max);
+s->length_before=((double) (min + max) / (double) 2);
+add_sentence_delimiters(tfst,language);
+if (tfst->automaton->number_of_states<2) {
+   s->empty=1;
+} else {
+   for (int j=0;j<gramms->nbelems;j++) {
+      Fst2Automaton* grammar=(Fst2Automaton*)(gramms->tab[j]);
+      SingleGraph temp=elag_intersection(language,tfst->automaton,grammar->automaton,TEXT_GRAMMAR);
+      trim(temp,free_symbol);
+      free_SingleGraph(tfst->automaton,free_symbol);
+      tfst->automaton=temp;
+      if (tfst->automaton->number_of_states<2) {
+         /* If the sentence has been rejected by the grammar, we don't go
+          * on intersecting with other grammars */
+         free_SingleGraph(tfst->automaton,free_symbol);
+         tfst->automaton=new_SingleGraph(1,PTR_TAGS);
+         SingleGraphState initial_state=add_state(tfst->automaton);
+         set_initial_state(initial_state);
+         s->rejected=1;
+         return;
+      }
+   }
+}
+elag_determinize(language,tfst->automaton,free_symbol);
+trim(tfst->automaton,free_symbol);
+elag_minimize(tfst->automaton);
+remove_sentence_delimiters(tfst,language);
+s->after=evaluate_ambiguity(tfst->automaton,&min,&max);
+s->length_after=((double) (min + max) / (double) 2);
+}
+
+
+static void ABSTRACT_CALLBACK_UNITEX elag_worker_thread(void* private_data,unsigned int) {
+struct elag_round* round=(struct elag_round*)private_data;
+for (;;) {
+   SyncGetMutex(round->mutex);
+   int k=round->next_sentence;
+   if (k<round->n_sentences) {
+      (round->next_sentence)++;
+   }
+   SyncReleaseMutex(round->mutex);
+   if (k>=round->n_sentences) {
+      return;
+   }
+   disambiguate_sentence(&(round->sentences[k]),round->gramms,round->language);
+}
+}
 
 
 /**
  * This function loads a .tfst text automaton, disambiguates it according to the given rules,
- * and saves the result in another text automaton.
+ * and saves the result in another text automaton. If n_threads>1, the sentences
+ * are disambiguated by n_threads workers, but the result is the same as with
+ * a single thread.
  */
-void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* output, const VersatileEncodingConfig* vec,language_t* language,int save_statistics) {
+void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* output, const VersatileEncodingConfig* vec,language_t* language,int save_statistics,int n_threads) {
    Elag_Tfst_file_in* input=load_tfst_file(vec,input_tfst,language);
    if (input==NULL) {
       fatal_error("Unable to load text automaton'%s'\n",input_tfst);
@@ -84,80 +201,85 @@ void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* ou
    u_printf("\nProcessing ...\n");
    int n_rejected_sentences = 0;
    int nb_unloadable = 0;
-   double before, after;
    double total_before = 0.0, total_after = 0.0;
    double length_before = 0., length_after = 0.; // average text length in words
-   Tfst* tfst=input->tfst;
 
    /* We use this hash table to rebuild files tfst_tags_by_freq/alph.txt */
    hash_table* form_frequencies=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)((EQUAL_UNICHAR_FUNCTION)u_equal),
            (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
 
-   for (int current_sentence=1;current_sentence<=input->tfst->N;current_sentence++) {
-      load_tfst_sentence_automaton(input,current_sentence);
-      elag_determinize(language,tfst->automaton,free_symbol);
-      elag_minimize(tfst->automaton);
-      int is_rejected=0;
-      if (current_sentence % 100 == 0) {
-         u_printf("Sentence %d/%d...\r",current_sentence,input->tfst->N);
+   /* Loading a sentence adds its forms to the language, so that it is always
+    * done by the main thread. The workers only do the disambiguation */
+   int max_sentences=(n_threads>1)?n_threads*ELAG_SENTENCES_PER_WORKER:1;
+   struct elag_round round;
+   round.sentences=(struct elag_sentence*)malloc(max_sentences*sizeof(struct elag_sentence));
+   if (round.sentences==NULL) {
+      fatal_alloc_error("remove_ambiguities");
+   }
+   round.gramms=gramms;
+   round.language=language;
+   round.mutex=(n_threads>1)?SyncBuildMutex():NULL;
+   void** w_ptr=NULL;
+   if (n_threads>1) {
+      w_ptr=(void**)malloc(n_threads*sizeof(void*));
+      if (w_ptr==NULL) {
+         fatal_alloc_error("remove_ambiguities");
       }
-      u_printf("Sentence %d\n",current_sentence);
-      if (tfst->automaton->number_of_states<2) {
-         /* If the sentence is empty, we replace the sentence automaton
-          * by a 1-state automaton with no transition. */
-         error("Sentence %d is empty\n",current_sentence);
-         free_SingleGraph(tfst->automaton,free_symbol);
-         tfst->automaton=new_SingleGraph(1,PTR_TAGS);
-         SingleGraphState initial_state=add_state(tfst->automaton);
-         set_initial_state(initial_state);
-         nb_unloadable++;
+      for (int i=0;i<n_threads;i++) {
+         w_ptr[i]=&round;
+      }
+   }
+   int N=input->tfst->N;
+   for (int first=1;first<=N;first=first+max_sentences) {
+      round.n_sentences=(N-first+1<max_sentences)?(N-first+1):max_sentences;
+      round.next_sentence=0;
+      for (int k=0;k<round.n_sentences;k++) {
+         load_tfst_sentence_automaton(input,first+k);
+         detach_current_sentence(input->tfst,&(round.sentences[k].tfst));
+      }
+      /* The sentence delimiter must be known before the workers start,
+       * since they must not modify the language */
+      language_add_form(language,SENTENCE_DELIMITER);
+      if (n_threads>1) {
+         SyncRunThreads((unsigned int)n_threads,elag_worker_thread,w_ptr);
       } else {
-         int min,max;
-         before=evaluate_ambiguity(tfst->automaton,&min,&max);
-         total_before += before;
-         length_before = length_before + ((double) (min + max) / (double) 2);
-         add_sentence_delimiters(tfst,language);
-         if (tfst->automaton->number_of_states<2) {
-            error("Sentence %d is empty\n",current_sentence) ;
+         elag_worker_thread(&round,0);
+      }
+      for (int k=0;k<round.n_sentences;k++) {
+         struct elag_sentence* s=&(round.sentences[k]);
+         int current_sentence=first+k;
+         if (current_sentence % 100 == 0) {
+            u_printf("Sentence %d/%d...\r",current_sentence,N);
+         }
+         u_printf("Sentence %d\n",current_sentence);
+         if (s->empty) {
+            error("Sentence %d is empty\n",current_sentence);
+         }
+         if (s->unloadable) {
+            nb_unloadable++;
          } else {
-            for (int j=0;j<gramms->nbelems;j++) {
-               Fst2Automaton* grammar=(Fst2Automaton*)(gramms->tab[j]);
-               SingleGraph temp=elag_intersection(language,tfst->automaton,grammar->automaton,TEXT_GRAMMAR);
-               trim(temp,free_symbol);
-               free_SingleGraph(tfst->automaton,free_symbol);
-               tfst->automaton=temp;
-               if (tfst->automaton->number_of_states<2) {
-                  /* If the sentence has been rejected by the grammar */
-                  error("Sentence %d rejected\n\n",current_sentence);
-                  j=gramms->nbelems; /* We don't go on intersecting with other grammars */
-                  n_rejected_sentences++;
-                  free_SingleGraph(tfst->automaton,free_symbol);
-                  tfst->automaton=new_SingleGraph(1,PTR_TAGS);
-                  SingleGraphState initial_state=add_state(tfst->automaton);
-                  set_initial_state(initial_state);
-                  is_rejected=1;
-                  break;
-               }
+            total_before += s->before;
+            length_before = length_before + s->length_before;
+            if (s->rejected) {
+               error("Sentence %d rejected\n\n",current_sentence);
+               n_rejected_sentences++;
+            } else {
+               total_after += s->after;
+               length_after = length_after + s->length_after;
             }
          }
-         if (!is_rejected) {
-            elag_determinize(language,tfst->automaton,free_symbol);
-            trim(tfst->automaton,free_symbol);
-            elag_minimize(tfst->automaton);
-            remove_sentence_delimiters(tfst,language);
-            after = evaluate_ambiguity(tfst->automaton,&min,&max);
-            total_after += after;
-            length_after = length_after + ((double) (min + max) / (double) 2);
-         }
+         vector_ptr* new_tags=convert_elag_symbols_to_tfst_tags(&(s->tfst));
+         save_current_sentence(&(s->tfst),output_tfst,output_tind,(unichar**)new_tags->tab,new_tags->nbelems,form_frequencies);
+         free_vector_ptr(new_tags,free);
+         free_current_sentence(&(s->tfst));
       }
-      vector_ptr* new_tags=convert_elag_symbols_to_tfst_tags(input);
-      save_current_sentence(input->tfst,output_tfst,output_tind,(unichar**)new_tags->tab,new_tags->nbelems,form_frequencies);
-      free_vector_ptr(new_tags,free);
-      free_SingleGraph(tfst->automaton,NULL);
-      tfst->automaton=NULL;
    }
+   if (n_threads>1) {
+      SyncDeleteMutex(round.mutex);
+      free(w_ptr);
+   }
+   free(round.sentences);
    u_printf("\n");
-   int N=input->tfst->N;
    tfst_file_close_in(input);
    u_fclose(output_tfst);
    u_fclose(output_tind);
@@ -271,7 +393,7 @@ void explode_tfst(const char* input_tfst,const char* output, const VersatileEnco
       if (current_sentence % 100 == 0) {
          u_printf("Sentence %d/%d...\r",current_sentence,input->tfst->N);
       }
-      vector_ptr* new_tags=convert_elag_symbols_to_tfst_tags(input);
+      vector_ptr* new_tags=convert_elag_symbols_to_tfst_tags(input->tfst);
       save_current_sentence(input->tfst,output_tfst,output_tind,(unichar**)new_tags->tab,new_tags->nbelems,
                                  form_frequencies);
       free_vector_ptr(new_tags,free);
@@ -336,8 +458,7 @@ return grammars;
  * Adds {S} at the beginning and end of the sentence automaton.
  */
 static void add_sentence_delimiters(Tfst* tfst,language_t* language) {
-static const unichar S[] = { '{', 'S', '}', 0 };
-int idx=language_add_form(language,S);
+int idx=language_add_form(language,SENTENCE_DELIMITER);
 symbol_t* delimiter=new_symbol_PUNC(language,idx,-1);
 int pseudo_initial_state_index=tfst->automaton->number_of_states;
 SingleGraphState pseudo_initial_state=add_state(tfst->automaton);
@@ -465,11 +586,11 @@ return vector_ptr_add(tags,u_strdup(tag));
  * tfst tag strings like "@STD\n@{fait,faire.V:P3s:Kms}\n@2-2\n.\n"
  * We replace symbol_t* by integers that are indexes in the vector we return.
  */
-vector_ptr* convert_elag_symbols_to_tfst_tags(Elag_Tfst_file_in* input) {
+vector_ptr* convert_elag_symbols_to_tfst_tags(Tfst* tfst) {
 /* We change the tag type */
-input->tfst->automaton->tag_type=INT_TAGS;
+tfst->automaton->tag_type=INT_TAGS;
 vector_ptr* tags=new_vector_ptr(16);
-SingleGraph automaton=input->tfst->automaton;
+SingleGraph automaton=tfst->automaton;
 unichar tmp[4096];
 TfstTag* foo_tag=new_TfstTag(T_STD);
 Ustring* foo_content=new_Ustring(256);
@@ -483,7 +604,7 @@ for (int i=0;i<automaton->number_of_states;i++) {
       if (symbol->tfsttag_index==-1) {
          fatal_error("Internal error in convert_elag_symbols_to_tfst_tags: unexpected -1 tag index for this tag:\n%S\n",foo_content->str);
       }
-      TfstTag* original_tag=(TfstTag*)input->tfst->tags->tab[symbol->tfsttag_index];
+      TfstTag* original_tag=(TfstTag*)tfst->tags->tab[symbol->tfsttag_index];
       symbol_to_tfst_tag(symbol,original_tag,foo_tag,foo_content,tmp);
       t->tag_number=insert_tag(tags,tmp);
       t=t->next;
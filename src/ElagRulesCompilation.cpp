@@ -43,9 +43,6 @@
 
 namespace unitex {
 
-/* Maximum number of states for a grammar before we split it in several fst2 */
-#define MAX_GRAM_SIZE   128
-
 /* This constant is used at the time of locating the bounds of Elag rules's parts */
 #define ELAG_UNDEFINED (-1)
 
@@ -246,10 +243,10 @@ return 0;
 /**
  * This function reads a file that contains a list of Elag grammar names,
  * and it compiles them into the file 'outname'. However, if the result
- * automaton is too big, it will be saved in several automata inside
- * the output file.
+ * automaton has more than 'max_states' states, it will be saved in several
+ * automata inside the output file.
  */
-int compile_elag_rules(char* rulesname,char* outname, const VersatileEncodingConfig* vec,language_t* language) {
+int compile_elag_rules(char* rulesname,char* outname, const VersatileEncodingConfig* vec,language_t* language,int max_states) {
 u_printf("Compilation of %s\n",rulesname);
 U_FILE* f=NULL;
 U_FILE* frules=u_fopen(ASCII,rulesname,U_READ);
@@ -320,11 +317,14 @@ while (af_fgets(buf,UNITEX_FULLPATH_MAX,frules->f)) {
       free_SingleGraph(tmp,NULL);
       free_Fst2Automaton(A,NULL);
       trim(res->automaton,NULL);
+      /* We minimize the intersection before looking at its size, so that
+       * as many rules as possible are merged into the same automaton */
+      elag_minimize(res->automaton,1);
    } else {
       res=A;
    }
    nbRules++;
-   if (res->automaton->number_of_states>MAX_GRAM_SIZE) {
+   if (res->automaton->number_of_states>max_states) {
       /* If the automaton is too large, we will split the grammar
        * into several automata */
       elag_minimize(res->automaton,1);
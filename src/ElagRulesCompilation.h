@@ -45,6 +45,15 @@ namespace unitex {
 #define ELAG_MAX_CONSTRAINTS 8
 
 
+/**
+ * This is the default maximum number of states for a compiled grammar
+ * before we split it in several fst2. Elag intersects each sentence with
+ * every grammar of the .rul file, so that bigger grammars mean fewer
+ * intersections.
+ */
+#define MAX_GRAM_SIZE   128
+
+
 /**
  * This structure defines a couple of automata. It is used
  * to store the left and right parts of an Elag rule.
@@ -74,7 +83,7 @@ typedef struct {
 
 
 int compile_elag_grammar(char*,char*, const VersatileEncodingConfig*,language_t*);
-int compile_elag_rules(char*,char*, const VersatileEncodingConfig*,language_t*);
+int compile_elag_rules(char*,char*, const VersatileEncodingConfig*,language_t*,int max_states = MAX_GRAM_SIZE);
 
 } // namespace unitex
 
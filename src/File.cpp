@@ -25,6 +25,11 @@
 #include "File.h"
 #include "Error.h"
 #include "base/vendor/whereami/whereami.h"
+#include "base/compiler/intrinsic/atomic.h"    // unitex_atomic_add_long
+
+#ifndef _NOT_UNDER_WINDOWS
+#include <process.h>  // _getpid()
+#endif
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -605,6 +610,65 @@ if (res!=0) {
 }
 
 
+/**
+ * Number of temporary files opened by open_temp_file_for in this process.
+ */
+static long n_temp_files=0;
+
+
+/**
+ * Opens for writing a new file, in the same directory as 'name', whose
+ * name is copied into 'tmp_name'. This name is made of the process id and
+ * of a counter, so that it is unique even when several threads of the same
+ * process save the same file. Once complete, this file is meant to replace
+ * 'name' with replace_file, so that a concurrent reader of 'name', that
+ * may have it mapped in memory, never sees a file being written. Returns
+ * NULL on error.
+ */
+ABSTRACTFILE* open_temp_file_for(const char* name,char* tmp_name) {
+char suffix[64];
+long n=unitex_atomic_add_long(&n_temp_files,1);
+#ifdef _NOT_UNDER_WINDOWS
+sprintf(suffix,".%ld.%ld.tmp",(long)getpid(),n);
+#else
+sprintf(suffix,".%ld.%ld.tmp",(long)_getpid(),n);
+#endif
+if (strlen(name)+strlen(suffix)>=FILENAME_MAX) {
+   return NULL;
+}
+strcpy(tmp_name,name);
+strcat(tmp_name,suffix);
+return af_fopen(tmp_name,"wb");
+}
+
+
+/**
+ * Replaces the file 'name' by the file 'tmp_name'. On disk, this is done
+ * atomically, so that 'name' always exists for the other processes. If
+ * 'name' cannot be replaced, 'tmp_name' is removed. Returns 1 in case of
+ * success; 0 otherwise.
+ */
+int replace_file(const char* tmp_name,const char* name) {
+int ok;
+if (is_filename_in_abstract_file_space(name) || is_filename_in_abstract_file_space(tmp_name)) {
+   /* The virtual file system cannot rename a file over an existing one,
+    * but its files cannot be mapped by other processes */
+   af_remove(name);
+   ok=(af_rename(tmp_name,name)==0);
+} else {
+#ifdef _NOT_UNDER_WINDOWS
+   ok=(af_rename(tmp_name,name)==0);
+#else
+   ok=(MoveFileExA(tmp_name,name,MOVEFILE_REPLACE_EXISTING)!=0);
+#endif
+}
+if (!ok) {
+   af_remove(tmp_name);
+}
+return ok;
+}
+
+
 /**
  * Returns 1 if the given file exists and can be read; 0 otherwise.
  */
@@ -307,6 +307,8 @@ void replace_path_separator_by_colon(char*);
 void replace_colon_by_path_separator(char*);
 void new_file(const char*,const char*,char*);
 void copy_file(const char*,const char*);
+ABSTRACTFILE* open_temp_file_for(const char*,char*);
+int replace_file(const char*,const char*);
 int fexists(const char*);
 int file_exists(const char* filename);
 time_t get_file_date(const char* name);
@@ -47,6 +47,10 @@ const char* usage_Fst2Txt =
          "  -x/--dont_start_on_space: disables morphological use of space (default)\n"
          "  -c/--char_by_char: uses char by char tokenization; useful for languages like Thai\n"
          "  -w/--word_by_word: uses word by word tokenization (default)\n"
+         "  -j N/--threads=N: applies the grammar with N threads (default: 1). The text is\n"
+         "                    cut after newlines, so this is only done if no match of the\n"
+         "                    grammar can go over a newline. The result is the same as\n"
+         "                    with a single thread\n"
          "\n"
          "Output options:\n"
          "  -M/--merge (default)\n"
@@ -67,7 +71,7 @@ static void usage() {
   u_printf(usage_Fst2Txt);
 }
 
-const char* optstring_Fst2Txt=":t:a:MRcwsxVhlro:k:q:$:@:";
+const char* optstring_Fst2Txt=":t:a:MRcwsxVhlro:k:q:$:@:j:";
 const struct option_TS lopts_Fst2Txt[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -86,6 +90,7 @@ const struct option_TS lopts_Fst2Txt[]= {
   {"help",no_argument_TS,NULL,'h'},
   {"no_convert_lf_to_crlf",no_argument_TS,NULL,'l'},
   {"no_suppress_cr",no_argument_TS,NULL,'r'},
+  {"threads",required_argument_TS,NULL,'j'},
   {NULL,no_argument_TS,NULL,0}
 };
 
@@ -101,6 +106,7 @@ char in_offsets[FILENAME_MAX]="";
 char out_offsets[FILENAME_MAX]="";
 int val,index=-1;
 bool only_verify_arguments = false;
+char foo;
 UnitexGetOpt options;
 
 while (EOF!=(val=options.parse_long(argc,argv,optstring_Fst2Txt,lopts_Fst2Txt,&index))) {
@@ -187,6 +193,13 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Fst2Txt,lopts_Fst2Txt,&i
              break;
    case 'l': p->convLFtoCRLF=0; break;
    case 'r': p->keepCR = 1; break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&(p->n_threads),&foo) || p->n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                free_fst2txt_parameters(p);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case '?': index==-1 ? error("Invalid option -%c\n",options.vars()->optopt) :
                          error("Invalid option --%s\n",options.vars()->optarg);
              free_fst2txt_parameters(p);
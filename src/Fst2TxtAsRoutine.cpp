@@ -25,6 +25,8 @@
 #include "Overlap.h"
 #include "Fst2Check_lib.h"
 #include "File.h"
+#include "String_hash.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -39,7 +41,10 @@ namespace unitex {
 #define MINIMAL_SIZE_PRELOADED_TEXT (2048+1)
 
 static void build_state_token_trees(struct fst2txt_parameters*);
+static void build_start_chars(struct fst2txt_parameters*);
 static void parse_text(struct fst2txt_parameters*);
+static int can_split_text_at_newlines(struct fst2txt_parameters*);
+static void parse_text_with_threads(struct fst2txt_parameters*);
 
 int main_fst2txt(struct fst2txt_parameters* p) {
     p->f_input = u_fopen(&(p->vec), p->input_text_file, U_READ);
@@ -107,7 +112,13 @@ int main_fst2txt(struct fst2txt_parameters* p) {
     u_printf("Applying %s in %s mode...\n", p->fst_file, (p->output_policy
             == MERGE_OUTPUTS) ? "merge" : "replace");
     build_state_token_trees(p);
-    parse_text(p);
+    build_start_chars(p);
+    if (p->n_threads > 1 && can_split_text_at_newlines(p)) {
+        parse_text_with_threads(p);
+    }
+    else {
+        parse_text(p);
+    }
     u_fclose(p->f_input);
     u_fclose(p->f_output);
     if (p->output_text_file_is_temp) {
@@ -136,6 +147,8 @@ struct fst2txt_parameters* new_fst2txt_parameters() {
     p->alphabet_file = NULL;
     p->f_input = NULL;
     p->f_output = NULL;
+    p->output_text = NULL;
+    p->n_threads = 1;
     p->fst2 = NULL;
     p->fst2txt_abstract_allocator = NULL;
     p->fst2txt_abstract_allocator_mot_token = NULL;
@@ -147,6 +160,7 @@ struct fst2txt_parameters* new_fst2txt_parameters() {
     p->alphabet_file = NULL;
     p->token_tree = NULL;
     p->n_token_trees = 0;
+    p->start_chars = NULL;
     p->variables = NULL;
     p->output_policy = MERGE_OUTPUTS;
     p->tokenization_policy = WORD_BY_WORD_TOKENIZATION;
@@ -193,6 +207,7 @@ void free_fst2txt_parameters(struct fst2txt_parameters* p) {
         free_cb(p->token_tree, p->fst2txt_abstract_allocator);
     }
 
+    free(p->start_chars);
     free_Variables(p->variables);
     free_buffer(p->text_buffer);
 
@@ -312,35 +327,97 @@ void emit_output(struct fst2txt_parameters* p, unichar* s, int pos) {
 }
 
 
-static void parse_text(struct fst2txt_parameters* p) {
-    unichar * mot_token_buffer = (unichar * )malloc(sizeof(unichar) * MOT_BUFFER_TOKEN_SIZE);
-    if (mot_token_buffer == NULL) {
-      fatal_alloc_error("parse_text\n");
+/**
+ * Returns the first position in [start;limit[ whose character is in the given
+ * bit array, or 'limit' if there is none.
+ */
+static inline int skip_non_start_chars(const unichar* buffer, int start, int limit,
+        const unsigned char* start_chars) {
+    int i = start;
+    /* We test characters by groups of 4 to keep the loop tight, and then
+     * we look for the exact stop position */
+    while (i + 4 <= limit
+            && !(start_chars[buffer[i] >> 3] & (1 << (buffer[i] & 7)))
+            && !(start_chars[buffer[i + 1] >> 3] & (1 << (buffer[i + 1] & 7)))
+            && !(start_chars[buffer[i + 2] >> 3] & (1 << (buffer[i + 2] & 7)))
+            && !(start_chars[buffer[i + 3] >> 3] & (1 << (buffer[i + 3] & 7)))) {
+        i = i + 4;
     }
-    fill_buffer(p->text_buffer, p->text_buffer->MAXIMUM_BUFFER_SIZE, p->keepCR, p->f_input);
-    int debut = p->fst2->initial_states[1];
-    p->variables = new_Variables(p->fst2->input_variables);
-    int n_blocks = 0;
-    u_printf("Block %d", n_blocks);
-    int within_tag = 0;
-    if (p->output_policy == MERGE_OUTPUTS /* && p->f_out_offsets!=NULL*/) {
-        p->insertions = new_vector_int(2048, p->fst2txt_abstract_allocator);
-        p->current_insertions = new_vector_int(2048, p->fst2txt_abstract_allocator);
+    while (i < limit && !(start_chars[buffer[i] >> 3] & (1 << (buffer[i] & 7)))) {
+        i++;
     }
-    p->v_out_offsets = new_vector_offset();
-    /* The following test used to be a <, but now it's a <= because of the {$} tag
-     * that may be used even if the end of the text has already been reached */
-    while (p->current_origin <= p->text_buffer->size) {
+    return i;
+}
+
+
+/**
+ * Writes n characters of the output text.
+ */
+static void write_output(struct fst2txt_parameters* p, const unichar* s, int n) {
+    if (p->output_text != NULL) {
+        u_strcat(p->output_text, s, n);
+    }
+    else if (p->convLFtoCRLF == 0) {
+        u_fwrite_raw(s, n, p->f_output);
+    }
+    else {
+        u_fwrite(s, n, p->f_output);
+    }
+}
+
+
+/**
+ * Applies the grammar at each position of the text buffer, from
+ * p->current_origin, refilling the buffer from p->f_input when needed.
+ * The last position of the buffer is tried as well, for the {$} tag, only
+ * if 'end_of_text' is non-zero.
+ */
+static void parse_buffer(struct fst2txt_parameters* p, unichar* mot_token_buffer,
+        int* within_tag_, int* n_blocks, int end_of_text) {
+    int debut = p->fst2->initial_states[1];
+    int within_tag = *within_tag_;
+    /* At the end of the text, the following test used to be a <, but now it's a <=
+     * because of the {$} tag that may be used even if the end of the text has
+     * already been reached */
+    while (p->current_origin < p->text_buffer->size
+           || (end_of_text && p->current_origin == p->text_buffer->size)) {
         clean_allocator(p->pa.prv_alloc_vector_int_inside_token);
         if (!p->text_buffer->end_of_file && p->current_origin
             > (p->text_buffer->size - MINIMAL_SIZE_PRELOADED_TEXT)) {
             /* If we must change of block, we update the absolute offset, and we fill the
-             * buffer. */
-            p->absolute_offset = p->absolute_offset + p->current_origin;
-            fill_buffer_keepCR_option(p->text_buffer, p->current_origin, p->keepCR, p->f_input);
-            p->current_origin = 0;
-            n_blocks++;
-            u_printf("\rBlock %d        ", n_blocks);
+             * buffer. We keep the previous character, so that the tests on the left
+             * context of a match do not depend on where blocks start */
+            p->absolute_offset = p->absolute_offset + p->current_origin - 1;
+            fill_buffer_keepCR_option(p->text_buffer, p->current_origin - 1, p->keepCR, p->f_input);
+            p->current_origin = 1;
+            (*n_blocks)++;
+            u_printf("\rBlock %d        ", *n_blocks);
+        }
+        if (p->start_chars != NULL) {
+            /* No match can start on a character that is not in start_chars, so we
+             * copy such characters in one go, without trying the grammar on them.
+             * We stop where the per-position loop would have to refill the buffer */
+            int limit = p->text_buffer->size;
+            if (!p->text_buffer->end_of_file
+                && limit > p->text_buffer->size - MINIMAL_SIZE_PRELOADED_TEXT + 1) {
+                limit = p->text_buffer->size - MINIMAL_SIZE_PRELOADED_TEXT + 1;
+            }
+            int end = skip_non_start_chars(p->buffer, p->current_origin, limit, p->start_chars);
+            if (end != p->current_origin) {
+                int n = end - p->current_origin;
+                write_output(p, p->buffer + p->current_origin, n);
+                if (p->convLFtoCRLF != 0) {
+                    for (int i = p->current_origin; i < end; i++) {
+                        if (p->buffer[i] == '\n') {
+                            (p->CR_shift)++;
+                            (p->new_absolute_origin)++;
+                        }
+                    }
+                }
+                p->new_absolute_origin = p->new_absolute_origin + n;
+                p->current_origin = end;
+                continue;
+            }
         }
         p->output[0] = '\0';
         empty(p->stack);
@@ -404,24 +481,17 @@ static void parse_text(struct fst2txt_parameters* p) {
                 vector_offset_add(p->v_out_offsets, a, b, c, d);
             }
         }
-        if (p->convLFtoCRLF == 0) {
-            u_fputs_raw(p->output, p->f_output);
-        }
-        else {
-            u_fputs(p->output, p->f_output);
+        int output_length = u_strlen(p->output);
+        if (output_length != 0) {
+            write_output(p, p->output, output_length);
         }
-        p->new_absolute_origin = p->new_absolute_origin + u_strlen(p->output);
+        p->new_absolute_origin = p->new_absolute_origin + output_length;
         if (p->input_length == 0) {
             // if no input was read, we go on
             // u_fputc_raw write exactly the unichar in parameter
             // u_fputc replace LF ('\n') by CRLF ('\r\n')
             if (p->current_origin < p->text_buffer->size) {
-                if (p->convLFtoCRLF == 0) {
-                    u_fputc_raw(p->buffer[p->current_origin], p->f_output);
-                }
-                else {
-                    u_fputc(p->buffer[p->current_origin], p->f_output);
-                }
+                write_output(p, p->buffer + p->current_origin, 1);
             }
             (p->new_absolute_origin)++;
             if ((p->convLFtoCRLF != 0) && (p->buffer[p->current_origin] == '\n')) {
@@ -447,6 +517,26 @@ static void parse_text(struct fst2txt_parameters* p) {
             p->current_origin = new_origin;
         }
     }
+    *within_tag_ = within_tag;
+}
+
+
+static void parse_text(struct fst2txt_parameters* p) {
+    unichar * mot_token_buffer = (unichar * )malloc(sizeof(unichar) * MOT_BUFFER_TOKEN_SIZE);
+    if (mot_token_buffer == NULL) {
+      fatal_alloc_error("parse_text\n");
+    }
+    fill_buffer(p->text_buffer, p->text_buffer->MAXIMUM_BUFFER_SIZE, p->keepCR, p->f_input);
+    p->variables = new_Variables(p->fst2->input_variables);
+    int n_blocks = 0;
+    u_printf("Block %d", n_blocks);
+    int within_tag = 0;
+    if (p->output_policy == MERGE_OUTPUTS /* && p->f_out_offsets!=NULL*/) {
+        p->insertions = new_vector_int(2048, p->fst2txt_abstract_allocator);
+        p->current_insertions = new_vector_int(2048, p->fst2txt_abstract_allocator);
+    }
+    p->v_out_offsets = new_vector_offset();
+    parse_buffer(p, mot_token_buffer, &within_tag, &n_blocks, 1);
     u_printf("\r                           \n");
     free_Variables(p->variables);
     p->variables = NULL;
@@ -454,6 +544,7 @@ static void parse_text(struct fst2txt_parameters* p) {
 }
 
 
+
 /*
  * scan_graph token a lot of time of comparing string against
  *  "<E>", "<MOT>", "<NB>", "<MAJ>", "<MIN>", "<PRE>", "<PNC>", "<L>", "<^>", "#", " "
@@ -1390,4 +1481,460 @@ static void build_state_token_trees(struct fst2txt_parameters* p) {
     }
 }
 
+
+/**
+ * This structure is used to compute the characters that can start a match.
+ * 'state' tells for each fst2 state if it has not been explored yet (0), if it
+ * is being explored (1), if it has been explored (2) or if it has been explored
+ * and can reach a final state without reading any text (3). 'expanded' marks
+ * the characters whose uppercase equivalents have already been added. 'any' is
+ * set when we cannot tell which characters can start a match.
+ */
+struct start_chars_info {
+    unsigned char* set;
+    unsigned char* expanded;
+    char* state;
+    int any;
+    int letters_added;
+};
+
+
+static inline void set_start_char(unsigned char* set, unichar c) {
+    set[c >> 3] = (unsigned char) (set[c >> 3] | (1 << (c & 7)));
+}
+
+
+/**
+ * Adds 'c' and all the characters that 'c' can match in the text, i.e. its
+ * uppercase equivalents.
+ */
+static void add_start_char_variants(struct start_chars_info* info, unichar c,
+        Alphabet* alphabet) {
+    if (info->expanded[c >> 3] & (1 << (c & 7))) {
+        return;
+    }
+    set_start_char(info->expanded, c);
+    for (int i = 0; i < 0x10000; i++) {
+        if (is_equal_or_uppercase(c, (unichar) i, alphabet)) {
+            set_start_char(info->set, (unichar) i);
+        }
+    }
+}
+
+
+static void add_start_letters(struct start_chars_info* info, Alphabet* alphabet) {
+    if (info->letters_added) {
+        return;
+    }
+    info->letters_added = 1;
+    for (int i = 0; i < 0x10000; i++) {
+        if (is_letter((unichar) i, alphabet)) {
+            set_start_char(info->set, (unichar) i);
+        }
+    }
+}
+
+
+/**
+ * Adds to info->set the first characters of the text sequences that can be
+ * matched from the state 'e', following the same tag cases as scan_graph.
+ * Returns a non-zero value if a final state can be reached from 'e' without
+ * reading any text. 'main_graph' is non-zero if 'e' belongs to the main graph,
+ * where reaching a final state that way is a match that may happen anywhere.
+ */
+static int explore_start_chars(struct fst2txt_parameters* p, int e,
+        int main_graph, struct start_chars_info* info) {
+    if (info->any) {
+        return 0;
+    }
+    if (info->state[e] == 1) {
+        /* A loop that reads nothing: we give up */
+        info->any = 1;
+        return 0;
+    }
+    if (info->state[e] != 0) {
+        return info->state[e] == 3;
+    }
+    info->state[e] = 1;
+    Fst2State current_state = p->fst2->states[e];
+    int nullable = is_final_state(current_state);
+    if (nullable && main_graph) {
+        info->any = 1;
+    }
+    struct string_hash_tree_transition* trans = p->token_tree[e]->hash->root->trans;
+    while (trans != NULL) {
+        add_start_char_variants(info, trans->letter, p->alphabet);
+        trans = trans->next;
+    }
+    for (Transition* t = current_state->transitions; t != NULL && !info->any; t = t->next) {
+        int n_etiq = t->tag_number;
+        if (n_etiq < 0) {
+            if (explore_start_chars(p, p->fst2->initial_states[-n_etiq], 0, info)) {
+                nullable = explore_start_chars(p, t->state_number, main_graph, info) || nullable;
+            }
+            continue;
+        }
+        Fst2Tag etiq = p->fst2->tags[n_etiq];
+        unichar* contenu = etiq->input;
+        int len = u_len_possible_match(contenu);
+        if (etiq->type == BEGIN_VAR_TAG || etiq->type == END_VAR_TAG
+                || etiq->type == BEGIN_OUTPUT_VAR_TAG || etiq->type == END_OUTPUT_VAR_TAG) {
+            /* Variables keep their state from one position to the next, so
+             * we must try the grammar everywhere */
+            info->any = 1;
+        } else if (etiq->type == TEXT_START_TAG || etiq->type == TEXT_END_TAG
+                || (len == 3 && !u_trymatch_superfast3(contenu, ETIQ_E_LN3))
+                || (len == 1 && !u_trymatch_superfast1(contenu, '#')
+                    && !(etiq->control & RESPECT_CASE_TAG_BIT_MASK))) {
+            nullable = explore_start_chars(p, t->state_number, main_graph, info) || nullable;
+        } else if ((len == 5 && !u_trymatch_superfast5(contenu, ETIQ_MOT_LN5))
+                || (len == 6 && !u_trymatch_superfast6(contenu, ETIQ_WORD_LN6))
+                || (len == 5 && !u_trymatch_superfast5(contenu, ETIQ_MAJ_LN5))
+                || (len == 7 && !u_trymatch_superfast7(contenu, ETIQ_UPPER_LN7))
+                || (len == 5 && !u_trymatch_superfast5(contenu, ETIQ_MIN_LN5))
+                || (len == 7 && !u_trymatch_superfast7(contenu, ETIQ_LOWER_LN7))
+                || (len == 5 && !u_trymatch_superfast5(contenu, ETIQ_PRE_LN5))
+                || (len == 7 && !u_trymatch_superfast7(contenu, ETIQ_FIRST_LN7))) {
+            add_start_letters(info, p->alphabet);
+        } else if (len == 4 && !u_trymatch_superfast4(contenu, ETIQ_NB_LN4)) {
+            for (unichar c = '0'; c <= '9'; c++) {
+                set_start_char(info->set, c);
+            }
+        } else if (len == 5 && !u_trymatch_superfast5(contenu, ETIQ_PNC_LN5)) {
+            static const unichar pnc[] = { ';', '!', '?', ':', 0xbf, 0xa1, 0x0e4f,
+                    0x0e5a, 0x0e5b, 0x3001, 0x3002, 0x30fb, '.', 0 };
+            for (int i = 0; pnc[i] != 0; i++) {
+                set_start_char(info->set, pnc[i]);
+            }
+        } else if (len == 3 && !u_trymatch_superfast3(contenu, ETIQ_CIRC_LN3)) {
+            set_start_char(info->set, '\n');
+            set_start_char(info->set, '\r');
+        } else if (len == 1 && !u_trymatch_superfast1(contenu, ' ')) {
+            set_start_char(info->set, ' ');
+        } else if (len == 3 && !u_trymatch_superfast5(contenu, ETIQ_L_LN3)) {
+            add_start_letters(info, p->alphabet);
+        } else if (contenu[0] != '\0') {
+            if (etiq->control & RESPECT_CASE_TAG_BIT_MASK) {
+                set_start_char(info->set, contenu[0]);
+            } else {
+                add_start_char_variants(info, contenu[0], p->alphabet);
+            }
+        }
+    }
+    info->state[e] = (char) (nullable ? 3 : 2);
+    return nullable;
+}
+
+
+/**
+ * Computes the characters on which parse_text must stop: those that can start
+ * a match of the main graph, plus the '{' and '}' delimiters of tags. If we
+ * cannot tell, p->start_chars is left to NULL and every position is tried.
+ */
+static void build_start_chars(struct fst2txt_parameters* p) {
+    struct start_chars_info info;
+    info.set = (unsigned char*) calloc(0x10000 / 8, sizeof(unsigned char));
+    info.expanded = (unsigned char*) calloc(0x10000 / 8, sizeof(unsigned char));
+    info.state = (char*) calloc(p->fst2->number_of_states, sizeof(char));
+    if (info.set == NULL || info.expanded == NULL || info.state == NULL) {
+        fatal_alloc_error("build_start_chars");
+    }
+    info.any = 0;
+    info.letters_added = 0;
+    explore_start_chars(p, p->fst2->initial_states[1], 1, &info);
+    free(info.expanded);
+    free(info.state);
+    if (info.any) {
+        free(info.set);
+        return;
+    }
+    if (p->space_policy == START_WITH_SPACE) {
+        /* Most tags skip a space before what they match */
+        set_start_char(info.set, ' ');
+    }
+    set_start_char(info.set, '{');
+    set_start_char(info.set, '}');
+    p->start_chars = info.set;
+}
+
+
+/* When Fst2Txt runs with several threads, each thread is given about
+ * FST2TXT_CHARS_PER_THREAD characters of text per block */
+#define FST2TXT_CHARS_PER_THREAD 65536
+
+
+/**
+ * Returns a non-zero value if no match of the grammar can go over a newline,
+ * so that the text can be cut after a newline and each part be processed on
+ * its own. This is not the case if the grammar can read a newline, if it uses
+ * {$}, whose match depends on where the text ends, or if it uses variables,
+ * whose values are kept from one position to the next.
+ */
+static int can_split_text_at_newlines(struct fst2txt_parameters* p) {
+    if (p->fst2->input_variables != NULL || is_letter('\n', p->alphabet)) {
+        return 0;
+    }
+    for (int i = 0; i < p->fst2->number_of_tags; i++) {
+        Fst2Tag etiq = p->fst2->tags[i];
+        if (etiq->type == TEXT_END_TAG || etiq->type == BEGIN_VAR_TAG
+                || etiq->type == END_VAR_TAG || etiq->type == BEGIN_OUTPUT_VAR_TAG
+                || etiq->type == END_OUTPUT_VAR_TAG) {
+            return 0;
+        }
+        if (etiq->input == NULL) {
+            continue;
+        }
+        if (u_strchr(etiq->input, '\n') != NULL
+                || (u_len_possible_match(etiq->input) == 3
+                    && !u_trymatch_superfast3(etiq->input, ETIQ_CIRC_LN3))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Returns the position just after the first newline of [target;limit[ that
+ * is not inside a {...} tag, or 'limit' if there is none. No tag must be open
+ * at 'start'. parse_text never starts a match inside a tag, and a match never
+ * goes over a newline if can_split_text_at_newlines is true, so the text can
+ * be cut there without changing the result.
+ */
+static int next_text_cut(const unichar* text, int start, int target, int limit) {
+    int within_tag = 0;
+    for (int i = start; i < limit; i++) {
+        if (text[i] == '{') {
+            within_tag = 1;
+        }
+        else if (text[i] == '}') {
+            within_tag = 0;
+        }
+        else if (text[i] == '\n' && !within_tag && i + 1 >= target) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+
+/**
+ * Returns the position just after the last newline of [0;size[ where the
+ * text can be cut, or 0 if there is none.
+ */
+static int last_text_cut(const unichar* text, int size) {
+    int within_tag = 0;
+    int cut = 0;
+    for (int i = 0; i < size; i++) {
+        if (text[i] == '{') {
+            within_tag = 1;
+        }
+        else if (text[i] == '}') {
+            within_tag = 0;
+        }
+        else if (text[i] == '\n' && !within_tag) {
+            cut = i + 1;
+        }
+    }
+    return cut;
+}
+
+
+/**
+ * A part of the text given to a worker. 'p' holds the private parsing state
+ * of the worker: its output text and offsets are relative to the beginning
+ * of the part, and the main thread shifts them when it merges the parts.
+ */
+struct fst2txt_worker {
+    struct fst2txt_parameters* p;
+    unichar* mot_token_buffer;
+    unichar* text;
+    int length;
+    int end_of_text;
+};
+
+
+/**
+ * Returns a copy of the given parameters for a worker. The grammar, its
+ * token trees, the alphabet and the start characters are shared, since
+ * scan_graph only reads them; the parsing state and the allocators are
+ * private.
+ */
+static struct fst2txt_parameters* new_fst2txt_worker_parameters(struct fst2txt_parameters* p) {
+    struct fst2txt_parameters* w = (struct fst2txt_parameters*) malloc(
+            sizeof(struct fst2txt_parameters));
+    if (w == NULL) {
+        fatal_alloc_error("new_fst2txt_worker_parameters");
+    }
+    memcpy(w, p, sizeof(struct fst2txt_parameters));
+    w->f_input = NULL;
+    w->f_output = NULL;
+    w->f_out_offsets = NULL;
+    w->v_in_offsets = NULL;
+    w->fst2txt_abstract_allocator = create_abstract_allocator("fst2txt_fst2",AllocatorCreationFlagAutoFreePrefered);
+    w->fst2txt_abstract_allocator_mot_token = create_abstract_allocator("fst2txt_fst2_mot_token", AllocatorFreeOnlyAtAllocatorDelete | AllocatorTipGrowingOftenRecycledObject);
+    w->pa.prv_alloc_vector_int_inside_token = create_abstract_allocator("fst2_txt_inside_token", AllocatorCreationFlagAutoFreePrefered);
+    w->pa.prv_alloc_recycle = create_abstract_allocator("fst2_txt_recycle",
+        AllocatorFreeOnlyAtAllocatorDelete | AllocatorTipGrowingOftenRecycledObject,
+        0);
+    w->pa.prv_alloc_backup_growing_recycle = create_abstract_allocator("fst2_txt_pattern_growing_recycle",
+        AllocatorFreeOnlyAtAllocatorDelete | AllocatorTipGrowingOftenRecycledObject,
+        0);
+    w->stack = new_stack_unichar(MAX_OUTPUT_LENGTH);
+    w->variables = new_Variables(p->fst2->input_variables);
+    w->text_buffer = (struct buffer*) malloc(sizeof(struct buffer));
+    if (w->text_buffer == NULL) {
+        fatal_alloc_error("new_fst2txt_worker_parameters");
+    }
+    w->text_buffer->type = UNICHAR_BUFFER;
+    w->text_buffer->unichar_buffer = NULL;
+    w->text_buffer->MAXIMUM_BUFFER_SIZE = 0;
+    w->text_buffer->size = 0;
+    /* A worker never refills its buffer */
+    w->text_buffer->end_of_file = 1;
+    w->buffer = NULL;
+    w->insertions = NULL;
+    w->current_insertions = NULL;
+    if (p->output_policy == MERGE_OUTPUTS) {
+        w->insertions = new_vector_int(2048, w->fst2txt_abstract_allocator);
+        w->current_insertions = new_vector_int(2048, w->fst2txt_abstract_allocator);
+    }
+    w->v_out_offsets = new_vector_offset();
+    w->output_text = new_Ustring();
+    return w;
+}
+
+
+static void free_fst2txt_worker_parameters(struct fst2txt_parameters* w) {
+    free_Ustring(w->output_text);
+    free_vector_offset(w->v_out_offsets);
+    if (!(get_allocator_cb_flag(w->fst2txt_abstract_allocator) & AllocatorGetFlagAutoFreePresent)) {
+        free_vector_int(w->insertions, w->fst2txt_abstract_allocator);
+        free_vector_int(w->current_insertions, w->fst2txt_abstract_allocator);
+    }
+    /* The buffer points into the text of the main thread */
+    free(w->text_buffer);
+    free_Variables(w->variables);
+    free_stack_unichar(w->stack);
+    close_abstract_allocator(w->fst2txt_abstract_allocator);
+    close_abstract_allocator(w->fst2txt_abstract_allocator_mot_token);
+    close_abstract_allocator(w->pa.prv_alloc_vector_int_inside_token);
+    close_abstract_allocator(w->pa.prv_alloc_recycle);
+    close_abstract_allocator(w->pa.prv_alloc_backup_growing_recycle);
+    free(w);
+}
+
+
+static void ABSTRACT_CALLBACK_UNITEX fst2txt_worker_thread(void* private_data, unsigned int) {
+    struct fst2txt_worker* worker = (struct fst2txt_worker*) private_data;
+    struct fst2txt_parameters* p = worker->p;
+    empty(p->output_text);
+    p->v_out_offsets->nbelems = 0;
+    p->CR_shift = 0;
+    p->new_absolute_origin = 0;
+    if (worker->length == 0 && !worker->end_of_text) {
+        return;
+    }
+    p->buffer = worker->text;
+    p->text_buffer->unichar_buffer = worker->text;
+    p->text_buffer->MAXIMUM_BUFFER_SIZE = worker->length;
+    p->text_buffer->size = worker->length;
+    p->current_origin = 0;
+    int within_tag = 0;
+    int n_blocks = 0;
+    parse_buffer(p, worker->mot_token_buffer, &within_tag, &n_blocks, worker->end_of_text);
+}
+
+
+/**
+ * Does the same as parse_text with p->n_threads threads. The text is read by
+ * blocks. Each block is cut after newlines into one part per thread, and the
+ * main thread writes the outputs of the parts and merges their offsets in
+ * text order, so that the result is the same as with a single thread.
+ */
+static void parse_text_with_threads(struct fst2txt_parameters* p) {
+    int n_threads = p->n_threads;
+    struct buffer* text = new_buffer(n_threads * FST2TXT_CHARS_PER_THREAD, UNICHAR_BUFFER);
+    fill_buffer(text, text->MAXIMUM_BUFFER_SIZE, p->keepCR, p->f_input);
+    struct fst2txt_worker* workers = (struct fst2txt_worker*) malloc(n_threads * sizeof(struct fst2txt_worker));
+    void** w_ptr = (void**) malloc(n_threads * sizeof(void*));
+    if (workers == NULL || w_ptr == NULL) {
+        fatal_alloc_error("parse_text_with_threads");
+    }
+    for (int i = 0; i < n_threads; i++) {
+        workers[i].p = new_fst2txt_worker_parameters(p);
+        workers[i].mot_token_buffer = (unichar*) malloc(sizeof(unichar) * MOT_BUFFER_TOKEN_SIZE);
+        if (workers[i].mot_token_buffer == NULL) {
+            fatal_alloc_error("parse_text_with_threads");
+        }
+        w_ptr[i] = &(workers[i]);
+    }
+    p->v_out_offsets = new_vector_offset();
+    int n_blocks = 0;
+    u_printf("Block %d", n_blocks);
+    for (;;) {
+        /* We process the block up to its last cut, the rest of it will be
+         * processed with the next one */
+        int limit = text->end_of_file ? text->size : last_text_cut(text->unichar_buffer, text->size);
+        if (limit == 0) {
+            /* If there is no place to cut the block, we make it bigger. fill_buffer
+             * moves what is after 'pos' to the beginning of the buffer, so we put
+             * the text at the end of the new buffer before filling it */
+            struct buffer* bigger = new_buffer(2 * text->MAXIMUM_BUFFER_SIZE, UNICHAR_BUFFER);
+            int pos = bigger->MAXIMUM_BUFFER_SIZE - text->size;
+            memcpy(bigger->unichar_buffer + pos, text->unichar_buffer, text->size * sizeof(unichar));
+            fill_buffer(bigger, pos, p->keepCR, p->f_input);
+            free_buffer(text);
+            text = bigger;
+            continue;
+        }
+        int start = 0;
+        for (int i = 0; i < n_threads; i++) {
+            int end = limit;
+            if (i != n_threads - 1) {
+                end = next_text_cut(text->unichar_buffer, start,
+                        start + (limit - start) / (n_threads - i), limit);
+            }
+            workers[i].text = text->unichar_buffer + start;
+            workers[i].length = end - start;
+            workers[i].end_of_text = text->end_of_file && (i == n_threads - 1);
+            workers[i].p->absolute_offset = p->absolute_offset + start;
+            start = end;
+        }
+        SyncRunThreads((unsigned int) n_threads, fst2txt_worker_thread, w_ptr);
+        for (int i = 0; i < n_threads; i++) {
+            struct fst2txt_parameters* w = workers[i].p;
+            if (p->convLFtoCRLF == 0) {
+                u_fputs_raw(w->output_text->str, p->f_output);
+            }
+            else {
+                u_fputs(w->output_text->str, p->f_output);
+            }
+            for (int k = 0; k < w->v_out_offsets->nbelems; k++) {
+                Offsets* o = &(w->v_out_offsets->tab[k]);
+                vector_offset_add(p->v_out_offsets, o->old_start + p->CR_shift,
+                        o->old_end + p->CR_shift, o->new_start + p->new_absolute_origin,
+                        o->new_end + p->new_absolute_origin);
+            }
+            p->CR_shift = p->CR_shift + w->CR_shift;
+            p->new_absolute_origin = p->new_absolute_origin + w->new_absolute_origin;
+        }
+        if (text->end_of_file) {
+            break;
+        }
+        p->absolute_offset = p->absolute_offset + limit;
+        fill_buffer(text, limit, p->keepCR, p->f_input);
+        n_blocks++;
+        u_printf("\rBlock %d        ", n_blocks);
+    }
+    u_printf("\r                           \n");
+    for (int i = 0; i < n_threads; i++) {
+        free_fst2txt_worker_parameters(workers[i].p);
+        free(workers[i].mot_token_buffer);
+    }
+    free(workers);
+    free(w_ptr);
+    free_buffer(text);
+}
+
 } // namespace unitex
@@ -34,6 +34,7 @@
 #include "Stack_unichar.h"
 #include "Offsets.h"
 #include "Vector.h"
+#include "Ustring.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -59,6 +60,11 @@ struct fst2txt_parameters {
 
    U_FILE* f_input;
    U_FILE* f_output;
+   /* If not NULL, the output text is appended to this string instead of
+    * being written to f_output */
+   Ustring* output_text;
+   /* Number of threads used to apply the grammar to the text */
+   int n_threads;
    Fst2* fst2;
    Alphabet* alphabet;
 
@@ -71,6 +77,10 @@ struct fst2txt_parameters {
     * we cache it here, in order to avoid problems if the fst2 is freed
     * before 'token_tree'. */
    int n_token_trees;
+   /* Bit array of the 65536 characters on which the text parsing must stop
+    * (those that can start a match, and '{' and '}'), or NULL if a match
+    * may start on any character */
+   unsigned char* start_chars;
    InputVariables* variables;
    /* Here are the text buffer and the current origin in it */
    struct buffer* text_buffer;
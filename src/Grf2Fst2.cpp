@@ -72,7 +72,13 @@ const char* usage_Grf2Fst2 =
      "                            'let' space 'pi' # '=' # '3' # '.' # '1' # '4'\n"
      "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
      "  -C/--clean: compile only with outputs\n"
+     "  -j N/--threads=N: compile the graphs with N threads (default: 1)\n"
+     "  --cache=FILE: keep the compiled graphs in FILE, so that only the graphs that\n"
+     "                have changed since the last compilation are compiled again\n"
      "  -p/--pack-fst2: create a packed fst2 file\n"
+     "  -b/--binary-fst2: create a binary image of the fst2 file, that is loaded\n"
+     "                    without parsing. Such a file can only be used by a program\n"
+     "                    built for the same platform\n"
      "  -h/--help: this help\n"
      "\n"
      "Compiles the grammar <grf> and saves the result in a FST2 file\n"
@@ -139,7 +145,7 @@ return ret;
 }
 
 
-const char* optstring_Grf2Fst2=":ypntsa:d:ecVho:k:q:r:vS:C";
+const char* optstring_Grf2Fst2=":ypbntsa:d:ecVho:k:q:r:vS:Cj:";
 const struct option_TS lopts_Grf2Fst2[]= {
   {"loop_check",no_argument_TS,NULL,'y'},
   {"no_loop_check",no_argument_TS,NULL,'n'},
@@ -160,6 +166,9 @@ const struct option_TS lopts_Grf2Fst2[]= {
   {"strict_tokenization",no_argument_TS,NULL,'S'},
   {"clean",no_argument_TS,NULL,'C'},
   {"pack-fst2",no_argument_TS,NULL,'p'},
+  {"binary-fst2",no_argument_TS,NULL,'b'},
+  {"threads",required_argument_TS,NULL,'j'},
+  {"cache",required_argument_TS,NULL,2},
   {NULL,no_argument_TS,NULL,0}
 };
 
@@ -237,12 +246,15 @@ int val,index=-1;
 fst2_file_name[0]='\0';
 bool only_verify_arguments = false;
 bool pack_fst2 = false;
+bool image_fst2 = false;
 UnitexGetOpt options;
 int clean=0;
+char foo;
 
 while (EOF!=(val=options.parse_long(argc,argv,optstring_Grf2Fst2,lopts_Grf2Fst2,&index))) {
    switch(val) {
    case 'p': pack_fst2=true; break;
+   case 'b': image_fst2=true; break;
    case 'y': check_recursion=1; break;
    case 'n': check_recursion=0; break;
    case 't': tfst_check=1;
@@ -314,6 +326,21 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Grf2Fst2,lopts_Grf2Fst2,
    case 'S': infos->strict_tokenization=1; break;
    case 'C': clean=1;
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&(infos->n_threads),&foo) || infos->n_threads<=0) {
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                free(named);
+                free_compilation_info(infos);
+                return USAGE_ERROR_CODE;
+             }
+             break;
+   case 2: if (options.vars()->optarg[0]=='\0') {
+                error("Empty cache file name\n");
+                free(named);
+                free_compilation_info(infos);
+                return USAGE_ERROR_CODE;
+             }
+             strcpy(infos->cache_file,options.vars()->optarg);
+             break;
    case '?': index==-1 ? error("Invalid option -%c\n",options.vars()->optopt) :
                          error("Invalid option --%s\n",options.vars()->optarg);
              free(named);
@@ -353,6 +380,10 @@ if (fst2_file_name[0]=='\0') {
   strcpy(fst2_file_name,argv[options.vars()->optind]);
 }
 remove_extension(fst2_file_name);
+if (image_fst2) {
+  /* The image replaces the packed format */
+  pack_fst2 = true;
+}
 if (pack_fst2) {
   strcpy(fst2_packed_file_name, fst2_file_name); 
   strcat(fst2_packed_file_name, ".fst2");
@@ -409,7 +440,10 @@ if (tfst_check) {
 }
 
 free_compilation_info(infos);
-if (pack_fst2) {
+if (image_fst2) {
+  convert_fst2_to_fst2_image_file(fst2_file_name, fst2_packed_file_name, false);
+  af_remove(fst2_file_name);
+} else if (pack_fst2) {
   convert_fst2_to_fst2_pack_file(fst2_file_name, fst2_packed_file_name, false);
   af_remove(fst2_file_name);
 }
@@ -19,6 +19,7 @@
  *
  */
 
+#include <stddef.h>
 #include "Grf2Fst2_lib.h"
 #include "FIFO.h"
 #include "Error.h"
@@ -27,6 +28,7 @@
 #include "SingleGraph.h"
 #include "DebugMode.h"
 #include "Grf_lib.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -195,6 +197,9 @@ vector_int_add(infos->part_of_precompiled_fst2,0);
 infos->current_saved_graph=0;
 infos->check_outputs=0;
 infos->strict_tokenization=0;
+infos->n_threads=1;
+infos->cache_file[0]='\0';
+infos->messages=NULL;
 return infos;
 }
 
@@ -213,6 +218,32 @@ free(infos);
 }
 
 
+/**
+ * Prints the given warning on the error stream, or appends it to
+ * infos->messages if any.
+ */
+static void compilation_warning(const struct compilation_info* infos,const char* format,...) {
+va_list list;
+va_start(list,format);
+if (infos->messages==NULL) {
+   u_vfprintf(U_STDERR,format,list);
+   va_end(list);
+   return;
+}
+int size=u_vsprintf(NULL,format,list);
+va_end(list);
+unichar* tmp=(unichar*)malloc((size+1)*sizeof(unichar));
+if (tmp==NULL) {
+   fatal_alloc_error("compilation_warning");
+}
+va_start(list,format);
+u_vsprintf(tmp,format,list);
+va_end(list);
+u_strcat(infos->messages,tmp);
+free(tmp);
+}
+
+
 /**
  * Returns 1 if the given character is a letter, according to the
  * tokenization policy; 0 otherwise.
@@ -378,7 +409,7 @@ u_strcat(temp,".grf");
 /* Finally, we turn the file name into ISO-8859-1 */
 u_encode_char(name,temp);
 if (abs_path_name_warning!=0) {
-   error("Absolute path name detected (%s):\n"
+   compilation_warning(infos,"Absolute path name detected (%s):\n"
          "%s\n"
          "Absolute path names are not portable!\n",
          ((abs_path_name_warning==1) ? "Windows" :
@@ -845,7 +876,7 @@ if (token[0]==':' && token[1]!='\0') {
         free_choosen_allocated_or_stack_unichar_buffer(tmp,tmp_stack);
     }
     else if (is_an_output) {
-      error("WARNING in %S: ignoring output associated to subgraph call %S\n",
+      compilation_warning(infos,"WARNING in %S: ignoring output associated to subgraph call %S\n",
             infos->graph_names->value[current_graph],token);
    }
    if (!is_empty(u_tokens)) {
@@ -1345,7 +1376,7 @@ for (int i=m;i<n;i++) {
  *
  * Note also that this function does not apply to the initial and final states.
  */
-static void expand_box_ranges(Grf* grf,const char* graphFileName) {
+static void expand_box_ranges(Grf* grf,const char* graphFileName,const struct compilation_info* infos) {
 ReverseTransitions* reverse=compute_reverse_transitions(grf);
 int n=grf->n_states;
 for (int i=2;i<n;i++) {
@@ -1354,7 +1385,7 @@ for (int i=2;i<n;i++) {
     vector_ptr* lines=tokenize_box_content(s->box_content);
     // tokenize_box_content return NULL if there is error
     if (lines==NULL) {
-      error("Bad graph content '%S' at state position %d of file %s\n",s->box_content,i,graphFileName);
+      compilation_warning(infos,"Bad graph content '%S' at state position %d of file %s\n",s->box_content,i,graphFileName);
       continue;
     }
     unichar* last=(unichar*)lines->tab[lines->nbelems-1];
@@ -1455,79 +1486,14 @@ free_Ustring(ustr);
 
 
 /**
- * This function compiles the graph number #n and saves its states into the
- * output .fst2.
+ * Turns the given .grf into the graph #n, which is then cleaned but not
+ * minimized yet. The graph has no state if it has been emptied. The .grf
+ * is freed.
  */
-static int compile_grf(int n,struct compilation_info* infos,int clean) {
+static void build_graph_from_grf(Grf* grf,const char* name,SingleGraph graph,int n,
+                                 struct compilation_info* infos,int clean) {
 int i;
-char called_from[FILENAME_MAX]="";
-char name[FILENAME_MAX];
-char name_fst2[FILENAME_MAX];
-int n_caller;
-SingleGraph graph=new_SingleGraph();
-/* We get the absolute path of the graph */
-get_absolute_name(&n_caller,name,n,infos);
-if (n_caller!=-1) {
-    get_absolute_name(NULL,called_from,n_caller,infos);
-}
-char* full_name=NULL;
-if (infos->debug) {
-    full_name=name;
-}
-infos->current_saved_graph++;
-vector_int_add(infos->renumber,infos->current_saved_graph);
-char foo[FILENAME_MAX];
-get_extension(name,foo);
-if (foo[0]=='\0') {
-    strcat(name,".grf");
-}
-Grf* grf=NULL;
-if (fexists(name)) {
-    grf=load_Grf(&(infos->vec),name);
-}
-if (grf==NULL) {
-    /* If we can't load the .grf, maybe we should try the .fst2 */
-    remove_extension(name,name_fst2);
-    strcat(name_fst2,".fst2");
-    Fst2* fst2=NULL;
-    if (n!=1 && fexists(name_fst2)) {
-        /* We don't try to load the .fst2 for the main graph */
-        fst2=load_fst2(&(infos->vec),name_fst2,1);
-        if (fst2==NULL) {
-            error("Cannot load %s\n",name_fst2);
-            write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],full_name);
-            free_SingleGraph(graph,NULL);
-            vector_int_add(infos->part_of_precompiled_fst2,0);
-            if (n==1) return 0;
-            return 1;
-        }
-    } else {
-        error("Cannot open graph %s\n",name);
-        if (called_from[0]!='\0') {
-            error("which is called from %s\n",called_from);
-        }
-        write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],full_name);
-        free_SingleGraph(graph,NULL);
-        vector_int_add(infos->part_of_precompiled_fst2,0);
-        if (n==1) return 0;
-        return 1;
-    }
-    if (infos->verbose_name_grf!=0) {
-        u_printf("Loading compiled graph %s\n",name_fst2);
-    }
-    save_compiled_fst2(name_fst2,fst2,infos);
-    /* -1 because we already made infos->current_saved_graph++ */
-    infos->current_saved_graph+=(fst2->number_of_graphs-1);
-    free_Fst2(fst2);
-    free_SingleGraph(graph,NULL);
-    return 1;
-}
-if (n==1 || infos->verbose_name_grf!=0) {
-  u_printf("Compiling graph %s\n",/*infos->graph_names->value[n]*/name);
-}
-/* We indicate that we have a .grf */
-vector_int_add(infos->part_of_precompiled_fst2,0);
-expand_box_ranges(grf,name);
+expand_box_ranges(grf,name,infos);
 /* If necessary, we resize the graph that it can hold all the states */
 if (graph->capacity<grf->n_states) {
    set_state_array_capacity(graph,grf->n_states);
@@ -1639,25 +1605,110 @@ check_co_accessibility(graph->states,1);
 remove_epsilon_transitions(graph,1);
 check_accessibility(graph->states,0);
 remove_useless_states(graph,NULL);
+}
+
+
+/**
+ * Prints the message about the emptied graph #n, if any. Returns 0 if it
+ * makes the compilation fail, i.e. if #n is the main graph; 1 otherwise.
+ */
+static int report_emptied_graph(int n,const struct compilation_info* infos) {
+if (n!=1 && infos->no_empty_graph_warning) return 1;
+unichar* emptied_graph_name = u_strdup(infos->graph_names->value[n]);
+unsigned int emptied_graph_name_size = u_strlen(emptied_graph_name);
+for (unsigned int loop = 0; loop < emptied_graph_name_size; loop++) {
+  if (*(emptied_graph_name + loop) == 2)
+    *(emptied_graph_name + loop) = 0;
+}
+if (n==1) {
+   error("ERROR: Main graph %S.grf has been emptied\n", emptied_graph_name);
+   free(emptied_graph_name);
+   return 0;
+}
+error("WARNING: graph %S.grf has been emptied\n", emptied_graph_name);
+free(emptied_graph_name);
+return 1;
+}
+
+
+/**
+ * This function compiles the graph number #n and saves its states into the
+ * output .fst2.
+ */
+static int compile_grf(int n,struct compilation_info* infos,int clean) {
+char called_from[FILENAME_MAX]="";
+char name[FILENAME_MAX];
+char name_fst2[FILENAME_MAX];
+int n_caller;
+SingleGraph graph=new_SingleGraph();
+/* We get the absolute path of the graph */
+get_absolute_name(&n_caller,name,n,infos);
+if (n_caller!=-1) {
+    get_absolute_name(NULL,called_from,n_caller,infos);
+}
+char* full_name=NULL;
+if (infos->debug) {
+    full_name=name;
+}
+infos->current_saved_graph++;
+vector_int_add(infos->renumber,infos->current_saved_graph);
+char foo[FILENAME_MAX];
+get_extension(name,foo);
+if (foo[0]=='\0') {
+    strcat(name,".grf");
+}
+Grf* grf=NULL;
+if (fexists(name)) {
+    grf=load_Grf(&(infos->vec),name);
+}
+if (grf==NULL) {
+    /* If we can't load the .grf, maybe we should try the .fst2 */
+    remove_extension(name,name_fst2);
+    strcat(name_fst2,".fst2");
+    Fst2* fst2=NULL;
+    if (n!=1 && fexists(name_fst2)) {
+        /* We don't try to load the .fst2 for the main graph */
+        fst2=load_fst2(&(infos->vec),name_fst2,1);
+        if (fst2==NULL) {
+            error("Cannot load %s\n",name_fst2);
+            write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],full_name);
+            free_SingleGraph(graph,NULL);
+            vector_int_add(infos->part_of_precompiled_fst2,0);
+            if (n==1) return 0;
+            return 1;
+        }
+    } else {
+        error("Cannot open graph %s\n",name);
+        if (called_from[0]!='\0') {
+            error("which is called from %s\n",called_from);
+        }
+        write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],full_name);
+        free_SingleGraph(graph,NULL);
+        vector_int_add(infos->part_of_precompiled_fst2,0);
+        if (n==1) return 0;
+        return 1;
+    }
+    if (infos->verbose_name_grf!=0) {
+        u_printf("Loading compiled graph %s\n",name_fst2);
+    }
+    save_compiled_fst2(name_fst2,fst2,infos);
+    /* -1 because we already made infos->current_saved_graph++ */
+    infos->current_saved_graph+=(fst2->number_of_graphs-1);
+    free_Fst2(fst2);
+    free_SingleGraph(graph,NULL);
+    return 1;
+}
+if (n==1 || infos->verbose_name_grf!=0) {
+  u_printf("Compiling graph %s\n",/*infos->graph_names->value[n]*/name);
+}
+/* We indicate that we have a .grf */
+vector_int_add(infos->part_of_precompiled_fst2,0);
+build_graph_from_grf(grf,name,graph,n,infos,clean);
 if (graph->states[0]==NULL) {
    /* If the graph has been emptied */
    write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],full_name);
    free_SingleGraph(graph,NULL);
-   if (n!=1 && infos->no_empty_graph_warning) return 1;
-   unichar* emptied_graph_name = u_strdup(infos->graph_names->value[n]);
-   unsigned int emptied_graph_name_size = u_strlen(emptied_graph_name);
-   for (unsigned int loop = 0; loop < emptied_graph_name_size; loop++) {
-     if (*(emptied_graph_name + loop) == 2)
-       *(emptied_graph_name + loop) = 0;
-   }
-   if (n==1) {
-      error("ERROR: Main graph %S.grf has been emptied\n", emptied_graph_name);
-      free(emptied_graph_name);
-      return 0;
-   }
-   error("WARNING: graph %S.grf has been emptied\n", emptied_graph_name);
-   free(emptied_graph_name);
-   return 1;
+   return report_emptied_graph(n,infos);
 }
 /* Now, we minimize the automaton assuming that reversed transitions are still there */
 minimize(graph,0);
@@ -1668,6 +1719,753 @@ return 1;
 }
 
 
+/*
+ * Incremental compilation
+ *
+ * When a cache file or several threads are used, each .grf is compiled alone
+ * into a fragment, with its own tags and graph names, as if it was the main
+ * graph. Then, the fragments are linked into the .fst2 in the graph number
+ * order: their tags and subgraph names are inserted into the global ones in
+ * the same order as during a normal compilation, so that the .fst2 is exactly
+ * the same. The graphs are compiled by waves: the first wave is the main graph,
+ * and each following wave is made of the subgraphs found when linking the
+ * previous one. The graphs of a wave can be compiled in parallel.
+ *
+ * A fragment is made of an int array and a unichar array, in which strings
+ * are stored as null-terminated sequences. The int array contains:
+ *
+ *   n_contexts context[n_contexts]
+ *   n_tags tag[n_tags-1]
+ *   n_names name[n_names-2]
+ *   n_states (control n_out (tag state)[n_out] n_in (tag state)[n_in])[n_states]
+ *   messages
+ *
+ * where 'tag' and 'name' are offsets in the unichar array. Tag #0 is <E>,
+ * name #0 is the empty string and name #1 is the graph itself, so they are
+ * not stored. 'context' is the tag number of each context start mark, since
+ * they must be renumbered when linking (see CONTEXT_COUNTER). Then come the
+ * states with their outgoing and reverted incoming transitions, in which
+ * negative tags are subgraph calls. If the graph has been emptied, n_states
+ * is 0. The graph is not minimized yet, because the result of the
+ * minimization depends on the tag numbers: it is minimized when linking,
+ * once its tags have their final numbers. 'messages' is the offset of the
+ * warnings printed while compiling the graph: they are printed when linking
+ * it, so that they appear after its "Compiling graph" line, in the graph
+ * order, and even if the fragment comes from the cache.
+ *
+ * The cache file contains a header, an int array and a unichar array. Each
+ * fragment is described in the int array by:
+ *
+ *   n_ints n_unichars grf_size(2 ints) grf_hash(2 ints) ints[n_ints]
+ *
+ * and in the unichar array by the key of its graph name, followed by its
+ * n_unichars unichars.
+ */
+#define GRF_CACHE_VERSION 2
+#define GRF_CACHE_BYTE_ORDER_MARKER 0x01020304
+
+struct grf_cache_header {
+   char magic[8];
+   unsigned int byte_order_marker;
+   unsigned int tokenization_policy;
+   unsigned int options;
+   unsigned int input_encoding;
+   uint64_t alphabet_hash;
+   /* The fields above identify the cache, the ones below describe its content */
+   unsigned int n_fragments;
+   unsigned int n_ints;
+   unsigned int n_unichars;
+   unsigned int reserved;
+};
+
+
+struct grf_fragment {
+   /* The key of the graph in the graph names, i.e. the name without the
+    * number of the caller */
+   unichar* key;
+   uint64_t grf_size;
+   uint64_t grf_hash;
+   int* ints;
+   unsigned int n_ints;
+   unichar* strings;
+   unsigned int n_unichars;
+};
+
+
+/**
+ * A graph to compile. 'fragment' is NULL if the .grf cannot be loaded, in
+ * which case the graph is compiled by compile_grf when linking.
+ */
+struct grf_job {
+   char* name;
+   unichar* key;
+   const unichar* value;
+   struct grf_fragment* fragment;
+   /* 1 if the fragment belongs to the cache */
+   int cached;
+};
+
+
+/**
+ * This structure is shared by the threads that compile a wave. Each thread
+ * takes the next job until there is none left.
+ */
+struct grf_job_queue {
+   struct grf_job* jobs;
+   int next;
+   int end;
+   const struct compilation_info* infos;
+   int clean;
+   struct string_hash_ptr* cache;
+   SYNC_Mutex_OBJECT mutex;
+};
+
+
+#define GRF_CACHE_HASH_BASIS 14695981039346656037ULL
+#define GRF_CACHE_HASH_PRIME 1099511628211ULL
+
+/**
+ * Updates the hash 'h' with the given bytes, mixed 8 by 8.
+ */
+static uint64_t hash_grf_cache_bytes(uint64_t h,const void* data,size_t size) {
+const unsigned char* s=(const unsigned char*)data;
+size_t i=0;
+for (;i+8<=size;i+=8) {
+   uint64_t word;
+   memcpy(&word,s+i,8);
+   h=(h^word)*GRF_CACHE_HASH_PRIME;
+   h^=h>>29;
+}
+for (;i<size;i++) {
+   h=(h^s[i])*GRF_CACHE_HASH_PRIME;
+}
+return h;
+}
+
+
+static uint64_t hash_grf_cache_alphabet(const Alphabet* alphabet) {
+uint64_t h=GRF_CACHE_HASH_BASIS;
+if (alphabet==NULL) {
+   return h;
+}
+h=hash_grf_cache_bytes(h,alphabet->array_case_flags,sizeof(alphabet->array_case_flags));
+for (unsigned int c=0;c<0x10000;c++) {
+   int pos=alphabet->pos_in_represent_list[c];
+   if (pos!=0) {
+      const unichar* s=alphabet->t_array_collection[pos];
+      h=hash_grf_cache_bytes(h,&c,sizeof(c));
+      h=hash_grf_cache_bytes(h,s,(u_strlen(s)+1)*sizeof(unichar));
+   }
+}
+if (alphabet->korean_equivalent_syllable!=NULL) {
+   h=hash_grf_cache_bytes(h,alphabet->korean_equivalent_syllable,0x10000*sizeof(unichar));
+}
+return h;
+}
+
+
+/**
+ * Fills 'key' with the compilation options that identify a cache file.
+ */
+static void get_grf_cache_key(const struct compilation_info* infos,int clean,struct grf_cache_header* key) {
+memset(key,0,sizeof(struct grf_cache_header));
+memcpy(key->magic,"GRFCACH",7);
+key->magic[7]=GRF_CACHE_VERSION;
+key->byte_order_marker=GRF_CACHE_BYTE_ORDER_MARKER;
+key->tokenization_policy=(unsigned int)infos->tokenization_policy;
+key->options=(clean==1) | ((infos->strict_tokenization!=0)<<1) | ((infos->check_outputs!=0)<<2);
+key->input_encoding=(unsigned int)infos->vec.mask_encoding_compatibility_input;
+key->alphabet_hash=hash_grf_cache_alphabet(infos->alphabet);
+}
+
+
+/**
+ * Computes the size and the hash of the given file. Returns 0 if the file
+ * cannot be read or is empty.
+ */
+static int get_grf_file_hash(const char* name,uint64_t* size,uint64_t* hash) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return 0;
+}
+size_t file_size=af_get_mapfile_size(amf);
+const void* buf=(file_size==0) ? NULL : af_get_mapfile_pointer(amf);
+if (buf==NULL) {
+   af_close_mapfile(amf);
+   return 0;
+}
+*size=(uint64_t)file_size;
+*hash=hash_grf_cache_bytes(GRF_CACHE_HASH_BASIS,buf,file_size);
+af_release_mapfile_pointer(amf,buf);
+af_close_mapfile(amf);
+return 1;
+}
+
+
+/**
+ * Returns a copy of the given graph name without the number of its caller.
+ */
+static unichar* get_graph_name_key(const unichar* value) {
+unichar* key=u_strdup(value);
+int pos=u_strrchr(key,(unichar)0x02);
+if (pos!=-1) {
+   key[pos]='\0';
+}
+return key;
+}
+
+
+static struct grf_fragment* new_grf_fragment(const unichar* key,uint64_t grf_size,uint64_t grf_hash,
+                                             const int* ints,unsigned int n_ints,
+                                             const unichar* strings,unsigned int n_unichars) {
+struct grf_fragment* f=(struct grf_fragment*)malloc(sizeof(struct grf_fragment));
+if (f==NULL) {
+   fatal_alloc_error("new_grf_fragment");
+}
+f->key=u_strdup(key);
+f->grf_size=grf_size;
+f->grf_hash=grf_hash;
+f->ints=(int*)malloc((n_ints+1)*sizeof(int));
+f->strings=(unichar*)malloc((n_unichars+1)*sizeof(unichar));
+if (f->ints==NULL || f->strings==NULL) {
+   fatal_alloc_error("new_grf_fragment");
+}
+memcpy(f->ints,ints,n_ints*sizeof(int));
+memcpy(f->strings,strings,n_unichars*sizeof(unichar));
+f->n_ints=n_ints;
+f->n_unichars=n_unichars;
+return f;
+}
+
+
+static void free_grf_fragment(void* ptr) {
+struct grf_fragment* f=(struct grf_fragment*)ptr;
+if (f==NULL) return;
+free(f->key);
+free(f->ints);
+free(f->strings);
+free(f);
+}
+
+
+/**
+ * Checks the string offsets found at t[0..n-1].
+ */
+static int check_grf_fragment_strings(const int* t,int n,const struct grf_fragment* f) {
+for (int i=0;i<n;i++) {
+   if (t[i]<0 || (unsigned int)t[i]>=f->n_unichars) return 0;
+}
+return 1;
+}
+
+
+/**
+ * Returns 1 if the given fragment is consistent; 0 otherwise. This is used
+ * in order not to crash on a corrupted cache file.
+ */
+static int check_grf_fragment(const struct grf_fragment* f) {
+const int* t=f->ints;
+unsigned int n=f->n_ints;
+unsigned int pos=0;
+if (f->n_unichars>0 && f->strings[f->n_unichars-1]!='\0') return 0;
+if (n<1) return 0;
+int n_contexts=t[pos++];
+if (n_contexts<0 || n-pos<(unsigned int)n_contexts+1) return 0;
+const int* contexts=t+pos;
+pos=pos+n_contexts;
+int n_tags=t[pos++];
+if (n_tags<1 || n-pos<(unsigned int)n_tags) return 0;
+for (int i=0;i<n_contexts;i++) {
+   if (contexts[i]<1 || contexts[i]>=n_tags) return 0;
+}
+if (!check_grf_fragment_strings(t+pos,n_tags-1,f)) return 0;
+pos=pos+n_tags-1;
+int n_names=t[pos++];
+if (n_names<2 || n-pos<(unsigned int)n_names-1) return 0;
+if (!check_grf_fragment_strings(t+pos,n_names-2,f)) return 0;
+pos=pos+n_names-2;
+int n_states=t[pos++];
+if (n_states<0) return 0;
+for (int i=0;i<n_states;i++) {
+   if (n-pos<1) return 0;
+   pos++;
+   /* Outgoing, then reverted incoming transitions */
+   for (int k=0;k<2;k++) {
+      if (n-pos<1) return 0;
+      int n_transitions=t[pos++];
+      if (n_transitions<0 || (n-pos)/2<(unsigned int)n_transitions) return 0;
+      for (int j=0;j<n_transitions;j++,pos+=2) {
+         if (t[pos]>=n_tags || t[pos]<=-n_names || t[pos+1]<0 || t[pos+1]>=n_states) return 0;
+      }
+   }
+}
+if (n-pos<1 || !check_grf_fragment_strings(t+pos,1,f)) return 0;
+pos++;
+return pos==n;
+}
+
+
+/**
+ * Adds the given string to the unichar array of a fragment and returns its offset.
+ */
+static int add_grf_fragment_string(Ustring* strings,const unichar* s) {
+int offset=(int)strings->len;
+u_strcat(strings,s);
+u_strcat(strings,(unichar)'\0');
+return offset;
+}
+
+
+static void add_grf_fragment_transitions(vector_int* ints,const Transition* t) {
+int n_transitions=ints->nbelems;
+vector_int_add(ints,0);
+for (;t!=NULL;t=t->next) {
+   vector_int_add(ints,t->tag_number);
+   vector_int_add(ints,t->state_number);
+   ints->tab[n_transitions]++;
+}
+}
+
+
+/**
+ * Reads the transition list found at t[*pos] and moves '*pos' after it.
+ * Tags are renumbered with 'tags' and subgraph calls with 'names'.
+ */
+static Transition* get_grf_fragment_transitions(const int* t,unsigned int* pos,const int* tags,const int* names) {
+Transition* list=NULL;
+Transition* last=NULL;
+int n_transitions=t[(*pos)++];
+for (int i=0;i<n_transitions;i++,(*pos)+=2) {
+   int tag=t[*pos];
+   Transition* tr=new_Transition((tag<0)?-names[-tag]:tags[tag],t[(*pos)+1]);
+   if (last==NULL) {
+      list=tr;
+   } else {
+      last->next=tr;
+   }
+   last=tr;
+}
+return list;
+}
+
+
+/**
+ * Compiles the given .grf alone and returns the corresponding fragment, or
+ * NULL if the .grf cannot be loaded. 'value' is the entry of the graph in
+ * the graph names, which is needed for relative subgraph calls.
+ */
+static struct grf_fragment* compile_grf_fragment(const char* name,const unichar* key,const unichar* value,
+                                                 uint64_t grf_size,uint64_t grf_hash,
+                                                 const struct compilation_info* infos,int clean) {
+Grf* grf=load_Grf(&(infos->vec),name);
+if (grf==NULL) {
+   return NULL;
+}
+/* The graph is compiled as the graph #1 of its own tags and graph names */
+struct compilation_info local;
+memcpy(&local,infos,sizeof(struct compilation_info));
+local.tags=new_string_hash(256);
+get_value_index(EPSILON,local.tags);
+local.graph_names=new_string_hash(256);
+get_value_index(U_EMPTY,local.graph_names);
+get_value_index(key,local.graph_names,value);
+local.CONTEXT_COUNTER=0;
+local.fst2=NULL;
+local.renumber=NULL;
+local.part_of_precompiled_fst2=NULL;
+local.messages=new_Ustring();
+SingleGraph graph=new_SingleGraph();
+build_graph_from_grf(grf,name,graph,1,&local,clean);
+vector_int* ints=new_vector_int(1024);
+Ustring* strings=new_Ustring(1024);
+unichar mark[32];
+vector_int_add(ints,local.CONTEXT_COUNTER);
+for (int i=0;i<local.CONTEXT_COUNTER;i++) {
+   u_sprintf(mark,"$[%d",i);
+   int tag=get_value_index(mark,local.tags,DONT_INSERT);
+   if (tag==NO_VALUE_INDEX) {
+      u_sprintf(mark,"$![%d",i);
+      tag=get_value_index(mark,local.tags,DONT_INSERT);
+   }
+   if (tag==NO_VALUE_INDEX) {
+      fatal_error("Internal error in compile_grf_fragment\n");
+   }
+   vector_int_add(ints,tag);
+}
+vector_int_add(ints,local.tags->size);
+for (int i=1;i<local.tags->size;i++) {
+   vector_int_add(ints,add_grf_fragment_string(strings,local.tags->value[i]));
+}
+vector_int_add(ints,local.graph_names->size);
+for (int i=2;i<local.graph_names->size;i++) {
+   unichar* subgraph=get_graph_name_key(local.graph_names->value[i]);
+   vector_int_add(ints,add_grf_fragment_string(strings,subgraph));
+   free(subgraph);
+}
+if (graph->states[0]==NULL) {
+   /* If the graph has been emptied */
+   vector_int_add(ints,0);
+} else {
+   vector_int_add(ints,graph->number_of_states);
+   for (int i=0;i<graph->number_of_states;i++) {
+      SingleGraphState s=graph->states[i];
+      vector_int_add(ints,s->control);
+      add_grf_fragment_transitions(ints,s->outgoing_transitions);
+      add_grf_fragment_transitions(ints,s->reverted_incoming_transitions);
+   }
+}
+vector_int_add(ints,add_grf_fragment_string(strings,local.messages->str));
+struct grf_fragment* f=new_grf_fragment(key,grf_size,grf_hash,ints->tab,ints->nbelems,
+                                        strings->str,strings->len);
+free_vector_int(ints);
+free_Ustring(strings);
+free_SingleGraph(graph,NULL);
+free_string_hash(local.tags);
+free_string_hash(local.graph_names);
+free_Ustring(local.messages);
+return f;
+}
+
+
+/**
+ * Gets the fragment of the given job from the cache if the .grf has not
+ * changed, or compiles it.
+ */
+static void process_grf_job(struct grf_job* job,struct grf_job_queue* queue) {
+uint64_t grf_size,grf_hash;
+if (!fexists(job->name) || !get_grf_file_hash(job->name,&grf_size,&grf_hash)) {
+   return;
+}
+struct grf_fragment* f=(struct grf_fragment*)get_value(job->key,queue->cache);
+if (f!=NULL && f->grf_size==grf_size && f->grf_hash==grf_hash) {
+   job->fragment=f;
+   job->cached=1;
+   return;
+}
+job->fragment=compile_grf_fragment(job->name,job->key,job->value,grf_size,grf_hash,queue->infos,queue->clean);
+}
+
+
+static void ABSTRACT_CALLBACK_UNITEX grf_job_worker_thread(void* private_data,unsigned int) {
+struct grf_job_queue* queue=(struct grf_job_queue*)private_data;
+for (;;) {
+   SyncGetMutex(queue->mutex);
+   int i=queue->next;
+   if (i<queue->end) {
+      queue->next++;
+   }
+   SyncReleaseMutex(queue->mutex);
+   if (i>=queue->end) {
+      return;
+   }
+   process_grf_job(&(queue->jobs[i]),queue);
+}
+}
+
+
+/**
+ * Saves the fragment of the graph #n into the .fst2, as compile_grf would
+ * have saved the graph, with the same return values.
+ */
+static int link_grf_fragment(int n,const char* name,const struct grf_fragment* f,struct compilation_info* infos) {
+/* We compute the names as compile_grf does, for the warnings about them */
+char foo[FILENAME_MAX];
+int n_caller;
+get_absolute_name(&n_caller,foo,n,infos);
+if (n_caller!=-1) {
+    get_absolute_name(NULL,foo,n_caller,infos);
+}
+infos->current_saved_graph++;
+vector_int_add(infos->renumber,infos->current_saved_graph);
+if (n==1 || infos->verbose_name_grf!=0) {
+  u_printf("Compiling graph %s\n",name);
+}
+const unichar* messages=f->strings+f->ints[f->n_ints-1];
+if (messages[0]!='\0') {
+   error("%S",messages);
+}
+/* We indicate that we have a .grf */
+vector_int_add(infos->part_of_precompiled_fst2,0);
+const int* t=f->ints;
+unsigned int pos=0;
+int n_contexts=t[pos++];
+const int* contexts=t+pos;
+pos=pos+n_contexts;
+int n_tags=t[pos++];
+int* tags=(int*)malloc(n_tags*sizeof(int));
+if (tags==NULL) {
+   fatal_alloc_error("link_grf_fragment");
+}
+/* We first use the tag array to mark context start marks with their number */
+for (int i=0;i<n_tags;i++) {
+   tags[i]=-1;
+}
+for (int i=0;i<n_contexts;i++) {
+   tags[contexts[i]]=i;
+}
+tags[0]=0;
+Ustring* tmp=new_Ustring();
+for (int i=1;i<n_tags;i++) {
+   const unichar* tag=f->strings+t[pos++];
+   if (tags[i]!=-1) {
+      u_sprintf(tmp,"%s%d",(tag[1]=='!')?"$![":"$[",infos->CONTEXT_COUNTER+tags[i]);
+      tag=tmp->str;
+   }
+   tags[i]=get_value_index(tag,infos->tags);
+}
+infos->CONTEXT_COUNTER+=n_contexts;
+int n_names=t[pos++];
+int* names=(int*)malloc(n_names*sizeof(int));
+if (names==NULL) {
+   fatal_alloc_error("link_grf_fragment");
+}
+names[0]=0;
+names[1]=n;
+for (int i=2;i<n_names;i++) {
+   /* We add the subgraph names as process_box_line_token does */
+   const unichar* subgraph=f->strings+t[pos++];
+   u_sprintf(tmp,"%S%C%d",subgraph,0x02,n);
+   names[i]=get_value_index(subgraph,infos->graph_names,tmp->str);
+}
+free_Ustring(tmp);
+int result=1;
+int n_states=t[pos++];
+if (n_states==0) {
+   /* If the graph has been emptied */
+   SingleGraph graph=new_SingleGraph();
+   write_graph(infos->fst2,graph,-n,infos->graph_names->value[n],NULL);
+   free_SingleGraph(graph,NULL);
+   result=report_emptied_graph(n,infos);
+} else {
+   SingleGraph graph=new_SingleGraph();
+   set_state_array_capacity(graph,n_states);
+   for (int i=0;i<n_states;i++) {
+      SingleGraphState s=new_SingleGraphState();
+      s->control=(unsigned char)t[pos++];
+      s->outgoing_transitions=get_grf_fragment_transitions(t,&pos,tags,names);
+      s->reverted_incoming_transitions=get_grf_fragment_transitions(t,&pos,tags,names);
+      graph->states[i]=s;
+   }
+   graph->number_of_states=n_states;
+   /* Now, we minimize the automaton assuming that reversed transitions are still there */
+   minimize(graph,0);
+   write_graph(infos->fst2,graph,-infos->current_saved_graph,infos->graph_names->value[n],NULL);
+   free_SingleGraph(graph,NULL);
+}
+free(tags);
+free(names);
+return result;
+}
+
+
+/**
+ * Loads into 'cache' the fragments of the given cache file, if it was built
+ * with the same options and if it has the size announced by its header.
+ * Otherwise, the file is ignored.
+ */
+static void load_grf_cache(const char* cache_name,const struct grf_cache_header* key,
+                           struct string_hash_ptr* cache) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(cache_name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return;
+}
+size_t size=af_get_mapfile_size(amf);
+const void* buf=(size<sizeof(struct grf_cache_header)) ? NULL : af_get_mapfile_pointer(amf);
+if (buf==NULL) {
+   af_close_mapfile(amf);
+   return;
+}
+const struct grf_cache_header* header=(const struct grf_cache_header*)buf;
+int ok=!memcmp(header,key,offsetof(struct grf_cache_header,n_fragments))
+       && size==sizeof(struct grf_cache_header)+(size_t)header->n_ints*sizeof(int)
+                +(size_t)header->n_unichars*sizeof(unichar);
+const int* ints=(const int*)((const char*)buf+sizeof(struct grf_cache_header));
+const unichar* strings=ok ? (const unichar*)(ints+header->n_ints) : NULL;
+unsigned int pos=0;
+unsigned int u_pos=0;
+for (unsigned int i=0;ok && i<header->n_fragments;i++) {
+   if (header->n_ints-pos<6) break;
+   unsigned int n_ints=(unsigned int)ints[pos];
+   unsigned int n_unichars=(unsigned int)ints[pos+1];
+   uint64_t grf_size=(uint64_t)(unsigned int)ints[pos+2] | ((uint64_t)(unsigned int)ints[pos+3]<<32);
+   uint64_t grf_hash=(uint64_t)(unsigned int)ints[pos+4] | ((uint64_t)(unsigned int)ints[pos+5]<<32);
+   pos=pos+6;
+   if (n_ints>header->n_ints-pos || n_unichars>header->n_unichars-u_pos) break;
+   /* The key is followed by the unichars of the fragment */
+   const unichar* graph_key=strings+u_pos;
+   unsigned int l=0;
+   while (l<n_unichars && graph_key[l]!='\0') l++;
+   if (l==n_unichars) break;
+   struct grf_fragment* f=new_grf_fragment(graph_key,grf_size,grf_hash,ints+pos,n_ints,
+                                           graph_key+l+1,n_unichars-l-1);
+   if (!check_grf_fragment(f) || get_value(f->key,cache)!=NULL) {
+      free_grf_fragment(f);
+      break;
+   }
+   get_value_index(f->key,cache,INSERT_IF_NEEDED,f);
+   pos=pos+n_ints;
+   u_pos=u_pos+n_unichars;
+}
+af_release_mapfile_pointer(amf,buf);
+af_close_mapfile(amf);
+}
+
+
+/**
+ * Saves the fragments of the given jobs into the cache file. If the file
+ * cannot be written, we just go on without cache. Like the dictionary cache
+ * of Locate, it is written to a temporary file that replaces the old one once
+ * complete, since a concurrent Grf2Fst2 may have the old one mapped.
+ */
+static void save_grf_cache(const char* cache_name,const struct grf_cache_header* key,
+                           const struct grf_job* jobs,int n_jobs) {
+vector_int* ints=new_vector_int(4096);
+unichar* strings=NULL;
+size_t strings_size=0;
+size_t n_unichars=0;
+struct grf_cache_header header=*key;
+for (int i=0;i<n_jobs;i++) {
+   const struct grf_fragment* f=jobs[i].fragment;
+   if (f==NULL) continue;
+   unsigned int key_length=u_strlen(f->key)+1;
+   vector_int_add(ints,(int)f->n_ints);
+   vector_int_add(ints,(int)(key_length+f->n_unichars));
+   vector_int_add(ints,(int)(f->grf_size&0xFFFFFFFF));
+   vector_int_add(ints,(int)(f->grf_size>>32));
+   vector_int_add(ints,(int)(f->grf_hash&0xFFFFFFFF));
+   vector_int_add(ints,(int)(f->grf_hash>>32));
+   for (unsigned int j=0;j<f->n_ints;j++) {
+      vector_int_add(ints,f->ints[j]);
+   }
+   reallocate_unichar_buffer(&strings,&strings_size,n_unichars+key_length+f->n_unichars);
+   memcpy(strings+n_unichars,f->key,key_length*sizeof(unichar));
+   memcpy(strings+n_unichars+key_length,f->strings,f->n_unichars*sizeof(unichar));
+   n_unichars=n_unichars+key_length+f->n_unichars;
+   header.n_fragments++;
+}
+header.n_ints=(unsigned int)ints->nbelems;
+header.n_unichars=(unsigned int)n_unichars;
+size_t size_ints=header.n_ints*sizeof(int);
+size_t size_strings=header.n_unichars*sizeof(unichar);
+char tmp_name[FILENAME_MAX];
+ABSTRACTFILE* f=open_temp_file_for(cache_name,tmp_name);
+if (f!=NULL) {
+   int ok=(af_fwrite(&header,sizeof(header),1,f)==1);
+   if (ok && size_ints>0) ok=(af_fwrite(ints->tab,1,size_ints,f)==size_ints);
+   if (ok && size_strings>0) ok=(af_fwrite(strings,1,size_strings,f)==size_strings);
+   af_fclose(f);
+   if (ok) {
+      replace_file(tmp_name,cache_name);
+   } else {
+      af_remove(tmp_name);
+   }
+}
+free_vector_int(ints);
+free_reallocate_unichar_buffer(&strings);
+}
+
+
+/**
+ * Compiles the grammar by fragments, using the threads and the cache file
+ * given in 'infos'. It returns 1 in case of success; 0 otherwise.
+ */
+static int compile_grf_fragments(struct compilation_info* infos,int clean) {
+struct grf_cache_header key;
+get_grf_cache_key(infos,clean,&key);
+struct string_hash_ptr* cache=new_string_hash_ptr();
+if (infos->cache_file[0]!='\0') {
+   load_grf_cache(infos->cache_file,&key,cache);
+}
+struct grf_job_queue queue;
+queue.jobs=NULL;
+queue.infos=infos;
+queue.clean=clean;
+queue.cache=cache;
+queue.mutex=SyncBuildMutex();
+int capacity=0;
+void** w_ptr=(void**)malloc(infos->n_threads*sizeof(void*));
+if (w_ptr==NULL) {
+   fatal_alloc_error("compile_grf_fragments");
+}
+for (int i=0;i<infos->n_threads;i++) {
+   w_ptr[i]=&queue;
+}
+int current_graph=1;
+int result=1;
+while (result && current_graph<infos->graph_names->size) {
+   /* The graphs that have been found but not compiled yet make the next wave */
+   int end=infos->graph_names->size;
+   if (end>capacity) {
+      capacity=(end>2*capacity) ? end : 2*capacity;
+      queue.jobs=(struct grf_job*)realloc(queue.jobs,capacity*sizeof(struct grf_job));
+      if (queue.jobs==NULL) {
+         fatal_alloc_error("compile_grf_fragments");
+      }
+   }
+   /* The warnings about the names are printed when linking */
+   infos->messages=new_Ustring();
+   for (int n=current_graph;n<end;n++) {
+      struct grf_job* job=&(queue.jobs[n]);
+      char name[FILENAME_MAX];
+      char foo[FILENAME_MAX];
+      get_absolute_name(NULL,name,n,infos);
+      get_extension(name,foo);
+      if (foo[0]=='\0') {
+         strcat(name,".grf");
+      }
+      job->name=strdup(name);
+      if (job->name==NULL) {
+         fatal_alloc_error("compile_grf_fragments");
+      }
+      job->key=get_graph_name_key(infos->graph_names->value[n]);
+      job->value=infos->graph_names->value[n];
+      job->fragment=NULL;
+      job->cached=0;
+   }
+   free_Ustring(infos->messages);
+   infos->messages=NULL;
+   queue.next=current_graph;
+   queue.end=end;
+   int n_threads=(infos->n_threads<end-current_graph) ? infos->n_threads : end-current_graph;
+   if (n_threads>1) {
+      SyncRunThreads((unsigned int)n_threads,grf_job_worker_thread,w_ptr);
+   } else {
+      grf_job_worker_thread(&queue,0);
+   }
+   /* The fragments are linked in the graph number order */
+   for (int n=current_graph;result && n<end;n++) {
+      struct grf_job* job=&(queue.jobs[n]);
+      int res;
+      if (job->fragment==NULL) {
+         res=compile_grf(n,infos,clean);
+      } else {
+         res=link_grf_fragment(n,job->name,job->fragment,infos);
+      }
+      if ((res==0 && n==1) || res==-1) {
+         /* If the main graph has been emptied, then the compilation has failed */
+         result=0;
+      }
+   }
+   current_graph=end;
+}
+if (result && infos->cache_file[0]!='\0') {
+   save_grf_cache(infos->cache_file,&key,queue.jobs+1,current_graph-1);
+}
+for (int n=1;n<current_graph;n++) {
+   free(queue.jobs[n].name);
+   free(queue.jobs[n].key);
+   if (!queue.jobs[n].cached) {
+      free_grf_fragment(queue.jobs[n].fragment);
+   }
+}
+free(queue.jobs);
+free(w_ptr);
+SyncDeleteMutex(queue.mutex);
+free_string_hash_ptr(cache,free_grf_fragment);
+return result;
+}
+
+
 /**
  * This function takes the main graph name as given to the program and
  * computes its path and its name without path and extension. Then, the
@@ -1703,6 +2501,9 @@ int compile_grf(char* main_graph,struct compilation_info* infos,int clean) {
 int current_graph=1;
 int result;
 extract_path_and_main_graph(main_graph,infos);
+if (!infos->debug && (infos->n_threads>1 || infos->cache_file[0]!='\0')) {
+   return compile_grf_fragments(infos,clean);
+}
 do {
    result=compile_grf(current_graph,infos, clean);
    if (result==0 && current_graph==1) {
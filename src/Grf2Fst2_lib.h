@@ -30,6 +30,7 @@
 #include "String_hash.h"
 #include "SingleGraph.h"
 #include "Vector.h"
+#include "Ustring.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -91,6 +92,19 @@ struct compilation_info {
    int current_saved_graph;
    char check_outputs;
    char strict_tokenization;
+
+   /* If n_threads>1 or if a cache file is given, every .grf is compiled alone
+    * into a fragment that is then linked into the .fst2. Fragments are
+    * compiled by n_threads threads and saved into the cache file, so that
+    * only the .grf that have changed are compiled again on the next run */
+   int n_threads;
+   char cache_file[FILENAME_MAX];
+
+   /* If not NULL, the warnings about the graph being compiled are appended
+    * to it instead of being printed, so that a fragment compiled by a thread
+    * can print them when it is linked, at the place where a normal
+    * compilation prints them */
+   Ustring* messages;
 };
 
 
@@ -82,6 +82,21 @@ const char* usage_Locate =
          "  -u X/--arabic_rules=X: Arabic typographic rule configuration file\n"
          "  -g minus/--negation_operator=minus: uses minus as negation operator for Unitex 2.0 graphs\n"
          "  -g tilde/--negation_operator=tilde: uses tilde as negation operator (default)\n"
+         "  -j N/--threads=N: explores the text with N threads (default: 1). The text is\n"
+         "                    cut at {S} into chunks and the concordance is the same as\n"
+         "                    with a single thread. Ignored if -n is used\n"
+         "  -D/--dont_use_dic_cache: always loads the text dictionaries dlf and dlc from their\n"
+         "                           text files. By default, they are saved at the first load\n"
+         "                           in the binary files dlf.cache and dlc.cache, which are\n"
+         "                           used by next runs as long as the text is not modified\n"
+         "  -B/--binary_index: saves concord.ind in a binary form, faster to write and to\n"
+         "                     load by Concord, ConcorDiff, Extract and Cassys, but that\n"
+         "                     cannot be read as a text file\n"
+         "  -F/--profile: counts the visits, the failed explorations and the time spent in\n"
+         "                each state and subgraph call of the grammar, and saves them in\n"
+         "                locate_profile.txt (sorted by decreasing time) and\n"
+         "                locate_profile.json in the text directory. Matches found in\n"
+         "                the Locate cache are not explored again, use -e to profile them\n"
          "\n"
          "Search limit options:\n"
          "  -l/--all: looks for all matches (default)\n"
@@ -150,7 +165,7 @@ static void usage() {
 #endif
 }
 
-const char* optstring_Locate=":t:a:m:SLAIMRXYZln:d:E:cewsxbzpKVhk:q:o:u:g:Tv:$:@:C:P:HQN+:";
+const char* optstring_Locate=":t:a:m:SLAIMRXYZln:d:E:cewsxbzpKVhk:q:o:u:g:Tv:$:@:C:P:HQN+:j:DFB";
 const struct option_TS lopts_Locate[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -182,6 +197,9 @@ const struct option_TS lopts_Locate[]= {
   {"arabic_rules",required_argument_TS,NULL,'u'},
   {"negation_operator",required_argument_TS,NULL,'g'},
   {"dont_use_locate_cache",no_argument_TS,NULL,'e'},
+  {"dont_use_dic_cache",no_argument_TS,NULL,'D'},
+  {"profile",no_argument_TS,NULL,'F'},
+  {"binary_index",no_argument_TS,NULL,'B'},
   {"dont_allow_trace",no_argument_TS,NULL,'T'},
   {"variable",required_argument_TS,NULL,'v'},
   {"stack_max",required_argument_TS,NULL,'$'},
@@ -192,6 +210,7 @@ const struct option_TS lopts_Locate[]= {
   {"lesser_tolerant",no_argument_TS,NULL,'Q'},
   {"least_tolerant",no_argument_TS,NULL,'N'},
   {"trace_option",required_argument_TS,NULL,'+'},
+  {"threads",required_argument_TS,NULL,'j'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
   {"help",no_argument_TS,NULL,'h'},
   {NULL,no_argument_TS,NULL,0}
@@ -282,8 +301,12 @@ int tolerance_divide_factor=1;
 int max_errors=0;
 int tilde_negation_operator=1;
 int useLocateCache=1;
+int useDicCache=1;
 int selected_negation_operator=0;
 int allow_trace=1;
+int n_threads=1;
+int profile=0;
+int binary_concord=0;
 char** list_param_trace=new_locate_trace_param();
 char foo;
 vector_ptr* injected_vars=new_vector_ptr();
@@ -363,6 +386,9 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Locate,lopts_Locate,&ind
    case 'Z': variable_error_policy=BACKTRACK_ON_VARIABLE_ERRORS; break;
    case 'l': search_limit=NO_MATCH_LIMIT; break;
    case 'e': useLocateCache=0; break;
+   case 'D': useDicCache=0; break;
+   case 'F': profile=1; break;
+   case 'B': binary_concord=1; break;
    case 'T': allow_trace=0; break;
    case 'n': if (1!=sscanf(options.vars()->optarg,"%d%c",&search_limit,&foo) || search_limit<=0) {
                 /* foo is used to check that the search limit is not like "45gjh" */
@@ -436,6 +462,15 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Locate,lopts_Locate,&ind
                 return USAGE_ERROR_CODE;
              }
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                free_vector_ptr(injected_vars,free);
+                free_locate_trace_param(list_param_trace);
+                free(morpho_dic);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'H': {
                 tolerance_divide_factor=2;
              }
@@ -671,7 +706,12 @@ int OK=locate_pattern(text_cod,
                allow_trace,
                list_param_trace,
                injected_vars,
-               elg_extensions_path);
+               elg_extensions_path,
+               NULL,
+               n_threads,
+               useDicCache,
+               profile,
+               binary_concord);
 
 free(buffer_filename);
 free_vector_ptr(injected_vars,free);
@@ -794,6 +834,8 @@ if (arabic_rules && arabic_rules[0]!='\0') {
    sprintf(tmp,"--arabic_rules=%s",arabic_rules);
    add_argument(invoker,tmp);
 }
+/* The dlf and dlc are being built by Dico, so there is no point in caching them */
+add_argument(invoker,"--dont_use_dic_cache");
 add_argument(invoker,fst2);
 /* Finally, we call the main function of Locate */
 int ret=invoke(invoker);
@@ -21,9 +21,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "LocateCache.h"
 #include "Error.h"
 #include "Match.h"
+#include "Unicode.h"
+#include "base/compiler/intrinsic/atomic.h"    // unitex_atomic_*
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -32,10 +35,12 @@
 namespace unitex {
 
 /**
- * Builds, initializes and returns a new LocateCache.
+ * Builds, initializes and returns a new LocateCache. Cache entries are
+ * allocated with malloc, because they may be shared by several threads that
+ * all have their own allocators.
  */
-LocateCache new_LocateCache(int token,struct match_list* matches,Abstract_allocator prv_alloc) {
-LocateCache c=(LocateCache)malloc_cb(sizeof(struct locate_cache),prv_alloc);
+static LocateCache new_LocateCache(int token,struct match_list* matches) {
+LocateCache c=(LocateCache)malloc(sizeof(struct locate_cache));
 if (c==NULL) {
     fatal_alloc_error("new_LocateCache");
 }
@@ -52,118 +57,274 @@ return c;
  * Frees all the memory associated to the given LocateCache, including
  * its match list, if any.
  */
-void free_LocateCache(LocateCache c,Abstract_allocator prv_alloc) {
+static void free_LocateCache(LocateCache c) {
 if (c==NULL) return;
-free_LocateCache(c->left,prv_alloc);
-free_LocateCache(c->middle,prv_alloc);
-free_LocateCache(c->right,prv_alloc);
-free_match_list(c->matches,prv_alloc);
-free_cb(c,prv_alloc);
+free_LocateCache(c->left);
+free_LocateCache(c->middle);
+free_LocateCache(c->right);
+free_match_list(c->matches);
+free(c);
 }
 
 
 /**
- * Caches the given token sequence in the given cache. Note that
- * match is supposed to contain a single match, not a match list.
- */
-static void cache_match_internal(struct match_list* match,const int* tab,int start,int end,LocateCache *c,Abstract_allocator prv_alloc) {
-int token=-1;
-struct match_list* m=match;
-if (start<=end) {
-    token=tab[start];
-    m=NULL;
-}
-/* No node */
-if (*c==NULL) {
-    *c=new_LocateCache(token,m,prv_alloc);
-    if (token!=-1) {
-        cache_match_internal(match,tab,start+1,end,&((*c)->middle),prv_alloc);
+ * Builds and returns a new cache table for a text with 'n_tokens' different
+ * tokens. If 'max_size' is not positive, the cache size is not limited.
+ */
+struct locate_cache_table* new_LocateCache_table(int n_tokens,long max_size) {
+struct locate_cache_table* t=(struct locate_cache_table*)malloc(sizeof(struct locate_cache_table));
+if (t==NULL) {
+    fatal_alloc_error("new_LocateCache_table");
+}
+t->caches=(LocateCache*)malloc(n_tokens*sizeof(LocateCache));
+if (t->caches==NULL) {
+    fatal_alloc_error("new_LocateCache_table");
+}
+memset(t->caches,0,n_tokens*sizeof(LocateCache));
+t->n_caches=n_tokens;
+t->size=0;
+t->max_size=max_size;
+return t;
+}
+
+
+/**
+ * Removes all the entries of the given cache. No other thread must be using
+ * the cache at this time.
+ */
+void clear_LocateCache_table(struct locate_cache_table* t) {
+if (t==NULL) return;
+for (int i=0;i<t->n_caches;i++) {
+    free_LocateCache(t->caches[i]);
+    t->caches[i]=NULL;
+}
+t->size=0;
+}
+
+
+/**
+ * Frees all the memory associated to the given cache table.
+ */
+void free_LocateCache_table(struct locate_cache_table* t) {
+if (t==NULL) return;
+clear_LocateCache_table(t);
+free(t->caches);
+free(t);
+}
+
+
+/**
+ * Returns 1 if the given cache has reached its memory cap; 0 otherwise.
+ */
+int is_LocateCache_table_full(const struct locate_cache_table* t) {
+return t->max_size>0 && t->size>=t->max_size;
+}
+
+
+/**
+ * Returns the number of bytes used by the given match list element.
+ */
+static long get_match_size(const struct match_list* m) {
+long size=(long)sizeof(struct match_list);
+if (m->output!=NULL) {
+    size=size+(long)((u_strlen(m->output)+1)*sizeof(unichar));
+}
+return size;
+}
+
+
+/**
+ * Returns 1 if a and b are the same match with the same output.
+ */
+static int same_cached_match(struct match_list* a,struct match_list* b) {
+return compare_matches(&(a->m),&(b->m))==A_EQUALS_B
+       && !u_strcmp(a->output,b->output);
+}
+
+
+/**
+ * Returns a private copy of the given match list, without duplicates. The
+ * size of the copy is added to '*size'.
+ */
+static struct match_list* copy_match_list(const struct match_list* matches,long *size) {
+struct match_list* res=NULL;
+struct match_list* *end=&res;
+for (;matches!=NULL;matches=matches->next) {
+    struct match_list* z;
+    for (z=res;z!=NULL;z=z->next) {
+        if (same_cached_match(z,(struct match_list*)matches)) break;
     }
-    return;
+    if (z!=NULL) continue;
+    *end=new_match(matches->m.start_pos_in_token,matches->m.end_pos_in_token,
+                   matches->m.start_pos_in_char,matches->m.end_pos_in_char,
+                   matches->m.start_pos_in_letter,matches->m.end_pos_in_letter,
+                   matches->output,matches->weight,NULL);
+    (*size)+=get_match_size(*end);
+    end=&((*end)->next);
+}
+return res;
+}
+
+
+/**
+ * Builds the branch of nodes that represents tab[start..end], with the
+ * given match list in its final node. The size of the nodes is added to
+ * '*size'.
+ */
+static LocateCache new_LocateCache_branch(struct match_list* matches,const int* tab,int start,int end,long *size) {
+LocateCache final_node=new_LocateCache(-1,matches);
+(*size)+=(long)sizeof(struct locate_cache);
+LocateCache c=final_node;
+for (int i=end;i>=start;i--) {
+    LocateCache node=new_LocateCache(tab[i],NULL);
+    node->middle=c;
+    (*size)+=(long)sizeof(struct locate_cache);
+    c=node;
+}
+return c;
+}
+
+
+/**
+ * Frees a branch built by new_LocateCache_branch that could not be
+ * published, except its match list.
+ */
+static void free_LocateCache_branch(LocateCache c) {
+while (c!=NULL) {
+    LocateCache next=c->middle;
+    free(c);
+    c=next;
 }
-/* There is a node */
-if (token<(*c)->token) {
-    /* If we have to move on the left */
-    return cache_match_internal(match,tab,start,end,&((*c)->left),prv_alloc);
-}
-if (token>(*c)->token) {
-    /* If we have to move on the right */
-    return cache_match_internal(match,tab,start,end,&((*c)->right),prv_alloc);
-}
-/* We have the correct token */
-if (token==-1) {
-    /* If we are in a final node that already existed, we just add
-     * the new match at the end of the match list to get the same match order as
-     * if the cache system had not been used, but only if the match is not already present */
-    struct match_list* *ptr=&((*c)->matches);
+}
+
+
+/**
+ * Appends the matches of 'batch' that are not already there at the end of
+ * the match list of the given final node, in order to get the same match
+ * order as if the cache system had not been used. Returns the size of
+ * what was appended.
+ */
+static long append_cached_matches(LocateCache final_node,struct match_list* batch) {
+struct match_list* *ptr=&(final_node->matches);
+for (;;) {
     struct match_list* z;
-    match->next=NULL;
-    while ((*ptr)!=NULL) {
-        z=*ptr;
-        if (compare_matches(&(z->m),&(match->m))==A_EQUALS_B &&
-                !u_strcmp(z->output,match->output)) {
-            /* We discard a match that was already in cache */
-            free_match_list_element(match,prv_alloc);
-            return;
+    while ((z=(struct match_list*)unitex_atomic_load_ptr(ptr))!=NULL) {
+        /* We discard the matches that were already in cache */
+        struct match_list* *b=&batch;
+        while (*b!=NULL) {
+            if (same_cached_match(z,*b)) {
+                struct match_list* tmp=*b;
+                *b=tmp->next;
+                free_match_list_element(tmp);
+            } else {
+                b=&((*b)->next);
+            }
         }
-        ptr=&((*ptr)->next);
+        ptr=&(z->next);
     }
-    (*ptr)=match;
-    return;
+    if (batch==NULL) return 0;
+    /* The size must be computed before the batch is published, since other
+     * threads may append their own matches after it at once */
+    long size=0;
+    for (z=batch;z!=NULL;z=z->next) {
+        size+=get_match_size(z);
+    }
+    if (unitex_atomic_cas_ptr(ptr,(struct match_list*)NULL,batch)) {
+        return size;
+    }
+    /* Another thread has appended matches in the meantime, so we
+     * go on from where we were */
 }
-cache_match_internal(match,tab,start+1,end,&((*c)->middle),prv_alloc);
 }
 
 
 /**
- * Caches the given token sequence in the given cache. Note that
- * match is supposed to contain a single match, not a match list.
+ * Caches the given matches for the token sequence tab[start..end].
+ * The cache does not take ownership of 'matches': it stores a copy that is
+ * published at once, so that a concurrent reader never sees a partial list.
  * There is no need to save the first token, since caches are stored
- * in an array indexed on first tokens.
+ * in an array indexed on first tokens. If the cache is full, nothing is done.
  */
-void cache_match(struct match_list* match,const int* tab,int start,int end,LocateCache *c, Abstract_allocator prv_alloc) {
-cache_match_internal(match,tab,start+1,end,c,prv_alloc);
+void cache_matches(const struct match_list* matches,const int* tab,int start,int end,struct locate_cache_table* t) {
+if (matches==NULL || is_LocateCache_table_full(t)) return;
+long size=0;
+struct match_list* batch=copy_match_list(matches,&size);
+LocateCache* slot=&(t->caches[tab[start]]);
+int pos=start+1;
+for (;;) {
+    int token=(pos<=end)?tab[pos]:-1;
+    LocateCache c=(LocateCache)unitex_atomic_load_ptr(slot);
+    if (c==NULL) {
+        /* No node: we try to publish the whole remaining branch at once */
+        long branch_size=0;
+        LocateCache branch=new_LocateCache_branch(batch,tab,pos,end,&branch_size);
+        if (unitex_atomic_cas_ptr(slot,(LocateCache)NULL,branch)) {
+            unitex_atomic_add_long(&(t->size),size+branch_size);
+            return;
+        }
+        /* Another thread has published a node here in the meantime */
+        free_LocateCache_branch(branch);
+        continue;
+    }
+    if (token<c->token) {
+        /* If we have to move on the left */
+        slot=&(c->left);
+    } else if (token>c->token) {
+        /* If we have to move on the right */
+        slot=&(c->right);
+    } else if (token==-1) {
+        /* If we are in a final node that already existed */
+        size=append_cached_matches(c,batch);
+        unitex_atomic_add_long(&(t->size),size);
+        return;
+    } else {
+        slot=&(c->middle);
+        pos++;
+    }
+}
 }
 
 
 /**
  * Explores a given node of the cache tree.
  */
-void explore_cache_node(const int* tab,int pos,int tab_size,LocateCache c,vector_ptr* res) {
+static void explore_cache_node(const int* tab,int pos,int tab_size,LocateCache c,vector_ptr* res) {
 if (pos==tab_size || c==NULL) return;
 if (c->token==-1) {
     /* If we have found a token sequence end mark, then we have matches to
      * store before trying the right node to look for longer matches. As -1 is
      * lower than any token value, we don't need to explore the left side */
-    vector_ptr_add(res,c->matches);
-    explore_cache_node(tab,pos,tab_size,c->right,res);
+    vector_ptr_add(res,unitex_atomic_load_ptr(&(c->matches)));
+    explore_cache_node(tab,pos,tab_size,(LocateCache)unitex_atomic_load_ptr(&(c->right)),res);
     return;
 }
 int token=tab[pos];
 if (token==c->token) {
-    explore_cache_node(tab,pos+1,tab_size,c->middle,res);
+    explore_cache_node(tab,pos+1,tab_size,(LocateCache)unitex_atomic_load_ptr(&(c->middle)),res);
     return;
 }
 if (token<c->token) {
-    explore_cache_node(tab,pos,tab_size,c->left,res);
+    explore_cache_node(tab,pos,tab_size,(LocateCache)unitex_atomic_load_ptr(&(c->left)),res);
     return;
 }
-explore_cache_node(tab,pos,tab_size,c->right,res);
+explore_cache_node(tab,pos,tab_size,(LocateCache)unitex_atomic_load_ptr(&(c->right)),res);
 }
 
 
 /**
  * Consults the cache to find matches. If some are found, the match list pointers
  * associated to token sequences are stored in 'res'. Returns 1 if matches
- * were found; 0 otherwise.
+ * were found; 0 otherwise. This function takes no lock, so it can be called
+ * while other threads add entries to the cache.
  */
-int consult_cache(const int* tab,int start,int tab_size,LocateCache* caches,vector_ptr* res) {
+int consult_cache(const int* tab,int start,int tab_size,const struct locate_cache_table* t,vector_ptr* res) {
 res->nbelems=0;
 int first_token=tab[start];
 if (first_token==-1) {
     return 0;
 }
-explore_cache_node(tab,start+1,tab_size,caches[first_token],res);
+explore_cache_node(tab,start+1,tab_size,
+                   (LocateCache)unitex_atomic_load_ptr(&(t->caches[first_token])),res);
 return res->nbelems!=0;
 }
 
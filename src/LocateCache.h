@@ -34,6 +34,13 @@ namespace unitex {
 /**
  * This library provides a cache for storing match lists associated to token
  * sequences, using a ternary search tree.
+ *
+ * The cache can be shared by several threads: lookups take no lock, and new
+ * nodes or match lists are published with a single compare-and-swap on a
+ * pointer that was NULL, so that a reader sees either nothing or a complete
+ * entry. Published nodes are never modified nor freed while threads may read
+ * them: the memory cap only refuses new entries, and the cache is emptied by
+ * clear_LocateCache_table(), which must be called when no thread uses it.
  */
 
 
@@ -46,10 +53,29 @@ typedef struct locate_cache {
 }* LocateCache;
 
 
-LocateCache new_LocateCache(int token,struct match_list* matches,Abstract_allocator);
-void free_LocateCache(LocateCache c,Abstract_allocator);
-void cache_match(struct match_list* matches,const int* tab,int start,int end,LocateCache* c,Abstract_allocator);
-int consult_cache(const int* tab,int start,int tab_size,LocateCache* c,vector_ptr* res);
+/**
+ * Caches are stored in an array indexed on first tokens. 'size' is an
+ * approximation of the number of bytes used by the cache entries; once it
+ * reaches 'max_size', no more entries are added.
+ */
+struct locate_cache_table {
+    LocateCache* caches;
+    int n_caches;
+    long size;
+    long max_size;
+};
+
+
+/* Default memory cap of a Locate cache, in bytes */
+#define DEFAULT_LOCATE_CACHE_MAX_SIZE (256L*1024L*1024L)
+
+
+struct locate_cache_table* new_LocateCache_table(int n_tokens,long max_size);
+void free_LocateCache_table(struct locate_cache_table* t);
+void clear_LocateCache_table(struct locate_cache_table* t);
+int is_LocateCache_table_full(const struct locate_cache_table* t);
+void cache_matches(const struct match_list* matches,const int* tab,int start,int end,struct locate_cache_table* t);
+int consult_cache(const int* tab,int start,int tab_size,const struct locate_cache_table* t,vector_ptr* res);
 
 } // namespace unitex
 
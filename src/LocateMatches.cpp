@@ -98,11 +98,325 @@ while (l!=NULL) {
 
 
 
+#define CONCORD_WRITER_BUFFER_SIZE 0x10000
+
+
+/**
+ * Creates a writer for the given concord.ind file. In text mode, the header
+ * is supposed to have been written by the caller. In binary mode, 'f' must
+ * have been opened with the BINARY encoding, and the header is written here.
+ */
+struct concord_writer* new_concord_writer(U_FILE* f,int binary,unichar header) {
+struct concord_writer* w=(struct concord_writer*)malloc(sizeof(struct concord_writer));
+if (w==NULL) {
+   fatal_alloc_error("new_concord_writer");
+}
+w->f=f;
+w->binary=binary;
+w->size=CONCORD_WRITER_BUFFER_SIZE;
+w->pos=0;
+w->previous_start=0;
+w->buffer=NULL;
+w->bytes=NULL;
+if (binary) {
+   w->bytes=(unsigned char*)malloc(w->size);
+   if (w->bytes==NULL) {
+      fatal_alloc_error("new_concord_writer");
+   }
+   memcpy(w->bytes,BINARY_CONCORD_MAGIC,BINARY_CONCORD_MAGIC_SIZE);
+   w->bytes[BINARY_CONCORD_MAGIC_SIZE]=(unsigned char)header;
+   w->pos=BINARY_CONCORD_MAGIC_SIZE+1;
+} else {
+   /* +1 for the final \0 needed by u_fputs */
+   w->buffer=(unichar*)malloc((w->size+1)*sizeof(unichar));
+   if (w->buffer==NULL) {
+      fatal_alloc_error("new_concord_writer");
+   }
+}
+return w;
+}
+
+
+/**
+ * Writes the pending data.
+ */
+void flush_concord_writer(struct concord_writer* w) {
+if (w->pos==0) return;
+if (w->binary) {
+   af_fwrite(w->bytes,1,w->pos,w->f->f);
+} else {
+   w->buffer[w->pos]='\0';
+   u_fputs(w->buffer,w->f);
+}
+w->pos=0;
+}
+
+
+void free_concord_writer(struct concord_writer* w) {
+if (w==NULL) return;
+flush_concord_writer(w);
+free(w->buffer);
+free(w->bytes);
+free(w);
+}
+
+
+/**
+ * Makes sure that 'needed' more units can be added to the writer buffer.
+ */
+static void reserve_concord_writer(struct concord_writer* w,int needed) {
+if (w->pos+needed<=w->size) return;
+flush_concord_writer(w);
+if (needed<=w->size) return;
+/* Huge output: we grow the buffer so that the match is written at once */
+w->size=needed;
+if (w->binary) {
+   w->bytes=(unsigned char*)realloc(w->bytes,w->size);
+} else {
+   w->buffer=(unichar*)realloc(w->buffer,(w->size+1)*sizeof(unichar));
+}
+if (w->bytes==NULL && w->buffer==NULL) {
+   fatal_alloc_error("reserve_concord_writer");
+}
+}
+
+
+/**
+ * Appends the decimal form of 'n' to the writer buffer.
+ */
+static inline void append_concord_int(struct concord_writer* w,int n) {
+unichar tmp[12];
+int i=12;
+unsigned int u=(n<0) ? 0u-(unsigned int)n : (unsigned int)n;
+do {
+   tmp[--i]=(unichar)('0'+u%10);
+   u=u/10;
+} while (u!=0);
+if (n<0) {
+   tmp[--i]='-';
+}
+memcpy(w->buffer+w->pos,tmp+i,(12-i)*sizeof(unichar));
+w->pos+=12-i;
+}
+
+
+/**
+ * Appends 'n' as a variable length number: 7 bits per byte, the high bit
+ * meaning that more bytes follow. Negative values are zigzag encoded.
+ */
+static inline void append_concord_varint(struct concord_writer* w,int n) {
+unsigned int u=((unsigned int)n<<1)^(unsigned int)(n>>31);
+while (u>=0x80) {
+   w->bytes[w->pos++]=(unsigned char)(u|0x80);
+   u>>=7;
+}
+w->bytes[w->pos++]=(unsigned char)u;
+}
+
+
+/**
+ * Writes a match, in the form that load_match_list reads.
+ */
+void write_concord_match(struct concord_writer* w,const Match* m,const unichar* output) {
+int length=(output==NULL) ? 0 : u_strlen(output);
+if (w->binary) {
+   /* A flag byte, at most 7 numbers of 5 bytes, and the output */
+   reserve_concord_writer(w,1+7*5+2*length);
+   int letters=(m->start_pos_in_char!=0 || m->start_pos_in_letter!=0 || m->end_pos_in_letter!=0);
+   w->bytes[w->pos++]=(unsigned char)(((output!=NULL) ? BINARY_CONCORD_OUTPUT : 0)
+                                      |(letters ? BINARY_CONCORD_LETTERS : 0));
+   append_concord_varint(w,m->start_pos_in_token-w->previous_start);
+   append_concord_varint(w,m->end_pos_in_token-m->start_pos_in_token);
+   append_concord_varint(w,m->end_pos_in_char);
+   w->previous_start=m->start_pos_in_token;
+   if (letters) {
+      append_concord_varint(w,m->start_pos_in_char);
+      append_concord_varint(w,m->start_pos_in_letter);
+      append_concord_varint(w,m->end_pos_in_letter);
+   }
+   if (output!=NULL) {
+      append_concord_varint(w,length);
+      for (int i=0;i<length;i++) {
+         w->bytes[w->pos++]=(unsigned char)(output[i]&0xFF);
+         w->bytes[w->pos++]=(unsigned char)(output[i]>>8);
+      }
+   }
+   return;
+}
+/* 6 positions of at most 11 chars, separators, the output and the final \n */
+reserve_concord_writer(w,6*12+2+length+1);
+append_concord_int(w,m->start_pos_in_token);
+w->buffer[w->pos++]='.';
+append_concord_int(w,m->start_pos_in_char);
+w->buffer[w->pos++]='.';
+append_concord_int(w,m->start_pos_in_letter);
+w->buffer[w->pos++]=' ';
+append_concord_int(w,m->end_pos_in_token);
+w->buffer[w->pos++]='.';
+append_concord_int(w,m->end_pos_in_char);
+w->buffer[w->pos++]='.';
+append_concord_int(w,m->end_pos_in_letter);
+if (output!=NULL) {
+   w->buffer[w->pos++]=' ';
+   memcpy(w->buffer+w->pos,output,length*sizeof(unichar));
+   w->pos+=length;
+}
+w->buffer[w->pos++]='\n';
+}
+
+
+/**
+ * Returns 1 if the given file is a binary concord.ind; 0 otherwise. The file
+ * position is not modified.
+ */
+int is_binary_match_list(U_FILE* f) {
+char magic[BINARY_CONCORD_MAGIC_SIZE];
+long pos=af_ftell(f->f);
+int binary=(af_fread(magic,1,BINARY_CONCORD_MAGIC_SIZE,f->f)==BINARY_CONCORD_MAGIC_SIZE
+            && !memcmp(magic,BINARY_CONCORD_MAGIC,BINARY_CONCORD_MAGIC_SIZE));
+af_fseek(f->f,pos,SEEK_SET);
+return binary;
+}
+
+
+#define BINARY_CONCORD_READ_SIZE 0x10000
+
+/**
+ * Buffered reader for binary concord.ind files.
+ */
+struct binary_concord_reader {
+   ABSTRACTFILE* f;
+   unsigned char buffer[BINARY_CONCORD_READ_SIZE];
+   size_t pos;
+   size_t filled;
+};
+
+
+/**
+ * Returns the next byte, or EOF at the end of the file.
+ */
+static inline int read_concord_byte(struct binary_concord_reader* r) {
+if (r->pos==r->filled) {
+   r->filled=af_fread(r->buffer,1,BINARY_CONCORD_READ_SIZE,r->f);
+   r->pos=0;
+   if (r->filled==0) return EOF;
+}
+return r->buffer[r->pos++];
+}
+
+
+/**
+ * Reads a number written by append_concord_varint. Returns 0 at the end
+ * of the file.
+ */
+static inline int read_concord_varint(struct binary_concord_reader* r,int* n) {
+unsigned int u=0;
+int shift=0;
+int c;
+do {
+   if ((c=read_concord_byte(r))==EOF || shift>28) return 0;
+   u|=((unsigned int)(c&0x7F))<<shift;
+   shift+=7;
+} while (c&0x80);
+*n=(int)(u>>1)^-(int)(u&1);
+return 1;
+}
+
+
+/**
+ * Loads a binary concord.ind. See load_match_list.
+ */
+static struct match_list* load_binary_match_list(U_FILE* f,OutputPolicy *output_policy,unichar *header,Abstract_allocator prv_alloc) {
+struct match_list* l=NULL;
+struct match_list* end_of_list=NULL;
+struct binary_concord_reader* r=(struct binary_concord_reader*)malloc(sizeof(struct binary_concord_reader));
+if (r==NULL) {
+   fatal_alloc_error("load_binary_match_list");
+}
+r->f=f->f;
+r->pos=0;
+r->filled=0;
+for (int i=0;i<BINARY_CONCORD_MAGIC_SIZE;i++) {
+   read_concord_byte(r);
+}
+int h=read_concord_byte(r);
+if (header!=NULL) {
+   *header=(unichar)h;
+}
+OutputPolicy policy;
+switch(h) {
+   case 'M': policy=MERGE_OUTPUTS; break;
+   case 'R': policy=REPLACE_OUTPUTS; break;
+   default: policy=IGNORE_OUTPUTS; break;
+}
+if (output_policy!=NULL) {
+   (*output_policy)=policy;
+}
+int size_output=256;
+unichar* output=(unichar*)malloc((size_output+1)*sizeof(unichar));
+if (output==NULL) {
+   fatal_alloc_error("load_binary_match_list");
+}
+int start=0,length,end_char,start_char=0,start_letter=0,end_letter=0,delta;
+int flags;
+while ((flags=read_concord_byte(r))!=EOF) {
+   int ok=read_concord_varint(r,&delta) && read_concord_varint(r,&length)
+          && read_concord_varint(r,&end_char);
+   start+=delta;
+   int end=start+length;
+   if (ok && (flags & BINARY_CONCORD_LETTERS)) {
+      ok=read_concord_varint(r,&start_char) && read_concord_varint(r,&start_letter)
+         && read_concord_varint(r,&end_letter);
+   } else {
+      start_char=start_letter=end_letter=0;
+   }
+   if (ok && (flags & BINARY_CONCORD_OUTPUT)) {
+      ok=read_concord_varint(r,&length) && length>=0;
+      if (ok && length>size_output) {
+         size_output=length;
+         output=(unichar*)realloc(output,(size_output+1)*sizeof(unichar));
+         if (output==NULL) {
+            fatal_alloc_error("load_binary_match_list");
+         }
+      }
+      for (int i=0;ok && i<length;i++) {
+         int lo=read_concord_byte(r);
+         int hi=read_concord_byte(r);
+         ok=(hi!=EOF);
+         output[i]=(unichar)(lo|(hi<<8));
+      }
+      if (ok) {
+         output[length]='\0';
+      }
+   }
+   if (!ok) {
+      error("Truncated binary concordance file\n");
+      break;
+   }
+   struct match_list* m=new_match(start,end,start_char,end_char,start_letter,end_letter,
+                                  (policy!=IGNORE_OUTPUTS && (flags & BINARY_CONCORD_OUTPUT))?output:NULL,
+                                  -1,NULL,prv_alloc);
+   if (l==NULL) {
+      l=m;
+   } else {
+      end_of_list->next=m;
+   }
+   end_of_list=m;
+}
+free(output);
+free(r);
+return l;
+}
+
+
 /**
  * Loads a match list. Match lists are supposed to have been
- * generated by the Locate program.
+ * generated by the Locate program, in text or binary form.
  */
 struct match_list* load_match_list(U_FILE* f,OutputPolicy *output_policy,unichar *header,Abstract_allocator prv_alloc) {
+if (is_binary_match_list(f)) {
+   return load_binary_match_list(f,output_policy,header,prv_alloc);
+}
 struct match_list* l=NULL;
 struct match_list* end_of_list=NULL;
 int start,end,start_char,end_char,start_letter,end_letter;
@@ -55,6 +55,47 @@ struct match_list* load_match_list(U_FILE*,OutputPolicy*,unichar*,Abstract_alloc
 void filter_unambiguous_outputs(struct match_list* *list,vector_int*);
 int are_ambiguous(struct match_list* a,struct match_list* b);
 
+
+/**
+ * A concord.ind file can also be saved in a compact binary form, that is
+ * loaded much faster by load_match_list. It starts with BINARY_CONCORD_MAGIC
+ * followed by the header char ('I', 'M' or 'R') on one byte. Then, each match
+ * starts with a flag byte (BINARY_CONCORD_OUTPUT and BINARY_CONCORD_LETTERS),
+ * followed by variable length numbers: the difference between the start of
+ * the match and the one of the previous match, the length of the match in
+ * tokens and the end position in char. If BINARY_CONCORD_LETTERS is set, we
+ * have the 3 other positions (start in char, start and end in letter), that
+ * are 0 otherwise. If BINARY_CONCORD_OUTPUT is set, we have the length of the
+ * output followed by its unichars, on 2 little-endian bytes each.
+ */
+#define BINARY_CONCORD_MAGIC "UCONCIDX"
+#define BINARY_CONCORD_MAGIC_SIZE 8
+#define BINARY_CONCORD_OUTPUT 1
+#define BINARY_CONCORD_LETTERS 2
+
+/**
+ * This structure is used to write the matches of a concord.ind file. The
+ * matches are formatted in a large buffer, without going through u_fprintf,
+ * and the buffer is written at once when it is full.
+ */
+struct concord_writer {
+   U_FILE* f;
+   int binary;
+   /* Pending unichars in text mode */
+   unichar* buffer;
+   /* Pending bytes in binary mode */
+   unsigned char* bytes;
+   int size;
+   int pos;
+   int previous_start;
+};
+
+struct concord_writer* new_concord_writer(U_FILE*,int binary,unichar header);
+void write_concord_match(struct concord_writer*,const Match*,const unichar* output);
+void flush_concord_writer(struct concord_writer*);
+void free_concord_writer(struct concord_writer*);
+int is_binary_match_list(U_FILE*);
+
 } // namespace unitex
 
 #endif
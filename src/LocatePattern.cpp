@@ -19,6 +19,7 @@
  *
  */
 
+#include <stddef.h>
 #include "LocatePattern.h"
 #include "Error.h"
 #include "LemmaTree.h"
@@ -30,6 +31,8 @@
 #include "File.h"
 #include "UserCancelling.h"
 #include "LocateTrace.h"
+#include "SyncTool.h"
+#include "PackFst2.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -53,6 +56,7 @@ if (p==NULL) {
 memset(p,0,sizeof(struct locate_parameters));
 p->tilde_negation_operator=1;
 p->useLocateCache=1;
+p->useDicCache=1;
 p->token_control=NULL;
 p->matching_patterns=NULL;
 p->current_compound_pattern=0;
@@ -87,6 +91,13 @@ p->output_policy=IGNORE_OUTPUTS;
 p->ambiguous_output_policy=ALLOW_AMBIGUOUS_OUTPUTS;
 p->variable_error_policy=IGNORE_VARIABLE_ERRORS;
 p->match_list=NULL;
+p->match_index=NULL;
+p->match_index_size=0;
+p->match_index_capacity=0;
+p->recorded_matches=NULL;
+p->recorded_origins=NULL;
+p->error_origin=-1;
+p->shared_error_count=NULL;
 p->number_of_matches=0;
 p->number_of_outputs=0;
 p->start_position_last_printed_match=-1;
@@ -103,6 +114,7 @@ p->morpho_dic_inf_free=NULL;
 p->morpho_dic_bin_free=NULL;
 p->n_morpho_dics=0;
 p->morpho_dic_index=NULL;
+p->morpho_case_variants=NULL;
 p->dic_variables=NULL;
 p->left_ctx_shift=0;
 p->left_ctx_base=0;
@@ -142,6 +154,8 @@ p->is_in_cancel_state = 0;
 p->debug=0;
 p->weight=-1;
 p->graph_depth_backup_nested=0;
+p->profile=NULL;
+p->token_length=NULL;
 
 p->stack_max=STACK_MAX;
 p->max_matches_at_token_pos=MAX_MATCHES_AT_TOKEN_POS;
@@ -180,6 +194,9 @@ if (p->recyclable_unichar_buffer!=NULL) {
     free(p->recyclable_unichar_buffer);
 }
 free_vector_ptr(p->cached_match_vector,NULL);
+if (p->match_index!=NULL) {
+    free(p->match_index);
+}
 free(p);
 }
 
@@ -215,6 +232,121 @@ int ABSTRACT_CALLBACK_UNITEX locate_trace(const struct locate_trace_info* locate
   return 0;
 }
 
+/**
+ * Builds the parameters of a Locate worker thread. The worker shares with 'p'
+ * all the data that is read-only during the exploration (fst2, optimized
+ * states, tokens, matching patterns, DLC tree, morphological dictionaries...),
+ * but it owns everything that is modified while exploring: allocators,
+ * stacks, variables, caches and ELG virtual machine.
+ */
+static struct locate_parameters* new_locate_worker_parameters(const struct locate_parameters* p,
+                    const char* elg_extensions_path,vector_ptr* injected_vars,int n_text_tokens) {
+struct locate_parameters* w=new_locate_parameters(elg_extensions_path);
+/* We keep what has just been allocated for the worker... */
+vm* elg=w->elg;
+struct stack_unichar* literal_output=w->literal_output;
+struct stack_unichar* stack_elg=w->stack_elg;
+unichar_regex* recyclable_wchart_buffer=w->recyclable_wchart_buffer;
+unichar* recyclable_unichar_buffer=w->recyclable_unichar_buffer;
+vector_ptr* cached_match_vector=w->cached_match_vector;
+/* ...we take all the shared fields from the main parameters... */
+memcpy(w,p,sizeof(struct locate_parameters));
+w->elg=elg;
+w->literal_output=literal_output;
+w->stack_elg=stack_elg;
+w->recyclable_wchart_buffer=recyclable_wchart_buffer;
+w->recyclable_unichar_buffer=recyclable_unichar_buffer;
+w->size_recyclable_unichar_buffer=SIZE_RECYCLABLE_UNICHAR_BUFFER;
+w->cached_match_vector=cached_match_vector;
+/* ...and we reset the private ones */
+w->match_list=NULL;
+w->match_index=NULL;
+w->match_index_size=0;
+w->match_index_capacity=0;
+w->match_cache_first=NULL;
+w->match_cache_last=NULL;
+w->recorded_matches=NULL;
+w->recorded_origins=NULL;
+w->error_origin=-1;
+w->shared_error_count=NULL;
+w->dic_variables=NULL;
+w->backup_memory_reserve=NULL;
+w->lti=NULL;
+if (p->profile!=NULL) {
+   w->profile=new_locate_profile(p->fst2);
+}
+w->number_of_matches=0;
+w->number_of_outputs=0;
+w->matching_units=0;
+w->is_in_cancel_state=0;
+int nb_input_variable=0;
+w->input_variables=new_Variables(p->fst2->input_variables,&nb_input_variable);
+w->output_variables=new_OutputVariables(p->fst2->output_variables,&(w->nb_output_variables),injected_vars);
+/* like in locate_pattern, matches are kept out of the arena */
+w->al.prv_alloc_generic=create_abstract_allocator("locate_worker",AllocatorCreationFlagAutoFreeUnused);
+w->al.pa.prv_alloc_vector_int_inside_token=create_abstract_allocator("locate_worker_inside_token",AllocatorCreationFlagAutoFreePrefered);
+w->al.pa.prv_alloc_recycle=create_abstract_allocator("locate_worker_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
+                                 get_prefered_allocator_item_size_for_nb_variable(nb_input_variable));
+w->al.pa.prv_alloc_backup_growing_recycle=create_abstract_allocator("locate_worker_growing_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+w->al.prv_alloc_recycle_morphlogical_content_buffer=create_abstract_allocator("locate_worker_morphlogical_content_buffer_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+w->al.prv_alloc_context=create_abstract_allocator("locate_worker_growing_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+w->al.prv_alloc_trace_info_allocator=create_abstract_allocator("locate_worker_recycle_locate_trace_info",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
+                                 sizeof(locate_trace_info));
+w->failfast=new_bit_array(n_text_tokens,ONE_BIT);
+if (p->korean!=NULL) {
+    /* Korean objects cache their Hangul to Jamo conversions, so they cannot be shared */
+    w->korean=new Korean(p->alphabet);
+}
+w->elg->load_main_extension(p->graph_filename,p->fst2);
+return w;
+}
+
+
+/**
+ * Frees what a worker owns. The shared fields are freed with the main parameters.
+ */
+static void free_locate_worker_parameters(struct locate_parameters* w) {
+w->elg->unload_main_extension();
+free_bit_array(w->failfast);
+free_Variables(w->input_variables);
+free_OutputVariables(w->output_variables);
+free_match_list(w->match_list,w->al.prv_alloc_generic);
+if (w->korean!=NULL) {
+    delete w->korean;
+}
+close_abstract_allocator(w->al.prv_alloc_generic);
+close_abstract_allocator(w->al.pa.prv_alloc_vector_int_inside_token);
+close_abstract_allocator(w->al.pa.prv_alloc_recycle);
+close_abstract_allocator(w->al.pa.prv_alloc_backup_growing_recycle);
+close_abstract_allocator(w->al.prv_alloc_recycle_morphlogical_content_buffer);
+close_abstract_allocator(w->al.prv_alloc_context);
+close_abstract_allocator(w->al.prv_alloc_trace_info_allocator);
+free_stack_unichar(w->literal_output);
+free_stack_unichar(w->stack_elg);
+free_locate_parameters(w);
+}
+
+
+/**
+ * Frees the fst2 used by Locate, which is either a clone made with
+ * 'prv_alloc' or a binary image.
+ */
+static void free_locate_fst2(Fst2* fst2,int is_image,Abstract_allocator prv_alloc) {
+if (is_image) {
+   free_image_fst2(fst2,prv_alloc);
+} else {
+   free_Fst2(fst2,prv_alloc);
+}
+}
+
 
 int locate_pattern(const char* text_cod,const char* tokens,const char* fst2_name,const char* dlf,const char* dlc,const char* err,
                    const char* alphabet,MatchPolicy match_policy,OutputPolicy output_policy,
@@ -226,7 +358,8 @@ int locate_pattern(const char* text_cod,const char* tokens,const char* fst2_name
                    int is_korean,int max_count_call,int max_count_call_warning,
                    int stack_max, int max_matches_at_token_pos,int max_matches_per_subgraph,int max_errors,
                    char* arabic_rules,int tilde_negation_operator,int useLocateCache,int allow_trace,char* const trace_params[],
-                   vector_ptr* injected_vars,const char* elg_extensions_path,const char* enter_pos) {
+                   vector_ptr* injected_vars,const char* elg_extensions_path,const char* enter_pos,
+                   int n_threads,int useDicCache,int profile,int binary_concord) {
 UNITEX_DISCARD_UNUSED_PARAMETER(allow_trace);
 UNITEX_DISCARD_UNUSED_PARAMETER(trace_params);
 u_printf("Initializing the Extend Local Grammars (ELG) Engine...\n");
@@ -295,6 +428,7 @@ long text_size=(long)af_get_mapfile_size(p->text_cod)/sizeof(int);
 p->buffer_size=(int)text_size;
 p->tilde_negation_operator=tilde_negation_operator;
 p->useLocateCache=useLocateCache;
+p->useDicCache=useDicCache;
 if (max_count_call == -1) {
    max_count_call = (int)text_size;
 }
@@ -329,7 +463,11 @@ strcat(morpho_bin,"morpho.bin");
 if (arabic_rules!=NULL && arabic_rules[0]!='\0') {
     load_arabic_typo_rules(vec,arabic_rules,&(p->arabic));
 }
-out=u_fopen(vec,concord,U_WRITE);
+if (binary_concord) {
+   out=u_fopen(BINARY,concord,U_WRITE);
+} else {
+   out=u_fopen(vec,concord,U_WRITE);
+}
 if (out==NULL) {
    error("Cannot write %s\n",concord);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
@@ -407,30 +545,51 @@ if (fst2load->debug) {
     p->output_policy=MERGE_OUTPUTS;
     p->ambiguous_output_policy=ALLOW_AMBIGUOUS_OUTPUTS;
     p->debug=1;
+    if (binary_concord) {
+       /* The binary form cannot hold the debug header */
+       error("Debug grammar, saving the concordance in text form\n");
+       u_fclose(out);
+       out=u_fopen(vec,concord,U_WRITE);
+       binary_concord=0;
+       if (out==NULL) {
+          fatal_error("Cannot write %s\n",concord);
+       }
+    }
     u_fprintf(out,"#D\n");
     u_fprintf(out,"%d\n",fst2load->number_of_graphs);
     for (int i=0;i<fst2load->number_of_graphs;i++) {
         u_fprintf(out,"%S\n",fst2load->graph_names[i+1]);
     }
 }
+unichar concord_header='\0';
 switch(p->real_output_policy) {
-   case IGNORE_OUTPUTS: u_fprintf(out,"#I\n"); break;
-   case MERGE_OUTPUTS: u_fprintf(out,"#M\n"); break;
-   case REPLACE_OUTPUTS: u_fprintf(out,"#R\n"); break;
+   case IGNORE_OUTPUTS: concord_header='I'; break;
+   case MERGE_OUTPUTS: concord_header='M'; break;
+   case REPLACE_OUTPUTS: concord_header='R'; break;
    default:break;
 }
+if (!binary_concord && concord_header!='\0') {
+   u_fprintf(out,"#%C\n",concord_header);
+}
 
 Abstract_allocator locate_abstract_allocator=create_abstract_allocator("locate_pattern",AllocatorCreationFlagAutoFreePrefered);
 
 
-p->fst2=new_Fst2_clone(fst2load,locate_abstract_allocator);
-free_abstract_Fst2(fst2load,&fst2load_free);
+/* A binary image is already a private block, where Locate can attach the
+ * patterns and token lists of the tags, so that we don't need a clone */
+int fst2_is_image=is_image_abstract_fst2(&fst2load_free);
+if (fst2_is_image) {
+   p->fst2=fst2load;
+} else {
+   p->fst2=new_Fst2_clone(fst2load,locate_abstract_allocator);
+   free_abstract_Fst2(fst2load,&fst2load_free);
+}
 
 if (is_cancelling_requested() != 0) {
    error("User cancel request..\n");
    free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,fst2_is_image,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
    af_close_mapfile(p->text_cod);
@@ -453,7 +612,7 @@ if (p->filters==NULL) {
    error("Cannot compile filter(s)\n");
    free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,fst2_is_image,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    free_stack_unichar(p->literal_output);
    free_stack_unichar(p->stack_elg);
@@ -474,7 +633,7 @@ if (p->tokens==NULL) {
    error("Cannot load token list %s\n",tokens);
    free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,fst2_is_image,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    free_locate_parameters(p);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
@@ -503,7 +662,7 @@ if(enter_pos) {
    free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
    free_string_hash(p->tokens);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,fst2_is_image,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    free_locate_parameters(p);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
@@ -516,22 +675,21 @@ if(enter_pos) {
 
 }
 
-Abstract_allocator locate_work_abstract_allocator = locate_abstract_allocator;
+/* matches are allocated and freed all along the parsing, so they must not
+ * go to an arena that would only give them back at the end */
+Abstract_allocator locate_work_abstract_allocator=create_abstract_allocator("locate_pattern_work",AllocatorCreationFlagAutoFreeUnused);
 
-p->match_cache=(LocateCache*)malloc_cb(p->tokens->size * sizeof(LocateCache),locate_work_abstract_allocator);
-memset(p->match_cache,0,p->tokens->size * sizeof(LocateCache));
-if (p->match_cache==NULL) {
-    fatal_alloc_error("locate_pattern");
-}
+p->match_cache=new_LocateCache_table(p->tokens->size,DEFAULT_LOCATE_CACHE_MAX_SIZE);
 
 #ifdef REGEX_FACADE_ENGINE
-p->filter_match_index=new_FilterMatchIndex(p->filters,p->tokens);
+p->filter_match_index=new_FilterMatchIndex(p->filters,p->tokens,n_threads);
 if (p->filter_match_index==NULL) {
    error("Cannot optimize filter(s)\n");
    free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
    free_string_hash(p->tokens);
    close_abstract_allocator(locate_abstract_allocator);
+   close_abstract_allocator(locate_work_abstract_allocator);
    free_locate_parameters(p);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
    af_close_mapfile(p->text_cod);
@@ -545,6 +703,9 @@ if (p->filter_match_index==NULL) {
 extract_semantic_codes_from_tokens(p->tokens,semantic_codes,locate_abstract_allocator);
 u_printf("Loading morphological dictionaries...\n");
 load_morphological_dictionaries(vec,morpho_dic_list,p,morpho_bin);
+if (p->n_morpho_dics!=0) {
+    p->morpho_case_variants=new_bin_case_variants(p->alphabet);
+}
 extract_semantic_codes_from_morpho_dics(p->morpho_dic,p->n_morpho_dics,semantic_codes,locate_abstract_allocator);
 p->token_control=(unsigned char*)malloc(n_text_tokens*sizeof(unsigned char));
 if (p->token_control==NULL) {
@@ -646,7 +807,66 @@ p->al.prv_alloc_context=locate_recycle_context_abstract_allocator;
 //p->lti->jamo=NULL;
 //p->lti->pos_in_jamo=0;
 
-launch_locate(out,text_size,info,p);
+if (profile) {
+   p->profile=new_locate_profile(p->fst2);
+}
+
+int n_workers=0;
+struct locate_parameters** workers=NULL;
+if (n_threads>1) {
+   if (p->search_limit!=NO_MATCH_LIMIT) {
+      /* The match limit is checked while saving matches, so we could not
+       * stop the workers in time */
+      error("Search limit is set, working with a single thread\n");
+   } else if (!SyncIsSeveralThreadsPossible()) {
+      error("Threads are not available, working with a single thread\n");
+   } else {
+      n_workers=n_threads;
+      workers=(struct locate_parameters**)malloc(n_workers*sizeof(struct locate_parameters*));
+      if (workers==NULL) {
+         fatal_alloc_error("locate_pattern");
+      }
+      for (int i=0;i<n_workers;i++) {
+         workers[i]=new_locate_worker_parameters(p,real_elg_extensions_path,injected_vars,n_text_tokens);
+      }
+      u_printf("Working with %d threads...\n",n_workers);
+   }
+}
+
+p->token_length=(int*)malloc(p->tokens->size*sizeof(int));
+if (p->token_length==NULL) {
+   fatal_alloc_error("locate_pattern");
+}
+for (int i=0;i<p->tokens->size;i++) {
+   p->token_length[i]=u_strlen(p->tokens->value[i]);
+}
+for (int i=0;i<n_workers;i++) {
+   workers[i]->token_length=p->token_length;
+}
+struct concord_writer* writer=new_concord_writer(out,binary_concord,concord_header);
+launch_locate(writer,text_size,info,p,n_workers,workers);
+free_concord_writer(writer);
+free(p->token_length);
+p->token_length=NULL;
+
+for (int i=0;i<n_workers;i++) {
+   if (p->profile!=NULL) {
+      merge_locate_profile(p->profile,workers[i]->profile);
+      free_locate_profile(workers[i]->profile);
+   }
+   free_locate_worker_parameters(workers[i]);
+}
+free(workers);
+
+if (p->profile!=NULL) {
+   char profile_txt[FILENAME_MAX];
+   char profile_json[FILENAME_MAX];
+   sprintf(profile_txt,"%slocate_profile.txt",dynamicDir);
+   sprintf(profile_json,"%slocate_profile.json",dynamicDir);
+   save_locate_profile(p->profile,vec,profile_txt,profile_json);
+   free_locate_profile(p->profile);
+   p->profile=NULL;
+}
 
 // unload main extension
 p->elg->unload_main_extension();
@@ -663,12 +883,7 @@ af_close_mapfile(p->text_cod);
 if (info!=NULL) u_fclose(info);
 u_fclose(out);
 
-if (p->match_cache!=NULL) {
-    for (int i=0;i<p->tokens->size;i++) {
-        free_LocateCache(p->match_cache[i],locate_work_abstract_allocator);
-    }
-    free_cb(p->match_cache,locate_work_abstract_allocator);
-}
+free_LocateCache_table(p->match_cache);
 int free_abstract_allocator_item=(get_allocator_cb_flag(locate_abstract_allocator) & AllocatorGetFlagAutoFreePresent) ? 0 : 1;
 
 if (free_abstract_allocator_item) {
@@ -676,15 +891,22 @@ if (free_abstract_allocator_item) {
 }
 free_stack_unichar(p->literal_output);
 free_stack_unichar(p->stack_elg);
-/** Too long to free the DLC tree if it is big
- * free_DLC_tree(p->DLC_tree);
- */
+/* Freeing a big DLC tree node by node is too long, but it is instant
+ * when the tree lives in an auto free allocator */
+if (p->DLC_tree!=NULL && (get_allocator_cb_flag(p->DLC_tree->prv_alloc) & AllocatorGetFlagAutoFreePresent)) {
+  free_DLC_tree(p->DLC_tree);
+  p->DLC_tree=NULL;
+}
 if (free_abstract_allocator_item) {
   free_pattern_node(p->pattern_tree_root,locate_abstract_allocator);
-  free_Fst2(p->fst2,locate_abstract_allocator);
   free_list_int(p->tag_token_list,locate_abstract_allocator);
 }
+/* An image does not belong to the allocator, so that it is always freed */
+if (free_abstract_allocator_item || fst2_is_image) {
+  free_locate_fst2(p->fst2,fst2_is_image,locate_abstract_allocator);
+}
 close_abstract_allocator(locate_abstract_allocator);
+close_abstract_allocator(locate_work_abstract_allocator);
 close_abstract_allocator(locate_work_abstract_allocator_inside_token);
 close_abstract_allocator(locate_recycle_abstract_allocator);
 close_abstract_allocator(locate_recycle_backup_abstract_allocator);
@@ -729,6 +951,7 @@ free(p->morpho_dic);
 free(p->morpho_dic_inf_free);
 free(p->morpho_dic_bin_free);
 free_string_hash(p->morpho_dic_index);
+free_bin_case_variants(p->morpho_case_variants);
 
 //delete p->elg; free on free_locate_parameters(p)
 #if (defined(UNITEX_LIBRARY) || defined(UNITEX_RELEASE_MEMORY_AT_EXIT))
@@ -933,6 +1156,430 @@ free_string_hash(ERR);
 }
 
 
+/**
+ * Loading the dlf and the dlc of a text is costly: each line must be parsed
+ * and its inflected form must be looked up among the text tokens with all
+ * its case variants. As Locate is often launched many times on the same text,
+ * the result of this work is saved the first time in a binary file named like
+ * the dictionary with the ".cache" extension ("dlf.cache" and "dlc.cache").
+ * The cache is only used if the dictionary, the text tokens, the alphabet and
+ * the tokenization policy are the same as when it was built. Matching the
+ * entries against the patterns of the grammar is still done at each run, but
+ * on entries that are already split into their fields.
+ *
+ * After the header, the file contains an int array and a unichar array, in
+ * which strings are stored as null-terminated sequences. Each entry is
+ * described in the int array by:
+ *
+ *   inflected lemma codes sem[n_sem] infl[n_infl] filter[n_filter]
+ *   n_tokens token[n_tokens] n_compound compound[n_compound]
+ *
+ * where strings are offsets in the unichar array and 'codes' packs n_sem,
+ * n_infl, n_filter and the filter polarity on one byte each. 'token' is the
+ * list of the text tokens that can be matched by the inflected form, and
+ * 'compound' is the output of 'tokenize_compound_word', or nothing if
+ * n_compound is -1 (simple word).
+ */
+#define DIC_CACHE_VERSION 1
+#define DIC_CACHE_BYTE_ORDER_MARKER 0x01020304
+
+struct dic_cache_header {
+   char magic[8];
+   unsigned int byte_order_marker;
+   unsigned int tokenization_policy;
+   uint64_t dic_size;
+   uint64_t dic_hash;
+   uint64_t tokens_hash;
+   uint64_t alphabet_hash;
+   /* The fields above identify the cache, the ones below describe its content */
+   unsigned int n_entries;
+   unsigned int n_ints;
+   unsigned int n_unichars;
+   unsigned int reserved;
+};
+
+
+/**
+ * This structure is used to record the entries of a dictionary while it is
+ * loaded, in order to save them in a cache file.
+ */
+struct dic_cache_builder {
+   vector_int* ints;
+   Ustring* strings;
+   unsigned int n_entries;
+};
+
+
+#define DIC_CACHE_HASH_BASIS 14695981039346656037ULL
+#define DIC_CACHE_HASH_PRIME 1099511628211ULL
+
+/**
+ * Updates the hash 'h' with the given bytes. Bytes are mixed 8 by 8, since
+ * the whole dictionary is hashed at each Locate run.
+ */
+static uint64_t hash_dic_cache_bytes(uint64_t h,const void* data,size_t size) {
+const unsigned char* s=(const unsigned char*)data;
+size_t i=0;
+for (;i+8<=size;i+=8) {
+   uint64_t word;
+   memcpy(&word,s+i,8);
+   h=(h^word)*DIC_CACHE_HASH_PRIME;
+   h^=h>>29;
+}
+for (;i<size;i++) {
+   h=(h^s[i])*DIC_CACHE_HASH_PRIME;
+}
+return h;
+}
+
+
+static uint64_t hash_dic_cache_tokens(const struct string_hash* tokens) {
+uint64_t h=hash_dic_cache_bytes(DIC_CACHE_HASH_BASIS,&(tokens->size),sizeof(tokens->size));
+for (int i=0;i<tokens->size;i++) {
+   /* We include the final \0 to separate the tokens */
+   h=hash_dic_cache_bytes(h,tokens->value[i],(u_strlen(tokens->value[i])+1)*sizeof(unichar));
+}
+return h;
+}
+
+
+static uint64_t hash_dic_cache_alphabet(const Alphabet* alphabet) {
+uint64_t h=DIC_CACHE_HASH_BASIS;
+if (alphabet==NULL) {
+   return h;
+}
+h=hash_dic_cache_bytes(h,alphabet->array_case_flags,sizeof(alphabet->array_case_flags));
+for (unsigned int c=0;c<0x10000;c++) {
+   int pos=alphabet->pos_in_represent_list[c];
+   if (pos!=0) {
+      const unichar* s=alphabet->t_array_collection[pos];
+      h=hash_dic_cache_bytes(h,&c,sizeof(c));
+      h=hash_dic_cache_bytes(h,s,(u_strlen(s)+1)*sizeof(unichar));
+   }
+}
+if (alphabet->korean_equivalent_syllable!=NULL) {
+   h=hash_dic_cache_bytes(h,alphabet->korean_equivalent_syllable,0x10000*sizeof(unichar));
+}
+return h;
+}
+
+
+/**
+ * Fills 'key' with the fields that identify the cache of the given
+ * dictionary. Returns 0 if the dictionary cannot be read or is empty.
+ */
+static int get_dic_cache_key(const char* dic_name,const Alphabet* alphabet,const struct string_hash* tokens,
+                             TokenizationPolicy tokenization_policy,struct dic_cache_header* key) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(dic_name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return 0;
+}
+size_t size=af_get_mapfile_size(amf);
+const void* buf=(size==0) ? NULL : af_get_mapfile_pointer(amf);
+if (buf==NULL) {
+   af_close_mapfile(amf);
+   return 0;
+}
+memset(key,0,sizeof(struct dic_cache_header));
+memcpy(key->magic,"DICCACH",7);
+key->magic[7]=DIC_CACHE_VERSION;
+key->byte_order_marker=DIC_CACHE_BYTE_ORDER_MARKER;
+key->tokenization_policy=(unsigned int)tokenization_policy;
+key->dic_size=(uint64_t)size;
+key->dic_hash=hash_dic_cache_bytes(DIC_CACHE_HASH_BASIS,buf,size);
+key->tokens_hash=hash_dic_cache_tokens(tokens);
+key->alphabet_hash=hash_dic_cache_alphabet(alphabet);
+af_release_mapfile_pointer(amf,buf);
+af_close_mapfile(amf);
+return 1;
+}
+
+
+static struct dic_cache_builder* new_dic_cache_builder() {
+struct dic_cache_builder* builder=(struct dic_cache_builder*)malloc(sizeof(struct dic_cache_builder));
+if (builder==NULL) {
+   fatal_alloc_error("new_dic_cache_builder");
+}
+builder->ints=new_vector_int(4096);
+builder->strings=new_Ustring(4096);
+builder->n_entries=0;
+return builder;
+}
+
+
+static void free_dic_cache_builder(struct dic_cache_builder* builder) {
+if (builder==NULL) return;
+free_vector_int(builder->ints);
+free_Ustring(builder->strings);
+free(builder);
+}
+
+
+/**
+ * Adds the given string to the unichar array of the cache and returns its offset.
+ */
+static int add_dic_cache_string(struct dic_cache_builder* builder,const unichar* s) {
+int offset=(int)builder->strings->len;
+u_strcat(builder->strings,s);
+u_strcat(builder->strings,(unichar)'\0');
+return offset;
+}
+
+
+static void add_dic_cache_entry(struct dic_cache_builder* builder,const struct dela_entry* entry,
+                                const int* token_numbers,int n_token_numbers,const int* compound_tokens) {
+vector_int* ints=builder->ints;
+int inflected=add_dic_cache_string(builder,entry->inflected);
+vector_int_add(ints,inflected);
+vector_int_add(ints,u_strcmp(entry->lemma,entry->inflected) ? add_dic_cache_string(builder,entry->lemma) : inflected);
+vector_int_add(ints,entry->n_semantic_codes | (entry->n_inflectional_codes<<8)
+                    | (entry->n_filter_codes<<16) | (entry->filter_polarity<<24));
+for (int i=0;i<entry->n_semantic_codes;i++) {
+   vector_int_add(ints,add_dic_cache_string(builder,entry->semantic_codes[i]));
+}
+for (int i=0;i<entry->n_inflectional_codes;i++) {
+   vector_int_add(ints,add_dic_cache_string(builder,entry->inflectional_codes[i]));
+}
+for (int i=0;i<entry->n_filter_codes;i++) {
+   vector_int_add(ints,add_dic_cache_string(builder,entry->filter_codes[i]));
+}
+vector_int_add(ints,n_token_numbers);
+for (int i=0;i<n_token_numbers;i++) {
+   vector_int_add(ints,token_numbers[i]);
+}
+if (compound_tokens==NULL) {
+   vector_int_add(ints,-1);
+} else {
+   int n=0;
+   while (compound_tokens[n++]!=END_TOKEN_LIST) {}
+   vector_int_add(ints,n);
+   for (int i=0;i<n;i++) {
+      vector_int_add(ints,compound_tokens[i]);
+   }
+}
+builder->n_entries++;
+}
+
+
+/**
+ * Saves the cache. If the file cannot be written, for instance because the
+ * text directory is read-only, we just go on without cache. The cache is
+ * written to a temporary file that replaces the old one once complete, since
+ * another Locate on the same text may have the old one mapped in memory.
+ */
+static void save_dic_cache(const char* cache_name,const struct dic_cache_header* key,
+                           const struct dic_cache_builder* builder) {
+struct dic_cache_header header=*key;
+header.n_entries=builder->n_entries;
+header.n_ints=(unsigned int)builder->ints->nbelems;
+header.n_unichars=builder->strings->len;
+size_t size_ints=header.n_ints*sizeof(int);
+size_t size_strings=header.n_unichars*sizeof(unichar);
+char tmp_name[FILENAME_MAX];
+ABSTRACTFILE* f=open_temp_file_for(cache_name,tmp_name);
+if (f==NULL) {
+   return;
+}
+int ok=(af_fwrite(&header,sizeof(header),1,f)==1);
+if (ok && size_ints>0) ok=(af_fwrite(builder->ints->tab,1,size_ints,f)==size_ints);
+if (ok && size_strings>0) ok=(af_fwrite(builder->strings->str,1,size_strings,f)==size_strings);
+af_fclose(f);
+if (!ok) {
+   af_remove(tmp_name);
+   return;
+}
+replace_file(tmp_name,cache_name);
+}
+
+
+static const unichar* get_dic_cache_string(const unichar* strings,unsigned int n_unichars,int offset) {
+if (offset<0 || (unsigned int)offset>=n_unichars) {
+   return NULL;
+}
+return strings+offset;
+}
+
+
+/**
+ * Decodes the cache entry that starts at '*pos' in 'ints' and moves '*pos'
+ * to the next entry. The strings of 'entry' point into the cache. Returns 0
+ * if the entry is not consistent with the size of the cache.
+ */
+static int decode_dic_cache_entry(const int* ints,unsigned int n_ints,const unichar* strings,
+                                  unsigned int n_unichars,int n_tokens,unsigned int* pos,
+                                  struct dela_entry* entry,const int** token_numbers,
+                                  int* n_token_numbers,const int** compound_tokens) {
+unsigned int i=*pos;
+if (n_ints-i<3) return 0;
+entry->inflected=(unichar*)get_dic_cache_string(strings,n_unichars,ints[i++]);
+entry->lemma=(unichar*)get_dic_cache_string(strings,n_unichars,ints[i++]);
+unsigned int codes=(unsigned int)ints[i++];
+entry->n_semantic_codes=(unsigned char)(codes&0xFF);
+entry->n_inflectional_codes=(unsigned char)((codes>>8)&0xFF);
+entry->n_filter_codes=(unsigned char)((codes>>16)&0xFF);
+entry->filter_polarity=(unsigned char)((codes>>24)&0xFF);
+if (entry->inflected==NULL || entry->lemma==NULL
+    || entry->n_semantic_codes>MAX_SEMANTIC_CODES
+    || entry->n_inflectional_codes>MAX_INFLECTIONAL_CODES
+    || entry->n_filter_codes>MAX_FILTERS) {
+   return 0;
+}
+unsigned int n_codes=entry->n_semantic_codes+entry->n_inflectional_codes+entry->n_filter_codes;
+/* We need the codes, plus n_tokens and n_compound */
+if (n_ints-i<n_codes+2) return 0;
+for (int j=0;j<entry->n_semantic_codes;j++) {
+   if (NULL==(entry->semantic_codes[j]=(unichar*)get_dic_cache_string(strings,n_unichars,ints[i++]))) return 0;
+}
+for (int j=0;j<entry->n_inflectional_codes;j++) {
+   if (NULL==(entry->inflectional_codes[j]=(unichar*)get_dic_cache_string(strings,n_unichars,ints[i++]))) return 0;
+}
+for (int j=0;j<entry->n_filter_codes;j++) {
+   if (NULL==(entry->filter_codes[j]=(unichar*)get_dic_cache_string(strings,n_unichars,ints[i++]))) return 0;
+}
+int n=ints[i++];
+/* We need the tokens, plus n_compound */
+if (n<0 || n_ints-i<(unsigned int)n+1) return 0;
+for (int j=0;j<n;j++) {
+   if (ints[i+j]<0 || ints[i+j]>=n_tokens) return 0;
+}
+*token_numbers=ints+i;
+*n_token_numbers=n;
+i=i+n;
+n=ints[i++];
+if (n==-1) {
+   *compound_tokens=NULL;
+} else {
+   if (n<1 || n>MAX_TOKEN_IN_A_COMPOUND_WORD || n_ints-i<(unsigned int)n
+       || ints[i+n-1]!=END_TOKEN_LIST) return 0;
+   for (int j=0;j<n;j++) {
+      if (ints[i+j]>=n_tokens || (ints[i+j]<0 && ints[i+j]!=BEGIN_CASE_VARIANT_LIST
+          && ints[i+j]!=END_CASE_VARIANT_LIST && ints[i+j]!=END_TOKEN_LIST)) return 0;
+   }
+   *compound_tokens=ints+i;
+   i=i+n;
+}
+*pos=i;
+return 1;
+}
+
+
+/**
+ * Uses the information about a dictionary entry to mark the tokens and the
+ * compound words that it can match. 'token_numbers' is the list of the text
+ * tokens that can be matched by the inflected form of the entry, and
+ * 'compound_tokens' is the tokenization of the inflected form if it is a
+ * compound word, NULL otherwise.
+ */
+static void add_dic_entry_for_locate(struct dela_entry* entry,const int* token_numbers,int n_token_numbers,
+                                     const int* compound_tokens,Alphabet* alphabet,int number_of_patterns,
+                                     int is_DIC_pattern,int is_CDIC_pattern,struct lemma_node* root,
+                                     struct locate_parameters* parameters) {
+struct string_hash* tokens=parameters->tokens;
+/* We add the inflected form to the list of forms associated to the lemma.
+ * This will be used to replace patterns like "<be>" by the actual list of
+ * forms that can be matched by it, for optimization reasons */
+add_inflected_form_for_lemma(entry->inflected,entry->lemma,root);
+/* We look for matching patterns only if there are some. The patterns only
+ * depend on the entry, so we compute them once for all its tokens */
+struct list_pointer* list=NULL;
+if (number_of_patterns && (n_token_numbers>0 || compound_tokens!=NULL)) {
+   list=get_matching_patterns(entry,parameters->pattern_tree_root);
+}
+/* Here, we will deal with all simple words */
+for (int k=0;k<n_token_numbers;k++) {
+   int i=token_numbers[k];
+   /* If the current token can be matched, then it can be recognized by the "<DIC>" pattern */
+   parameters->token_control[i]=(unsigned char)(get_control_byte(tokens->value[i],alphabet,NULL,parameters->tokenization_policy)|DIC_TOKEN_BIT_MASK);
+   if (list!=NULL) {
+      /* If we have some patterns to add */
+      if (parameters->matching_patterns[i]==NULL) {
+         /* We allocate the pattern bit array, if needed */
+         parameters->matching_patterns[i]=new_bit_array(number_of_patterns,ONE_BIT);
+      }
+      struct list_pointer* tmp=list;
+      while (tmp!=NULL) {
+         /* Then we add all the pattern numbers to the bit array */
+         set_value(parameters->matching_patterns[i],((struct constraint_list*)(tmp->pointer))->pattern_number,1);
+         tmp=tmp->next;
+      }
+   }
+}
+if (compound_tokens!=NULL) {
+   /* If the inflected form is a compound word */
+   if (is_DIC_pattern || is_CDIC_pattern) {
+      /* If the .fst2 contains "<DIC>" and/or "<CDIC>", then we
+       * must note that all compound words can be matched by them */
+      add_compound_word_token_list_with_pattern(compound_tokens,COMPOUND_WORD_PATTERN,parameters->DLC_tree);
+   }
+   struct list_pointer* tmp=list;
+   while (tmp!=NULL) {
+      /* If the word is matched by at least one pattern, we store it. */
+      int pattern_number=((struct constraint_list*)(tmp->pointer))->pattern_number;
+      add_compound_word_token_list_with_pattern(compound_tokens,pattern_number,parameters->DLC_tree);
+      tmp=tmp->next;
+   }
+}
+/* Finally, we free the constraint list */
+free_list_pointer(list);
+}
+
+
+/**
+ * Loads the dictionary information from the given cache file. Returns 0 if
+ * there is no valid cache for the dictionary identified by 'key'; in that
+ * case, nothing has been modified.
+ */
+static int load_dic_for_locate_from_cache(const char* cache_name,const struct dic_cache_header* key,
+                                          Alphabet* alphabet,int number_of_patterns,int is_DIC_pattern,
+                                          int is_CDIC_pattern,struct lemma_node* root,
+                                          struct locate_parameters* parameters) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(cache_name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return 0;
+}
+size_t size=af_get_mapfile_size(amf);
+const void* buf=(size<sizeof(struct dic_cache_header)) ? NULL : af_get_mapfile_pointer(amf);
+if (buf==NULL) {
+   af_close_mapfile(amf);
+   return 0;
+}
+const struct dic_cache_header* header=(const struct dic_cache_header*)buf;
+/* We only accept a cache that has exactly the size announced by its header */
+int ok=!memcmp(header,key,offsetof(struct dic_cache_header,n_entries))
+       && size==sizeof(struct dic_cache_header)+(size_t)header->n_ints*sizeof(int)
+                +(size_t)header->n_unichars*sizeof(unichar);
+const int* ints=(const int*)((const char*)buf+sizeof(struct dic_cache_header));
+const unichar* strings=ok ? (const unichar*)(ints+header->n_ints) : NULL;
+int n_tokens=parameters->tokens->size;
+ok=ok && (header->n_entries==0 || (header->n_unichars>0 && strings[header->n_unichars-1]=='\0'));
+struct dela_entry entry;
+const int* token_numbers;
+int n_token_numbers;
+const int* compound_tokens;
+unsigned int pos=0;
+/* We check all the entries before modifying anything */
+for (unsigned int n=0;ok && n<header->n_entries;n++) {
+   ok=decode_dic_cache_entry(ints,header->n_ints,strings,header->n_unichars,n_tokens,&pos,
+                             &entry,&token_numbers,&n_token_numbers,&compound_tokens);
+}
+if (ok && pos!=header->n_ints) {
+   ok=0;
+}
+if (ok) {
+   pos=0;
+   for (unsigned int n=0;n<header->n_entries;n++) {
+      decode_dic_cache_entry(ints,header->n_ints,strings,header->n_unichars,n_tokens,&pos,
+                             &entry,&token_numbers,&n_token_numbers,&compound_tokens);
+      add_dic_entry_for_locate(&entry,token_numbers,n_token_numbers,compound_tokens,alphabet,
+                               number_of_patterns,is_DIC_pattern,is_CDIC_pattern,root,parameters);
+   }
+}
+af_release_mapfile_pointer(amf,buf);
+af_close_mapfile(amf);
+return ok;
+}
+
+
 /**
  * This function loads a DLF or a DLC. It computes information about tokens
  * that will be used during the Locate operation. For instance, if we have the
@@ -949,22 +1596,42 @@ free_string_hash(ERR);
  * indicate if the .fst2 contains the corresponding patterns. For instance, if
  * the pattern "<CDIC>" is used in the grammar, it means that any token sequence that is a
  * compound word must be marked as be matched by this pattern.
+ *
+ * If 'parameters->useDicCache' is set, the dictionary is loaded from its cache
+ * when it is valid; otherwise, the cache is built while the dictionary is loaded.
  */
 void load_dic_for_locate(const char* dic_name, const VersatileEncodingConfig* vec,Alphabet* alphabet,
                          int number_of_patterns,int is_DIC_pattern,
                          int is_CDIC_pattern,
                          struct lemma_node* root,struct locate_parameters* parameters) {
 struct string_hash* tokens=parameters->tokens;
+char name[FILENAME_MAX];
+remove_path(dic_name,name);
+char cache_name[FILENAME_MAX];
+struct dic_cache_header key;
+struct dic_cache_builder* builder=NULL;
+if (parameters->useDicCache && strlen(dic_name)+strlen(".cache")<FILENAME_MAX
+    && get_dic_cache_key(dic_name,alphabet,tokens,parameters->tokenization_policy,&key)) {
+   strcpy(cache_name,dic_name);
+   strcat(cache_name,".cache");
+   if (load_dic_for_locate_from_cache(cache_name,&key,alphabet,number_of_patterns,is_DIC_pattern,
+                                      is_CDIC_pattern,root,parameters)) {
+      u_printf("%s: loaded from cache\n",name);
+      return;
+   }
+   builder=new_dic_cache_builder();
+}
 U_FILE* f;
 f=u_fopen(vec,dic_name,U_READ);
 if (f==NULL) {
+   free_dic_cache_builder(builder);
    return;
 }
 /* We parse all the lines */
 int lines=0;
-char name[FILENAME_MAX];
-remove_path(dic_name,name);
 Ustring* line=new_Ustring(DIC_LINE_SIZE);
+vector_int* token_numbers=new_vector_int(16);
+int compound_tokens[MAX_TOKEN_IN_A_COMPOUND_WORD];
 
 Abstract_allocator load_dic_recycle_abstract_allocator=NULL;
 load_dic_recycle_abstract_allocator=create_abstract_allocator("load_dic_for_locate",
@@ -994,74 +1661,42 @@ while (EOF!=readline(line,f)) {
       error("Invalid dictionary line in load_dic_for_locate\n");
       continue;
    }
-   /* We add the inflected form to the list of forms associated to the lemma.
-    * This will be used to replace patterns like "<be>" by the actual list of
-    * forms that can be matched by it, for optimization reasons */
-   add_inflected_form_for_lemma(entry->inflected,entry->lemma,root);
    /* We get the list of all tokens that can be matched by the inflected form of this
     * this entry, with regards to case variations (see the "extended" example above). */
    struct list_int* ptr=get_token_list_for_sequence(entry->inflected,alphabet,tokens,load_dic_list_int_recycle_abstract_allocator);
-   /* We save the list pointer to free it later */
-   struct list_int* ptr_copy=ptr;
-   /* Here, we will deal with all simple words */
-   while (ptr!=NULL) {
-      int i=ptr->n;
-      /* If the current token can be matched, then it can be recognized by the "<DIC>" pattern */
-      parameters->token_control[i]=(unsigned char)(get_control_byte(tokens->value[i],alphabet,NULL,parameters->tokenization_policy)|DIC_TOKEN_BIT_MASK);
-      if (number_of_patterns) {
-         /* We look for matching patterns only if there are some */
-         struct list_pointer* list=get_matching_patterns(entry,parameters->pattern_tree_root);
-         if (list!=NULL) {
-            /* If we have some patterns to add */
-            if (parameters->matching_patterns[i]==NULL) {
-               /* We allocate the pattern bit array, if needed */
-               parameters->matching_patterns[i]=new_bit_array(number_of_patterns,ONE_BIT);
-            }
-            struct list_pointer* tmp=list;
-            while (tmp!=NULL) {
-               /* Then we add all the pattern numbers to the bit array */
-               set_value(parameters->matching_patterns[i],((struct constraint_list*)(tmp->pointer))->pattern_number,1);
-               tmp=tmp->next;
-            }
-            /* Finally, we free the constraint list */
-            free_list_pointer(list);
-         }
-      }
-      ptr=ptr->next;
+   token_numbers->nbelems=0;
+   for (struct list_int* tmp=ptr;tmp!=NULL;tmp=tmp->next) {
+      vector_int_add(token_numbers,tmp->n);
    }
-   /* Finally, we free the token list */
-   free_list_int(ptr_copy,load_dic_list_int_recycle_abstract_allocator);
-   if (!is_a_simple_word(entry->inflected,parameters->tokenization_policy,alphabet)) {
-      /* If the inflected form is a compound word */
-      if (is_DIC_pattern || is_CDIC_pattern) {
-         /* If the .fst2 contains "<DIC>" and/or "<CDIC>", then we
-          * must note that all compound words can be matched by them */
-         add_compound_word_with_no_pattern(entry->inflected,alphabet,tokens,parameters->DLC_tree,parameters->tokenization_policy);
-      }
-      if (number_of_patterns) {
-         /* We look for matching patterns only if there are some */
-         /* We look if the compound word can be matched by some patterns */
-         struct list_pointer* list=get_matching_patterns(entry,parameters->pattern_tree_root);
-         struct list_pointer* tmp=list;
-         while (tmp!=NULL) {
-            /* If the word is matched by at least one pattern, we store it. */
-            int pattern_number=((struct constraint_list*)(tmp->pointer))->pattern_number;
-            add_compound_word_with_pattern(entry->inflected,pattern_number,alphabet,tokens,parameters->DLC_tree,parameters->tokenization_policy);
-            tmp=tmp->next;
-         }
-         free_list_pointer(list);
-      }
+   free_list_int(ptr,load_dic_list_int_recycle_abstract_allocator);
+   /* If the inflected form is a compound word, we tokenize it, unless it
+    * is useless because the grammar cannot match compound words */
+   int* compound=NULL;
+   if ((builder!=NULL || is_DIC_pattern || is_CDIC_pattern || number_of_patterns)
+       && !is_a_simple_word(entry->inflected,parameters->tokenization_policy,alphabet)) {
+      tokenize_compound_word(entry->inflected,compound_tokens,alphabet,tokens,parameters->tokenization_policy);
+      compound=compound_tokens;
+   }
+   add_dic_entry_for_locate(entry,token_numbers->tab,token_numbers->nbelems,compound,alphabet,
+                            number_of_patterns,is_DIC_pattern,is_CDIC_pattern,root,parameters);
+   if (builder!=NULL) {
+      add_dic_cache_entry(builder,entry,token_numbers->tab,token_numbers->nbelems,compound);
    }
    free_dela_entry(entry,load_dic_recycle_abstract_allocator);
 }
 
 close_abstract_allocator(load_dic_recycle_abstract_allocator);
 close_abstract_allocator(load_dic_list_int_recycle_abstract_allocator);
+free_vector_int(token_numbers);
 free_Ustring(line);
 if (lines>10000) {
    u_printf("\n");
 }
 u_fclose(f);
+if (builder!=NULL) {
+   save_dic_cache(cache_name,&key,builder);
+   free_dic_cache_builder(builder);
+}
 }
 
 
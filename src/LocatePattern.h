@@ -276,6 +276,32 @@ struct locate_parameters {
    /* The match list associated to the current Locate operation */
    struct match_list* match_list;
 
+   /* In ALL_MATCHES mode, match_list is sorted by (start,end). This array
+    * holds the same elements in the same order, so that we can find where a
+    * new match goes with a binary search instead of walking the list. It is
+    * rebuilt by save_matches, which goes through the whole list anyway */
+   struct match_list** match_index;
+   int match_index_size;
+   int match_index_capacity;
+
+   /* When Locate is sharded across worker threads, a worker does not select
+    * and save its matches itself: it records them, together with the origin
+    * they were found from, so that the main thread can replay them in text
+    * order. Both vectors are NULL in single thread mode. */
+   vector_ptr* recorded_matches;
+   vector_int* recorded_origins;
+
+   /* Workers do not report errors either: the sequential loop gives up on
+    * the max_errors-th error, and a match cached from an origin with an error
+    * may hide the errors of later origins, so that errors can only be handled
+    * in text order. The first error found by a worker cancels its exploration
+    * and is noted in error_origin and in the shared_error_count of all
+    * workers. The workers then stop, and the main thread finishes the text
+    * alone from the first origin they did not fully explore.
+    * shared_error_count is NULL in single thread mode. */
+   int error_origin;
+   long* shared_error_count;
+
 
    /* The total number of outputs. It may be different from the number
     * of matches if ambiguous outputs are allowed. */
@@ -309,6 +335,10 @@ struct locate_parameters {
     * the 'morpho_dic' array */
    struct string_hash* morpho_dic_index;
 
+   /* The lowercase variants of each char, used to follow transitions of
+    * indexed states in the morphological mode dictionaries */
+   struct bin_case_variants* morpho_case_variants;
+
    /* The DELAF entry variables filled in morphological mode */
    struct dic_variable* dic_variables;
 
@@ -329,6 +359,9 @@ struct locate_parameters {
    /* to known if we must use Locate Cache feature */
    int useLocateCache;
 
+   /* to known if we must load the dlf and dlc from their cache files, and build them if needed */
+   int useDicCache;
+
 
    struct Token_error_ctx token_error_ctx;
 
@@ -363,7 +396,7 @@ struct locate_parameters {
    struct match_list* match_cache_first;
    struct match_list* match_cache_last;
    /* This is the cache array to store matches */
-   LocateCache* match_cache;
+   struct locate_cache_table* match_cache;
    /* This vector is used to store results obtained from cache consultation */
    vector_ptr* cached_match_vector;
 
@@ -376,6 +409,12 @@ struct locate_parameters {
    t_fnc_locate_trace_step fnc_locate_trace_step;
    void*private_param_locate_trace;
 
+   /* Counters of the Locate profiler, NULL when profiling is off */
+   struct locate_profile* profile;
+
+   /* Length of each token, used to save the matches */
+   int* token_length;
+
    const char* token_filename;
    unichar* recyclable_unichar_buffer;
    unsigned int size_recyclable_unichar_buffer;
@@ -433,7 +472,9 @@ int locate_pattern(const char*,const char*,const char*,const char*,const char*,c
                    SpacePolicy,int,const char*,AmbiguousOutputPolicy,
                    VariableErrorPolicy,int,int,int,int,
                    int stack_max, int max_matches_at_token_pos,int max_matches_per_subgraph,int max_errors,
-                   char*,int,int,int,char* const [],vector_ptr*,const char* elg_extensions_path = NULL,const char* enter_pos = NULL);
+                   char*,int,int,int,char* const [],vector_ptr*,const char* elg_extensions_path = NULL,const char* enter_pos = NULL,
+                   int n_threads = 1,int useDicCache = 1,int profile = 0,
+                   int binary_concord = 0);
 
 void numerote_tags(Fst2*,struct string_hash*,int*,struct string_hash*,Alphabet*,int*,int*,int*,int,struct locate_parameters*);
 unsigned char get_control_byte(const unichar*,const Alphabet*,struct string_hash*,TokenizationPolicy);
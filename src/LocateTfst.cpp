@@ -51,6 +51,8 @@ const char* usage_LocateTfst =
   "  -g tilde/--negation_operator=tilde: uses tilde as negation operator (default)\n"
   "  --single_tags_only: skips all results that match more than one text tag\n"
   "  --dont_match_word_boundaries: allows 'air'+'port' in a graph to match 'airport' in the TFST\n"
+  "  -j N/--threads=N: explores the sentence automata with N threads (default: 1). The\n"
+  "                    concordance is the same as with a single thread. Ignored if -n is used\n"
   "\n"
   "Search limit options:\n"
   "  -l/--all: looks for all matches (default)\n"
@@ -99,7 +101,7 @@ static void usage() {
 }
 
 
-const char* optstring_LocateTfst=":t:a:Kln:SLAIMRXYZbzVhg:k:q:v:";
+const char* optstring_LocateTfst=":t:a:Kln:SLAIMRXYZbzVhg:k:q:v:j:";
 const struct option_TS lopts_LocateTfst[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -123,6 +125,7 @@ const struct option_TS lopts_LocateTfst[]= {
   {"help",no_argument_TS,NULL,'h'},
   {"negation_operator",required_argument_TS,NULL,'g'},
   {"variable",required_argument_TS,NULL,'v'},
+  {"threads",required_argument_TS,NULL,'j'},
   {"tagging",no_argument_TS,NULL,1},
   {"single_tags_only",no_argument_TS,NULL,2},
   {"dont_match_word_boundaries", no_argument_TS, NULL,3},
@@ -155,6 +158,7 @@ OutputPolicy output_policy=IGNORE_OUTPUTS;
 AmbiguousOutputPolicy ambiguous_output_policy=ALLOW_AMBIGUOUS_OUTPUTS;
 VariableErrorPolicy variable_error_policy=IGNORE_VARIABLE_ERRORS;
 int search_limit=NO_MATCH_LIMIT;
+int n_threads=1;
 char foo;
 vector_ptr* injected=new_vector_ptr();
 bool only_verify_arguments = false;
@@ -202,6 +206,13 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_LocateTfst,lopts_LocateT
                 return USAGE_ERROR_CODE;
              }
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                free_vector_ptr(injected);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'S': match_policy=SHORTEST_MATCHES; break;
    case 'L': match_policy=LONGEST_MATCHES; break;
    case 'A': match_policy=ALL_MATCHES; break;
@@ -299,7 +310,8 @@ int OK=locate_tfst(text,
                    injected,
                    tagging,
                    single_tags_only,
-                   match_word_boundaries);
+                   match_word_boundaries,
+                   n_threads);
 
 free_vector_ptr(injected);
 
@@ -29,6 +29,7 @@
 #include "Korean.h"
 #include "Contexts.h"
 #include "List_int.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -48,6 +49,11 @@ namespace unitex {
  * a combinatorial explosion */
 #define MAX_VISITS_PER_TFST_STATE 128
 
+/* When LocateTfst runs with several threads, the sentences are given to
+ * the workers by rounds of LOCATE_TFST_SENTENCES_PER_WORKER sentences per
+ * worker, after which the main thread saves their matches in sentence order */
+#define LOCATE_TFST_SENTENCES_PER_WORKER 64
+
 
 void explore_tfst(int* visits,Tfst* tfst,int current_state_in_tfst,
                   int current_state_in_fst2,int graph_depth,
@@ -73,6 +79,11 @@ int real_match_between_text_and_grammar_tags(Tfst* tfst,TfstTag* text_tag,Fst2Ta
 struct pattern* tokenize_grammar_tag(unichar* tag,int *negation,int tilde_negation_operator);
 int is_space_on_the_left_in_tfst(Tfst* tfst,TfstTag* tag);
 int morphological_filter_is_ok(const unichar* content,Fst2Tag grammar_tag,const struct locate_tfst_infos* infos);
+static void locate_tfst_in_sentence(struct locate_tfst_infos* infos,int n,int tilde_negation_operator);
+static void locate_tfst_with_workers(struct locate_tfst_infos* infos,int n_threads,
+                                     const VersatileEncodingConfig* vec,const char* text,
+                                     int is_korean,vector_ptr* injected_vars,
+                                     int tilde_negation_operator);
 
 
 /**
@@ -115,7 +126,7 @@ int locate_tfst(const char* text,const char* grammar,const char* alphabet,const
                   OutputPolicy output_policy,AmbiguousOutputPolicy ambiguous_output_policy,
                   VariableErrorPolicy variable_error_policy,int search_limit,int is_korean,
                   int tilde_negation_operator,vector_ptr* injected_vars,int tagging,
-                  int single_tags_only,int match_word_boundaries) {
+                  int single_tags_only,int match_word_boundaries,int n_threads) {
 Tfst* tfst=open_text_automaton(vec,text);
 if (tfst==NULL) {
     return 0;
@@ -212,34 +223,16 @@ init_Korean_stuffs(&infos,is_korean);
 infos.cache=new_LocateTfstTagMatchingCache(tfst->N,infos.fst2->number_of_tags);
 infos.contexts=compute_contexts(infos.fst2);
 /* We launch the matching for each sentence */
-for (int i=1;i<=tfst->N && infos.number_of_matches!=infos.search_limit;i++) {
-   if (i%100==0) {
-        u_printf("\rSentence %d/%d...",i,tfst->N);
-    }
-   load_sentence(tfst,i);
-    compute_token_contents(tfst);
-    if (infos.korean!=NULL) {
-       compute_jamo_tfst_tags(&infos);
-    }
-    infos.matches=NULL;
-    prepare_cache_for_new_sentence(infos.cache,tfst->tags->nbelems);
-#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
-    int* visits=(int*)malloc(sizeof(int)*(1+tfst->automaton->number_of_states));
-#else
-    int visits[tfst->automaton->number_of_states];
-#endif
-    /* Within a sentence graph, we try to match from any state */
-    for (int j=0;j<tfst->automaton->number_of_states;j++) {
-       for (int k=0;k<tfst->automaton->number_of_states;k++) {
-          visits[k]=0;
-       }
-       explore_tfst(visits,tfst,j,infos.fst2->initial_states[1],0,NULL,NULL,&infos,-1,-1,NULL,NULL,NULL,tilde_negation_operator);
+if (n_threads>1 && infos.search_limit==NO_MATCH_LIMIT && tfst->N>1) {
+    locate_tfst_with_workers(&infos,n_threads,vec,text,is_korean,injected_vars,tilde_negation_operator);
+} else {
+    for (int i=1;i<=tfst->N && infos.number_of_matches!=infos.search_limit;i++) {
+        if (i%100==0) {
+            u_printf("\rSentence %d/%d...",i,tfst->N);
+        }
+        locate_tfst_in_sentence(&infos,i,tilde_negation_operator);
+        save_tfst_matches(&infos);
     }
-#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
-    free(visits);
-#endif
-    save_tfst_matches(&infos);
-    clear_dic_variable_list(&(infos.dic_variables));
 }
 u_printf("\rDone.                                    \n");
 /* We save some infos */
@@ -286,6 +279,155 @@ return 1;
 }
 
 
+/**
+ * Applies the grammar to the sentence #n of the text automaton. The matches
+ * are left in infos->matches, so that the caller can save them.
+ */
+static void locate_tfst_in_sentence(struct locate_tfst_infos* infos,int n,int tilde_negation_operator) {
+Tfst* tfst=infos->tfst;
+load_sentence(tfst,n);
+compute_token_contents(tfst);
+if (infos->korean!=NULL) {
+    compute_jamo_tfst_tags(infos);
+}
+infos->current_sentence=n;
+infos->matches=NULL;
+prepare_cache_for_new_sentence(infos->cache,tfst->tags->nbelems);
+#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
+int* visits=(int*)malloc(sizeof(int)*(1+tfst->automaton->number_of_states));
+#else
+int visits[tfst->automaton->number_of_states];
+#endif
+/* Within a sentence graph, we try to match from any state */
+for (int j=0;j<tfst->automaton->number_of_states;j++) {
+    for (int k=0;k<tfst->automaton->number_of_states;k++) {
+        visits[k]=0;
+    }
+    explore_tfst(visits,tfst,j,infos->fst2->initial_states[1],0,NULL,NULL,infos,-1,-1,NULL,NULL,NULL,tilde_negation_operator);
+}
+#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
+free(visits);
+#endif
+clear_dic_variable_list(&(infos->dic_variables));
+}
+
+
+/**
+ * The sentences of a round, shared by all the workers. Each worker takes
+ * the next unprocessed sentence until there is none left, and puts its
+ * matches in 'matches'.
+ */
+struct locate_tfst_round {
+    int first_sentence;
+    int n_sentences;
+    int next_sentence;
+    struct tfst_simple_match_list** matches;
+    SYNC_Mutex_OBJECT mutex;
+};
+
+
+/**
+ * A worker owns its own copy of the text automaton, so that it can load
+ * sentences independently, and everything that is modified while exploring
+ * a sentence. The grammar, the alphabet and the contexts are shared.
+ */
+struct locate_tfst_worker {
+    struct locate_tfst_infos infos;
+    struct locate_tfst_round* round;
+    int tilde_negation_operator;
+};
+
+
+static void ABSTRACT_CALLBACK_UNITEX locate_tfst_worker_thread(void* private_data,unsigned int) {
+struct locate_tfst_worker* w=(struct locate_tfst_worker*)private_data;
+for (;;) {
+    SyncGetMutex(w->round->mutex);
+    int k=w->round->next_sentence;
+    if (k<w->round->n_sentences) {
+        (w->round->next_sentence)++;
+    }
+    SyncReleaseMutex(w->round->mutex);
+    if (k>=w->round->n_sentences) {
+        return;
+    }
+    locate_tfst_in_sentence(&(w->infos),w->round->first_sentence+k,w->tilde_negation_operator);
+    w->round->matches[k]=w->infos.matches;
+    w->infos.matches=NULL;
+}
+}
+
+
+/**
+ * Applies the grammar to all the sentences with n_threads workers. The matches
+ * of each round are saved by the main thread in sentence order, so that the
+ * concordance is the same as with a single thread.
+ */
+static void locate_tfst_with_workers(struct locate_tfst_infos* infos,int n_threads,
+                                     const VersatileEncodingConfig* vec,const char* text,
+                                     int is_korean,vector_ptr* injected_vars,
+                                     int tilde_negation_operator) {
+int N=infos->tfst->N;
+int max_sentences=n_threads*LOCATE_TFST_SENTENCES_PER_WORKER;
+struct locate_tfst_round round;
+round.matches=(struct tfst_simple_match_list**)malloc(max_sentences*sizeof(struct tfst_simple_match_list*));
+struct locate_tfst_worker* w=(struct locate_tfst_worker*)malloc(n_threads*sizeof(struct locate_tfst_worker));
+void** w_ptr=(void**)malloc(n_threads*sizeof(void*));
+if (round.matches==NULL || w==NULL || w_ptr==NULL) {
+    fatal_alloc_error("locate_tfst_with_workers");
+}
+round.mutex=SyncBuildMutex();
+for (int i=0;i<n_threads;i++) {
+    memcpy(&(w[i].infos),infos,sizeof(struct locate_tfst_infos));
+    w[i].infos.tfst=open_text_automaton(vec,text);
+    if (w[i].infos.tfst==NULL) {
+        fatal_error("Cannot open %s\n",text);
+    }
+    w[i].infos.output=NULL;
+    w[i].infos.matches=NULL;
+    w[i].infos.input_variables=new_Variables(infos->fst2->input_variables);
+    w[i].infos.output_variables=new_OutputVariables(infos->fst2->output_variables,NULL,injected_vars);
+    w[i].infos.dic_variables=NULL;
+    w[i].infos.cache=new_LocateTfstTagMatchingCache(N,infos->fst2->number_of_tags);
+    init_Korean_stuffs(&(w[i].infos),is_korean);
+#ifdef REGEX_FACADE_ENGINE
+    w[i].infos.filters=new_FilterSet(infos->fst2,infos->alphabet);
+    if (w[i].infos.filters==NULL) {
+        fatal_error("Cannot compile filter(s)\n");
+    }
+#endif
+    w[i].round=&round;
+    w[i].tilde_negation_operator=tilde_negation_operator;
+    w_ptr[i]=&(w[i]);
+}
+for (int first=1;first<=N;first=first+max_sentences) {
+    round.first_sentence=first;
+    round.n_sentences=(N-first+1<max_sentences)?(N-first+1):max_sentences;
+    round.next_sentence=0;
+    SyncRunThreads((unsigned int)n_threads,locate_tfst_worker_thread,w_ptr);
+    for (int k=0;k<round.n_sentences;k++) {
+        infos->current_sentence=first+k;
+        infos->matches=round.matches[k];
+        save_tfst_matches(infos);
+    }
+    u_printf("\rSentence %d/%d...",first+round.n_sentences-1,N);
+}
+for (int i=0;i<n_threads;i++) {
+#ifdef REGEX_FACADE_ENGINE
+    free_FilterSet(w[i].infos.filters);
+#endif
+    free_Variables(w[i].infos.input_variables);
+    free_OutputVariables(w[i].infos.output_variables);
+    free_Korean_stuffs(&(w[i].infos));
+    free_LocateTfstTagMatchingCache(w[i].infos.cache);
+    close_text_automaton(w[i].infos.tfst);
+}
+SyncDeleteMutex(round.mutex);
+free(round.matches);
+free(w_ptr);
+free(w);
+}
+
+
 /**
  * If we must deal with a Korean .tfst, we compute the jamo version of all fst2 tags.
  */
@@ -1284,9 +1426,11 @@ if (tag[l-1]!='>') {
 }
 if (tag[1]=='!') {(*negation)=1;}
 else {(*negation)=0;}
-tag[l-1]='\0';
-struct pattern* pattern=build_pattern(&(tag[1+(*negation)]),NULL,tilde_negation_operator);
-tag[l-1]='>';
+/* We work on a copy, because the tag belongs to the grammar, which may be
+ * shared by several threads */
+unichar* content=u_strndup(&(tag[1+(*negation)]),l-2-(*negation));
+struct pattern* pattern=build_pattern(content,NULL,tilde_negation_operator);
+free(content);
 return pattern;
 }
 
@@ -104,6 +104,10 @@ struct locate_tfst_infos {
 
     struct tfst_simple_match_list* matches;
 
+    /* The sentence the matches come from. With several threads, it is not
+     * the one loaded in 'tfst' when the main thread saves the matches */
+    int current_sentence;
+
     /* Stuffs for Korean */
     Korean* korean;
     int n_jamo_fst2_tags;
@@ -122,7 +126,7 @@ struct locate_tfst_infos {
 
 
 int locate_tfst(const char*,const char*,const char*,const char*, const VersatileEncodingConfig*,MatchPolicy,OutputPolicy,AmbiguousOutputPolicy,
-                VariableErrorPolicy,int,int,int,vector_ptr*,int,int,int);
+                VariableErrorPolicy,int,int,int,vector_ptr*,int,int,int,int n_threads = 1);
 
 } // namespace unitex
 
@@ -33,6 +33,8 @@
 #include "LocatePattern.h"
 #include "LocateTrace.h"
 #include "LocateTracePlugCallback.h"
+#include "Error.h"
+#include "base/time/time.h"
 
 
 
@@ -76,6 +78,329 @@ void close_locate_trace(struct locate_parameters* p,t_fnc_locate_trace_step /*fn
 }
 
 
+/**
+ * Returns the current time in microseconds.
+ */
+static int64_t profile_clock() {
+struct timeval tv;
+time_now(&tv,NULL);
+return ((int64_t)tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+
+/**
+ * Allocates a profile with all counters set to 0.
+ */
+struct locate_profile* new_locate_profile(Fst2* fst2) {
+struct locate_profile* profile=(struct locate_profile*)malloc(sizeof(struct locate_profile));
+if (profile==NULL) {
+   fatal_alloc_error("new_locate_profile");
+}
+profile->fst2=fst2;
+profile->states=(struct locate_profile_state*)calloc(fst2->number_of_states,sizeof(struct locate_profile_state));
+if (profile->states==NULL) {
+   fatal_alloc_error("new_locate_profile");
+}
+profile->successes=0;
+profile->child_time=0;
+return profile;
+}
+
+
+void free_locate_profile(struct locate_profile* profile) {
+if (profile==NULL) return;
+for (int i=0;i<profile->fst2->number_of_states;i++) {
+   free(profile->states[i].calls);
+}
+free(profile->states);
+free(profile);
+}
+
+
+/**
+ * Returns the counters of the calls to the given graph from the given state,
+ * creating them if needed. A state calls very few graphs, so that a linear
+ * search is enough.
+ */
+static struct locate_profile_call* get_profile_call(struct locate_profile_state* state,int graph_number) {
+for (int i=0;i<state->n_calls;i++) {
+   if (state->calls[i].graph_number==graph_number) {
+      return state->calls+i;
+   }
+}
+struct locate_profile_call* calls=(struct locate_profile_call*)realloc(state->calls,
+                             (state->n_calls+1)*sizeof(struct locate_profile_call));
+if (calls==NULL) {
+   fatal_alloc_error("get_profile_call");
+}
+state->calls=calls;
+struct locate_profile_call* call=state->calls+(state->n_calls++);
+call->graph_number=graph_number;
+call->calls=0;
+call->failures=0;
+call->time=0;
+return call;
+}
+
+
+/**
+ * Adds the counters of 'src' to the ones of 'dest'. Both profiles must have
+ * been built for the same fst2.
+ */
+void merge_locate_profile(struct locate_profile* dest,const struct locate_profile* src) {
+for (int i=0;i<src->fst2->number_of_states;i++) {
+   struct locate_profile_state* d=dest->states+i;
+   const struct locate_profile_state* s=src->states+i;
+   d->visits+=s->visits;
+   d->failures+=s->failures;
+   d->self_time+=s->self_time;
+   for (int j=0;j<s->n_calls;j++) {
+      struct locate_profile_call* call=get_profile_call(d,s->calls[j].graph_number);
+      call->calls+=s->calls[j].calls;
+      call->failures+=s->calls[j].failures;
+      call->time+=s->calls[j].time;
+   }
+}
+}
+
+
+/**
+ * Starts the visit of a state. 'is_final' is non zero if the state is final,
+ * which is a success for the current graph.
+ */
+void begin_profiled_visit(struct locate_profile* profile,struct locate_profile_visit* visit,int is_final) {
+visit->successes=profile->successes;
+if (is_final) {
+   profile->successes++;
+}
+visit->child_time=profile->child_time;
+profile->child_time=0;
+visit->start=profile_clock();
+}
+
+
+/**
+ * Ends the visit of the given state, started with begin_profiled_visit.
+ */
+void end_profiled_visit(struct locate_profile* profile,const struct locate_profile_visit* visit,int state) {
+int64_t elapsed=profile_clock()-visit->start;
+struct locate_profile_state* s=profile->states+state;
+s->visits++;
+if (profile->successes==visit->successes) {
+   s->failures++;
+}
+s->self_time+=elapsed-profile->child_time;
+profile->child_time=visit->child_time+elapsed;
+}
+
+
+/**
+ * Starts the exploration of a new graph: a subgraph call or an entry in the
+ * morphological mode. The successes of this graph must not be seen as
+ * successes of the visits of the caller.
+ */
+void begin_profiled_frame(struct locate_profile* profile,struct locate_profile_visit* frame) {
+frame->successes=profile->successes;
+profile->successes=0;
+frame->start=profile_clock();
+}
+
+
+void end_profiled_frame(struct locate_profile* profile,const struct locate_profile_visit* frame) {
+profile->successes=frame->successes;
+}
+
+
+/**
+ * Ends a frame started for the call of 'graph_number' from 'state'.
+ * 'failed' is non zero if the subgraph did not match anything.
+ */
+void end_profiled_call(struct locate_profile* profile,const struct locate_profile_visit* frame,int state,int graph_number,int failed) {
+int64_t elapsed=profile_clock()-frame->start;
+end_profiled_frame(profile,frame);
+struct locate_profile_call* call=get_profile_call(profile->states+state,graph_number);
+call->calls++;
+if (failed) {
+   call->failures++;
+}
+call->time+=elapsed;
+}
+
+
+/**
+ * A line of the profile report. 'state' is the state number in its graph, as
+ * displayed by the graph editor debug mode, and 'callee' is -1 for states and graphs.
+ */
+struct profile_line {
+   int graph;
+   int state;
+   int callee;
+   unsigned long n;
+   unsigned long failures;
+   int64_t time;
+};
+
+
+static int compare_profile_lines(const void* a,const void* b) {
+const struct profile_line* x=(const struct profile_line*)a;
+const struct profile_line* y=(const struct profile_line*)b;
+if (x->time!=y->time) return (x->time>y->time) ? -1 : 1;
+if (x->n!=y->n) return (x->n>y->n) ? -1 : 1;
+if (x->graph!=y->graph) return x->graph-y->graph;
+if (x->state!=y->state) return x->state-y->state;
+return x->callee-y->callee;
+}
+
+
+static void add_profile_line(struct profile_line** lines,int* n,int* size,int graph,int state,int callee,
+                             unsigned long count,unsigned long failures,int64_t time) {
+if (*n==*size) {
+   *size=(*size==0) ? 256 : 2*(*size);
+   *lines=(struct profile_line*)realloc(*lines,(*size)*sizeof(struct profile_line));
+   if (*lines==NULL) {
+      fatal_alloc_error("add_profile_line");
+   }
+}
+struct profile_line* l=(*lines)+((*n)++);
+l->graph=graph;
+l->state=state;
+l->callee=callee;
+l->n=count;
+l->failures=failures;
+l->time=time;
+}
+
+
+static void write_profile_lines(U_FILE* f,const Fst2* fst2,const char* title,const char* header,
+                                const struct profile_line* lines,int n) {
+char tmp[128];
+u_fprintf(f,"\n%s\n%s\n",title,header);
+for (int i=0;i<n;i++) {
+   const struct profile_line* l=lines+i;
+   sprintf(tmp,"%12.3f %10lu %10lu  ",l->time/1000.,l->n,l->failures);
+   u_fprintf(f,"%s",tmp);
+   if (l->state!=-1) {
+      u_fprintf(f,"%6d  ",l->state);
+   }
+   u_fprintf(f,"%S",fst2->graph_names[l->graph]);
+   if (l->callee!=-1) {
+      u_fprintf(f," -> %S",fst2->graph_names[l->callee]);
+   }
+   u_fprintf(f,"\n");
+}
+}
+
+
+static void write_json_string(U_FILE* f,const unichar* s) {
+unichar* tmp=(unichar*)malloc((6*u_strlen(s)+1)*sizeof(unichar));
+if (tmp==NULL) {
+   fatal_alloc_error("write_json_string");
+}
+u_jsonize(s,tmp);
+u_fprintf(f,"\"%S\"",tmp);
+free(tmp);
+}
+
+
+static void write_json_profile_lines(U_FILE* f,const Fst2* fst2,const char* name,const char* n_name,
+                                     const struct profile_line* lines,int n,int last) {
+char tmp[128];
+u_fprintf(f,"  \"%s\": [",name);
+for (int i=0;i<n;i++) {
+   const struct profile_line* l=lines+i;
+   u_fprintf(f,"%s\n    {\"graph\": ",(i==0)?"":",");
+   write_json_string(f,fst2->graph_names[l->graph]);
+   if (l->state!=-1) {
+      u_fprintf(f,", \"state\": %d",l->state);
+   }
+   if (l->callee!=-1) {
+      u_fprintf(f,", \"subgraph\": ");
+      write_json_string(f,fst2->graph_names[l->callee]);
+   }
+   sprintf(tmp,", \"%s\": %lu, \"failed\": %lu, \"time_us\": %lld}",n_name,l->n,l->failures,(long long)l->time);
+   u_fprintf(f,"%s",tmp);
+}
+u_fprintf(f,"\n  ]%s\n",last?"":",");
+}
+
+
+/**
+ * Saves the profile in a text report sorted by decreasing time, and in UTF8 JSON.
+ * Graphs and states are sorted by self time, subgraph calls by total time.
+ * Returns 0 if a file cannot be created.
+ */
+int save_locate_profile(const struct locate_profile* profile,const VersatileEncodingConfig* vec,const char* txt,const char* json) {
+const Fst2* fst2=profile->fst2;
+struct profile_line* graphs=NULL;
+struct profile_line* states=NULL;
+struct profile_line* calls=NULL;
+int n_graphs=0,size_graphs=0,n_states=0,size_states=0,n_calls=0,size_calls=0;
+unsigned long total_visits=0,total_failures=0;
+int64_t total_time=0;
+for (int g=1;g<=fst2->number_of_graphs;g++) {
+   unsigned long visits=0,failures=0;
+   int64_t time=0;
+   for (int i=0;i<fst2->number_of_states_per_graphs[g];i++) {
+      int n=fst2->initial_states[g]+i;
+      const struct locate_profile_state* s=profile->states+n;
+      if (s->visits!=0) {
+         add_profile_line(&states,&n_states,&size_states,g,i,-1,s->visits,s->failures,s->self_time);
+         visits+=s->visits;
+         failures+=s->failures;
+         time+=s->self_time;
+      }
+      for (int j=0;j<s->n_calls;j++) {
+         add_profile_line(&calls,&n_calls,&size_calls,g,i,s->calls[j].graph_number,
+                          s->calls[j].calls,s->calls[j].failures,s->calls[j].time);
+      }
+   }
+   if (visits!=0) {
+      add_profile_line(&graphs,&n_graphs,&size_graphs,g,-1,-1,visits,failures,time);
+      total_visits+=visits;
+      total_failures+=failures;
+      total_time+=time;
+   }
+}
+qsort(graphs,n_graphs,sizeof(struct profile_line),compare_profile_lines);
+qsort(states,n_states,sizeof(struct profile_line),compare_profile_lines);
+qsort(calls,n_calls,sizeof(struct profile_line),compare_profile_lines);
+int ok=1;
+char tmp[128];
+U_FILE* f=u_fopen(vec,txt,U_WRITE);
+if (f==NULL) {
+   error("Cannot create %s\n",txt);
+   ok=0;
+} else {
+   sprintf(tmp,"%lu visits, %lu failed, %.3f ms\n",total_visits,total_failures,total_time/1000.);
+   u_fprintf(f,"%s",tmp);
+   write_profile_lines(f,fst2,"Graphs by self time:",
+                       "   time (ms)     visits     failed  graph",graphs,n_graphs);
+   write_profile_lines(f,fst2,"States by self time:",
+                       "   time (ms)     visits     failed   state  graph",states,n_states);
+   write_profile_lines(f,fst2,"Subgraph calls by total time:",
+                       "   time (ms)      calls     failed   state  graph -> subgraph",calls,n_calls);
+   u_fclose(f);
+}
+f=u_fopen(UTF8,json,U_WRITE);
+if (f==NULL) {
+   error("Cannot create %s\n",json);
+   ok=0;
+} else {
+   sprintf(tmp,"{\n  \"visits\": %lu,\n  \"failed\": %lu,\n  \"time_us\": %lld,\n",
+           total_visits,total_failures,(long long)total_time);
+   u_fprintf(f,"%s",tmp);
+   write_json_profile_lines(f,fst2,"graphs","visits",graphs,n_graphs,0);
+   write_json_profile_lines(f,fst2,"states","visits",states,n_states,0);
+   write_json_profile_lines(f,fst2,"calls","calls",calls,n_calls,1);
+   u_fprintf(f,"}\n");
+   u_fclose(f);
+}
+free(graphs);
+free(states);
+free(calls);
+return ok;
+}
+
 } // namespace unitex
 
 
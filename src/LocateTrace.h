@@ -44,6 +44,65 @@ namespace unitex {
 void open_locate_trace(struct locate_parameters* p,t_fnc_locate_trace_step * p_fnc_locate_trace_step,void** p_private_param_locate_trace,char* const params[]);
 void close_locate_trace(struct locate_parameters* p,t_fnc_locate_trace_step fnc_locate_trace_step,void* private_param_locate_trace);
 
+
+/**
+ * Locate profiler. When p->profile is not NULL, each visit of a grammar state
+ * and each subgraph call is counted and timed. A visit is said to fail when
+ * the exploration that starts from it never reaches a final state, a $> or
+ * the end of a context of the same graph, which is the cost of backtracking.
+ * All times are in microseconds; the time of a state does not include the
+ * time spent in the states visited from it.
+ */
+struct locate_profile_call {
+   int graph_number;
+   unsigned long calls;
+   unsigned long failures;
+   int64_t time;
+};
+
+struct locate_profile_state {
+   unsigned long visits;
+   unsigned long failures;
+   int64_t self_time;
+   int n_calls;
+   struct locate_profile_call* calls;
+};
+
+struct locate_profile {
+   Fst2* fst2;
+   struct locate_profile_state* states;
+   /* Number of successes in the graph being explored */
+   unsigned long successes;
+   /* Time spent in the visits nested in the current one */
+   int64_t child_time;
+};
+
+/* What is saved on the stack for each visit, subgraph call or entry in the
+ * morphological mode */
+struct locate_profile_visit {
+   unsigned long successes;
+   int64_t child_time;
+   int64_t start;
+};
+
+struct locate_profile* new_locate_profile(Fst2*);
+void free_locate_profile(struct locate_profile*);
+void merge_locate_profile(struct locate_profile* dest,const struct locate_profile* src);
+void begin_profiled_visit(struct locate_profile*,struct locate_profile_visit*,int is_final);
+void end_profiled_visit(struct locate_profile*,const struct locate_profile_visit*,int state);
+void begin_profiled_frame(struct locate_profile*,struct locate_profile_visit*);
+void end_profiled_frame(struct locate_profile*,const struct locate_profile_visit*);
+void end_profiled_call(struct locate_profile*,const struct locate_profile_visit*,int state,int graph_number,int failed);
+
+/**
+ * Notes that the current graph has reached a $> or the end of a context.
+ */
+static inline void locate_profile_success(struct locate_profile* profile) {
+profile->successes++;
+}
+
+int save_locate_profile(const struct locate_profile*,const VersatileEncodingConfig*,const char* txt,const char* json);
+
 } // namespace unitex
 
 #endif
@@ -22,6 +22,8 @@
 #include "MorphologicalFilters.h"
 #include "Error.h"
 #include "DELA.h"
+#include "SyncTool.h"
+#include "base/compiler/intrinsic/atomic.h"    // unitex_atomic_*
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -33,10 +35,15 @@ namespace unitex {
 
 #define HASH_FILTERS_DIM 1024
 
+/* When the filter match index is built with several threads, the workers
+ * take the tokens by blocks of this size. It must be a multiple of 8, so that
+ * two workers never write in the same byte of a bit array */
+#define FILTER_TOKENS_PER_BLOCK 4096
+
 
 static void free_FilterSet(FilterSet*,int);
-static void w_extract_inflected(const unichar* tag_token, unichar_regex** inflected, size_t *buffer_size);
 static void split_filter(const unichar*,unichar*,char*);
+static void analyze_filter(MorphoFilter*,int);
 
 
 /**
@@ -75,6 +82,9 @@ if (filters->size>0) {
       filter_set->filter[i].content=NULL;
       filter_set->filter[i].options=NULL;
       filter_set->filter[i].matcher=NULL;
+      filter_set->filter[i].first_chars=NULL;
+      filter_set->filter[i].last_chars=NULL;
+      filter_set->filter[i].required_chars=NULL;
       /* We split the filter into a regular and the options, if any. For instance,
        * "<<able$>>_f_" will be turned into "able$" and "f". */
       split_filter(filters->value[i],filterContent,filterOptions);
@@ -139,6 +149,7 @@ if (filters->size>0) {
          free_FilterSet(filter_set,i);
          return NULL;
       }
+      analyze_filter(&(filter_set->filter[i]),regBasic);
    }
 } else {
    /* No need to allocate an array if there is no filter */
@@ -168,6 +179,9 @@ for (int i=0;i<n;i++) {
        regex_facade_regfree(filters->filter[i].matcher);
        free(filters->filter[i].matcher);
    }
+   free_bit_array(filters->filter[i].first_chars);
+   free_bit_array(filters->filter[i].last_chars);
+   free_bit_array(filters->filter[i].required_chars);
 }
 free(filters->filter);
 free(filters);
@@ -184,14 +198,123 @@ free_FilterSet(filters,filters->size);
 
 
 /**
- * Allocates, initializes and returns a structure that indicates for each token
- * which of the given filters it matches.
+ * Returns 0 if the given string cannot match the given filter, because it
+ * does not have the first, last or required characters of the filter; 1
+ * otherwise, in which case the matcher must be run to know.
+ */
+static int may_match_filter(const MorphoFilter* filter,const unichar* s) {
+if (filter->first_chars!=NULL && (s[0]=='\0' || !get_value(filter->first_chars,s[0]))) {
+   return 0;
+}
+int length=u_strlen(s);
+if (filter->last_chars!=NULL && (length==0 || !get_value(filter->last_chars,s[length-1]))) {
+   return 0;
+}
+if (filter->required_chars!=NULL) {
+   for (int i=0;i<length;i++) {
+      if (get_value(filter->required_chars,s[i])) {
+         return 1;
+      }
+   }
+   return 0;
+}
+return 1;
+}
+
+
+/**
+ * The tokens shared by the workers that build a filter match index. Each
+ * worker takes the next block of FILTER_TOKENS_PER_BLOCK tokens until there
+ * is none left.
  */
-FilterMatchIndex* new_FilterMatchIndex(FilterSet* filters,struct string_hash* tokens) {
-int i,k;
+struct filter_match_job {
+   FilterSet* filters;
+   struct string_hash* tokens;
+   FilterMatchIndex* index;
+   int next_token;
+   SYNC_Mutex_OBJECT mutex;
+};
+
+
+/**
+ * Returns the bit array of the filter k, allocating it if needed. Several
+ * workers may need it at the same time: only the first one publishes its
+ * array, the others free theirs.
+ */
+static struct bit_array* get_filter_bit_array(FilterMatchIndex* index,int k,int n_tokens) {
+struct bit_array* array=(struct bit_array*)unitex_atomic_load_ptr(&(index->matching_tokens[k]));
+if (array!=NULL) {
+   return array;
+}
+array=new_bit_array(n_tokens,ONE_BIT);
+if (unitex_atomic_cas_ptr(&(index->matching_tokens[k]),(struct bit_array*)NULL,array)) {
+   return array;
+}
+free_bit_array(array);
+return (struct bit_array*)unitex_atomic_load_ptr(&(index->matching_tokens[k]));
+}
+
+
+static void ABSTRACT_CALLBACK_UNITEX filter_match_worker_thread(void* private_data,unsigned int) {
+struct filter_match_job* job=(struct filter_match_job*)private_data;
+FilterSet* filters=job->filters;
+struct string_hash* tokens=job->tokens;
 unichar_regex *inflected=NULL;
 size_t inflected_buffer_size = 0;
-unichar* current_token;
+for (;;) {
+   SyncGetMutex(job->mutex);
+   int start=job->next_token;
+   job->next_token=job->next_token+FILTER_TOKENS_PER_BLOCK;
+   SyncReleaseMutex(job->mutex);
+   if (start>=tokens->size) {
+      break;
+   }
+   int end=(start+FILTER_TOKENS_PER_BLOCK<tokens->size)?start+FILTER_TOKENS_PER_BLOCK:tokens->size;
+   for (int i=start;i<end;i++) {
+      unichar* current_token=tokens->value[i];
+      struct dela_entry* entry=NULL;
+      const unichar* form=current_token;
+      if (current_token[0]=='{' && u_strcmp(current_token,"{S}")
+          && u_strcmp(current_token,"{STOP}")) {
+         /* If we have a tag token like "{today,.ADV}", we extract its inflected form */
+         entry=tokenize_tag_token(current_token,1);
+         if (entry==NULL) {
+            fatal_error("Invalid tag token in new_FilterMatchIndex\n");
+         }
+         form=entry->inflected;
+      }
+      int converted=0;
+      for (int k=0;k<filters->size;k++) {
+         if (!may_match_filter(&(filters->filter[k]),form)) {
+            continue;
+         }
+         if (!converted) {
+            /* We convert the unichar* form into a unichar_regex* string only
+             * for the first filter that may match it */
+            w_strcpy(&inflected,&inflected_buffer_size,form);
+            converted=1;
+         }
+         if (regex_facade_regexec(filters->filter[k].matcher,inflected,0,NULL,0)==0) {
+            /* If the current token matches the filter k, we mark it as being
+             * matched by the filter */
+            set_value(get_filter_bit_array(job->index,k,tokens->size),i,1);
+         }
+      }
+      free_dela_entry(entry);
+   }
+}
+if (inflected != NULL) {
+  free(inflected);
+}
+}
+
+
+/**
+ * Allocates, initializes and returns a structure that indicates for each token
+ * which of the given filters it matches. If n_threads>1, the tokens are
+ * processed by n_threads workers.
+ */
+FilterMatchIndex* new_FilterMatchIndex(FilterSet* filters,struct string_hash* tokens,int n_threads) {
 FilterMatchIndex* index=(FilterMatchIndex*)malloc(sizeof(FilterMatchIndex));
 if (index==NULL) {
    fatal_alloc_error("new_FilterMatchIndex");
@@ -203,40 +326,36 @@ if (filters->size>0) {
       fatal_alloc_error("new_FilterMatchIndex");
    }
    /* We initialize the bit arrays */
-   for (i=0;i<index->size;i++) {
+   for (int i=0;i<index->size;i++) {
       index->matching_tokens[i]=NULL;
    }
    /* Then, we look all the tokens */
-   for (i=0;i<tokens->size;i++) {
-      current_token=tokens->value[i];
-      if (current_token[0]=='{' && u_strcmp(current_token,"{S}")
-          && u_strcmp(current_token,"{STOP}")) {
-         /* If we have a tag token like "{today,.ADV}", we extract its inflected form */
-         w_extract_inflected(current_token,&inflected,&inflected_buffer_size);
-      } else {
-         /* Otherwise, we just convert the unichar* token into a unichar_regex* string */
-         w_strcpy(&inflected, &inflected_buffer_size, current_token);
+   struct filter_match_job job;
+   job.filters=filters;
+   job.tokens=tokens;
+   job.index=index;
+   job.next_token=0;
+   if (n_threads>1 && tokens->size>FILTER_TOKENS_PER_BLOCK) {
+      job.mutex=SyncBuildMutex();
+      void** w_ptr=(void**)malloc(n_threads*sizeof(void*));
+      if (w_ptr==NULL) {
+         fatal_alloc_error("new_FilterMatchIndex");
       }
-      for (k=0;k<filters->size;k++) {
-         if (regex_facade_regexec(filters->filter[k].matcher,inflected,0,NULL,0)==0) {
-            /* If the current token matches the filter k */
-            if (index->matching_tokens[k]==NULL) {
-               /* If necessary, we allocate the bit array of the filter k */
-               index->matching_tokens[k]=new_bit_array(tokens->size,ONE_BIT);
-            }
-            /* Then, we mark the token as being matched by the filter */
-            set_value(index->matching_tokens[k],i,1);
-         }
+      for (int i=0;i<n_threads;i++) {
+         w_ptr[i]=&job;
       }
+      SyncRunThreads((unsigned int)n_threads,filter_match_worker_thread,w_ptr);
+      free(w_ptr);
+      SyncDeleteMutex(job.mutex);
+   } else {
+      job.mutex=NULL;
+      filter_match_worker_thread(&job,0);
    }
 } else {
    /* If there is no filter */
    index->size=0;
    index->matching_tokens=NULL;
 }
-if (inflected != NULL) {
-  free(inflected);
-}
 return index;
 }
 
@@ -259,6 +378,9 @@ free(index);
  * with a user provided buffer
  */
 int string_match_filter(const FilterSet* filters, const unichar* s, int filter_number, unichar_regex* original_temp, size_t size_temp) {
+if (!may_match_filter(&(filters->filter[filter_number]),s)) {
+   return 0;
+}
 unichar_regex* allocated_temp = NULL; const unichar_regex* temp;
 temp = w_strcpy_optional_buffer(original_temp, size_temp, &allocated_temp, s, NULL, NULL);
 int ret_value = !regex_facade_regexec(filters->filter[filter_number].matcher,temp,0,NULL,0);
@@ -271,6 +393,9 @@ return ret_value;
  * Returns 1 if the given string matches the given filter.
  */
 int string_match_filter(const FilterSet* filters,const unichar* s,int filter_number) {
+if (!may_match_filter(&(filters->filter[filter_number]),s)) {
+   return 0;
+}
 #define STRING_MATCH_STRING_BUFFER_SIZE 8
 unichar_regex original_temp[STRING_MATCH_STRING_BUFFER_SIZE]; unichar_regex* allocated_temp = NULL; const unichar_regex* temp;
 temp = w_strcpy_optional_buffer(original_temp, STRING_MATCH_STRING_BUFFER_SIZE, &allocated_temp, s, NULL, NULL);
@@ -296,20 +421,6 @@ return get_value(index->matching_tokens[filter_number],token);
 }
 
 
-/**
- * This function extracts the inflected form of the given tag token and
- * stores it in the given unichar_regex* string.
- */
-static void w_extract_inflected(const unichar* tag_token,unichar_regex** inflected, size_t *buffer_size) {
-struct dela_entry* entry=tokenize_tag_token(tag_token,1);
-if (entry==NULL) {
-   fatal_error("Invalid tag token in w_extract_inflected\n");
-}
-w_strcpy(inflected, buffer_size, entry->inflected);
-free_dela_entry(entry);
-}
-
-
 /**
  * Splits a filter like "<<able$>>_f_" into its content "able$" and its options "f".
  */
@@ -334,6 +445,214 @@ filter_options[j]='\0';
 }
 
 
+/**
+ * Reads the bracket expression of 're' that starts at '*pos', like "[a-zA-Z]",
+ * and adds the characters it matches to 'chars'. Returns 1 if it did, 0 if
+ * the expression is valid but too complex for us, or -1 if it is malformed.
+ * In all cases but -1, '*pos' is moved after the expression.
+ */
+static int read_bracket_expression(const unichar* re,int* pos,struct bit_array* chars) {
+int i=*pos+1;
+int known=1;
+if (re[i]=='^') {
+   /* We do not try to complement negated expressions */
+   known=0;
+   i++;
+}
+int first=1;
+for (;;) {
+   unichar c=re[i];
+   if (c=='\0') return -1;
+   if (c==']' && !first) {
+      i++;
+      break;
+   }
+   first=0;
+   if (c=='[' && (re[i+1]==':' || re[i+1]=='.' || re[i+1]=='=')) {
+      /* Character classes like [:alpha:]: we skip them */
+      known=0;
+      unichar end=re[i+1];
+      i=i+2;
+      while (re[i]!='\0' && (re[i]!=end || re[i+1]!=']')) i++;
+      if (re[i]=='\0') return -1;
+      i=i+2;
+      continue;
+   }
+   if (c=='\\') {
+      /* Backslashes are not special in POSIX bracket expressions, but we do not
+       * rely on that */
+      known=0;
+   }
+   i++;
+   unichar last=c;
+   if (re[i]=='-' && re[i+1]!=']' && re[i+1]!='\0') {
+      last=re[i+1];
+      if (last=='[' || last=='\\') known=0;
+      i=i+2;
+   }
+   if (known) {
+      for (int k=c;k<=last;k++) {
+         set_value(chars,k,1);
+      }
+   }
+}
+*pos=i;
+return known;
+}
+
+
+/**
+ * Reads the atom of the extended regular expression 're' that starts at '*pos'
+ * and moves '*pos' after it. Returns 1 if the atom matches a single character
+ * among those it adds to 'chars', 0 if it matches a character we cannot
+ * tell, or -1 if we cannot analyze it.
+ */
+static int read_atom(const unichar* re,int* pos,struct bit_array* chars) {
+unichar c=re[*pos];
+switch (c) {
+   case '[': return read_bracket_expression(re,pos,chars);
+   case '.': (*pos)++; return 0;
+   case '*': case '+': case '?': case '{': return -1;
+   case '\\': {
+      /* We only consider escaped special characters, not things like \w or \< */
+      unichar next=re[*pos+1];
+      if (next=='\0' || u_strchr(".[]*+?^$\\{}()|/-",next)==NULL) {
+         return -1;
+      }
+      set_value(chars,next,1);
+      *pos=*pos+2;
+      return 1;
+   }
+   default:
+      set_value(chars,c,1);
+      (*pos)++;
+      return 1;
+}
+}
+
+
+/**
+ * Returns the number of characters in the given set.
+ */
+static int count_chars(const struct bit_array* chars) {
+int n=0;
+for (int i=0;i<chars->size_in_bytes;i++) {
+   for (unsigned char b=chars->array[i];b!=0;b=(unsigned char)(b&(b-1))) n++;
+}
+return n;
+}
+
+
+/**
+ * Looks at the regular expression of the given filter in order to compute
+ * its first, last and required characters. We only consider the atoms that
+ * are at the top level of the expression, outside parentheses, and that are
+ * not made optional by '*', '?' or '{'. If the expression has a top level
+ * alternative or anything we do not understand, we deduce nothing. Basic
+ * regular expressions are not analyzed.
+ */
+static void analyze_filter(MorphoFilter* filter,int basic) {
+if (basic) return;
+const unichar* re=filter->content;
+int i=0;
+int depth=0;
+int anchored_start=0;
+int anchored_end=0;
+int first_atom=1;
+struct bit_array* first=NULL;
+struct bit_array* last=NULL;
+struct bit_array* required=NULL;
+int n_required=0;
+if (re[0]=='^') {
+   anchored_start=1;
+   i=1;
+}
+while (re[i]!='\0') {
+   unichar c=re[i];
+   if (c=='(') {
+      depth++;
+      i++;
+      first_atom=0;
+      free_bit_array(last);
+      last=NULL;
+      continue;
+   }
+   if (c=='|') {
+      if (depth==0) goto give_up;
+      i++;
+      continue;
+   }
+   if (c==')') {
+      if (depth==0) goto give_up;
+      depth--;
+      i++;
+      /* A group is never a known atom, so its quantifiers do not matter */
+      while (re[i]=='*' || re[i]=='+' || re[i]=='?') i++;
+      continue;
+   }
+   if (c=='^') goto give_up;
+   if (c=='$') {
+      if (re[i+1]!='\0' || depth!=0) goto give_up;
+      anchored_end=1;
+      break;
+   }
+   struct bit_array* chars=new_bit_array(0x10000,ONE_BIT);
+   int known=read_atom(re,&i,chars);
+   if (known==-1) {
+      free_bit_array(chars);
+      goto give_up;
+   }
+   /* Then we look at the quantifiers */
+   int optional=0;
+   while (re[i]=='*' || re[i]=='+' || re[i]=='?' || re[i]=='{') {
+      if (re[i]=='{') {
+         while (re[i]!='\0' && re[i]!='}') i++;
+         if (re[i]=='\0') {
+            free_bit_array(chars);
+            goto give_up;
+         }
+      }
+      if (re[i]!='+') optional=1;
+      i++;
+   }
+   if (depth>0 || !known || optional) {
+      free_bit_array(chars);
+      chars=NULL;
+   }
+   if (depth>0) continue;
+   if (first_atom && anchored_start && chars!=NULL) {
+      first=new_bit_array(0x10000,ONE_BIT);
+      memcpy(first->array,chars->array,chars->size_in_bytes);
+   }
+   first_atom=0;
+   if (chars!=NULL) {
+      int n=count_chars(chars);
+      if (required==NULL || n<n_required) {
+         free_bit_array(required);
+         required=new_bit_array(0x10000,ONE_BIT);
+         memcpy(required->array,chars->array,chars->size_in_bytes);
+         n_required=n;
+      }
+   }
+   free_bit_array(last);
+   last=chars;
+}
+if (depth!=0) goto give_up;
+if (!anchored_end) {
+   free_bit_array(last);
+   last=NULL;
+}
+filter->first_chars=first;
+filter->last_chars=last;
+filter->required_chars=required;
+return;
+give_up:
+free_bit_array(first);
+free_bit_array(last);
+free_bit_array(required);
+}
+
+
 #endif
 
 } // namespace unitex
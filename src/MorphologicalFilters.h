@@ -62,6 +62,13 @@ typedef struct {
    /* 'matcher' is a TRE object that represents an automaton that can match the same
     * things that the given regular expression. */
    regex_facade_regex_t* matcher;
+   /* Characters that a matching string must respectively start with, end with
+    * and contain at least one of, as deduced from the regular expression. They
+    * are NULL when nothing can be deduced. They are used to reject most strings
+    * without running the matcher. */
+   struct bit_array* first_chars;
+   struct bit_array* last_chars;
+   struct bit_array* required_chars;
 } MorphoFilter;
 
 
@@ -92,7 +99,7 @@ typedef struct {
 FilterSet* new_FilterSet(Fst2*,Alphabet*);
 void free_FilterSet(FilterSet*);
 
-FilterMatchIndex* new_FilterMatchIndex(FilterSet*,struct string_hash*);
+FilterMatchIndex* new_FilterMatchIndex(FilterSet*,struct string_hash*,int n_threads = 1);
 void free_FilterMatchIndex(FilterMatchIndex*);
 
 int string_match_filter(const FilterSet*,const unichar*,int);
@@ -38,6 +38,7 @@
 #include "Contexts.h"
 #include "DebugMode.h"
 #include "MorphologicalLocate.h"
+#include "LocateTrace.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -291,9 +292,19 @@ static void morphological_locate(int current_state_index,
   LocateMode locate_mode = p->locate_mode;
 
   // call the morphological locate
-  core_morphological_locate(
-      current_state_index, pos_in_tokens, pos_in_chars, matches,
-      n_matches, ctx, p, jamo, pos_in_jamo, content_buffer);
+  if (p->profile == NULL) {
+    core_morphological_locate(
+        current_state_index, pos_in_tokens, pos_in_chars, matches,
+        n_matches, ctx, p, jamo, pos_in_jamo, content_buffer);
+  } else {
+    struct locate_profile_visit visit;
+    begin_profiled_visit(p->profile, &visit,
+        p->optimized_states[current_state_index]->control & 1);
+    core_morphological_locate(
+        current_state_index, pos_in_tokens, pos_in_chars, matches,
+        n_matches, ctx, p, jamo, pos_in_jamo, content_buffer);
+    end_profiled_visit(p->profile, &visit, current_state_index);
+  }
 
   // restore the minimal unit of analysis
   p->locate_mode = locate_mode;
@@ -505,10 +516,18 @@ unichar* content_buffer /* reusable unichar 4096 buffer for content */
                 }
 
                 p->weight=old_weight;
+                struct locate_profile_visit frame;
+                if (p->profile != NULL) {
+                    begin_profiled_frame(p->profile, &frame);
+                }
                 morphological_locate(/*graph_depth + 1,*/ /* Exploration of the subgraph */
                         p->fst2->initial_states[graph_call_list->graph_number], pos_in_tokens,
                         pos_in_chars, &L, 0, NULL, p,
                         jamo, pos_in_jamo, content_buffer);
+                if (p->profile != NULL) {
+                    end_profiled_call(p->profile, &frame, current_state_index,
+                                      graph_call_list->graph_number, L == NULL);
+                }
                 p->graph_depth -- ;
 
                 clear_dic_variable_list(&(p->dic_variables));
@@ -929,6 +948,9 @@ unichar* content_buffer /* reusable unichar 4096 buffer for content */
                             p->input_variables, p->output_variables, p->dic_variables, -1, -1, jamo,
                             pos_in_jamo, NULL, p->weight,&p->al.pa);
                 }
+                if (p->profile != NULL) {
+                    locate_profile_success(p->profile);
+                }
                 break;
 
             } /* End of the switch */
@@ -1458,9 +1480,16 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
     int backup_graph_depth = p->graph_depth;
     p->graph_depth = 0;
     p->graph_depth_backup_nested ++;
+    struct locate_profile_visit frame;
+    if (p->profile != NULL) {
+        begin_profiled_frame(p->profile, &frame);
+    }
     morphological_locate(/*0,*/ state, pos, 0, &L, 0, NULL, p,
             (p->jamo_tags != NULL) ? p->jamo_tags[current_token] : NULL, 0,
             content_buffer);
+    if (p->profile != NULL) {
+        end_profiled_frame(p->profile, &frame);
+    }
     p->graph_depth_backup_nested --;
     p->graph_depth = backup_graph_depth;
 
@@ -1573,9 +1602,9 @@ static void explore_dic_in_morpho_mode_standard(struct locate_parameters* p,
         int pos_in_inflected, int pos_offset, struct parsing_info* *matches,
         struct pattern* pattern, int save_dic_entry, unichar* jamo,
         int pos_in_jamo, Ustring *line_buffer,Ustring* ustr,int base) {
-int final,n_transitions,inf_number;
+int final,n_transitions,inf_number,index_pos;
 int z=save_output(ustr);
-offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number);
+offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number,&index_pos);
 
 
     if (final) {
@@ -1675,6 +1704,25 @@ offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number);
     /* We look for outgoing transitions */
     unichar c;
     int adr;
+    if (jamo == NULL && n_transitions != 0) {
+        int positions[BIN_MAX_CASE_VARIANTS];
+        int n_positions = find_dictionary_transitions(d, index_pos, n_transitions,
+                current_token[pos_in_current_token], p->morpho_case_variants, positions);
+        if (n_positions != -1) {
+            /* If the state has an index, we only look at the matching transitions */
+            update_last_position(p, pos_offset);
+            for (int i = 0; i < n_positions; i++) {
+                read_dictionary_transition(d, positions[i], &c, &adr, ustr);
+                inflected[pos_in_inflected] = c;
+                explore_dic_in_morpho_mode_standard(p, d, adr,
+                        current_token, inflected, pos_in_current_token + 1,
+                        pos_in_inflected + 1, pos_offset, matches, pattern,
+                        save_dic_entry, jamo, pos_in_jamo, line_buffer, ustr, base);
+                restore_output(z, ustr);
+            }
+            return;
+        }
+    }
     for (int i = 0; i < n_transitions; i++) {
         update_last_position(p, pos_offset);
         offset=read_dictionary_transition(d,offset,&c,&adr,ustr);
@@ -30,10 +30,10 @@
 
 namespace unitex {
 
-#define MAX_LINE_BUFFER_SIZE (32768)
+#define MAX_LINE_BUFFER_SIZE (0x100000)
 #define MINIMAL_CHAR_IN_BUFFER_BEFORE_CONTINUE_LINE (256)
 
-#define SIZE_OUTPUT_BUFFER 0x100
+#define SIZE_OUTPUT_BUFFER 0x4000
 
 struct OUTBUF {
     unichar outbuf[SIZE_OUTPUT_BUFFER + 1];
@@ -158,6 +158,24 @@ while (s[*ptr]!='\0') {
 return P_OK;
 }
 
+/**
+ * Reads up to 'size' chars of the input. If the input is mapped, chars are
+ * copied from the mapping, which avoids decoding them one by one.
+ */
+static int read_input_block(U_FILE* input,const U_MAPPED_TEXT* mapped,size_t* mapped_pos,
+        unichar* t,int size) {
+    if (mapped == NULL) {
+        return u_fread_raw(t, size, input);
+    }
+    size_t n = mapped->length - (*mapped_pos);
+    if (n > (size_t) size) {
+        n = (size_t) size;
+    }
+    memcpy(t, mapped->text + (*mapped_pos), n * sizeof(unichar));
+    (*mapped_pos) += n;
+    return (int) n;
+}
+
 /**
  * This function produces a normalized version of 'input' and stores it into 'ouput'.
  * The following rules are applied in the given order:
@@ -193,6 +211,8 @@ int normalize(const char *fin, const char *fout, const VersatileEncodingConfig*
         u_fclose(input);
         return 1;
     }
+    U_MAPPED_TEXT* mapped = u_map_text(input, fin);
+    size_t mapped_pos = 0;
     struct string_hash* replacements = NULL;
     if (rules != NULL && rules[0] != '\0') {
         replacements = load_key_value_list(rules, vec, '\t');
@@ -261,7 +281,7 @@ int normalize(const char *fin, const char *fout, const VersatileEncodingConfig*
         int current_start_pos = 0;
         const unichar* buff = line_read;
         int result_read = 0;
-        result_read=u_fread_raw(line_read,line_buffer_size,input);
+        result_read=read_input_block(input,mapped,&mapped_pos,line_read,line_buffer_size);
         if (result_read==0) break;
         while (current_start_pos < result_read) {
             if (/*(lastline_was_terminated == 0) &&*/ (eof_found == 0)
@@ -274,8 +294,8 @@ int normalize(const char *fin, const char *fout, const VersatileEncodingConfig*
                     line_read[i] = line_read[current_start_pos + i];
                 /* This is required to avoid bound checking */
                 line_read[i]='\0';
-                int result_read_continue = u_fread_raw(line_read+ nb_to_keep,
-                        line_buffer_size - nb_to_keep, input);
+                int result_read_continue = read_input_block(input, mapped, &mapped_pos,
+                        line_read + nb_to_keep, line_buffer_size - nb_to_keep);
                 if (result_read_continue == 0) {
                     eof_found = lastline_was_terminated = 1;
                 } else {
@@ -473,6 +493,7 @@ int normalize(const char *fin, const char *fout, const VersatileEncodingConfig*
     free(line_read);
     free_string_hash(replacements);
     free_Ustring(tmp);
+    u_unmap_text(mapped);
     u_fclose(input);
     u_fclose(output);
     return 0;
@@ -33,6 +33,8 @@
 #include "Persistence.h"
 #include "UnusedParameter.h"
 
+#include <stddef.h>
+
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -45,7 +47,17 @@ int load_persistent_fst2(const char* name) {
   VersatileEncodingConfig vec = VEC_DEFAULT;
 
   Fst2* f;
-  f = read_pack_fst2_from_file(name, NULL);
+  f = read_image_fst2_from_file(name);
+  if (f != NULL) {
+    /* The persistent fst2 is freed with free_Fst2, so it cannot be
+     * the image itself */
+    Fst2* image = f;
+    f = new_Fst2_clone(image, NULL);
+    free_image_fst2(image);
+  }
+  if (f == NULL) {
+    f = read_pack_fst2_from_file(name, NULL);
+  }
   if (f == NULL) {
     f = load_fst2(&vec, name, 1, NULL);
   }
@@ -1519,6 +1531,487 @@ void free_pack_fst2(Fst2* fst2, Abstract_allocator prv_alloc)
 }
 
 
+/*******************************************************************************/
+/*
+ * Binary image of a fst2.
+ *
+ * An image is a copy of the in-memory Fst2 structures (the Fst2 itself, its
+ * states, transitions, tags, patterns and strings) laid out in a single block,
+ * where every pointer is replaced by its offset from the beginning of the
+ * block. The block is followed by a relocation table that gives the offsets
+ * of all these pointer fields. Loading an image is then a plain copy of the
+ * block followed by the addition of the block address to each relocated field:
+ * there is no parsing and a single allocation.
+ *
+ * The image uses the native layout of the structures, so that it can only be
+ * loaded by a program built with the same pointer size, byte order and
+ * structure sizes. The header stores these values and the loader rejects
+ * any image that does not match, so that the caller can fall back on
+ * the text .fst2.
+ *
+ * Header (FST2_IMAGE_HEADER_SIZE bytes, native byte order):
+ *   0: "FST2im" 0 version
+ *   8: size of the block, header included
+ *  12: number of relocations
+ *  16: byte order marker
+ *  20: pointer size
+ *  24: structure layout signature
+ * The Fst2 structure itself is stored right after the header.
+ */
+
+#define FST2_IMAGE_HEADER_SIZE 32
+#define FST2_IMAGE_VERSION 1
+#define FST2_IMAGE_BYTE_ORDER_MARKER 0x01020304
+#define FST2_IMAGE_ALIGN 8
+
+
+static unsigned int get_fst2_image_layout_signature() {
+  return ((unsigned int)(sizeof(Fst2) & 0xff)) |
+         (((unsigned int)(sizeof(struct fst2Tag) & 0xff)) << 8) |
+         (((unsigned int)(sizeof(Transition) & 0xff)) << 16) |
+         (((unsigned int)(sizeof(struct pattern) & 0xff)) << 24);
+}
+
+
+class image_store {
+ public:
+  image_store();
+  ~image_store();
+
+  size_t alloc(size_t size);
+  void* at(size_t offset) {
+    return buf + offset;
+  };
+  void set_pointer(size_t field_offset, size_t target_offset);
+  bool write_to_file(const char* filename);
+
+  size_t get_size() {
+    return size;
+  };
+
+ private:
+  unsigned char* buf;
+  size_t size;
+  size_t capacity;
+  unsigned int* relocations;
+  unsigned int nb_relocations;
+  unsigned int nb_relocations_allocated;
+};
+
+
+image_store::image_store()
+    : buf(NULL), size(0), capacity(0), relocations(NULL),
+      nb_relocations(0), nb_relocations_allocated(0) {
+}
+
+
+image_store::~image_store() {
+  free(buf);
+  free(relocations);
+}
+
+
+/**
+ * Reserves 'size' zeroed bytes in the image and returns their offset.
+ */
+size_t image_store::alloc(size_t size_alloc) {
+  size_t offset = (size + FST2_IMAGE_ALIGN - 1) & ~((size_t)(FST2_IMAGE_ALIGN - 1));
+  if (offset + size_alloc > capacity) {
+    size_t new_capacity = GET_NEW_ITEM_ALLOCATED_FROM_OLD_NUMBER(capacity);
+    if (new_capacity < offset + size_alloc)
+      new_capacity = offset + size_alloc;
+    unsigned char* new_buf = (unsigned char*)realloc(buf, new_capacity);
+    if (new_buf == NULL) {
+      fatal_alloc_error("image_store::alloc");
+    }
+    buf      = new_buf;
+    capacity = new_capacity;
+  }
+  memset(buf + size, 0, offset + size_alloc - size);
+  size = offset + size_alloc;
+  return offset;
+}
+
+
+/**
+ * Stores 'target_offset' in the pointer field located at 'field_offset',
+ * and records the field in the relocation table. Offset 0 is the header,
+ * so that it is used to represent NULL.
+ */
+void image_store::set_pointer(size_t field_offset, size_t target_offset) {
+  void* value = (void*)target_offset;
+  memcpy(buf + field_offset, &value, sizeof(void*));
+  if (target_offset == 0)
+    return;
+  if (nb_relocations == nb_relocations_allocated) {
+    nb_relocations_allocated =
+        GET_NEW_ITEM_ALLOCATED_FROM_OLD_NUMBER(nb_relocations_allocated);
+    relocations = (unsigned int*)realloc(
+        relocations, nb_relocations_allocated * sizeof(unsigned int));
+    if (relocations == NULL) {
+      fatal_alloc_error("image_store::set_pointer");
+    }
+  }
+  relocations[nb_relocations++] = (unsigned int)field_offset;
+}
+
+
+bool image_store::write_to_file(const char* filename) {
+  unsigned char* header = buf;
+  unsigned int image_size = (unsigned int)size;
+  unsigned int marker = FST2_IMAGE_BYTE_ORDER_MARKER;
+  unsigned int pointer_size = (unsigned int)sizeof(void*);
+  unsigned int signature = get_fst2_image_layout_signature();
+  memset(header, 0, FST2_IMAGE_HEADER_SIZE);
+  header[0] = 'F';
+  header[1] = 'S';
+  header[2] = 'T';
+  header[3] = '2';
+  header[4] = 'i';
+  header[5] = 'm';
+  header[6] = 0;
+  header[7] = FST2_IMAGE_VERSION;
+  memcpy(header + 8, &image_size, 4);
+  memcpy(header + 12, &nb_relocations, 4);
+  memcpy(header + 16, &marker, 4);
+  memcpy(header + 20, &pointer_size, 4);
+  memcpy(header + 24, &signature, 4);
+
+  ABSTRACTFILE* f = af_fopen(filename, "wb");
+  if (f == NULL)
+    return false;
+  bool fRet = true;
+  if (((long)af_fwrite(buf, 1, size, f)) != (long)size)
+    fRet = false;
+  size_t size_relocations = nb_relocations * sizeof(unsigned int);
+  if ((size_relocations > 0) &&
+      (((long)af_fwrite(relocations, 1, size_relocations, f)) != (long)size_relocations))
+    fRet = false;
+  af_fclose(f);
+  return fRet;
+}
+
+
+static size_t image_ustring(const unichar* str, image_store* img) {
+  if (str == NULL)
+    return 0;
+  size_t len    = (size_t)u_strlen(str) + 1;
+  size_t offset = img->alloc(len * sizeof(unichar));
+  memcpy(img->at(offset), str, len * sizeof(unichar));
+  return offset;
+}
+
+
+static size_t image_list_int(const struct list_int* list, image_store* img) {
+  size_t first = 0;
+  size_t previous = 0;
+  for (; list != NULL; list = list->next) {
+    size_t offset = img->alloc(sizeof(struct list_int));
+    ((struct list_int*)img->at(offset))->n = list->n;
+    if (previous == 0)
+      first = offset;
+    else
+      img->set_pointer(previous + offsetof(struct list_int, next), offset);
+    previous = offset;
+  }
+  return first;
+}
+
+
+static size_t image_list_ustring(const struct list_ustring* list, image_store* img) {
+  size_t first = 0;
+  size_t previous = 0;
+  for (; list != NULL; list = list->next) {
+    size_t offset = img->alloc(sizeof(struct list_ustring));
+    img->set_pointer(offset + offsetof(struct list_ustring, string),
+                     image_ustring(list->string, img));
+    if (previous == 0)
+      first = offset;
+    else
+      img->set_pointer(previous + offsetof(struct list_ustring, next), offset);
+    previous = offset;
+  }
+  return first;
+}
+
+
+static size_t image_pattern(const struct pattern* pattern, image_store* img) {
+  if (pattern == NULL)
+    return 0;
+  size_t offset = img->alloc(sizeof(struct pattern));
+  ((struct pattern*)img->at(offset))->type = pattern->type;
+  img->set_pointer(offset + offsetof(struct pattern, inflected),
+                   image_ustring(pattern->inflected, img));
+  img->set_pointer(offset + offsetof(struct pattern, lemma),
+                   image_ustring(pattern->lemma, img));
+  img->set_pointer(offset + offsetof(struct pattern, grammatical_codes),
+                   image_list_ustring(pattern->grammatical_codes, img));
+  img->set_pointer(offset + offsetof(struct pattern, forbidden_codes),
+                   image_list_ustring(pattern->forbidden_codes, img));
+  img->set_pointer(offset + offsetof(struct pattern, inflectional_codes),
+                   image_list_ustring(pattern->inflectional_codes, img));
+  return offset;
+}
+
+
+/**
+ * The transitions of a state are stored in a single array, so that
+ * exploring them reads contiguous memory.
+ */
+static size_t image_transition_list(const Transition* list, image_store* img) {
+  int n = length_transition_list(list);
+  if (n == 0)
+    return 0;
+  size_t first = img->alloc(n * sizeof(Transition));
+  for (int i = 0; list != NULL; list = list->next, i++) {
+    size_t offset = first + i * sizeof(Transition);
+    Transition* t = (Transition*)img->at(offset);
+    t->tag_number   = list->tag_number;
+    t->state_number = list->state_number;
+    if (list->next != NULL)
+      img->set_pointer(offset + offsetof(Transition, next), offset + sizeof(Transition));
+  }
+  return first;
+}
+
+
+static size_t image_Fst2State(Fst2State state, image_store* img) {
+  if (state == NULL)
+    return 0;
+  size_t offset = img->alloc(sizeof(struct fst2State));
+  ((Fst2State)img->at(offset))->control = state->control;
+  img->set_pointer(offset + offsetof(struct fst2State, transitions),
+                   image_transition_list(state->transitions, img));
+  return offset;
+}
+
+
+static size_t image_Fst2Tag(Fst2Tag tag, image_store* img) {
+  if (tag == NULL)
+    return 0;
+  size_t offset = img->alloc(sizeof(struct fst2Tag));
+  Fst2Tag dest = (Fst2Tag)img->at(offset);
+  dest->type             = tag->type;
+  dest->control          = tag->control;
+  dest->filter_number    = tag->filter_number;
+  dest->meta             = tag->meta;
+  dest->pattern_number   = tag->pattern_number;
+  dest->compound_pattern = tag->compound_pattern;
+  img->set_pointer(offset + offsetof(struct fst2Tag, input),
+                   image_ustring(tag->input, img));
+  img->set_pointer(offset + offsetof(struct fst2Tag, morphological_filter),
+                   image_ustring(tag->morphological_filter, img));
+  img->set_pointer(offset + offsetof(struct fst2Tag, output),
+                   image_ustring(tag->output, img));
+  img->set_pointer(offset + offsetof(struct fst2Tag, pattern),
+                   image_pattern(tag->pattern, img));
+  img->set_pointer(offset + offsetof(struct fst2Tag, variable),
+                   image_ustring(tag->variable, img));
+  img->set_pointer(offset + offsetof(struct fst2Tag, matching_tokens),
+                   image_list_int(tag->matching_tokens, img));
+  return offset;
+}
+
+
+static size_t image_int_array(const int* array, int n, image_store* img) {
+  if (array == NULL)
+    return 0;
+  size_t offset = img->alloc(n * sizeof(int));
+  memcpy(img->at(offset), array, n * sizeof(int));
+  return offset;
+}
+
+
+static void image_Fst2(Fst2* fst2, image_store* img) {
+  img->alloc(FST2_IMAGE_HEADER_SIZE);
+  size_t offset = img->alloc(sizeof(Fst2));
+  Fst2* dest = (Fst2*)img->at(offset);
+  dest->number_of_graphs = fst2->number_of_graphs;
+  dest->number_of_states = fst2->number_of_states;
+  dest->number_of_tags   = fst2->number_of_tags;
+#ifdef FST2_STRUCTURE_HAS_DEBUG_MEMBER
+  dest->debug = fst2->debug;
+#endif
+
+  size_t states = img->alloc(fst2->number_of_states * sizeof(Fst2State));
+  img->set_pointer(offset + offsetof(Fst2, states), states);
+  for (int i = 0; i < fst2->number_of_states; i++) {
+    img->set_pointer(states + i * sizeof(Fst2State),
+                     image_Fst2State(fst2->states[i], img));
+  }
+
+  size_t tags = img->alloc(fst2->number_of_tags * sizeof(Fst2Tag));
+  img->set_pointer(offset + offsetof(Fst2, tags), tags);
+  for (int i = 0; i < fst2->number_of_tags; i++) {
+    img->set_pointer(tags + i * sizeof(Fst2Tag),
+                     image_Fst2Tag(fst2->tags[i], img));
+  }
+
+  img->set_pointer(offset + offsetof(Fst2, initial_states),
+                   image_int_array(fst2->initial_states,
+                                   fst2->number_of_graphs + 1, img));
+  img->set_pointer(offset + offsetof(Fst2, number_of_states_per_graphs),
+                   image_int_array(fst2->number_of_states_per_graphs,
+                                   fst2->number_of_graphs + 1, img));
+
+  if (fst2->graph_names != NULL) {
+    size_t names = img->alloc((fst2->number_of_graphs + 1) * sizeof(unichar*));
+    img->set_pointer(offset + offsetof(Fst2, graph_names), names);
+    for (int i = 1; i <= fst2->number_of_graphs; i++) {
+      img->set_pointer(names + i * sizeof(unichar*),
+                       image_ustring(fst2->graph_names[i], img));
+    }
+  }
+
+  img->set_pointer(offset + offsetof(Fst2, input_variables),
+                   image_list_ustring(fst2->input_variables, img));
+  img->set_pointer(offset + offsetof(Fst2, output_variables),
+                   image_list_ustring(fst2->output_variables, img));
+}
+
+
+bool write_image_fst2(Fst2* fst2load, const char* fst2_image_name, bool fVerbose) {
+  if (fst2load == NULL)
+    return false;
+  image_store img;
+  image_Fst2(fst2load, &img);
+  if (fVerbose)
+    u_printf("\nsize of the fst2 image : %u\n", (unsigned int)img.get_size());
+  return img.write_to_file(fst2_image_name);
+}
+
+
+bool convert_fst2_to_fst2_image_file(const char* fst2_name, const char* fst2_image_name,
+                                     bool fVerbose) {
+#ifdef VersatileEncodingConfigDefined
+  const VersatileEncodingConfig vecDefault = {
+      DEFAULT_MASK_ENCODING_COMPATIBILITY_INPUT, DEFAULT_ENCODING_OUTPUT,
+      DEFAULT_BOM_OUTPUT};
+#endif
+
+  Fst2* fst2load;
+  struct FST2_free_info fst2load_free;
+  fst2load = load_abstract_fst2(
+#ifdef VersatileEncodingConfigDefined
+      &vecDefault,
+#endif
+      fst2_name, 1, &fst2load_free);
+  if (fst2load == NULL)
+    return false;
+
+  if (fVerbose)
+    u_printf("\n\nload %s and save %s\n", fst2_name, fst2_image_name);
+  bool fRet = write_image_fst2(fst2load, fst2_image_name, fVerbose);
+
+  free_abstract_Fst2(fst2load, &fst2load_free);
+  return fRet;
+}
+
+
+/**
+ * Returns a Fst2 built from the given image, or NULL if the buffer does not
+ * contain an image that was built for this program. The returned Fst2 must
+ * be freed with free_image_fst2.
+ */
+Fst2* read_image_fst2_from_memory(const void* buf, size_t size_buf) {
+  const unsigned char* header = (const unsigned char*)buf;
+  if (size_buf < FST2_IMAGE_HEADER_SIZE + sizeof(Fst2))
+    return NULL;
+  if ((header[0] != 'F') || (header[1] != 'S') || (header[2] != 'T') ||
+      (header[3] != '2') || (header[4] != 'i') || (header[5] != 'm') ||
+      (header[6] != 0) || (header[7] != FST2_IMAGE_VERSION))
+    return NULL;
+  unsigned int image_size, nb_relocations, marker, pointer_size, signature;
+  memcpy(&image_size, header + 8, 4);
+  memcpy(&nb_relocations, header + 12, 4);
+  memcpy(&marker, header + 16, 4);
+  memcpy(&pointer_size, header + 20, 4);
+  memcpy(&signature, header + 24, 4);
+  if ((marker != FST2_IMAGE_BYTE_ORDER_MARKER) ||
+      (pointer_size != sizeof(void*)) ||
+      (signature != get_fst2_image_layout_signature()))
+    return NULL;
+  if ((image_size < FST2_IMAGE_HEADER_SIZE + sizeof(Fst2)) ||
+      ((size_t)image_size + (size_t)nb_relocations * sizeof(unsigned int) > size_buf))
+    return NULL;
+
+  unsigned char* image = (unsigned char*)malloc(image_size);
+  if (image == NULL) {
+    fatal_alloc_error("read_image_fst2_from_memory");
+  }
+  memcpy(image, buf, image_size);
+  const unsigned char* relocations = header + image_size;
+  for (unsigned int i = 0; i < nb_relocations; i++) {
+    unsigned int field_offset;
+    memcpy(&field_offset, relocations + i * sizeof(unsigned int), sizeof(unsigned int));
+    size_t target_offset;
+    if ((size_t)field_offset + sizeof(void*) > image_size) {
+      free(image);
+      return NULL;
+    }
+    memcpy(&target_offset, image + field_offset, sizeof(size_t));
+    if (target_offset >= image_size) {
+      free(image);
+      return NULL;
+    }
+    void* target = image + target_offset;
+    memcpy(image + field_offset, &target, sizeof(void*));
+  }
+  return (Fst2*)(image + FST2_IMAGE_HEADER_SIZE);
+}
+
+
+Fst2* read_image_fst2_from_file(const char* filename) {
+  ABSTRACTMAPFILE* amf = af_open_mapfile(filename, MAPFILE_OPTION_READ, 0);
+  if (amf == NULL) {
+    return NULL;
+  }
+  const void* buf = af_get_mapfile_pointer(amf);
+  size_t size_buf = af_get_mapfile_size(amf);
+  Fst2* ret       = read_image_fst2_from_memory(buf, size_buf);
+  af_release_mapfile_pointer(amf, buf);
+  af_close_mapfile(amf);
+  return ret;
+}
+
+
+static bool is_in_fst2_image(const void* ptr, const unsigned char* image, unsigned int image_size) {
+  return ((const unsigned char*)ptr >= image) &&
+         ((const unsigned char*)ptr < image + image_size);
+}
+
+
+/**
+ * Frees a Fst2 loaded from an image. Its structures all belong to the image
+ * block, so that they must not be freed one by one, except the ones that
+ * were attached to the tags with 'prv_alloc' after loading, as Locate does
+ * when it works on the image instead of a clone. These ones are not visited
+ * if 'prv_alloc' frees them by itself.
+ */
+void free_image_fst2(Fst2* fst2, Abstract_allocator prv_alloc) {
+  if (fst2 == NULL)
+    return;
+  unsigned char* image = ((unsigned char*)fst2) - FST2_IMAGE_HEADER_SIZE;
+  unsigned int image_size;
+  memcpy(&image_size, image + 8, 4);
+  int must_free_tag_items =
+      (get_allocator_cb_flag(prv_alloc) & AllocatorGetFlagAutoFreePresent) ? 0 : 1;
+  for (int i = 0; must_free_tag_items && (i < fst2->number_of_tags); i++) {
+    Fst2Tag tag = fst2->tags[i];
+    if ((tag->pattern != NULL) && !is_in_fst2_image(tag->pattern, image, image_size))
+      free_pattern(tag->pattern, prv_alloc);
+    struct list_int* list = tag->matching_tokens;
+    while (list != NULL) {
+      struct list_int* next = list->next;
+      if (!is_in_fst2_image(list, image, image_size))
+        free_cb(list, prv_alloc);
+      list = next;
+    }
+  }
+  free(image);
+}
+
+
 #ifdef _DEBUG
 
 bool do_test_pack_int_array(const int* iArray, int nb_item) {
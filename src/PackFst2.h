@@ -56,6 +56,17 @@ Fst2* read_pack_fst2_from_file(const char* filename,
                                Abstract_allocator prv_alloc);
 
 void free_pack_fst2(Fst2* fst2,Abstract_allocator prv_alloc);
+
+Fst2* read_image_fst2_from_memory(const void* buf, size_t size_buf);
+
+Fst2* read_image_fst2_from_file(const char* filename);
+
+bool write_image_fst2(Fst2* fst2load, const char* fst2_image_name, bool fVerbose);
+
+bool convert_fst2_to_fst2_image_file(const char* fst2_name,
+                                     const char* fst2_image_name, bool fVerbose);
+
+void free_image_fst2(Fst2* fst2, Abstract_allocator prv_alloc = STANDARD_ALLOCATOR);
 }
 
 #endif
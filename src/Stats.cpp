@@ -27,6 +27,9 @@
 #include "HashTable.h"
 #include "Vector.h"
 #include "Alphabet.h"
+#include "String_hash.h"
+#include "Ustring.h"
+#include "SyncTool.h"
 #include "UnitexGetOpt.h"
 
 #include "Stats.h"
@@ -40,9 +43,9 @@ namespace unitex {
 // main work functions
 
 int concord_stats(const char* , int , const char *, const char* , const char* , const char*,
-    const VersatileEncodingConfig*, int , int, int );
+    const VersatileEncodingConfig*, int , int, int, int );
 int build_counted_concord(match_list* , text_tokens* , U_FILE* , Alphabet*, int , int , int, vector_ptr** , hash_table** );
-int build_counted_collocates(match_list* , text_tokens* , U_FILE* , Alphabet*, int , int , int, vector_int** , hash_table** , hash_table** , hash_table** );
+int build_counted_collocates(match_list* , text_tokens* , U_FILE* , Alphabet*, int , int , int, int, vector_int** , hash_table** , hash_table** , hash_table** );
 
 // ...main work functions
 
@@ -82,7 +85,8 @@ inline long max_long(long, long);
 vector_int* get_string_in_context_as_token_list(match_list*, int, int, int**, long*, long*, long, text_tokens*, U_FILE*, int, counted_match_descriptor*);
 void print_string_token_list_with_count(U_FILE*,vector_int*, text_tokens*, counted_match_descriptor*);
 int get_buffer_around_token(U_FILE*, int**, long, long, long, long*, long*);
-int count_collocates(U_FILE* , text_tokens* , Alphabet*, int, hash_table* , hash_table** , int* );
+int* get_token_classes(text_tokens*, Alphabet*, int, int*);
+int count_collocates(U_FILE* , text_tokens* , const int*, int, int, int** , int* );
 int is_appropriate_token(int tokenID, text_tokens* tokens);
 
  // sort helper functions
@@ -121,6 +125,7 @@ int is_appropriate_token(int tokenID, text_tokens* tokens);
 
 
 #define STATS_BUFFER_LENGTH 4096
+#define STATS_COD_CHUNK_LENGTH (1 << 22)
 
 
 const char* usage_Stats =
@@ -138,6 +143,8 @@ const char* usage_Stats =
   "  -l N/--left=N: length of left context in tokens\n"
   "  -r N/--right=N: length of right context in tokens\n"
   "  -c N/--case=N: 0=case insensitive, 1=case sensitive (default is 1)\n"
+  "  -j N/--threads=N: number of threads used to count collocates in the whole text\n"
+  "                    in mode 2 (default is 1)\n"
   "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
   "  -h/--help: this help\n"
   "\n"
@@ -149,7 +156,7 @@ static void usage() {
 }
 
 
-const char* optstring_Stats=":m:a:l:r:c:o:Vhk:q:";
+const char* optstring_Stats=":m:a:l:r:c:o:j:Vhk:q:";
 
 const struct option_TS lopts_Stats[]= {
   {"mode",required_argument_TS,NULL,'m'},
@@ -158,6 +165,7 @@ const struct option_TS lopts_Stats[]= {
   {"right",required_argument_TS,NULL,'r'},
   {"case",optional_argument_TS,NULL,'c'},
   {"output",optional_argument_TS,NULL,'o'},
+  {"threads",required_argument_TS,NULL,'j'},
   {"input_encoding",required_argument_TS,NULL,'k'},
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
@@ -171,7 +179,7 @@ if (argc <= 1) {
   return SUCCESS_RETURN_CODE;
 }
 
-int leftContext = 0,  rightContext = 0, mode=-1, caseSensitive = 1;
+int leftContext = 0,  rightContext = 0, mode=-1, caseSensitive = 1, n_threads = 1;
 char concord_ind[FILENAME_MAX]="";
 char tokens_txt[FILENAME_MAX]="";
 char text_cod[FILENAME_MAX]="";
@@ -216,6 +224,11 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Stats,lopts_Stats,&index
             }
             strcpy(output,options.vars()->optarg);
             break;
+  case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+               error("Invalid thread number argument: %s\n",options.vars()->optarg);
+               return USAGE_ERROR_CODE;
+            }
+            break;
   case 'k': if (options.vars()->optarg[0]=='\0') {
               error("Empty input_encoding argument\n");
               return USAGE_ERROR_CODE;
@@ -271,7 +284,8 @@ int return_value = concord_stats(output,
                                  &vec,
                                  leftContext,
                                  rightContext,
-                                 caseSensitive);
+                                 caseSensitive,
+                                 n_threads);
 
 return return_value;
 }
@@ -283,12 +297,13 @@ return return_value;
  * tokens.txt, codname is path to text.cod containing text represented as sequence of token IDs.
  * leftContext and rightContext are number of non-space tokens to look to the left and right from the
  * match to build string for counting. The function is_appropriate_token makes distinction between
- * "space"-like and "regular" tokens to include.
+ * "space"-like and "regular" tokens to include. n_threads is the number of threads used to count
+ * collocates in the whole text in mode 2.
  */
 int concord_stats(const char* outfilename,int mode, const char *concordfname, const char* tokens_path, const char* codname,
                   const char* alphabetName,
                   const VersatileEncodingConfig* vec,
-                  int leftContext, int rightContext, int caseSensitive) {
+                  int leftContext, int rightContext, int caseSensitive, int n_threads) {
   U_FILE* concord = u_fopen(vec, concordfname, U_READ);
   U_FILE* outfile = (outfilename == NULL) ? U_STDOUT : u_fopen(vec, outfilename, U_WRITE);
   U_FILE* cod = u_fopen(BINARY, codname, U_READ);
@@ -412,6 +427,7 @@ int concord_stats(const char* outfilename,int mode, const char *concordfname, co
                                                                leftContext,
                                                                rightContext,
                                                                caseSensitive,
+                                                               n_threads,
                                                                &allMatches,
                                                                &countsPerMatch,
                                                                NULL,
@@ -473,6 +489,7 @@ int concord_stats(const char* outfilename,int mode, const char *concordfname, co
                                                                leftContext,
                                                                rightContext,
                                                                caseSensitive,
+                                                               n_threads,
                                                                &allMatches,
                                                                &countsPerMatch,
                                                                &z_score,
@@ -676,8 +693,11 @@ int build_counted_concord(match_list* matches, text_tokens* tokens, U_FILE* cod,
  * counts per tokens in context. In mode 2, it returns additional 2 hash tables, z_score hash table which
  * represents z-score of a collocate and countsInCorpora hash table which returns total count of a token
  * found in context of a match in the whole corpora.
+ *
+ * Counting is done on token classes (see get_token_classes) with plain int arrays; the hash tables
+ * are only filled once per distinct collocate at the end.
  */
-int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* cod, Alphabet* alphabet, int leftContext, int rightContext, int caseSensitive, vector_int** ret_vector, hash_table** ret_hash, hash_table** z_score, hash_table** countsInCorpora) {
+int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* cod, Alphabet* alphabet, int leftContext, int rightContext, int caseSensitive, int n_threads, vector_int** ret_vector, hash_table** ret_hash, hash_table** z_score, hash_table** countsInCorpora) {
   if (ret_vector == NULL) {
     error("Fatal error in build_counted_collocates, ret_vector cannot be NULL!");
     return DEFAULT_ERROR_CODE;
@@ -707,8 +727,18 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
     return get_buffer_return_value;
   }
 
+  int n_classes;
+  int* tokenClass = get_token_classes(tokens, alphabet, caseSensitive, &n_classes);
+  int* countPerClass = (int*)calloc(n_classes, sizeof(int));
+  if (tokenClass == NULL || countPerClass == NULL) {
+    alloc_error("build_counted_collocates");
+    free(countPerClass);
+    free(tokenClass);
+    free(buffer);
+    return ALLOC_ERROR_CODE;
+  }
+
   any* hash_val = NULL;
-  int hash_ret;
 
   int i;
 
@@ -730,7 +760,7 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
   int totalWindow = 0;
   int_CS_tag* currentKey = NULL;
 
-  // for all matches, we form list of token IDs and check it against hash table
+  // for all matches, we form list of token IDs and count their classes
   while(current_match != NULL) {
     currentMatchList = get_string_in_context_as_token_list(current_match,
                                                              leftContext,
@@ -745,8 +775,8 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
                                                              NULL);
 
     // now we don't just insert the whole match as we did in build_counted_concord, but
-    // for each token in the left and right context we treat it as a possible entry to a hash
-    // table
+    // each token in the left and right context is counted as a possible collocate. The
+    // first token seen for a class represents it in the results
 
     for (i = 0 ; i < currentMatchList->nbelems ; i++) {
       // we don't want space, sentence or stop tokens in results
@@ -755,24 +785,9 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
         continue;
       }
 
-      currentKey = new_int_CS_tag(currentMatchList->tab[i], caseSensitive, tokens, alphabet);
-      if (!currentKey) {
-        free_hash_table(countPerCollocate);
-        free_vector_int(allMatches, NULL);
-        free(buffer);
-        return ALLOC_ERROR_CODE;
-      }
-
-      hash_val = get_value(countPerCollocate, currentKey, HT_INSERT_IF_NEEDED, &hash_ret);
-
-      if (hash_ret == HT_KEY_ADDED) {
-        // new value, we need to set count to 1
-        hash_val->_int = 1;
+      if (countPerClass[tokenClass[currentMatchList->tab[i]]]++ == 0) {
         vector_int_add(allMatches, currentMatchList->tab[i]);
-      } else {
-        hash_val->_int++;
       }
-      free_int_CS_tag(currentKey);
     }
 
     // if we're calculating z-score as well, we have to account for totalWindow score
@@ -809,30 +824,48 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
   }
 
   free(buffer);
+
+  // now we fill the hash table that callers use to get the count of a collocate
+  currentKey = new_int_CS_tag(0, caseSensitive, tokens, alphabet);
+  for (i = 0 ; i < allMatches->nbelems ; i++) {
+    currentKey->tokenID = allMatches->tab[i];
+    hash_val = get_value(countPerCollocate, currentKey, HT_INSERT_IF_NEEDED);
+    hash_val->_int = countPerClass[tokenClass[allMatches->tab[i]]];
+  }
+
   *ret_vector = allMatches;
   *ret_hash   = countPerCollocate;
 
 
   // we don't proceed with calculating z-score unless it's required
   if (z_score == NULL || countsInCorpora == NULL) {
+    free_int_CS_tag(currentKey);
+    free(countPerClass);
+    free(tokenClass);
     return SUCCESS_RETURN_CODE;
   }
 
-  // now we count all collocates in corpus
+  // now we count all token classes in corpus
+  int* countPerClassInCorpora = NULL;
   int count_collocates_return_value = count_collocates(cod,
                                                        tokens,
-                                                       alphabet,
-                                                       caseSensitive,
-                                                       countPerCollocate,
-                                                       &collocateCountInCorpora,
+                                                       tokenClass,
+                                                       n_classes,
+                                                       n_threads,
+                                                       &countPerClassInCorpora,
                                                        &corporaLength);
 
   // return when count_collocates() fails
   if (count_collocates_return_value != SUCCESS_RETURN_CODE) {
+    free_int_CS_tag(currentKey);
+    free(countPerClass);
+    free(tokenClass);
     return count_collocates_return_value;
   }
 
   // now we build z_score hash per collocate
+  collocateCountInCorpora = new_hash_table(hash_token_as_int, tokens_as_int_equal, free_token_as_int, NULL,
+                copy_token_as_int);
   hash_table* zret  = new_hash_table(hash_token_as_int, tokens_as_int_equal, free_token_as_int, free,
                 copy_token_as_int);
   double* tmpZScore = NULL;
@@ -841,14 +874,13 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
   double E;
 
   for (i = 0 ; i < allMatches->nbelems ; i++) {
-    currentKey = new_int_CS_tag(allMatches->tab[i], caseSensitive, tokens, alphabet);
-    hash_val   = get_value(countPerCollocate, currentKey, HT_DONT_INSERT);
-
-    K = hash_val->_int;
+    currentKey->tokenID = allMatches->tab[i];
 
-    hash_val = get_value(collocateCountInCorpora, currentKey, HT_DONT_INSERT);
+    K  = countPerClass[tokenClass[allMatches->tab[i]]];
+    Fc = countPerClassInCorpora[tokenClass[allMatches->tab[i]]];
 
-    Fc = hash_val->_int;
+    hash_val = get_value(collocateCountInCorpora, currentKey, HT_INSERT_IF_NEEDED);
+    hash_val->_int = Fc;
 
     tmpZScore = (double*)malloc(sizeof(double));
 
@@ -859,6 +891,9 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
       free_int_CS_tag(currentKey);
       free_hash_table(countPerCollocate);
       free_vector_int(allMatches, NULL);
+      free(countPerClassInCorpora);
+      free(countPerClass);
+      free(tokenClass);
       return ALLOC_ERROR_CODE;
     }
 
@@ -869,100 +904,171 @@ int build_counted_collocates(match_list* matches, text_tokens* tokens, U_FILE* c
 
     hash_val = get_value(zret, currentKey, HT_INSERT_IF_NEEDED);
     hash_val->_ptr = tmpZScore;
-
-    free_int_CS_tag(currentKey);
   }
 
+  free_int_CS_tag(currentKey);
+  free(countPerClassInCorpora);
+  free(countPerClass);
+  free(tokenClass);
+
   *countsInCorpora = collocateCountInCorpora;
   *z_score         = zret;
   return SUCCESS_RETURN_CODE;
 }
 
 /**
- * This is a helper function for build_counted_collocates. It counts all collocates found for a specific
- * match list in corpora and returns the result as a hash table. Additional result - corpora_length, returns
- * total length of corpora in non-space tokens. Non-space tokens are determined by the result
- * of is_appropriate_token function.
+ * This function gives each token of tokens.txt the ID of its class: in case sensitive mode, a class
+ * is a token ID; in case insensitive mode, tokens that are equal once converted to uppercase with
+ * the alphabet share the same class. The number of classes is stored in n_classes. The returned
+ * array must be freed by the caller; NULL is returned on allocation failure.
  */
-int count_collocates(U_FILE* cod, text_tokens* tokens, Alphabet* alphabet, int caseSensitive, hash_table* collocates, hash_table** ret_hash, int* corpora_length) {
-  if (ret_hash == NULL) {
-    error("Error in count_collocates, ret_hash cannot be null!");
-    return DEFAULT_ERROR_CODE;
+int* get_token_classes(text_tokens* tokens, Alphabet* alphabet, int caseSensitive, int* n_classes) {
+  int* tokenClass = (int*)malloc(sizeof(int) * (tokens->N > 0 ? tokens->N : 1));
+  if (tokenClass == NULL) {
+    return NULL;
   }
-
-  int* buffer   = NULL;
-  long bufferStart;
-  long bufferEnd;
-
-  int get_buffer_return_value = get_buffer_around_token(cod,
-                                                        &buffer,
-                                                        0,
-                                                        0,
-                                                        STATS_BUFFER_LENGTH,
-                                                        &bufferStart,
-                                                        &bufferEnd);
-
-  if(get_buffer_return_value != SUCCESS_RETURN_CODE) {
-    free(buffer);
-    return get_buffer_return_value;
+  int i;
+  if (caseSensitive) {
+    for (i = 0 ; i < tokens->N ; i++) {
+      tokenClass[i] = i;
+    }
+    *n_classes = tokens->N;
+    return tokenClass;
   }
 
-  hash_table* ret = new_hash_table(hash_token_as_int,
-                                   tokens_as_int_equal,
-                                   free_token_as_int,
-                                   NULL,
-                                   copy_token_as_int);
+  struct string_hash* upperTokens = new_string_hash(tokens->N);
+  Ustring* upper = new_Ustring();
+  const unichar* token;
+  int j;
 
-  *corpora_length = 0;
-  int_CS_tag* currentKey = NULL;
-  int hash_ret;
-  any* hash_val = NULL;
-  int i ;
-  long codSize  = get_file_size(cod) / sizeof(int);
-  for (i = 0 ; i < codSize ; i++) {
-    if (i < bufferStart || i > bufferEnd) {
-      get_buffer_return_value = get_buffer_around_token(cod,
-                                                        &buffer,
-                                                        i,
-                                                        0,
-                                                        STATS_BUFFER_LENGTH,
-                                                        &bufferStart,
-                                                        &bufferEnd);
-      if(get_buffer_return_value != SUCCESS_RETURN_CODE) {
-        free(buffer);
-        return get_buffer_return_value;
-      }
+  for (i = 0 ; i < tokens->N ; i++) {
+    empty(upper);
+    token = tokens->token[i];
+    for (j = 0 ; token[j] != '\0' ; j++) {
+      u_strcat(upper, alphabet_to_upper(token[j], alphabet));
     }
+    tokenClass[i] = get_value_index(upper->str, upperTokens);
+  }
 
-    if (is_appropriate_token(buffer[i - bufferStart], tokens)) {
-      (*corpora_length)++;
-    }
+  *n_classes = upperTokens->size;
+  free_Ustring(upper);
+  free_string_hash(upperTokens);
+  return tokenClass;
+}
 
-    currentKey = new_int_CS_tag(buffer[i - bufferStart], caseSensitive, tokens, alphabet);
+/**
+ * This structure describes the work of a count_collocates thread: it counts the token classes of
+ * its part of the text buffer in its own array, the arrays being summed once the whole text.cod
+ * has been read.
+ */
+struct collocates_count_part {
+  const int* text;
+  long length;
+  const int* tokenClass;
+  text_tokens* tokens;
+  int* countPerClass;
+  int corporaLength;
+};
 
-    hash_val = get_value(collocates, currentKey, HT_DONT_INSERT, &hash_ret);
+static void ABSTRACT_CALLBACK_UNITEX count_collocates_thread(void* private_data, unsigned int) {
+  collocates_count_part* part = (collocates_count_part*)private_data;
+  for (long i = 0 ; i < part->length ; i++) {
+    part->countPerClass[part->tokenClass[part->text[i]]]++;
+    if (is_appropriate_token(part->text[i], part->tokens)) {
+      part->corporaLength++;
+    }
+  }
+}
 
-    if (hash_val!=NULL && hash_ret == HT_KEY_ALREADY_THERE) {
-      // this means that we can count this collocate in another hash
+/**
+ * This is a helper function for build_counted_collocates. It counts the tokens of the whole
+ * corpora per token class and returns the result as an array of n_classes integers that must be
+ * freed by the caller. Additional result - corpora_length, returns total length of corpora in
+ * non-space tokens. Non-space tokens are determined by the result of is_appropriate_token function.
+ * text.cod is read by chunks of STATS_COD_CHUNK_LENGTH tokens, each chunk being split between
+ * n_threads threads.
+ */
+int count_collocates(U_FILE* cod, text_tokens* tokens, const int* tokenClass, int n_classes, int n_threads, int** ret_counts, int* corpora_length) {
+  if (ret_counts == NULL) {
+    error("Error in count_collocates, ret_counts cannot be null!");
+    return DEFAULT_ERROR_CODE;
+  }
 
-      int_CS_tag* insertKey = new_int_CS_tag(buffer[i - bufferStart], caseSensitive, tokens, alphabet);
+  if (n_threads < 1) {
+    n_threads = 1;
+  }
 
-      hash_val = get_value(ret, insertKey, HT_INSERT_IF_NEEDED, &hash_ret);
+  long codSize  = get_file_size(cod) / sizeof(int);
+  long chunkLength = min_long(codSize, STATS_COD_CHUNK_LENGTH);
+  int* buffer = (int*)malloc(sizeof(int) * (chunkLength > 0 ? chunkLength : 1));
+  collocates_count_part* parts = (collocates_count_part*)calloc(n_threads, sizeof(collocates_count_part));
+  void** parts_ptr = (void**)malloc(sizeof(void*) * n_threads);
+  if (buffer == NULL || parts == NULL || parts_ptr == NULL) {
+    alloc_error("count_collocates");
+    free(parts_ptr);
+    free(parts);
+    free(buffer);
+    return ALLOC_ERROR_CODE;
+  }
 
-      if (hash_ret == HT_KEY_ADDED) {
-        hash_val->_int = 1;
+  int i, j;
+  for (i = 0 ; i < n_threads ; i++) {
+    parts[i].tokenClass    = tokenClass;
+    parts[i].tokens        = tokens;
+    parts[i].countPerClass = (int*)calloc(n_classes > 0 ? n_classes : 1, sizeof(int));
+    parts_ptr[i]           = &(parts[i]);
+    if (parts[i].countPerClass == NULL) {
+      alloc_error("count_collocates");
+      for (j = 0 ; j <= i ; j++) {
+        free(parts[j].countPerClass);
       }
-      else {
-        hash_val->_int++;
+      free(parts_ptr);
+      free(parts);
+      free(buffer);
+      return ALLOC_ERROR_CODE;
+    }
+  }
+
+  fseek(cod, 0, SEEK_SET);
+  long start, length, partLength;
+  for (start = 0 ; start < codSize ; start += length) {
+    length = min_long(codSize - start, chunkLength);
+    if ((long)fread(buffer, sizeof(int), length, cod) != length) {
+      error("Error in count_collocates, cannot read text.cod!");
+      for (i = 0 ; i < n_threads ; i++) {
+        free(parts[i].countPerClass);
       }
-      free_int_CS_tag(insertKey);
+      free(parts_ptr);
+      free(parts);
+      free(buffer);
+      return DEFAULT_ERROR_CODE;
+    }
+    partLength = (length + n_threads - 1) / n_threads;
+    for (i = 0 ; i < n_threads ; i++) {
+      parts[i].text   = buffer + min_long(length, i * partLength);
+      parts[i].length = min_long(length, (i + 1) * partLength) - min_long(length, i * partLength);
     }
+    if (n_threads == 1) {
+      count_collocates_thread(parts_ptr[0], 0);
+    } else {
+      SyncRunThreads((unsigned int)n_threads, count_collocates_thread, parts_ptr);
+    }
+  }
 
-    free_int_CS_tag(currentKey);
+  // reduction of the counts of all threads in the first one
+  *corpora_length = parts[0].corporaLength;
+  for (i = 1 ; i < n_threads ; i++) {
+    *corpora_length += parts[i].corporaLength;
+    for (j = 0 ; j < n_classes ; j++) {
+      parts[0].countPerClass[j] += parts[i].countPerClass[j];
+    }
+    free(parts[i].countPerClass);
   }
 
-  *ret_hash = ret;
+  *ret_counts = parts[0].countPerClass;
 
+  free(parts_ptr);
+  free(parts);
   free(buffer);
 
   return SUCCESS_RETURN_CODE;
@@ -66,6 +66,16 @@ UNITEX_FUNC void UNITEX_CALL SyncReleaseMutex(SYNC_Mutex_OBJECT pMut);
 UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut);
 
 
+/* Runs thread_func in iNbThread threads and waits for all of them. Each
+ * thread receives privateDataPtrArray[i] and its number i. When threads
+ * are not available (dummy or WinRT build), the calls are made one after
+ * the other in the calling thread */
+typedef void (ABSTRACT_CALLBACK_UNITEX* t_sync_thread_func)(void* privateDataPtr,unsigned int iNumThread);
+
+UNITEX_FUNC int UNITEX_CALL SyncIsSeveralThreadsPossible();
+UNITEX_FUNC void UNITEX_CALL SyncRunThreads(unsigned int iNbThread,t_sync_thread_func thread_func,void** privateDataPtrArray);
+
+
 
 
 #ifdef __cplusplus
@@ -123,6 +123,19 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 }
 
 
+UNITEX_FUNC int UNITEX_CALL SyncIsSeveralThreadsPossible()
+{
+    return 0;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunThreads(unsigned int iNbThread,t_sync_thread_func thread_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    for (i=0;i<iNbThread;i++)
+        (*thread_func)(*(privateDataPtrArray+i),i);
+}
+
+
 
 
 
@@ -140,5 +140,71 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 }
 
 
+typedef struct
+{
+    t_sync_thread_func thread_func;
+    void* privateDataPtr;
+    unsigned int iNumThread;
+} SYNC_THREAD_INFO_INTERNAL;
+
+
+static void* SyncThreadFuncPosix(void* pv)
+{
+    SYNC_THREAD_INFO_INTERNAL* pti = (SYNC_THREAD_INFO_INTERNAL*)pv;
+    (*(pti->thread_func))(pti->privateDataPtr,pti->iNumThread);
+    return NULL;
+}
+
+UNITEX_FUNC int UNITEX_CALL SyncIsSeveralThreadsPossible()
+{
+    return 1;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunThreads(unsigned int iNbThread,t_sync_thread_func thread_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    if (iNbThread == 0)
+        return;
+    if (iNbThread == 1)
+    {
+        (*thread_func)(*privateDataPtrArray,0);
+        return;
+    }
+    pthread_t* pTid = (pthread_t*)malloc(sizeof(pthread_t)*iNbThread);
+    SYNC_THREAD_INFO_INTERNAL* pThreadInfoArray = (SYNC_THREAD_INFO_INTERNAL*)malloc(sizeof(SYNC_THREAD_INFO_INTERNAL)*iNbThread);
+    int* pStarted = (int*)malloc(sizeof(int)*iNbThread);
+    if ((pTid == NULL) || (pThreadInfoArray == NULL) || (pStarted == NULL))
+    {
+        free(pTid);
+        free(pThreadInfoArray);
+        free(pStarted);
+        for (i=0;i<iNbThread;i++)
+            (*thread_func)(*(privateDataPtrArray+i),i);
+        return;
+    }
+
+    for (i=0;i<iNbThread;i++)
+    {
+        (pThreadInfoArray+i)->thread_func = thread_func;
+        (pThreadInfoArray+i)->privateDataPtr = *(privateDataPtrArray+i);
+        (pThreadInfoArray+i)->iNumThread = i;
+        *(pStarted+i) = (pthread_create(pTid+i,NULL,SyncThreadFuncPosix,pThreadInfoArray+i) == 0);
+        if (!(*(pStarted+i)))
+        {
+            /* If the system refuses a new thread, we do the job ourselves */
+            (*thread_func)(*(privateDataPtrArray+i),i);
+        }
+    }
+
+    for (i=0;i<iNbThread;i++)
+        if (*(pStarted+i))
+            pthread_join(*(pTid+i),NULL);
+
+    free(pStarted);
+    free(pThreadInfoArray);
+    free(pTid);
+}
+
+
 
 } // namespace unitex
@@ -189,6 +189,86 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 }
 
 
+#ifdef UNITEX_USING_WINRT_API
+
+UNITEX_FUNC int UNITEX_CALL SyncIsSeveralThreadsPossible()
+{
+    return 0;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunThreads(unsigned int iNbThread,t_sync_thread_func thread_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    for (i=0;i<iNbThread;i++)
+        (*thread_func)(*(privateDataPtrArray+i),i);
+}
+
+#else
+
+typedef struct
+{
+    t_sync_thread_func thread_func;
+    void* privateDataPtr;
+    unsigned int iNumThread;
+} SYNC_THREAD_INFO_INTERNAL;
+
+
+static DWORD WINAPI SyncThreadFuncWin(LPVOID lpv)
+{
+    SYNC_THREAD_INFO_INTERNAL* pti = (SYNC_THREAD_INFO_INTERNAL*)lpv;
+    (*(pti->thread_func))(pti->privateDataPtr,pti->iNumThread);
+    return 0;
+}
+
+UNITEX_FUNC int UNITEX_CALL SyncIsSeveralThreadsPossible()
+{
+    return 1;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunThreads(unsigned int iNbThread,t_sync_thread_func thread_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    if (iNbThread == 0)
+        return;
+    HANDLE* pHandle = (HANDLE*)malloc(sizeof(HANDLE)*iNbThread);
+    SYNC_THREAD_INFO_INTERNAL* pThreadInfoArray = (SYNC_THREAD_INFO_INTERNAL*)malloc(sizeof(SYNC_THREAD_INFO_INTERNAL)*iNbThread);
+    if ((pHandle == NULL) || (pThreadInfoArray == NULL))
+    {
+        free(pHandle);
+        free(pThreadInfoArray);
+        for (i=0;i<iNbThread;i++)
+            (*thread_func)(*(privateDataPtrArray+i),i);
+        return;
+    }
+
+    for (i=0;i<iNbThread;i++)
+    {
+        DWORD dwThreadId;
+        (pThreadInfoArray+i)->thread_func = thread_func;
+        (pThreadInfoArray+i)->privateDataPtr = *(privateDataPtrArray+i);
+        (pThreadInfoArray+i)->iNumThread = i;
+        *(pHandle+i) = CreateThread(NULL,0,SyncThreadFuncWin,pThreadInfoArray+i,0,&dwThreadId);
+        if (*(pHandle+i) == NULL)
+        {
+            /* If the system refuses a new thread, we do the job ourselves */
+            (*thread_func)(*(privateDataPtrArray+i),i);
+        }
+    }
+
+    for (i=0;i<iNbThread;i++)
+        if (*(pHandle+i) != NULL)
+        {
+            WaitForSingleObject(*(pHandle+i),INFINITE);
+            CloseHandle(*(pHandle+i));
+        }
+
+    free(pThreadInfoArray);
+    free(pHandle);
+}
+
+#endif
+
+
 
 
 #endif
@@ -53,6 +53,8 @@ const char* usage_Tagger =
          "  -d DATA/--data=DATA: use the .bin tagger data file containing tuples (unigrams,bigrams and trigrams)"
          " with frequencies\n"
          "  -t TAGSET/--tagset=TAGSET: use the TAGSET ELAG tagset file to normalize the dictionary entries\n"
+         "  -j N/--threads=N: tags the sentences with N threads (default: 1). The result is the same\n"
+         "                    as with a single thread\n"
          "\n"
          "Output options:\n"
          "  -o OUT/--output=OUT: specifies the output .tfst file. By default, the input .tfst is replaced.\n"
@@ -69,11 +71,12 @@ static void usage() {
 }
 
 
-const char* optstring_Tagger=":a:d:t:o:k:q:VhS";
+const char* optstring_Tagger=":a:d:t:o:k:q:VhSj:";
 const struct option_TS lopts_Tagger[]= {
     {"alphabet", required_argument_TS, NULL, 'a'},
     {"data", required_argument_TS, NULL, 'd'},
     {"tagset", required_argument_TS, NULL, 't'},
+    {"threads",required_argument_TS,NULL,'j'},
     {"output",required_argument_TS,NULL,'o'},
     {"input_encoding",required_argument_TS,NULL,'k'},
     {"output_encoding",required_argument_TS,NULL,'q'},
@@ -92,6 +95,8 @@ if (argc==1) {
 
 int val,index=-1;
 int save_statistics=1;
+int n_threads=1;
+char foo;
 char tfst[FILENAME_MAX]="";
 char tind[FILENAME_MAX]="";
 char tmp_tind[FILENAME_MAX]="";
@@ -143,6 +148,12 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Tagger,lopts_Tagger,&ind
              }
              decode_writing_encoding_parameter(&(vec.encoding_output),&(vec.bom_output),options.vars()->optarg);
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'S': save_statistics = 0;
              break;
    case 'V': only_verify_arguments = true;
@@ -193,13 +204,17 @@ if (d==NULL) {
   free_alphabet(alpha);
   return DEFAULT_ERROR_CODE;
 }
+/* We read all the statistics once, so that the dictionary is no
+ * longer needed */
+struct tagger_model* model=new_tagger_model(d);
+free_Dictionary(d);
 
 char* current_tfst = tfst;
-int form_type = get_form_type(d,alpha);
+int form_type = get_form_type(model);
 if(form_type == 1){
     if(tagset[0] == '\0'){
     error("No tagset file specified\n");
-    free_Dictionary(d);
+    free_tagger_model(model);
     free_alphabet(alpha);
     return USAGE_ERROR_CODE;
     }
@@ -209,7 +224,7 @@ if(form_type == 1){
      * necessary.*/
     if(tagset[0] == '\0'){
         error("-t option is mandatory when inflected data file is used\n");
-    free_Dictionary(d);
+    free_tagger_model(model);
     free_alphabet(alpha);
     return USAGE_ERROR_CODE;
     }
@@ -227,7 +242,7 @@ if(form_type == 1){
 Tfst* input_tfst = open_text_automaton(&vec,current_tfst);
 if(input_tfst == NULL) {
   error("Cannot load input .tfst\n");
-  free_Dictionary(d);
+  free_tagger_model(model);
   free_alphabet(alpha);
   return DEFAULT_ERROR_CODE;
 }
@@ -239,7 +254,7 @@ U_FILE* out_tfst=u_fopen(&vec,temp,U_WRITE);
 if (out_tfst==NULL) {
   error("Cannot create output .tfst\n");
   close_text_automaton(input_tfst);
-  free_Dictionary(d);
+  free_tagger_model(model);
   free_alphabet(alpha);
   return DEFAULT_ERROR_CODE;
 }
@@ -249,7 +264,7 @@ if (out_tind==NULL) {
   error("Cannot create output .tind\n");
   u_fclose(out_tfst);
   close_text_automaton(input_tfst);
-  free_Dictionary(d);
+  free_tagger_model(model);
   free_alphabet(alpha);
   return DEFAULT_ERROR_CODE;
 }
@@ -263,7 +278,7 @@ struct hash_table* form_frequencies=new_hash_table((HASH_FUNCTION)hash_unichar,(
         (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
 
 /* launches tagging process on the input tfst file */
-do_tagging(input_tfst,result,d,alpha,form_type,form_frequencies);
+do_tagging(input_tfst,result,model,form_type,form_frequencies,n_threads);
 
 close_text_automaton(input_tfst);
 close_text_automaton(result);
@@ -319,7 +334,7 @@ else {
 }
 
 free_alphabet(alpha);
-free_Dictionary(d);
+free_tagger_model(model);
 
 u_printf("Done.\n");
 return SUCCESS_RETURN_CODE;
@@ -24,6 +24,7 @@
  */
 
 #include "TaggingProcess.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -212,42 +213,6 @@ free_dela_entry(entry);
 return -1;
 }
 
-/**
- * Extracts INF_code of a given token in the dictionary.
- */
-void get_INF_code(Dictionary* d,const unichar* token,
-                  int case_sensitive,int index,int offset,
-                  const Alphabet* alphabet,int* inf_index,Ustring* ustr) {
-int final,n_transitions,inf_number;
-if (d->type!=BIN_CLASSIC) {
-    fatal_error("get_INF_code: unsupported dictionary type\n");
-}
-offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number);
-if (token[index]=='\0') {
-   /* If we are at end of the token */
-   if (final) {
-      /* If the node is final */
-       *inf_index=inf_number;
-   }
-   return;
-}
-unichar c;
-int adr;
-int z=save_output(ustr);
-for(int i=0;i<n_transitions;i++) {
-   /* For each outgoing transition, we look if the transition character is
-    * compatible with the token's one */
-    offset=read_dictionary_transition(d,offset,&c,&adr,ustr);
-   if(case_sensitive == 1 && c == token[index]){
-       get_INF_code(d,token,case_sensitive,index+1,adr,alphabet,inf_index,ustr);
-   }
-   else if(case_sensitive == 0 && is_equal_ignore_case(token[index],c,alphabet)){
-       get_INF_code(d,token,case_sensitive,index+1,adr,alphabet,inf_index,ustr);
-   }
-   restore_output(z,ustr);
-}
-}
-
 /*
  * Returns the value pointed by inf_code in the INF_codes structure.
  */
@@ -269,21 +234,235 @@ free(code);
 return value;
 }
 
-/*
- * Returns the long integer value of a string in the dictionnary
- * according to the extracted INF_codes index.
- * Returns -1 if the string is not in the dictionnary.
+/**
+ * Initializes an empty count table.
+ */
+static void init_count_table(struct tagger_count_table* table,int capacity){
+table->capacity = capacity;
+table->size = 0;
+table->keys = (int*)malloc(3*capacity*sizeof(int));
+table->counts = (long int*)malloc(capacity*sizeof(long int));
+if(table->keys == NULL || table->counts == NULL){
+    fatal_alloc_error("init_count_table");
+}
+for(int i=0;i<3*capacity;i++){
+    table->keys[i] = -1;
+}
+}
+
+/**
+ * Liberates memory used by a count table.
+ */
+static void free_count_table(struct tagger_count_table* table){
+free(table->keys);
+free(table->counts);
+}
+
+static unsigned int hash_count_key(int a,int b,int c){
+unsigned int h = (unsigned int)a*2654435761u;
+h = (h^(unsigned int)b)*2246822519u;
+h = (h^(unsigned int)c)*3266489917u;
+return h^(h>>15);
+}
+
+/**
+ * Returns the slot of the key (a,b,c) in the table, or the empty
+ * slot where it should be inserted.
+ */
+static int find_count_slot(const struct tagger_count_table* table,int a,int b,int c){
+int mask = table->capacity-1;
+int i = (int)(hash_count_key(a,b,c)&(unsigned int)mask);
+for(;;){
+    const int* key = table->keys+3*i;
+    if(key[0] == -1 || (key[0] == a && key[1] == b && key[2] == c)){
+        return i;
+    }
+    i = (i+1)&mask;
+}
+}
+
+/**
+ * Sets the count of the key (a,b,c). a must not be -1.
+ */
+static void put_count(struct tagger_count_table* table,int a,int b,int c,long int count){
+if(2*(table->size+1) > table->capacity){
+    /* we keep the table at most half full */
+    struct tagger_count_table old = *table;
+    init_count_table(table,2*old.capacity);
+    for(int i=0;i<old.capacity;i++){
+        if(old.keys[3*i] != -1){
+            put_count(table,old.keys[3*i],old.keys[3*i+1],old.keys[3*i+2],old.counts[i]);
+        }
+    }
+    free_count_table(&old);
+}
+int i = find_count_slot(table,a,b,c);
+if(table->keys[3*i] == -1){
+    table->keys[3*i] = a;
+    table->keys[3*i+1] = b;
+    table->keys[3*i+2] = c;
+    table->size++;
+}
+table->counts[i] = count;
+}
+
+/**
+ * Returns the count of the key (a,b,c), or -1 if the key is not
+ * in the table. The ids may be -1 for unknown tags or words.
+ */
+static long int get_count(const struct tagger_count_table* table,int a,int b,int c){
+if(a == -1){
+    return -1;
+}
+int i = find_count_slot(table,a,b,c);
+if(table->keys[3*i] == -1){
+    return -1;
+}
+return table->counts[i];
+}
+
+/**
+ * Returns 1 if s starts with the given prefix; 0 otherwise.
+ */
+static int has_prefix(const unichar* s,const char* prefix){
+for(int i=0;prefix[i]!='\0';i++){
+    if(s[i] != (unichar)prefix[i]){
+        return 0;
+    }
+}
+return 1;
+}
+
+/**
+ * Adds a (sequence,value) pair of the tagger data file to the model.
+ * Sequences look like "word_dog", "N\tword_dog", "DET\tN" or "DET\tA\tN".
+ */
+static void add_tagger_model_entry(struct tagger_model* model,const unichar* sequence,long int value){
+unichar tmp[DIC_LINE_SIZE];
+u_strcpy(tmp,sequence);
+unichar* part[3];
+int n = 0;
+part[n++] = tmp;
+for(unichar* s=tmp;*s!='\0';s++){
+    if(*s == '\t'){
+        if(n == 3){
+            /* we only use unigrams, bigrams and trigrams */
+            return;
+        }
+        *s = '\0';
+        part[n++] = s+1;
+    }
+}
+if(n == 1){
+    if(has_prefix(part[0],"word_")){
+        put_count(&model->words_count,get_value_index(part[0]+5,model->words),-1,-1,value);
+    }
+    else if(has_prefix(part[0],"suff_")){
+        put_count(&model->suffixes_count,get_value_index(part[0]+5,model->suffixes),-1,-1,value);
+    }
+    return;
+}
+if(n == 2 && !u_strcmp(part[0],"CODE") && !u_strcmp(part[1],"FEATURES")){
+    model->form_type = value;
+    return;
+}
+int a = get_value_index(part[0],model->tags);
+if(n == 2){
+    if(has_prefix(part[1],"word_")){
+        put_count(&model->emissions,a,get_value_index(part[1]+5,model->words),-1,value);
+    }
+    else if(has_prefix(part[1],"suff_")){
+        put_count(&model->suffix_emissions,a,get_value_index(part[1]+5,model->suffixes),-1,value);
+    }
+    else{
+        put_count(&model->bigrams,a,get_value_index(part[1],model->tags),-1,value);
+    }
+    return;
+}
+put_count(&model->trigrams,a,get_value_index(part[1],model->tags),get_value_index(part[2],model->tags),value);
+}
+
+/**
+ * Explores the tagger data dictionary from the given state, and adds
+ * all the sequences it contains to the model.
  */
-long int get_sequence_integer(const unichar* sequence,Dictionary* d,const Alphabet* alphabet){
-int inf_index = -1;
+static void load_tagger_model_entries(Dictionary* d,int offset,unichar* sequence,int pos,
+                                      Ustring* ustr,struct tagger_model* model){
+int final,n_transitions,inf_number;
+offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number);
+if(final){
+    sequence[pos] = '\0';
+    add_tagger_model_entry(model,sequence,get_inf_value(d->inf,inf_number));
+}
+if(pos == DIC_LINE_SIZE-1){
+    fatal_error("load_tagger_model_entries: sequence too long\n");
+}
+unichar c;
+int adr;
+int z=save_output(ustr);
+for(int i=0;i<n_transitions;i++){
+    offset=read_dictionary_transition(d,offset,&c,&adr,ustr);
+    sequence[pos] = c;
+    load_tagger_model_entries(d,adr,sequence,pos+1,ustr,model);
+    restore_output(z,ustr);
+}
+}
+
+/**
+ * Loads all the statistics of a .bin tagger data file. The Viterbi
+ * computation then uses integer tag and word ids instead of looking up
+ * sequences in the dictionary.
+ */
+struct tagger_model* new_tagger_model(Dictionary* d){
+if (d->type!=BIN_CLASSIC) {
+    fatal_error("new_tagger_model: unsupported dictionary type\n");
+}
+struct tagger_model* model = (struct tagger_model*)malloc(sizeof(struct tagger_model));
+if(model == NULL){
+    fatal_alloc_error("new_tagger_model");
+}
+model->form_type = -1;
+model->tags = new_string_hash(DONT_USE_VALUES);
+model->words = new_string_hash(DONT_USE_VALUES);
+model->suffixes = new_string_hash(DONT_USE_VALUES);
+init_count_table(&model->words_count,1024);
+init_count_table(&model->suffixes_count,1024);
+init_count_table(&model->emissions,1024);
+init_count_table(&model->suffix_emissions,1024);
+init_count_table(&model->bigrams,1024);
+init_count_table(&model->trigrams,1024);
+unichar sequence[DIC_LINE_SIZE];
 Ustring* ustr=new_Ustring();
-get_INF_code(d,sequence,1,0,d->initial_state_offset,alphabet,&inf_index,ustr);
+load_tagger_model_entries(d,d->initial_state_offset,sequence,0,ustr,model);
 free_Ustring(ustr);
-if(inf_index == -1){
-    /* sequence is not in the dictionary */
-    return -1;
+return model;
 }
-return get_inf_value(d->inf,inf_index);
+
+/**
+ * Liberates memory used by a tagger model.
+ */
+void free_tagger_model(struct tagger_model* model){
+if(model == NULL){
+    return;
+}
+free_string_hash(model->tags);
+free_string_hash(model->words);
+free_string_hash(model->suffixes);
+free_count_table(&model->words_count);
+free_count_table(&model->suffixes_count);
+free_count_table(&model->emissions);
+free_count_table(&model->suffix_emissions);
+free_count_table(&model->bigrams);
+free_count_table(&model->trigrams);
+free(model);
+}
+
+/**
+ * Returns the id of the given tag code in the model, or -1 if the
+ * tag code does not appear in the tagger data file.
+ */
+int get_tag_id(struct tagger_model* model,const unichar* tag_code){
+return get_value_index(tag_code,model->tags,DONT_INSERT);
 }
 
 /**
@@ -315,72 +494,30 @@ free(tmp_first);
 return sequence;
 }
 
-/**
- * Creates a new sequence token based on the combining of three tokens.
- * In our case, the tokens could be "N", "A" and "blue". The result is a
- * new unichar "N\tA\tblue".
- */
-unichar* create_trigram_sequence(const unichar* first_token,const unichar* second_token,const unichar* third_token){
-unichar* bigram = create_bigram_sequence(first_token,second_token,1);
-unichar* sequence = (unichar*)malloc(sizeof(unichar)*(2+u_strlen(bigram)+u_strlen(third_token)));
-if(sequence == NULL){
-    fatal_alloc_error("create_trigram_sequence");
-}
-unichar* tmp = u_strcpy_sized(sequence,u_strlen(bigram)+1,bigram);
-free(bigram);
-tmp = u_strcat(tmp,"\t");
-u_strcat(tmp,third_token);
-return sequence;
-}
-
-/**
- * Computes the suffix of size n of a token.
- */
-unichar* u_strnsuffix(const unichar* s,int n){
-unichar* suffix = (unichar*)malloc(sizeof(unichar)*(n+1));
-if(suffix == NULL){
-    fatal_alloc_error("u_strnsuffix");
-}
-for(int i=0;i<=n;i++){
-    suffix[i] = s[(u_strlen(s)-n)+i];
-}
-return suffix;
-}
-
 /**
  * Compute emit probability according to an inflected token associated
  * with a code (semantic and sometimes inflectional codes).
  * This probability is a double value between 0 and 1.
  */
-double compute_emit_probability(Dictionary* d,const Alphabet* alphabet,
-        const unichar* tag,const unichar* inflected){
-const char prefix1[] = "word_";
-unichar* new_inflected = create_bigram_sequence(prefix1,inflected,0);
-unichar* sequence1 = create_bigram_sequence(tag,new_inflected,1);
-long int N1 = get_sequence_integer(new_inflected,d,alphabet);
-long int N2 = get_sequence_integer(sequence1,d,alphabet);
-free(sequence1);
-free(new_inflected);
+double compute_emit_probability(struct tagger_model* model,int tag,const unichar* inflected){
+int word = get_value_index(inflected,model->words,DONT_INSERT);
+long int N1 = get_count(&model->words_count,word,-1,-1);
+long int N2 = get_count(&model->emissions,tag,word,-1);
 if(N1 == -1){
     /* current inflected token is unknown, we apply
      * a suffix-based algorithm to determine its part of speech tag*/
-    if(u_strlen(inflected) < 3){
+    int length = u_strlen(inflected);
+    if(length < 3){
         /* the word is too short to be treated */
         return 0;
     }
     int suffix_length = 4;
-    if(u_strlen(inflected) < 6){
-        suffix_length = u_strlen(inflected) - 2;
-    }
-    unichar* suffix = u_strnsuffix(inflected,suffix_length);
-    const char prefix2[] = "suff_";
-    unichar* seq_suff = create_bigram_sequence(prefix2,suffix,0);
-    N1 = get_sequence_integer(seq_suff,d,alphabet);
-    unichar* sequence2 = create_bigram_sequence(tag,seq_suff,1);
-    N2 = get_sequence_integer(sequence2,d,alphabet);
-    free(sequence2);
-    free(suffix);
-    free(seq_suff);
+    if(length < 6){
+        suffix_length = length - 2;
+    }
+    int suffix = get_value_index(inflected+length-suffix_length,model->suffixes,DONT_INSERT);
+    N1 = get_count(&model->suffixes_count,suffix,-1,-1);
+    N2 = get_count(&model->suffix_emissions,tag,suffix,-1);
 }
 if(N1 == -1){
     N1 = 0;
@@ -397,14 +534,9 @@ return (double)(((double)N2)/(1+((double)(N1))));
  * (semantic and sometimes inflectional codes). This probability is
  * a double value between 0 and 1.
  */
-double compute_transition_probability(Dictionary* d,const Alphabet* alphabet,
-                                     const unichar* ancestor,const unichar* predecessor,const unichar* current){
-unichar* tri_sequence = create_trigram_sequence(ancestor,predecessor,current);
-unichar* bi_sequence = create_bigram_sequence(ancestor,predecessor,1);
-long int C1 = get_sequence_integer(tri_sequence,d,alphabet);
-long int C2 = get_sequence_integer(bi_sequence,d,alphabet);
-free(bi_sequence);
-free(tri_sequence);
+double compute_transition_probability(struct tagger_model* model,int ancestor,int predecessor,int current){
+long int C1 = get_count(&model->trigrams,ancestor,predecessor,current);
+long int C2 = get_count(&model->bigrams,ancestor,predecessor,-1);
 if(C1 == -1){
     C1 = 0;
 }
@@ -426,76 +558,87 @@ void check_compound(unichar* inflected){
     }
 }
 
+/**
+ * Returns the id of the tag code followed by the given BIO suffix ("+B" or "+I").
+ */
+static int get_compound_tag_id(struct tagger_model* model,const unichar* tag_code,const char* suffix){
+unichar* new_tag_code = (unichar*)malloc(sizeof(unichar)*(u_strlen(tag_code)+3));
+if(new_tag_code == NULL){
+    fatal_alloc_error("get_compound_tag_id");
+}
+unichar* tmp = u_strcpy_sized(new_tag_code,u_strlen(tag_code)+1,tag_code);
+u_strcat(tmp,suffix);
+int id = get_tag_id(model,new_tag_code);
+free(new_tag_code);
+return id;
+}
+
 /**
  * Computes partial probability of a outgoing transition of a state (for compounds words only).
- * The system used here is BIO.
+ * The system used here is BIO. 'inflected' is modified but not freed: it
+ * belongs to the caller.
  */
-double compute_partial_probability_compounds(Dictionary* d,const Alphabet* alphabet,
-          unichar* ancestor,unichar* predecessor,unichar* tag_code,unichar* inflected){
+double compute_partial_probability_compounds(struct tagger_model* model,
+          int ancestor,int predecessor,const unichar* tag_code,unichar* inflected){
     check_compound(inflected);
+    int begin_tag = get_compound_tag_id(model,tag_code,"+B");
+    int inside_tag = get_compound_tag_id(model,tag_code,"+I");
     unichar* word = u_strchr(inflected,'_');
     int old_value=0,nb_words=0;
     double score = 0.0;
     while(word != NULL) {
         unichar* simple_word = u_strdup(inflected+old_value,u_strlen(inflected)-old_value-u_strlen(word));
-        unichar* new_tag_code = (unichar*)malloc(sizeof(unichar)*(u_strlen(tag_code)+3));
-        unichar* tmp = u_strcpy_sized(new_tag_code,u_strlen(tag_code)+1,tag_code);
-        if(nb_words == 0){
-            u_strcat(tmp,"+B\0");
-        }
-        else{
-            u_strcat(tmp,"+I\0");
-        }
-        score += compute_emit_probability(d,alphabet,new_tag_code,simple_word);
-        score += compute_transition_probability(d,alphabet,ancestor,predecessor,new_tag_code);
+        int new_tag = (nb_words == 0)?begin_tag:inside_tag;
+        score += compute_emit_probability(model,new_tag,simple_word);
+        score += compute_transition_probability(model,ancestor,predecessor,new_tag);
         nb_words+=1;
         old_value += u_strlen(simple_word)+1;
         word = u_strchr(inflected+old_value,'_');
-        if(nb_words>2){
-            free(ancestor);
-        }
         ancestor = predecessor;
-        predecessor = new_tag_code;
+        predecessor = new_tag;
         free(simple_word);
         if(word == NULL){
             if(u_strlen(inflected)-old_value != 0){
                 word = inflected+old_value;
-                unichar* new_tag_code_2 = (unichar*)malloc(sizeof(unichar)*(u_strlen(tag_code)+3));
-                unichar* tmp_2 = u_strcpy_sized(new_tag_code_2,u_strlen(tag_code)+1,tag_code);
-                u_strcat(tmp_2,"+I\0");
-                score += compute_emit_probability(d,alphabet,new_tag_code_2,word);
-                score += compute_transition_probability(d,alphabet,ancestor,predecessor,new_tag_code_2);
-                free(new_tag_code_2);
-            }
-            if(nb_words>=2){
-                free(ancestor);
-            }
-            if(nb_words>=1){
-                free(predecessor);
+                score += compute_emit_probability(model,inside_tag,word);
+                score += compute_transition_probability(model,ancestor,predecessor,inside_tag);
             }
             break;
         }
     }
-    free(inflected);
     return score;
 }
 
+/**
+ * Computes the tag id of a matrix entry and, for simple words, its emit
+ * probability, which does not depend on the predecessors of the entry.
+ */
+void prepare_matrix_entry(struct tagger_model* model,struct matrix_entry* entry){
+entry->tag_id = get_tag_id(model,entry->tag_code);
+unichar* inflected = compound_to_simple(entry->tag->inflected);
+entry->is_compound = (u_strchr(inflected,'_') != NULL || (u_strchr(inflected,'-') != NULL && inflected[0]!='-'))
+                     && u_strlen(inflected)>2;
+entry->emit_prob = entry->is_compound?0.0:compute_emit_probability(model,entry->tag_id,inflected);
+free(inflected);
+}
+
 /**
  * Computes partial probability of a outgoing transition of a state.
  * This probability is the product of emit and transition probabilities.
  */
-double compute_partial_probability(Dictionary* d,const Alphabet* alphabet,
+double compute_partial_probability(struct tagger_model* model,
                                   struct matrix_entry* ancestor,struct matrix_entry* predecessor,
                                   struct matrix_entry* current){
-unichar* inflected = compound_to_simple(current->tag->inflected);
 /* case : a transition tagged by a compound */
-if((u_strchr(inflected,'_') != NULL || (u_strchr(inflected,'-') != NULL && inflected[0]!='-'))&& u_strlen(inflected)>2){
-    return compute_partial_probability_compounds(d,alphabet,ancestor->tag_code,predecessor->tag_code,current->tag_code,inflected);
+if(current->is_compound){
+    unichar* inflected = compound_to_simple(current->tag->inflected);
+    double prob = compute_partial_probability_compounds(model,ancestor->tag_id,predecessor->tag_id,current->tag_code,
+                                                        inflected);
+    free(inflected);
+    return prob;
 }
-double emit_prob = compute_emit_probability(d,alphabet,current->tag_code,inflected);
-double trans_prob = compute_transition_probability(d,alphabet,ancestor->tag_code,predecessor->tag_code,current->tag_code);
-free(inflected);
-return emit_prob+trans_prob;
+double trans_prob = compute_transition_probability(model,ancestor->tag_id,predecessor->tag_id,current->tag_id);
+return current->emit_prob+trans_prob;
 }
 
 int u_find_char(const unichar* s,unichar t){
@@ -511,9 +654,9 @@ return -1;
  * Calculates partial probability for a transition and if this probability
  * is better than the previous best transition, we replace this one by the new.
  */
-void compute_best_probability(Dictionary* d,const Alphabet* alphabet,
+void compute_best_probability(struct tagger_model* model,
                               struct matrix_entry** matrix,int index_matrix,int indexI,int cover_span){
-double score = cover_span==1?0:compute_partial_probability(d,alphabet,matrix[matrix[indexI]->predecessor],
+double score = cover_span==1?0:compute_partial_probability(model,matrix[matrix[indexI]->predecessor],
                                           matrix[indexI],matrix[index_matrix])+matrix[indexI]->partial_prob;
 if(score > 0 && u_find_char(matrix[index_matrix]->tag->inflected,'_') != -1){
     score +=2;
@@ -660,12 +803,14 @@ return new_tags;
  * Computes the Viterbi Path algorithm to find the best path in
  * the automata and then this path is used to prune transitions.
  */
-vector_ptr* do_viterbi(Dictionary* d,const Alphabet* alphabet,Tfst* input_tfst,int form_type){
+vector_ptr* do_viterbi(struct tagger_model* model,Tfst* input_tfst,int form_type){
 SingleGraph automaton = input_tfst->automaton;
 int index_matrix = 2;
 topological_sort(automaton,NULL);
 compute_reverse_transitions(automaton);
 struct matrix_entry** matrix = initialize_viterbi_matrix(automaton,form_type);
+prepare_matrix_entry(model,matrix[0]);
+prepare_matrix_entry(model,matrix[1]);
 for(int i=0;i<automaton->number_of_states;i++){
     SingleGraphState state = automaton->states[i];
     for(Transition* transO=state->outgoing_transitions;transO!=NULL;transO=transO->next){
@@ -681,10 +826,11 @@ for(int i=0;i<automaton->number_of_states;i++){
             }
             build_tag(matrix[index_matrix]->tag,NULL,tag->content);
         }
+        prepare_matrix_entry(model,matrix[index_matrix]);
         if(is_initial_state(state) != 0){
             /* initial state has no incoming transitions so we
              * calculate probabilities in a separate process */
-            compute_best_probability(d,alphabet,matrix,index_matrix,1,0);
+            compute_best_probability(model,matrix,index_matrix,1,0);
         }
         for(Transition* transI=state->reverted_incoming_transitions;transI!=NULL;transI=transI->next){
             TfstTag* tagI = (TfstTag*)input_tfst->tags->tab[transI->tag_number];
@@ -693,7 +839,7 @@ for(int i=0;i<automaton->number_of_states;i++){
                          transI->tag_number,transI->state_number);
             free(content_2);
             int cover_span = same_positions(&tagI->m,&tag->m);
-            compute_best_probability(d,alphabet,matrix,index_matrix,indexI,cover_span);
+            compute_best_probability(model,matrix,index_matrix,indexI,cover_span);
         }
         index_matrix++;
     }
@@ -710,37 +856,114 @@ return new_tags;
  * this information is encoded in the dictionary
  * at the line "CODE\tFEATURES";returns 0 otherwise.
  */
-int get_form_type(Dictionary* d,const Alphabet* alphabet){
-unichar code_type[DIC_LINE_SIZE];
-u_sprintf(code_type,"CODE\tFEATURES");
-long int value = get_sequence_integer(code_type,d,alphabet);
-if(value == -1){
+int get_form_type(struct tagger_model* model){
+if(model->form_type == -1){
     fatal_error("Bad value in get_form_type\n");
 }
-return (int)value;
+return (int)model->form_type;
+}
+
+/**
+ * A sentence being tagged. 'tfst' holds the per-sentence fields detached
+ * from the input text automaton, and 'new_tags' the tags of the pruned
+ * automaton.
+ */
+struct tagging_sentence {
+    Tfst tfst;
+    vector_ptr* new_tags;
+};
+
+/**
+ * The sentences of a round, shared by all the workers. Each worker takes
+ * the next unprocessed sentence until there is none left.
+ */
+struct tagging_round {
+    struct tagging_sentence* sentences;
+    int n_sentences;
+    int next_sentence;
+    struct tagger_model* model;
+    int form_type;
+    SYNC_Mutex_OBJECT mutex;
+};
+
+static void ABSTRACT_CALLBACK_UNITEX tagging_worker_thread(void* private_data,unsigned int){
+struct tagging_round* round = (struct tagging_round*)private_data;
+for(;;){
+    SyncGetMutex(round->mutex);
+    int k = round->next_sentence;
+    if(k < round->n_sentences){
+        (round->next_sentence)++;
+    }
+    SyncReleaseMutex(round->mutex);
+    if(k >= round->n_sentences){
+        return;
+    }
+    struct tagging_sentence* s = &(round->sentences[k]);
+    s->new_tags = do_viterbi(round->model,&(s->tfst),round->form_type);
+}
 }
 
 /**
  * Computes Viterbi Path algorithm on each sentence of the tfst.
  * This algorithm aims at pruning tokens of the automata in order to
- * obtain a linear path (the most probable path).
+ * obtain a linear path (the most probable path). If n_threads>1, the
+ * sentences are loaded and saved by the main thread, in sentence order,
+ * and tagged by n_threads workers.
  */
-void do_tagging(Tfst* input_tfst,Tfst* result_tfst,Dictionary* d,
-                const Alphabet* alphabet,int form_type,
-                struct hash_table* form_frequencies){
+void do_tagging(Tfst* input_tfst,Tfst* result_tfst,struct tagger_model* model,
+                int form_type,struct hash_table* form_frequencies,int n_threads){
 /* we write the number of sentences in the result tfst file */
 u_fprintf(result_tfst->tfst,"%010d\n",input_tfst->N);
+int max_sentences = (n_threads > 1)?n_threads*TAGGER_SENTENCES_PER_WORKER:1;
+struct tagging_round round;
+round.sentences = (struct tagging_sentence*)malloc(max_sentences*sizeof(struct tagging_sentence));
+if(round.sentences == NULL){
+    fatal_alloc_error("do_tagging");
+}
+round.model = model;
+round.form_type = form_type;
+round.mutex = (n_threads > 1)?SyncBuildMutex():NULL;
+void** w_ptr = NULL;
+if(n_threads > 1){
+    w_ptr = (void**)malloc(n_threads*sizeof(void*));
+    if(w_ptr == NULL){
+        fatal_alloc_error("do_tagging");
+    }
+    for(int i=0;i<n_threads;i++){
+        w_ptr[i] = &round;
+    }
+}
 /* for each sentence we compute Viterbi Path algorithm */
-for(int i=1;i<=input_tfst->N;i++){
-    load_sentence(input_tfst,i);
-    vector_ptr* new_tags = do_viterbi(d,alphabet,input_tfst,form_type);
-    save_current_sentence(input_tfst,result_tfst->tfst,result_tfst->tind,
-            (unichar**)new_tags->tab,new_tags->nbelems,form_frequencies);
-    free_vector_ptr(new_tags,free);
-    if(i%100 == 0){
-        u_printf("Sentence %d/%d...\r",i,input_tfst->N);
+for(int first=1;first<=input_tfst->N;first=first+max_sentences){
+    round.n_sentences = (input_tfst->N-first+1 < max_sentences)?(input_tfst->N-first+1):max_sentences;
+    round.next_sentence = 0;
+    for(int k=0;k<round.n_sentences;k++){
+        load_sentence(input_tfst,first+k);
+        detach_current_sentence(input_tfst,&(round.sentences[k].tfst));
     }
+    if(n_threads > 1){
+        SyncRunThreads((unsigned int)n_threads,tagging_worker_thread,w_ptr);
+    }
+    else{
+        tagging_worker_thread(&round,0);
+    }
+    for(int k=0;k<round.n_sentences;k++){
+        struct tagging_sentence* s = &(round.sentences[k]);
+        save_current_sentence(&(s->tfst),result_tfst->tfst,result_tfst->tind,
+                (unichar**)s->new_tags->tab,s->new_tags->nbelems,form_frequencies);
+        free_vector_ptr(s->new_tags,free);
+        free_current_sentence(&(s->tfst));
+        int i = first+k;
+        if(i%100 == 0){
+            u_printf("Sentence %d/%d...\r",i,input_tfst->N);
+        }
+    }
+}
+if(n_threads > 1){
+    SyncDeleteMutex(round.mutex);
+    free(w_ptr);
 }
+free(round.sentences);
 u_printf("\n");
 }
 
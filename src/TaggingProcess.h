@@ -59,7 +59,9 @@ namespace unitex {
  * that maximizes partial probability), tag_number ( the number of the
  * transition in the automata), state_number (the number of the state
  * where the transition gets away) and a partial_prob (partial probability
- * of the best predecessor).
+ * of the best predecessor). tag_id is the id of tag_code in the tagger
+ * model, is_compound tells whether the inflected form is a compound
+ * word and emit_prob is the emit probability of a simple word.
  */
 struct matrix_entry {
     struct dela_entry* tag;
@@ -68,8 +70,49 @@ struct matrix_entry {
     int tag_number;
     int state_number;
     float partial_prob;
+    int tag_id;
+    int is_compound;
+    double emit_prob;
 };
 
+/**
+ * This structure is an open addressing hash table that associates
+ * counts to keys made of up to three integer ids. Unused ids are -1.
+ */
+struct tagger_count_table {
+    int* keys;
+    long int* counts;
+    int capacity;
+    int size;
+};
+
+/**
+ * This structure contains the statistics of a tagger data file. Tag codes,
+ * words and suffixes are interned once when the model is loaded, so that
+ * computing probabilities only needs integer lookups.
+ */
+struct tagger_model {
+    struct string_hash* tags;
+    struct string_hash* words;
+    struct string_hash* suffixes;
+    /* counts of the "word_XXX" and "suff_XXX" sequences */
+    struct tagger_count_table words_count;
+    struct tagger_count_table suffixes_count;
+    /* counts of the (tag,word) and (tag,suffix) sequences */
+    struct tagger_count_table emissions;
+    struct tagger_count_table suffix_emissions;
+    /* counts of the (tag,tag) and (tag,tag,tag) sequences */
+    struct tagger_count_table bigrams;
+    struct tagger_count_table trigrams;
+    /* value of the "CODE\tFEATURES" sequence, -1 if not found */
+    long int form_type;
+};
+
+/* When the Tagger runs with several threads, the sentences are given to
+ * the workers by rounds of TAGGER_SENTENCES_PER_WORKER sentences per
+ * worker, after which the main thread saves them in sentence order */
+#define TAGGER_SENTENCES_PER_WORKER 16
+
 void compute_tag_code(struct dela_entry*,unichar*,int);
 int create_matrix_entry(const unichar*,struct matrix_entry**,int,int,int);
 struct matrix_entry** allocate_matrix(int);
@@ -79,27 +122,27 @@ void free_viterbi_matrix(struct matrix_entry**,int);
 
 unichar* get_pos_unknown(const unichar*);
 int search_matrix_predecessor(struct matrix_entry**,unichar*,int,int,int);
-void get_INF_code(unsigned char*,const unichar*,int,int,int,const Alphabet*,int*);
 long int get_inf_value(const struct INF_codes*,int);
-long int get_sequence_integer(const unichar*,Dictionary*,const Alphabet*);
+struct tagger_model* new_tagger_model(Dictionary*);
+void free_tagger_model(struct tagger_model*);
+int get_tag_id(struct tagger_model*,const unichar*);
 
 unichar* create_bigram_sequence(const unichar*,const unichar*,int);
 unichar* create_bigram_sequence(const char*,const unichar*,int);
-unichar* create_trigram_sequence(const unichar*,const unichar*,const unichar*);
-unichar* u_strnsuffix(const unichar*,int);
 
-double compute_emit_probability(Dictionary*,const Alphabet*,const unichar*,const unichar*);
-double compute_transition_probability(Dictionary*,const Alphabet*,const unichar*,const unichar*,const unichar*);
-double compute_partial_probability(Dictionary*,const Alphabet*,struct matrix_entry*,struct matrix_entry*,struct matrix_entry*);
+double compute_emit_probability(struct tagger_model*,int,const unichar*);
+double compute_transition_probability(struct tagger_model*,int,int,int);
+void prepare_matrix_entry(struct tagger_model*,struct matrix_entry*);
+double compute_partial_probability(struct tagger_model*,struct matrix_entry*,struct matrix_entry*,struct matrix_entry*);
 int* get_state_sequence(struct matrix_entry**,int);
 int is_compound_word(const unichar*);
 unichar* compound_to_simple(const unichar*);
 vector_ptr* do_backtracking(struct matrix_entry**,int,SingleGraph,vector_ptr*,int);
-void compute_best_probability(Dictionary*,const Alphabet*,struct matrix_entry**,int,int,int);
+void compute_best_probability(struct tagger_model*,struct matrix_entry**,int,int,int);
 
-vector_ptr* do_viterbi(Dictionary*,const Alphabet*,Tfst*,int);
-int get_form_type(Dictionary*,const Alphabet*);
-void do_tagging(Tfst*,Tfst*,Dictionary*,const Alphabet*,int,struct hash_table*);
+vector_ptr* do_viterbi(struct tagger_model*,Tfst*,int);
+int get_form_type(struct tagger_model*);
+void do_tagging(Tfst*,Tfst*,struct tagger_model*,int,struct hash_table*,int n_threads = 1);
 
 } // namespace unitex
 
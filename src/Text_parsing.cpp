@@ -19,6 +19,7 @@
  *
  */
 
+#include <limits.h>
 #include <time.h>
 #include "Text_tokens.h"
 #include "TransductionStack.h"
@@ -32,6 +33,9 @@
 #include "File.h"
 #include "MappedFileHelper.h"
 #include "DebugMode.h"
+#include "SyncTool.h"
+#include "LocateTrace.h"
+#include "base/compiler/intrinsic/atomic.h"    // unitex_atomic_*
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -53,7 +57,7 @@ static struct match_list* eliminate_longer_matches(struct match_list*, int, int,
         unichar*, int*, struct locate_parameters*, Abstract_allocator);
 static struct match_list* eliminate_shorter_matches(struct match_list*, int, int,
         unichar*, int*, struct locate_parameters*, Abstract_allocator);
-static struct match_list* save_matches(struct match_list*, int, U_FILE*,
+static struct match_list* save_matches(struct match_list*, int, struct concord_writer*,
         struct locate_parameters*, Abstract_allocator);
 static inline int at_text_start(struct locate_parameters*,int);
 
@@ -83,22 +87,73 @@ static long CalcPerfHalfHundred(long text_size, long matching_units) {
 }
 
 /**
- * Performs the Locate operation on the text, saving the occurrences
- * on the fly.
+ * Prepares the given locate_parameters for a Locate operation. This must be
+ * done once for the main parameters and once for each worker.
  */
-void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
-        struct locate_parameters* p) {
+static void begin_locate(struct locate_parameters* p) {
     p->token_error_ctx.n_errors = 0;
     p->token_error_ctx.last_start = -1;
     p->token_error_ctx.last_length = 0;
     p->token_error_ctx.n_matches_at_token_pos__locate = 0;
     p->token_error_ctx.n_matches_at_token_pos__morphological_locate = 0;
+    p->current_origin = 0;
+    p->last_origin = 0;
+    p->backup_memory_reserve =
+            create_variable_backup_memory_reserve(p->input_variables,1);
+
+    // add special token constants
+    p->elg->setup_special_constants(p);
+
+    // setup local environment
+    p->elg->setup_local_environment();
+}
+
 
-    //fill_buffer(p->token_buffer, f);
+static void end_locate(struct locate_parameters* p) {
+    free_reserve(p->backup_memory_reserve);
+    p->backup_memory_reserve = NULL;
+}
+
+
+/**
+ * Gives a match found from the current origin to the match selection, or, if
+ * we are in a worker thread, records it so that the main thread can replay it.
+ */
+static void add_match_from_origin(struct match_list* m, struct locate_parameters* p) {
+    if (p->recorded_matches == NULL) {
+        real_add_match(m, p, p->al.prv_alloc_generic);
+        return;
+    }
+    /* The recorded copy is allocated with malloc, because it will be freed by
+     * the main thread, once replayed */
+    vector_ptr_add(p->recorded_matches, new_match(m->m.start_pos_in_token,
+            m->m.end_pos_in_token, m->output, m->weight, NULL));
+    vector_int_add(p->recorded_origins, p->current_origin);
+}
+
+
+/**
+ * Returns a non-zero value if we are a worker thread and if a worker has
+ * found an error. There is no need to go on then, since the main thread
+ * will finish the text alone.
+ */
+static inline int locate_workers_gave_up(struct locate_parameters* p) {
+    return p->shared_error_count != NULL
+           && unitex_atomic_load_long(p->shared_error_count) != 0;
+}
+
+
+/**
+ * Tries to match the grammar from every token in [start;end[. If 'out' is not
+ * NULL, the matches are saved on the fly and the progress is printed;
+ * otherwise, they are recorded in p->recorded_matches. Returns the number of
+ * exploration steps.
+ */
+static unsigned long locate_token_range(int start, int end, struct concord_writer* out,
+        long int text_size, struct locate_parameters* p) {
     OptimizedFst2State initial_state =
             p->optimized_states[p->fst2->initial_states[1]];
-    p->current_origin = 0;
-	  p->last_origin = 0;
+    p->current_origin = start;
     int n_read = 0;
     int unite;
     clock_t startTime = clock();
@@ -106,24 +161,16 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
     unsigned long total_count_step = 0;
 
     unite = (int)(((text_size / 100) > 1000) ? (text_size / 100) : 1000);
-    variable_backup_memory_reserve* backup_reserve =
-            create_variable_backup_memory_reserve(p->input_variables,1);
-    p->backup_memory_reserve = backup_reserve;
     int current_token;
 
-    // add special token constants
-    p->elg->setup_special_constants(p);
-
-    // setup local environment
-    p->elg->setup_local_environment();
-
     int pos = 0;
 
-    while (p->current_origin < p->buffer_size &&
+    while (p->current_origin < end &&
            p->buffer[p->current_origin] < p->tokens->size &&
-          (p->search_limit == -1 || p->number_of_matches < p->search_limit)) {
+          (p->search_limit == -1 || p->number_of_matches < p->search_limit) &&
+           !locate_workers_gave_up(p)) {
 
-        if (unite != 0) {
+        if (unite != 0 && out != NULL) {
             n_read = p->current_origin % unite;
             if (n_read == 0 && ((currentTime = clock()) - startTime > DELAY_PER_SEC)) {
                 startTime = currentTime;
@@ -156,12 +203,15 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
                 for (int i=0;i<p->cached_match_vector->nbelems;i++) {
                     struct match_list* tmp=(struct match_list*)(p->cached_match_vector->tab[i]);
                     while (tmp!=NULL) {
-                        /* We have to adjust the match coordinates */
+                        /* We have to adjust the match coordinates. We do it on a
+                         * copy, since the cache may be read by other threads */
+                        struct match_list adjusted=*tmp;
                         int size=tmp->m.end_pos_in_token-tmp->m.start_pos_in_token;
-                        tmp->m.start_pos_in_token=p->current_origin;
-                        tmp->m.end_pos_in_token=tmp->m.start_pos_in_token+size;
-                        real_add_match(tmp,p,p->al.prv_alloc_generic);
-                        tmp=tmp->next;
+                        adjusted.m.start_pos_in_token=p->current_origin;
+                        adjusted.m.end_pos_in_token=p->current_origin+size;
+                        adjusted.next=NULL;
+                        add_match_from_origin(&adjusted,p);
+                        tmp=(struct match_list*)unitex_atomic_load_ptr(&(tmp->next));
                     }
                 }
             } else {
@@ -235,15 +285,16 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
                     }
                 }
                 struct match_list* tmp;
+                struct match_list* to_cache = NULL;
+                struct match_list* *to_cache_end = &to_cache;
                 while (p->match_cache_first != NULL) {
-                    real_add_match(p->match_cache_first, p, p->al.prv_alloc_generic);
+                    add_match_from_origin(p->match_cache_first, p);
                     tmp = p->match_cache_first;
                     p->match_cache_first = p->match_cache_first->next;
                     if (can_cache_matches &&
                           tmp->m.start_pos_in_token==p->current_origin) {
                         /* We have to test the start position, because a match obtained using a left
-                         * context could cause problems. We have to set tmp->next to NULL because
-                         * we just want to consider this single match */
+                         * context could cause problems */
                         tmp->next=NULL;
                         /* We have to cache the match using the longest possible context and not
                          * only the end of the match. Imagine that the text contains the
@@ -252,15 +303,26 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
                          * then, if the text contains "volley ball meeting", we will find
                          * "volley" in cache and skip longer matches like "volley ball".
                          */
-                        cache_match(tmp, p->buffer,
-                                tmp->m.start_pos_in_token,
-                                p->last_matched_position,
-                                &(p->match_cache[current_token]), p->al.prv_alloc_generic);
+                        *to_cache_end = tmp;
+                        to_cache_end = &(tmp->next);
                     } else {
                         free_match_list_element(tmp, p->al.prv_alloc_generic);
                     }
                 }
                 p->match_cache_last = NULL;
+                if (to_cache != NULL) {
+                    /* All the matches are cached at once, so that a concurrent
+                     * reader cannot see only some of them */
+                    cache_matches(to_cache, p->buffer, p->current_origin,
+                            p->last_matched_position, p->match_cache);
+                    free_match_list(to_cache, p->al.prv_alloc_generic);
+                    if (p->recorded_matches == NULL
+                            && is_LocateCache_table_full(p->match_cache)) {
+                        /* When we are alone, we can empty a full cache right now.
+                         * Worker threads leave this to locate_with_workers */
+                        clear_LocateCache_table(p->match_cache);
+                    }
+                }
                 free_parsing_info(matches,&p->al.pa);
                 if (p->dic_variables != NULL) {
                     clear_dic_variable_list(&(p->dic_variables));
@@ -269,11 +331,258 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
             p->last_origin = p->current_origin;
         }
         reset_Variables(p->input_variables);
-        p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
+        if (out != NULL) {
+            p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
+        }
         (p->current_origin)++;
     } /* End of the big while */
-    free_reserve(backup_reserve);
-    p->backup_memory_reserve = NULL;
+    return total_count_step;
+}
+
+
+/**
+ * A slice of the token buffer processed by a Locate worker, and the matches
+ * the worker has recorded from it. explored_end is the first origin the
+ * worker did not fully explore: it is smaller than end if the workers have
+ * stopped because of an error.
+ */
+struct locate_chunk {
+    int start;
+    int end;
+    int explored_end;
+    vector_ptr* matches;
+    vector_int* origins;
+};
+
+
+/**
+ * The chunks of a round, shared by all the workers. Each worker takes the
+ * next unprocessed chunk until there is none left.
+ */
+struct locate_chunk_queue {
+    struct locate_chunk* chunks;
+    int n_chunks;
+    int next_chunk;
+    SYNC_Mutex_OBJECT mutex;
+};
+
+
+struct locate_worker {
+    struct locate_parameters* p;
+    struct locate_chunk_queue* queue;
+    long int text_size;
+    unsigned long count_step;
+};
+
+
+static void ABSTRACT_CALLBACK_UNITEX locate_worker_thread(void* private_data, unsigned int) {
+    struct locate_worker* w = (struct locate_worker*)private_data;
+    for (;;) {
+        SyncGetMutex(w->queue->mutex);
+        int n = w->queue->next_chunk;
+        if (n < w->queue->n_chunks) {
+            (w->queue->next_chunk)++;
+        }
+        SyncReleaseMutex(w->queue->mutex);
+        if (n >= w->queue->n_chunks) {
+            return;
+        }
+        struct locate_chunk* chunk = &(w->queue->chunks[n]);
+        w->p->recorded_matches = chunk->matches;
+        w->p->recorded_origins = chunk->origins;
+        w->p->error_origin = -1;
+        w->count_step += locate_token_range(chunk->start, chunk->end, NULL,
+                w->text_size, w->p);
+        if (w->p->error_origin != -1) {
+            chunk->explored_end = w->p->error_origin;
+        } else {
+            chunk->explored_end = (w->p->current_origin < chunk->end) ? w->p->current_origin : chunk->end;
+        }
+        w->p->recorded_matches = NULL;
+        w->p->recorded_origins = NULL;
+    }
+}
+
+
+/**
+ * Frees the matches of the given chunk that were not replayed, from the
+ * k-th one.
+ */
+static void drop_locate_chunk(struct locate_chunk* chunk, int k) {
+    for (; k < chunk->matches->nbelems; k++) {
+        free_match_list_element((struct match_list*)(chunk->matches->tab[k]));
+    }
+    chunk->matches->nbelems = 0;
+    chunk->origins->nbelems = 0;
+}
+
+
+/**
+ * Replays, in the main parameters, the matches recorded by a worker for the
+ * given chunk, exactly as if they had been found by the sequential loop, and
+ * saves the matches that cannot be modified anymore. Returns the first
+ * origin that was not replayed, which is the end of the chunk unless the
+ * workers have stopped because of an error.
+ */
+static int replay_locate_chunk(struct locate_chunk* chunk, struct concord_writer* out,
+        struct locate_parameters* p) {
+    int k = 0;
+    for (p->current_origin = chunk->start; p->current_origin < chunk->explored_end; (p->current_origin)++) {
+        while (k < chunk->origins->nbelems && chunk->origins->tab[k] <= p->current_origin) {
+            struct match_list* m = (struct match_list*)(chunk->matches->tab[k]);
+            real_add_match(m, p, p->al.prv_alloc_generic);
+            free_match_list_element(m);
+            k++;
+        }
+        p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
+    }
+    /* The matches from an origin with an error are incomplete */
+    drop_locate_chunk(chunk, k);
+    return chunk->explored_end;
+}
+
+
+/**
+ * Returns the end of the chunk that starts at 'start': we move at least
+ * LOCATE_THREAD_CHUNK_SIZE tokens forward, and then to the next sentence
+ * delimiter, if any, so that chunks are made of whole sentences.
+ */
+static int get_locate_chunk_end(int start, int text_end, struct locate_parameters* p) {
+    int end = start + LOCATE_THREAD_CHUNK_SIZE;
+    if (end >= text_end) {
+        return text_end;
+    }
+    if (p->SENTENCE == -1) {
+        return end;
+    }
+    while (end < text_end && p->buffer[end - 1] != p->SENTENCE) {
+        end++;
+    }
+    return end;
+}
+
+
+/**
+ * Sharded version of the token loop: the text is cut into chunks that are
+ * explored by the workers, and the matches they record are replayed in text
+ * order in 'p', so that the concordance is the same as the sequential one.
+ * Chunks are processed by rounds in order to bound the memory used by
+ * the recorded matches.
+ */
+static unsigned long locate_with_workers(struct concord_writer* out, long int text_size,
+        struct locate_parameters* p, int n_workers, struct locate_parameters** workers) {
+    unsigned long total_count_step = 0;
+    /* We stop at the first invalid token, just like the sequential loop */
+    int text_end = 0;
+    while (text_end < p->buffer_size && p->buffer[text_end] < p->tokens->size) {
+        text_end++;
+    }
+    int max_chunks = n_workers * LOCATE_THREAD_CHUNKS_PER_WORKER;
+    struct locate_chunk_queue queue;
+    queue.chunks = (struct locate_chunk*)malloc(max_chunks * sizeof(struct locate_chunk));
+    struct locate_worker* w = (struct locate_worker*)malloc(n_workers * sizeof(struct locate_worker));
+    void** w_ptr = (void**)malloc(n_workers * sizeof(void*));
+    if (queue.chunks == NULL || w == NULL || w_ptr == NULL) {
+        fatal_alloc_error("locate_with_workers");
+    }
+    for (int i = 0; i < max_chunks; i++) {
+        queue.chunks[i].matches = new_vector_ptr(256);
+        queue.chunks[i].origins = new_vector_int(256);
+    }
+    queue.mutex = SyncBuildMutex();
+    long error_count = 0;
+    for (int i = 0; i < n_workers; i++) {
+        workers[i]->shared_error_count = &error_count;
+        w[i].p = workers[i];
+        w[i].queue = &queue;
+        w[i].text_size = text_size;
+        w[i].count_step = 0;
+        w_ptr[i] = &(w[i]);
+        begin_locate(workers[i]);
+    }
+    int start = 0;
+    int replayed_end = -1;
+    clock_t startTime = clock();
+    clock_t currentTime;
+    while (start < text_end) {
+        queue.n_chunks = 0;
+        queue.next_chunk = 0;
+        while (start < text_end && queue.n_chunks < max_chunks) {
+            queue.chunks[queue.n_chunks].start = start;
+            start = get_locate_chunk_end(start, text_end, p);
+            queue.chunks[queue.n_chunks].end = start;
+            (queue.n_chunks)++;
+        }
+        SyncRunThreads((unsigned int)n_workers, locate_worker_thread, w_ptr);
+        if (is_LocateCache_table_full(p->match_cache)) {
+            /* The workers share the cache, so that it can only be emptied
+             * between two rounds, when nobody reads it */
+            clear_LocateCache_table(p->match_cache);
+        }
+        for (int i = 0; i < queue.n_chunks; i++) {
+            if (replayed_end != -1) {
+                drop_locate_chunk(&(queue.chunks[i]), 0);
+                continue;
+            }
+            int end = replay_locate_chunk(&(queue.chunks[i]), out, p);
+            if (end < queue.chunks[i].end) {
+                replayed_end = end;
+            }
+        }
+        if (replayed_end != -1) {
+            break;
+        }
+        if ((currentTime = clock()) - startTime > DELAY_PER_SEC) {
+            startTime = currentTime;
+            u_printf("%2.2f%% done        \r", 100.0 * (float) start / (float) text_size);
+        }
+    }
+    for (int i = 0; i < n_workers; i++) {
+        end_locate(workers[i]);
+        workers[i]->shared_error_count = NULL;
+        total_count_step += w[i].count_step;
+    }
+    if (replayed_end != -1) {
+        /* The workers have stopped because of an error: we finish the text
+         * alone from the first origin that was not replayed, so that errors
+         * are reported and counted like in the sequential loop. The cache is
+         * emptied first, since it may contain matches cached by the workers
+         * after the error, which could hide errors that the sequential loop
+         * would have reported */
+        clear_LocateCache_table(p->match_cache);
+        total_count_step += locate_token_range(replayed_end, text_end, out, text_size, p);
+    } else {
+        /* The sequential loop leaves current_origin on the first position it did
+         * not process */
+        p->current_origin = text_end;
+    }
+    for (int i = 0; i < max_chunks; i++) {
+        free_vector_ptr(queue.chunks[i].matches);
+        free_vector_int(queue.chunks[i].origins);
+    }
+    SyncDeleteMutex(queue.mutex);
+    free(queue.chunks);
+    free(w_ptr);
+    free(w);
+    return total_count_step;
+}
+
+
+/**
+ * Performs the Locate operation on the text, saving the occurrences
+ * on the fly. If workers are given, the text is explored by them in
+ * parallel.
+ */
+void launch_locate(struct concord_writer* out, long int text_size, U_FILE* info,
+        struct locate_parameters* p, int n_workers, struct locate_parameters** workers) {
+    unsigned long total_count_step = 0;
+    begin_locate(p);
+    if (n_workers > 0 && workers != NULL) {
+        total_count_step = locate_with_workers(out, text_size, p, n_workers, workers);
+    } else {
+        total_count_step = locate_token_range(0, p->buffer_size, out, text_size, p);
+    }
+    end_locate(p);
 
     if ((p->search_limit == -1 || p->number_of_matches < p->search_limit)) {
       p->match_list = save_matches(p->match_list,p->current_origin+1, out, p, p->al.prv_alloc_generic);
@@ -326,12 +635,29 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
  *  If there are more than MAX_ERRORS errors,
  *  exit the programm by calling "fatal_error".
  */
+/**
+ * Notes the first error found by a worker and cancels its exploration:
+ * the main thread will explore this origin again, and report the error.
+ */
+static void stop_worker_at_error(struct locate_parameters* p) {
+    if (p->error_origin == -1) {
+        p->error_origin = p->current_origin;
+        unitex_atomic_add_long(p->shared_error_count, 1);
+    }
+    p->is_in_cancel_state = 3;
+}
+
+
 void error_at_token_pos(const char* message, int start, int length,
         struct locate_parameters* p, const struct optimizedFst2State* current_state) {
     //static int n_errors;
     //static int last_start=-1;
     //static int last_length;
     int i;
+    if (p->shared_error_count != NULL) {
+        stop_worker_at_error(p);
+        return;
+    }
     if ((p->token_error_ctx.last_start) == start) {
         /* The context was already printed */
         return;
@@ -420,7 +746,14 @@ int locate(OptimizedFst2State current_state,
   int locate_matches = n_matches->maingraph;
 
   // call locate
-  core_tokenized_locate(current_state, pos, matches, n_matches, ctx, p);
+  if (p->profile == NULL) {
+    core_tokenized_locate(current_state, pos, matches, n_matches, ctx, p);
+  } else {
+    struct locate_profile_visit visit;
+    begin_profiled_visit(p->profile, &visit, current_state->control & 1);
+    core_tokenized_locate(current_state, pos, matches, n_matches, ctx, p);
+    end_profiled_visit(p->profile, &visit, current_state->pos_transition_in_fst2);
+  }
 
   // restore the minimal unit of analysis
   p->locate_mode = locate_mode;
@@ -757,11 +1090,19 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
 
                 struct locate_n_matches n_local_matches;
 
+                struct locate_profile_visit frame;
+                if (p->profile != NULL) {
+                    begin_profiled_frame(p->profile, &frame);
+                }
                 locate(/*graph_depth + 1,*/ /* Exploration of the subgraph */
                        p->optimized_states[p->fst2->initial_states[graph_call_list->graph_number]],
                        pos, &L, &n_local_matches, NULL, /* ctx is set to NULL because the end of a context must occur in the
                          * same graph than its beginning */
                        p);
+                if (p->profile != NULL) {
+                    end_profiled_call(p->profile, &frame, current_state->pos_transition_in_fst2,
+                                      graph_call_list->graph_number, L == NULL);
+                }
 
                 n_matches->maingraph += n_local_matches.maingraph;
                 n_matches->subgraph  += n_local_matches.subgraph;
@@ -1591,6 +1932,9 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
             /* Otherwise, we just indicate that we have found a context closing mark,
              * and we return */
             ctx->n = 1;
+            if (p->profile != NULL) {
+                locate_profile_success(p->profile);
+            }
             if (ctx->output==NULL) {
                 p->literal_output->buffer[p->literal_output->top+1]='\0';
                 set_list_context_output(ctx,p->literal_output->buffer);
@@ -2019,32 +2363,131 @@ static void add_match(int end, unichar* output, struct locate_parameters* p, Abs
 }
 
 
+/**
+ * Returns the position in the match index of the first match whose range
+ * is not lesser than [start;end], in (start,end) order.
+ */
+static int find_in_match_index(struct locate_parameters* p, int start, int end) {
+int min=0;
+int max=p->match_index_size;
+while (min<max) {
+    int middle=min+(max-min)/2;
+    struct match_list* m=p->match_index[middle];
+    if (m->m.start_pos_in_token<start
+        || (m->m.start_pos_in_token==start && m->m.end_pos_in_token<end)) {
+        min=middle+1;
+    } else {
+        max=middle;
+    }
+}
+return min;
+}
+
+
+/**
+ * Makes sure that the match index can receive one more match.
+ */
+static void grow_match_index(struct locate_parameters* p) {
+if (p->match_index_size<p->match_index_capacity) return;
+p->match_index_capacity=(p->match_index_capacity==0)?256:2*p->match_index_capacity;
+p->match_index=(struct match_list**)realloc(p->match_index,
+                   p->match_index_capacity*sizeof(struct match_list*));
+if (p->match_index==NULL) {
+    fatal_alloc_error("grow_match_index");
+}
+}
+
+
+/**
+ * Adds the given match at the end of the match index. The match is
+ * supposed to be already linked at the end of p->match_list.
+ */
+static void add_to_match_index(struct locate_parameters* p, struct match_list* m) {
+grow_match_index(p);
+p->match_index[(p->match_index_size)++]=m;
+}
+
+
+/**
+ * Inserts the given match at the position n of both the match index
+ * and p->match_list.
+ */
+static void insert_in_match_index(struct locate_parameters* p, int n, struct match_list* m) {
+grow_match_index(p);
+if (n==0) {
+    m->next=p->match_list;
+    p->match_list=m;
+} else {
+    m->next=p->match_index[n-1]->next;
+    p->match_index[n-1]->next=m;
+}
+memmove(p->match_index+n+1,p->match_index+n,(p->match_index_size-n)*sizeof(struct match_list*));
+p->match_index[n]=m;
+(p->match_index_size)++;
+}
+
+
 static void insert_in_all_matches_mode(struct match_list* m, struct locate_parameters* p, Abstract_allocator prv_alloc) {
 int start = m->m.start_pos_in_token;
 int end = m->m.end_pos_in_token;
 unichar* output = m->output;
-struct match_list* *L=&(p->match_list);
-while (*L != NULL) {
-    if ((*L)->m.start_pos_in_token == start
-        && (*L)->m.end_pos_in_token == end
-        && (p->ambiguous_output_policy != ALLOW_AMBIGUOUS_OUTPUTS || !u_strcmp((*L)->output, output))) {
+/* Matches with the same range follow each other in the list, so we only
+ * have to look at them, starting from the first one */
+int n=find_in_match_index(p,start,end);
+while (n<p->match_index_size
+       && p->match_index[n]->m.start_pos_in_token == start
+       && p->match_index[n]->m.end_pos_in_token == end) {
+    struct match_list* l=p->match_index[n];
+    if (p->ambiguous_output_policy != ALLOW_AMBIGUOUS_OUTPUTS || !u_strcmp(l->output, output)) {
         /* The match is already there, nothing to do */
-        if (p->ambiguous_output_policy!=ALLOW_AMBIGUOUS_OUTPUTS && u_strcmp((*L)->output, output)) {
+        if (p->ambiguous_output_policy!=ALLOW_AMBIGUOUS_OUTPUTS && u_strcmp(l->output, output)) {
             /* If ambiguous outputs are forbidden, we emit an error message */
-            error("Unexpected ambiguous outputs:\n<%S>\n<%S>\n",(*L)->output,output);
+            error("Unexpected ambiguous outputs:\n<%S>\n<%S>\n",l->output,output);
         }
         return;
     }
-    if (start<(*L)->m.start_pos_in_token ||
-            (start==(*L)->m.start_pos_in_token && end<(*L)->m.end_pos_in_token)) {
-        /* We have to insert at the current position */
-        (*L)=new_match(start, end, output, -1, *L, prv_alloc);
-        return;
+    n++;
+}
+/* We insert the match after the ones with the same range */
+insert_in_match_index(p,n,new_match(start, end, output, -1, NULL, prv_alloc));
+}
+
+
+/**
+ * Does the same as filter_on_weight_matches_with_same_start in ALL_MATCHES
+ * mode, where matches with the same start are contiguous in the match index.
+ */
+static void filter_on_weight_in_match_index(struct locate_parameters* p, int start,
+            int weight, int *dont_add_new_match, Abstract_allocator prv_alloc) {
+int first=find_in_match_index(p,start,INT_MIN);
+int n=first;
+int kept=first;
+while (n<p->match_index_size && p->match_index[n]->m.start_pos_in_token==start) {
+    struct match_list* l=p->match_index[n];
+    if (l->weight>weight) {
+        /* There is at least one match with a bigger weight, we must remove
+         * the new match */
+        *dont_add_new_match=1;
+        break;
+    }
+    n++;
+    if (l->weight<weight) {
+        /* The current match must be discarded */
+        free_match_list_element(l,prv_alloc);
+        continue;
     }
-    L = &((*L)->next);
+    p->match_index[kept++]=l;
+}
+if (kept==n) return;
+/* We remove the discarded matches from the index, and we relink the list */
+memmove(p->match_index+kept,p->match_index+n,(p->match_index_size-n)*sizeof(struct match_list*));
+p->match_index_size=p->match_index_size-(n-kept);
+struct match_list* next=(kept<p->match_index_size)?p->match_index[kept]:NULL;
+if (kept==0) {
+    p->match_list=next;
+} else {
+    p->match_index[kept-1]->next=next;
 }
-/* End of list? We add the match */
-(*L) = new_match(start, end, output, -1, NULL, prv_alloc);
 }
 
 static struct match_list* filter_on_weight_matches_with_same_start(struct match_list* l,int start,
@@ -2092,8 +2535,12 @@ static void real_add_match(struct match_list* m, struct locate_parameters* p, Ab
      * rule: if there is a match starting at the same position than the new one,
      * then we filter them according to their weights */
     dont_add_match=0;
-    p->match_list=filter_on_weight_matches_with_same_start(p->match_list,start,
-            weight,&dont_add_match,prv_alloc);
+    if (p->match_policy == ALL_MATCHES) {
+        filter_on_weight_in_match_index(p,start,weight,&dont_add_match,prv_alloc);
+    } else {
+        p->match_list=filter_on_weight_matches_with_same_start(p->match_list,start,
+                weight,&dont_add_match,prv_alloc);
+    }
     if (dont_add_match) {
         /* There is already a match better than the new one, so we are done */
         return;
@@ -2101,6 +2548,9 @@ static void real_add_match(struct match_list* m, struct locate_parameters* p, Ab
     if (p->match_list == NULL) {
         /* If the match list was empty, we always can put the match in the list */
         p->match_list = new_match(start, end, output, weight, NULL, prv_alloc);
+        if (p->match_policy == ALL_MATCHES) {
+            add_to_match_index(p,p->match_list);
+        }
         return;
     }
     switch (p->match_policy) {
@@ -2282,14 +2732,14 @@ static struct match_list* eliminate_shorter_matches(struct match_list *ptr, int
  * <E>/[[ <MIN>* <PRE> <MIN>* <E>/]]
  * left-most stehen am Anfang der Liste
  */
-static struct match_list* save_matches(struct match_list* l, int current_position,
-        U_FILE* f, struct locate_parameters* p, Abstract_allocator prv_alloc) {
+static struct match_list* save_matches(struct match_list* list, int current_position,
+        struct concord_writer* f, struct locate_parameters* p, Abstract_allocator prv_alloc) {
 struct match_list* ptr;
-
-    if (l == NULL) {
-        return NULL;
-    }
-
+struct match_list* *L = &list;
+/* The matches we keep are the new content of the match index */
+p->match_index_size = 0;
+while (*L != NULL) {
+    struct match_list* l = *L;
     if (l->m.end_pos_in_token < current_position) {
         /* we can save the match (necessary for SHORTEST_MATCHES: there
          * may be no shorter match) */
@@ -2299,23 +2749,25 @@ struct match_list* ptr;
          *   1) offset in token
          *   2) offset in char inside the token
          *   3) offset in logical letter inside the current char (for Korean) */
-        u_fprintf(f, "%d.0.0 %d.%d.0", l->m.start_pos_in_token,
-                l->m.end_pos_in_token, u_strlen(
-                        p->tokens->value[p->buffer[l->m.end_pos_in_token]]) - 1);
-        if (l->output != NULL) {
-            /* If there is an output */
-            if (!p->debug) {
-                /* Normal mode */
-                u_fprintf(f, " %S", l->output);
-            } else {
-                /* In debug mode, we save the normal (non debug) mode output,
-                 * before the debug one */
-                u_fprintf(f, " ");
-                save_real_output_from_debug(f,p->real_output_policy,l->output);
-                u_fputs(l->output,f);
-            }
+        Match m;
+        m.start_pos_in_token = l->m.start_pos_in_token;
+        m.start_pos_in_char = 0;
+        m.start_pos_in_letter = 0;
+        m.end_pos_in_token = l->m.end_pos_in_token;
+        m.end_pos_in_char = p->token_length[p->buffer[l->m.end_pos_in_token]] - 1;
+        m.end_pos_in_letter = 0;
+        if (l->output == NULL || !p->debug) {
+            write_concord_match(f, &m, l->output);
+        } else {
+            /* In debug mode, we save the normal (non debug) mode output,
+             * before the debug one */
+            flush_concord_writer(f);
+            u_fprintf(f->f, "%d.0.0 %d.%d.0 ", m.start_pos_in_token,
+                    m.end_pos_in_token, m.end_pos_in_char);
+            save_real_output_from_debug(f->f,p->real_output_policy,l->output);
+            u_fputs(l->output,f->f);
+            u_fprintf(f->f, "\n");
         }
-        u_fprintf(f, "\n");
         if (p->ambiguous_output_policy == ALLOW_AMBIGUOUS_OUTPUTS) {
             (p->number_of_outputs)++;
             /* If we allow different outputs for ambiguous transducers,
@@ -2412,7 +2864,8 @@ struct match_list* ptr;
                 l = l->next;
                 free_match_list_element(ptr, prv_alloc);
             }
-            return NULL;
+            *L = NULL;
+            return list;
           }
           else {
           // if ambiguous outputs are allowed and we have reached the search
@@ -2433,12 +2886,16 @@ struct match_list* ptr;
           }
         }
 
-        ptr = l->next;
+        *L = l->next;
         free_match_list_element(l, prv_alloc);
-        return save_matches(ptr, current_position, f, p, prv_alloc);
+        continue;
     }
-    l->next = save_matches(l->next, current_position, f, p, prv_alloc);
-    return l;
+    if (p->match_policy == ALL_MATCHES) {
+        add_to_match_index(p, l);
+    }
+    L = &(l->next);
+}
+return list;
 }
 
 /**
@@ -65,8 +65,16 @@ namespace unitex {
 /* we try to known if user request cancel each COUNT_CANCEL_TRYING_INIT_CONST locate */
 #define COUNT_CANCEL_TRYING_INIT_CONST (1024)
 
+/* minimal number of tokens of a chunk explored by a Locate worker thread;
+ * a chunk is then extended up to the next {S} */
+#define LOCATE_THREAD_CHUNK_SIZE 16384
+
+/* number of chunks per worker thread explored before the main thread
+ * writes the matches found so far */
+#define LOCATE_THREAD_CHUNKS_PER_WORKER 8
+
 void error_at_token_pos(const char* message,int start,int length,struct locate_parameters* p,const struct optimizedFst2State*);
-void launch_locate(U_FILE*,long int,U_FILE*,struct locate_parameters*);
+void launch_locate(struct concord_writer*,long int,U_FILE*,struct locate_parameters*,int n_workers=0,struct locate_parameters** workers=NULL);
 void core_tokenized_locate(/*int,*/OptimizedFst2State,int,/*int,*/struct parsing_info**,struct locate_n_matches*,struct list_context*,struct locate_parameters*);
 unichar* get_token_sequence(struct locate_parameters*, int, int);
 
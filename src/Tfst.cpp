@@ -24,6 +24,7 @@
 #include "Tfst.h"
 #include "File.h"
 #include "TfstStats.h"
+#include "String_hash.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -31,7 +32,8 @@
 
 namespace unitex {
 
-void free_current_sentence(Tfst*);
+static Tfst* open_binary_text_automaton(const char*);
+static void load_binary_sentence(Tfst*,int);
 
 
 
@@ -46,6 +48,9 @@ if (t==NULL) {
 t->N=N;
 t->tfst=tfst;
 t->tind=tind;
+t->binary=NULL;
+t->binary_data=NULL;
+t->binary_size=0;
 t->current_sentence=NO_SENTENCE_LOADED;
 t->text=NULL;
 t->tokens=NULL;
@@ -66,6 +71,10 @@ void close_text_automaton(Tfst* t) {
 if (t==NULL) return;
 if (t->tfst!=NULL) u_fclose(t->tfst);
 if (t->tind!=NULL) u_fclose(t->tind);
+if (t->binary!=NULL) {
+   af_release_mapfile_pointer(t->binary,t->binary_data);
+   af_close_mapfile(t->binary);
+}
 free_current_sentence(t);
 free(t);
 }
@@ -77,8 +86,16 @@ free(t);
  *  - the .tfst does not exist
  *  - the .tind does not exist
  *  - the .tfst does not start by a number >0
+ *
+ * If the file name ends with .tfstb, it is supposed to be a binary text
+ * automaton, and there is no .tind.
  */
 Tfst* open_text_automaton(const VersatileEncodingConfig* vec,const char* tfst) {
+char extension[FILENAME_MAX];
+get_extension(tfst,extension);
+if (!strcmp(extension,".tfstb")) {
+   return open_binary_text_automaton(tfst);
+}
 char tind[FILENAME_MAX];
 remove_extension(tfst,tind);
 strcat(tind,".tind");
@@ -227,6 +244,25 @@ return tag;
 }
 
 
+/**
+ * Moves the current sentence of 'tfst' into 'sentence', so that the next
+ * call to load_sentence does not free it. 'sentence' must then be freed
+ * with free_current_sentence.
+ */
+void detach_current_sentence(Tfst* tfst,Tfst* sentence) {
+memcpy(sentence,tfst,sizeof(Tfst));
+tfst->current_sentence=NO_SENTENCE_LOADED;
+tfst->text=NULL;
+tfst->tokens=NULL;
+tfst->token_sizes=NULL;
+tfst->token_content=NULL;
+tfst->offset_in_tokens=-1;
+tfst->offset_in_chars=-1;
+tfst->automaton=NULL;
+tfst->tags=NULL;
+}
+
+
 /**
  * Loads the given sentence of the given text automaton.
  */
@@ -240,6 +276,10 @@ if (n<=0 || n>tfst->N) {
 if (tfst->current_sentence!=NO_SENTENCE_LOADED) {
    free_current_sentence(tfst);
 }
+if (tfst->binary!=NULL) {
+   load_binary_sentence(tfst,n);
+   return;
+}
 tfst->current_sentence=n;
 long offset=get_sentence_offset(tfst,n);
 fseek(tfst->tfst,offset,SEEK_SET);
@@ -499,6 +539,401 @@ fatal_error("Invalid tag type %d in TfstTag_to_string\n",t->type);
 }
 
 
+/*
+ * A binary text automaton (.tfstb) holds the same information as a .tfst
+ * and its .tind, but it can be used without any parsing. All integers are
+ * 4-byte little-endian ones, except file offsets that use 8 bytes, and
+ * strings are made of a length followed by 2-byte little-endian characters.
+ *
+ * Header:
+ *    "UTFSTB01"
+ *    number of sentences N
+ *    number of distinct tag contents
+ *    offset of the sentence index: N sentence offsets
+ *    offset of the content index: one offset per tag content
+ *
+ * Sentence:
+ *    sentence number
+ *    text
+ *    number of tokens, token numbers, token sizes
+ *    offset in tokens, offset in chars
+ *    number of states S, number of transitions T
+ *    S+1 indexes in the transition arrays: the transitions of state #i are
+ *    those in [index[i];index[i+1]), in the order of the Transition lists
+ *    S final flags
+ *    T tag numbers, T destination states
+ *    number of tags, including the epsilon one #0
+ *    for each other tag: content number and the 6 positions of its Match
+ *
+ * Tag contents are shared by all sentences, so that a tag like {the,.DET}
+ * is stored only once.
+ */
+#define TFSTB_MAGIC "UTFSTB01"
+#define TFSTB_HEADER_SIZE 32
+
+
+static int read_tfstb_int(const unsigned char* *p) {
+const unsigned char* q=*p;
+(*p)=(*p)+4;
+return (int)((uint32_t)q[0] | ((uint32_t)q[1]<<8) | ((uint32_t)q[2]<<16) | ((uint32_t)q[3]<<24));
+}
+
+
+static long read_tfstb_offset(const unsigned char* p) {
+uint64_t n=0;
+for (int i=7;i>=0;i--) {
+   n=(n<<8)|p[i];
+}
+return (long)n;
+}
+
+
+/**
+ * Reads a string from the given position and returns an allocated copy of it.
+ */
+static unichar* read_tfstb_string(const unsigned char* *p) {
+int length=read_tfstb_int(p);
+unichar* s=(unichar*)malloc((length+1)*sizeof(unichar));
+if (s==NULL) {
+   fatal_alloc_error("read_tfstb_string");
+}
+const unsigned char* q=*p;
+for (int i=0;i<length;i++) {
+   s[i]=(unichar)(q[2*i] | (q[2*i+1]<<8));
+}
+s[length]='\0';
+(*p)=(*p)+2*length;
+return s;
+}
+
+
+/**
+ * Maps the given .tfstb file. Returns NULL if it is not a valid one.
+ */
+static Tfst* open_binary_text_automaton(const char* tfstb) {
+ABSTRACTMAPFILE* map=af_open_mapfile(tfstb,MAPFILE_OPTION_READ,0);
+if (map==NULL) {
+   error("Cannot open file %s\n",tfstb);
+   return NULL;
+}
+size_t size=af_get_mapfile_size(map);
+const unsigned char* data=(size<TFSTB_HEADER_SIZE)?NULL:(const unsigned char*)af_get_mapfile_pointer(map);
+if (data==NULL || memcmp(data,TFSTB_MAGIC,8)) {
+   error("%s is not a binary text automaton\n",tfstb);
+   if (data!=NULL) af_release_mapfile_pointer(map,data);
+   af_close_mapfile(map);
+   return NULL;
+}
+const unsigned char* p=data+8;
+int N=read_tfstb_int(&p);
+int n_contents=read_tfstb_int(&p);
+long sentence_index=read_tfstb_offset(data+16);
+long content_index=read_tfstb_offset(data+24);
+if (N<=0 || n_contents<0 || sentence_index<TFSTB_HEADER_SIZE || content_index<TFSTB_HEADER_SIZE
+    || (size_t)sentence_index+8*(size_t)N>size || (size_t)content_index+8*(size_t)n_contents>size) {
+   error("Corrupted binary text automaton %s\n",tfstb);
+   af_release_mapfile_pointer(map,data);
+   af_close_mapfile(map);
+   return NULL;
+}
+Tfst* t=new_Tfst(NULL,NULL,N);
+t->binary=map;
+t->binary_data=data;
+t->binary_size=size;
+return t;
+}
+
+
+/**
+ * Returns an allocated copy of the tag content #n of the given binary text automaton.
+ */
+static unichar* get_tfstb_content(Tfst* tfst,int n) {
+const unsigned char* data=tfst->binary_data;
+const unsigned char* p=data+12;
+if (n<0 || n>=read_tfstb_int(&p)) {
+   fatal_error("load_sentence: invalid tag content number %d\n",n);
+}
+p=data+read_tfstb_offset(data+read_tfstb_offset(data+24)+8*n);
+return read_tfstb_string(&p);
+}
+
+
+/**
+ * Loads the given sentence from a binary text automaton. The result is the
+ * same as with the .tfst, including the order of transitions.
+ */
+static void load_binary_sentence(Tfst* tfst,int n) {
+const unsigned char* data=tfst->binary_data;
+long offset=read_tfstb_offset(data+read_tfstb_offset(data+16)+8*(n-1));
+if (offset<TFSTB_HEADER_SIZE || (size_t)offset>=tfst->binary_size) {
+   fatal_error("load_sentence: invalid offset for sentence %d\n",n);
+}
+const unsigned char* p=data+offset;
+if (read_tfstb_int(&p)!=n) {
+   fatal_error("load_sentence: Invalid sentence header: should be $%d\n",n);
+}
+tfst->current_sentence=n;
+tfst->text=read_tfstb_string(&p);
+int n_tokens=read_tfstb_int(&p);
+tfst->tokens=new_vector_int(n_tokens>0?n_tokens:1);
+tfst->token_sizes=new_vector_int(n_tokens>0?n_tokens:1);
+for (int i=0;i<n_tokens;i++) {
+   vector_int_add(tfst->tokens,read_tfstb_int(&p));
+}
+for (int i=0;i<n_tokens;i++) {
+   vector_int_add(tfst->token_sizes,read_tfstb_int(&p));
+}
+tfst->offset_in_tokens=read_tfstb_int(&p);
+tfst->offset_in_chars=read_tfstb_int(&p);
+/* Now, we build the states */
+int n_states=read_tfstb_int(&p);
+int n_transitions=read_tfstb_int(&p);
+const unsigned char* first_transition=p;
+const unsigned char* final=first_transition+4*(n_states+1);
+const unsigned char* tag_numbers=final+4*n_states;
+const unsigned char* destinations=tag_numbers+4*n_transitions;
+tfst->automaton=new_SingleGraph(n_states>0?n_states:1,INT_TAGS);
+for (int i=0;i<n_states;i++) {
+   SingleGraphState s=add_state(tfst->automaton);
+   if (i==0) {
+      /* By convention, the first state is initial */
+      set_initial_state(s);
+   }
+   const unsigned char* q=final+4*i;
+   if (read_tfstb_int(&q)) {
+      set_final_state(s);
+   }
+   q=first_transition+4*i;
+   int start=read_tfstb_int(&q);
+   int end=read_tfstb_int(&q);
+   /* Transitions are inserted at the head of the list, so we add them backward */
+   for (int j=end-1;j>=start;j--) {
+      const unsigned char* tag=tag_numbers+4*j;
+      const unsigned char* dest=destinations+4*j;
+      add_outgoing_transition(s,read_tfstb_int(&tag),read_tfstb_int(&dest));
+   }
+}
+/* And the tags */
+p=destinations+4*n_transitions;
+int n_tags=read_tfstb_int(&p);
+tfst->tags=new_vector_ptr(n_tags>0?n_tags:1);
+vector_ptr_add(tfst->tags,new_TfstTag(T_EPSILON));
+for (int i=1;i<n_tags;i++) {
+   TfstTag* tag=new_TfstTag(T_STD);
+   tag->content=get_tfstb_content(tfst,read_tfstb_int(&p));
+   tag->m.start_pos_in_token=read_tfstb_int(&p);
+   tag->m.start_pos_in_char=read_tfstb_int(&p);
+   tag->m.start_pos_in_letter=read_tfstb_int(&p);
+   tag->m.end_pos_in_token=read_tfstb_int(&p);
+   tag->m.end_pos_in_char=read_tfstb_int(&p);
+   tag->m.end_pos_in_letter=read_tfstb_int(&p);
+   vector_ptr_add(tfst->tags,tag);
+}
+}
+
+
+/**
+ * A growable byte buffer used to build a .tfstb sentence before writing it.
+ */
+struct tfstb_buffer {
+   unsigned char* data;
+   size_t size;
+   size_t capacity;
+};
+
+
+static void add_tfstb_bytes(struct tfstb_buffer* b,const unsigned char* bytes,size_t n) {
+if (b->size+n>b->capacity) {
+   while (b->size+n>b->capacity) {
+      b->capacity=2*b->capacity;
+   }
+   b->data=(unsigned char*)realloc(b->data,b->capacity);
+   if (b->data==NULL) {
+      fatal_alloc_error("add_tfstb_bytes");
+   }
+}
+memcpy(b->data+b->size,bytes,n);
+b->size=b->size+n;
+}
+
+
+static void add_tfstb_int(struct tfstb_buffer* b,int n) {
+uint32_t u=(uint32_t)n;
+unsigned char t[4];
+t[0]=(unsigned char)(u&0xFF);
+t[1]=(unsigned char)((u>>8)&0xFF);
+t[2]=(unsigned char)((u>>16)&0xFF);
+t[3]=(unsigned char)((u>>24)&0xFF);
+add_tfstb_bytes(b,t,4);
+}
+
+
+static void add_tfstb_offset(struct tfstb_buffer* b,long offset) {
+uint64_t u=(uint64_t)offset;
+unsigned char t[8];
+for (int i=0;i<8;i++) {
+   t[i]=(unsigned char)((u>>(8*i))&0xFF);
+}
+add_tfstb_bytes(b,t,8);
+}
+
+
+static void add_tfstb_string(struct tfstb_buffer* b,const unichar* s) {
+int length=u_strlen(s);
+add_tfstb_int(b,length);
+for (int i=0;i<length;i++) {
+   unsigned char t[2];
+   t[0]=(unsigned char)(s[i]&0xFF);
+   t[1]=(unsigned char)((s[i]>>8)&0xFF);
+   add_tfstb_bytes(b,t,2);
+}
+}
+
+
+static void write_tfstb_buffer(struct tfstb_buffer* b,U_FILE* f) {
+if (b->size!=0 && b->size!=fwrite(b->data,1,b->size,f)) {
+   fatal_error("Write error on .tfstb file\n");
+}
+b->size=0;
+}
+
+
+/**
+ * Saves the sentence currently loaded in 'tfst' into the given buffer.
+ */
+static void add_tfstb_sentence(struct tfstb_buffer* b,Tfst* tfst,struct string_hash* contents) {
+add_tfstb_int(b,tfst->current_sentence);
+add_tfstb_string(b,tfst->text);
+add_tfstb_int(b,tfst->tokens->nbelems);
+for (int i=0;i<tfst->tokens->nbelems;i++) {
+   add_tfstb_int(b,tfst->tokens->tab[i]);
+}
+for (int i=0;i<tfst->token_sizes->nbelems;i++) {
+   add_tfstb_int(b,tfst->token_sizes->tab[i]);
+}
+add_tfstb_int(b,tfst->offset_in_tokens);
+add_tfstb_int(b,tfst->offset_in_chars);
+SingleGraph g=tfst->automaton;
+int n_transitions=0;
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      n_transitions++;
+   }
+}
+add_tfstb_int(b,g->number_of_states);
+add_tfstb_int(b,n_transitions);
+n_transitions=0;
+for (int i=0;i<g->number_of_states;i++) {
+   add_tfstb_int(b,n_transitions);
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      n_transitions++;
+   }
+}
+add_tfstb_int(b,n_transitions);
+for (int i=0;i<g->number_of_states;i++) {
+   add_tfstb_int(b,is_final_state(g->states[i]));
+}
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      add_tfstb_int(b,t->tag_number);
+   }
+}
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      add_tfstb_int(b,t->state_number);
+   }
+}
+add_tfstb_int(b,tfst->tags->nbelems);
+for (int i=1;i<tfst->tags->nbelems;i++) {
+   TfstTag* tag=(TfstTag*)(tfst->tags->tab[i]);
+   add_tfstb_int(b,get_value_index(tag->content,contents));
+   add_tfstb_int(b,tag->m.start_pos_in_token);
+   add_tfstb_int(b,tag->m.start_pos_in_char);
+   add_tfstb_int(b,tag->m.start_pos_in_letter);
+   add_tfstb_int(b,tag->m.end_pos_in_token);
+   add_tfstb_int(b,tag->m.end_pos_in_char);
+   add_tfstb_int(b,tag->m.end_pos_in_letter);
+}
+}
+
+
+/**
+ * Saves the given .tfst text automaton as a binary .tfstb one.
+ * Returns 1 in case of success; 0 otherwise.
+ */
+int save_binary_text_automaton(const VersatileEncodingConfig* vec,const char* tfst,const char* tfstb) {
+Tfst* in=open_text_automaton(vec,tfst);
+if (in==NULL) {
+   return 0;
+}
+U_FILE* out=u_fopen(BINARY,tfstb,U_WRITE);
+if (out==NULL) {
+   error("Cannot create %s\n",tfstb);
+   close_text_automaton(in);
+   return 0;
+}
+long* sentence_offsets=(long*)malloc(in->N*sizeof(long));
+if (sentence_offsets==NULL) {
+   fatal_alloc_error("save_binary_text_automaton");
+}
+struct tfstb_buffer b;
+b.capacity=4096;
+b.size=0;
+b.data=(unsigned char*)malloc(b.capacity);
+if (b.data==NULL) {
+   fatal_alloc_error("save_binary_text_automaton");
+}
+struct string_hash* contents=new_string_hash();
+/* We reserve the space for the header */
+unsigned char header[TFSTB_HEADER_SIZE];
+memset(header,0,TFSTB_HEADER_SIZE);
+add_tfstb_bytes(&b,header,TFSTB_HEADER_SIZE);
+write_tfstb_buffer(&b,out);
+for (int i=1;i<=in->N;i++) {
+   load_sentence(in,i);
+   sentence_offsets[i-1]=ftell(out);
+   add_tfstb_sentence(&b,in,contents);
+   write_tfstb_buffer(&b,out);
+}
+/* Then the tag contents and their index... */
+long* content_offsets=(long*)malloc((contents->size+1)*sizeof(long));
+if (content_offsets==NULL) {
+   fatal_alloc_error("save_binary_text_automaton");
+}
+for (int i=0;i<contents->size;i++) {
+   content_offsets[i]=ftell(out);
+   add_tfstb_string(&b,contents->value[i]);
+   write_tfstb_buffer(&b,out);
+}
+long content_index=ftell(out);
+for (int i=0;i<contents->size;i++) {
+   add_tfstb_offset(&b,content_offsets[i]);
+}
+write_tfstb_buffer(&b,out);
+/* ...the sentence index... */
+long sentence_index=ftell(out);
+for (int i=0;i<in->N;i++) {
+   add_tfstb_offset(&b,sentence_offsets[i]);
+}
+write_tfstb_buffer(&b,out);
+/* ...and finally the header */
+add_tfstb_bytes(&b,(const unsigned char*)TFSTB_MAGIC,8);
+add_tfstb_int(&b,in->N);
+add_tfstb_int(&b,contents->size);
+add_tfstb_offset(&b,sentence_index);
+add_tfstb_offset(&b,content_index);
+fseek(out,0,SEEK_SET);
+write_tfstb_buffer(&b,out);
+u_fclose(out);
+free(b.data);
+free(content_offsets);
+free(sentence_offsets);
+free_string_hash(contents);
+close_text_automaton(in);
+return 1;
+}
+
+
 /**
  * This function fills the 'token_content' field of the given tfst
  */
@@ -54,6 +54,12 @@ typedef struct {
    U_FILE* tfst;
    U_FILE* tind;
 
+   /* When the text automaton is a binary .tfstb file, it is mapped in memory
+    * and the two files above are NULL */
+   ABSTRACTMAPFILE* binary;
+   const unsigned char* binary_data;
+   size_t binary_size;
+
    /* Number of the current sentence */
    int current_sentence;
 
@@ -127,8 +133,11 @@ typedef struct {
 
 Tfst* new_Tfst(U_FILE* tfst,U_FILE* tind,int N);
 Tfst* open_text_automaton(const VersatileEncodingConfig*,const char* tfst);
+int save_binary_text_automaton(const VersatileEncodingConfig*,const char* tfst,const char* tfstb);
 void close_text_automaton(Tfst* tfst);
 void load_sentence(Tfst* tfst,int n);
+void free_current_sentence(Tfst* tfst);
+void detach_current_sentence(Tfst* tfst,Tfst* sentence);
 void save_current_sentence(Tfst* tfst,U_FILE* out_tfst,U_FILE* tind,unichar** tags,int n_tags,
                             struct hash_table* form_frequencies);
 
@@ -36,6 +36,8 @@
 #include "Token.h"
 #include "Offsets.h"
 #include "Overlap.h"
+#include "SyncTool.h"
+#include "Ustring.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -48,10 +50,12 @@ namespace unitex {
 
 static void sort_and_save_by_frequence(U_FILE*,vector_ptr*,vector_int*);
 static void sort_and_save_by_alph_order(U_FILE*,vector_ptr*,vector_int*);
-static void compute_statistics(U_FILE*,vector_ptr*,Alphabet*,int,int,int,int);
+static void compute_statistics(U_FILE*,vector_ptr*,const Alphabet*,int,int,int,int);
 static int tokenization(U_FILE*,U_FILE*,U_FILE*,Alphabet*,vector_ptr*,struct hash_table*,vector_int*,
         vector_int*,vector_int*,
-           int*,int*,int*,int*,U_FILE*,vector_offset*,int);
+           int*,int*,int*,int*,U_FILE*,vector_offset*,int,const U_MAPPED_TEXT*);
+static int parallel_tokenization(U_FILE*,U_FILE*,U_FILE*,Alphabet*,vector_ptr*,struct hash_table*,vector_int*,
+        vector_int*,vector_int*,int*,int*,int*,int*,int,int,const U_MAPPED_TEXT*);
 static void save_new_line_positions(U_FILE*,vector_int*);
 static int load_token_file(char* filename, const VersatileEncodingConfig*,vector_ptr* tokens,struct hash_table* hashtable,vector_int* n_occur);
 
@@ -107,12 +111,13 @@ static void usage() {
   u_printf(usage_Tokenize);
 }
 
-const char* optstring_Tokenize=":a:cwt:Vhk:q:$:@:";
+const char* optstring_Tokenize=":a:cwt:j:Vhk:q:$:@:";
 const struct option_TS lopts_Tokenize[]={
   {"alphabet", required_argument_TS, NULL, 'a'},
   {"char_by_char", no_argument_TS, NULL, 'c'},
   {"word_by_word", no_argument_TS, NULL, 'w'},
   {"tokens", required_argument_TS, NULL, 't'},
+  {"threads", required_argument_TS, NULL, 'j'},
   {"input_encoding",required_argument_TS,NULL,'k'},
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"input_offsets",required_argument_TS,NULL,'$'},
@@ -149,6 +154,8 @@ char* out_offsets = (buffer_filename + (step_filename_buffer * 3));
 VersatileEncodingConfig vec=VEC_DEFAULT;
 int val,index=-1;
 int mode=NORMAL;
+int n_threads=1;
+char foo;
 bool only_verify_arguments = false;
 UnitexGetOpt options;
 while (EOF!=(val=options.parse_long(argc,argv,optstring_Tokenize,lopts_Tokenize,&index))) {
@@ -169,6 +176,12 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Tokenize,lopts_Tokenize,
              }
              strcpy(token_file,options.vars()->optarg);
              break;
+   case 'j': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                error("Invalid thread number argument: %s\n",options.vars()->optarg);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'k': if (options.vars()->optarg[0]=='\0') {
                 error("Empty input_encoding argument\n");
                 free(buffer_filename);
@@ -374,11 +387,33 @@ int SENTENCES=0;
 int TOKENS_TOTAL=0;
 int WORDS_TOTAL=0;
 int DIGITS_TOTAL=0;
+/* If possible, the text is mapped and scanned in place */
+U_MAPPED_TEXT* mapped=u_map_text(text,argv[options.vars()->optind]);
+if (n_threads>1) {
+   if (f_out_offsets!=NULL) {
+      /* Offsets are computed with a state that depends on the whole
+       * text before the current token */
+      error("Offsets are produced, working with a single thread\n");
+      n_threads=1;
+   } else if (!SyncIsSeveralThreadsPossible()) {
+      error("Threads are not available, working with a single thread\n");
+      n_threads=1;
+   }
+}
 u_printf("Tokenizing text...\n");
-int result_tokenization = tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
+int result_tokenization;
+if (n_threads>1) {
+   u_printf("Working with %d threads...\n",n_threads);
+   result_tokenization = parallel_tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
+                          snt_offsets,
+                          &SENTENCES,&TOKENS_TOTAL,&WORDS_TOTAL,&DIGITS_TOTAL,(mode!=NORMAL),n_threads,mapped);
+} else {
+   result_tokenization = tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
                           snt_offsets,
                           &SENTENCES,&TOKENS_TOTAL,&WORDS_TOTAL,&DIGITS_TOTAL,f_out_offsets,
-                          v_in_offsets,(mode!=NORMAL));
+                          v_in_offsets,(mode!=NORMAL),mapped);
+}
+u_unmap_text(mapped);
 u_printf((result_tokenization == 0) ? "\nDone.\n" : "\nTokenization error.\n");
 save_new_line_positions(enter,n_enter_pos);
 if (!save_snt_offsets(snt_offsets,snt_offsets_pos)) {
@@ -587,7 +622,7 @@ case B_INCLUDES_A: {
 }
 
 
-#define TOKENIZE_WRITE_BUFFER_SIZE 0x80
+#define TOKENIZE_WRITE_BUFFER_SIZE 0x4000
 static void fast_fwrite_raw_flush(U_FILE* f, unsigned char*out_buffer, unsigned int* pos_out_buffer)
 {
     if ((*pos_out_buffer) > 0)
@@ -606,26 +641,52 @@ static inline void fast_fwrite_raw(U_FILE* f, int n, unsigned char*out_buffer, u
 
 #define TOKENIZE_GET_BUFFER_SIZE 0x200
 
-static inline int fast_u_fgetc_raw(U_FILE* f, unichar*buffer,unsigned int* pos_in_buffer, unsigned int* filled_in_buffer)
-{
-    for (;;)
-    {
-        if ((*pos_in_buffer) < (*filled_in_buffer))
-        {
-            int c = (int)*(buffer + (*pos_in_buffer));
-            (*pos_in_buffer)++;
-            return c;
-        }
+/**
+ * The text read by 'tokenization': either a mapped text, that is scanned in
+ * place, or a file that is read through a small buffer.
+ */
+struct tokenize_input {
+   U_FILE* f;
+   const unichar* text;
+   size_t pos;
+   size_t filled;
+   unichar buffer[TOKENIZE_GET_BUFFER_SIZE];
+};
 
-        *filled_in_buffer = 0;
-        *pos_in_buffer = 0;
-        int res = u_fget_unichars_raw(buffer, TOKENIZE_GET_BUFFER_SIZE, f);
-        if (res == 0)
-            return EOF;
-        if (res < 0)
-            return res;
-        *filled_in_buffer = res;
-    }
+
+static void init_tokenize_input(struct tokenize_input* input,U_FILE* f,const U_MAPPED_TEXT* mapped) {
+if (mapped!=NULL) {
+   input->f=NULL;
+   input->text=mapped->text;
+   input->filled=mapped->length;
+} else {
+   input->f=f;
+   input->text=input->buffer;
+   input->filled=0;
+}
+input->pos=0;
+}
+
+
+static inline int tokenize_getc(struct tokenize_input* input) {
+if (input->pos<input->filled) {
+   return input->text[input->pos++];
+}
+if (input->f==NULL) {
+   return EOF;
+}
+input->pos=0;
+input->filled=0;
+int res=u_fget_unichars_raw(input->buffer,TOKENIZE_GET_BUFFER_SIZE,input->f);
+if (res==0) {
+   return EOF;
+}
+if (res<0) {
+   return res;
+}
+input->filled=res;
+input->pos=1;
+return input->buffer[0];
 }
 
 static int enlarge_token_buffer_as_needed(unichar** token_buffer, size_t *buffer_size, size_t size_needed)
@@ -667,19 +728,18 @@ static int tokenization(U_FILE* f_read,U_FILE* coded_text,U_FILE* output,Alphabe
                          vector_int* snt_offsets,
                          int *SENTENCES,int *TOKENS_TOTAL,int *WORDS_TOTAL,
                          int *DIGITS_TOTAL,U_FILE* f_out_offsets,vector_offset* v_in_offsets,
-                         int char_by_char) {
+                         int char_by_char,const U_MAPPED_TEXT* mapped) {
 int c;
 int n;
 char ENTER;
 int COUNT=0;
 int current_megabyte=0;
 int shift=0;
-unichar read_buffer[TOKENIZE_GET_BUFFER_SIZE];
+struct tokenize_input input;
+init_tokenize_input(&input,f_read,mapped);
 unsigned char write_buffer[(TOKENIZE_WRITE_BUFFER_SIZE * 4) + 0x10];
-unsigned int pos_in_buffer = 0;
-unsigned int filled_in_buffer = 0;
 unsigned int pos_out_buffer = 0;
-c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
+c = tokenize_getc(&input);
 int current_pos;
 int snt_offsets_shift=0;
 int offset_index=0;
@@ -702,7 +762,7 @@ while ((c!=EOF) && (result == 0)) {
       ENTER=0;
       if (c==0x0d || c==0x0a) ENTER=1;
       // if the char is a separator, we jump all the separators
-      while ((c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) == ' ' || c == 0x0d || c == 0x0a || c == '\t') {
+      while ((c = tokenize_getc(&input)) == ' ' || c == 0x0d || c == 0x0a || c == '\t') {
         if (c==0x0d || c==0x0a) ENTER=1;
         COUNT++;
       }
@@ -726,7 +786,7 @@ while ((c!=EOF) && (result == 0)) {
      token_buffer[0]='{';
      int z=1;
      bool protected_char = false; // Cassys add
-     while ((((c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) != '}' && c
+     while ((((c = tokenize_getc(&input)) != '}' && c
                     != '{' && c != '\n') || protected_char)) {
             protected_char = false; // Cassys add
             if (c == '\\') { // Cassys add
@@ -770,7 +830,7 @@ while ((c!=EOF) && (result == 0)) {
      result=save_token_offset(f_out_offsets,token_buffer,n,current_pos,COUNT,v_in_offsets,&offset_index,&shift);
      (*TOKENS_TOTAL)++;
      fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
-     c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
+     c = tokenize_getc(&input);
    }
    else {
       token_buffer[0]=(unichar)c;
@@ -784,10 +844,10 @@ while ((c!=EOF) && (result == 0)) {
          (*TOKENS_TOTAL)++;
          if (c>='0' && c<='9') (*DIGITS_TOTAL)++;
          fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
-         c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
+         c = tokenize_getc(&input);
       }
       else {
-          while (EOF != (c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) && is_letter((unichar)c, alph)) {
+          while (EOF != (c = tokenize_getc(&input)) && is_letter((unichar)c, alph)) {
            enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, n + 2);
            token_buffer[n++]=(unichar)c;
            COUNT++;
@@ -817,6 +877,446 @@ return SUCCESS_RETURN_CODE;
 }
 
 
+/* In multi-threaded mode, the text is read by rounds of TOKENIZE_CHUNK_SIZE
+ * chars per thread, so that the memory used does not depend on the text size */
+#define TOKENIZE_CHUNK_SIZE (1<<22)
+
+#define CHUNK_NO_ERROR 0
+#define CHUNK_TAG_WITHOUT_END 1
+#define CHUNK_INVALID_TAG 2
+
+/**
+ * A piece of text tokenized by a worker thread. Tokens are numbered in a
+ * local table, in the order of their first occurrence in the chunk. Token
+ * positions in 'n_enter_pos' and 'snt_offsets' are relative to the chunk.
+ */
+struct tokenize_chunk {
+   const unichar* text;
+   int length;
+   const Alphabet* alph;
+   int char_by_char;
+
+   vector_ptr* tokens;
+   struct hash_table* hashtable;
+   vector_int* n_occur;
+   vector_int* codes;
+   vector_int* n_enter_pos;
+   vector_int* snt_offsets;
+   int snt_offsets_shift;
+   int SENTENCES;
+   int TOKENS_TOTAL;
+   int WORDS_TOTAL;
+   int DIGITS_TOTAL;
+
+   /* Global number of each local token, filled when the chunk is merged */
+   int* renumber;
+
+   int error;
+   unichar* error_tag;
+};
+
+
+static inline int is_separator(unichar c) {
+return c==' ' || c==0x0d || c==0x0a || c=='\t';
+}
+
+
+/**
+ * Returns the first position in [from;to[ where the text can be cut, or 'to'
+ * if there is none. A cut must be at the start of a separator sequence, and
+ * not inside a tag. 'lower' must be a known cut, like the start of the buffer.
+ */
+static int find_chunk_boundary(const unichar* text,int lower,int from,int to,const Alphabet* alph) {
+int pos=(from>lower)?from:lower+1;
+while (pos<to) {
+   if (!is_separator(text[pos]) || is_separator(text[pos-1]) || is_letter(text[pos],alph)) {
+      pos++;
+      continue;
+   }
+   /* We look back for the nearest '{', or for a '}' or a new line that
+    * would close a tag. Those preceded by a backslash may be protected
+    * chars inside a tag, so they don't tell anything */
+   int i;
+   for (i=pos-1;i>lower;i--) {
+      if (text[i]=='{') break;
+      if ((text[i]=='}' || text[i]=='\n') && text[i-1]!='\\') break;
+   }
+   if (text[i]!='{') {
+      return pos;
+   }
+   /* We are inside a tag, so we go to its end */
+   bool protected_char=false;
+   for (pos=i+1;pos<to && ((text[pos]!='}' && text[pos]!='{' && text[pos]!='\n') || protected_char);pos++) {
+      protected_char=(text[pos]=='\\');
+   }
+   pos++;
+}
+return to;
+}
+
+
+static struct tokenize_chunk* new_tokenize_chunks(int n,const Alphabet* alph,int char_by_char) {
+struct tokenize_chunk* chunks=(struct tokenize_chunk*)calloc(n,sizeof(struct tokenize_chunk));
+if (chunks==NULL) {
+   fatal_alloc_error("new_tokenize_chunks");
+}
+for (int i=0;i<n;i++) {
+   chunks[i].alph=alph;
+   chunks[i].char_by_char=char_by_char;
+   chunks[i].n_occur=new_vector_int(4096);
+   chunks[i].codes=new_vector_int(TOKENIZE_CHUNK_SIZE/4);
+   chunks[i].n_enter_pos=new_vector_int(4096);
+   chunks[i].snt_offsets=new_vector_int(4096);
+}
+return chunks;
+}
+
+
+/**
+ * Prepares the chunk for a new round.
+ */
+static void reset_tokenize_chunk(struct tokenize_chunk* chunk,const unichar* text,int length) {
+chunk->text=text;
+chunk->length=length;
+chunk->tokens=new_vector_ptr(4096);
+chunk->hashtable=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)((EQUAL_UNICHAR_FUNCTION)u_equal),
+                                (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
+chunk->n_occur->nbelems=0;
+chunk->codes->nbelems=0;
+chunk->n_enter_pos->nbelems=0;
+chunk->snt_offsets->nbelems=0;
+chunk->snt_offsets_shift=0;
+chunk->SENTENCES=0;
+chunk->TOKENS_TOTAL=0;
+chunk->WORDS_TOTAL=0;
+chunk->DIGITS_TOTAL=0;
+chunk->renumber=NULL;
+chunk->error=CHUNK_NO_ERROR;
+chunk->error_tag=NULL;
+}
+
+
+/**
+ * Frees what was allocated for the current round. Tokens that were moved to
+ * the global table have been replaced by NULL.
+ */
+static void clear_tokenize_chunk(struct tokenize_chunk* chunk) {
+free_vector_ptr(chunk->tokens,free);
+chunk->tokens=NULL;
+free_hash_table(chunk->hashtable);
+chunk->hashtable=NULL;
+free(chunk->renumber);
+chunk->renumber=NULL;
+free(chunk->error_tag);
+chunk->error_tag=NULL;
+}
+
+
+static void free_tokenize_chunks(struct tokenize_chunk* chunks,int n) {
+for (int i=0;i<n;i++) {
+   clear_tokenize_chunk(&(chunks[i]));
+   free_vector_int(chunks[i].n_occur);
+   free_vector_int(chunks[i].codes);
+   free_vector_int(chunks[i].n_enter_pos);
+   free_vector_int(chunks[i].snt_offsets);
+}
+free(chunks);
+}
+
+
+/**
+ * Tokenizes a chunk exactly like 'tokenization' does, except that offsets
+ * are not handled and that errors are not printed but recorded, so that
+ * only the first one in text order is reported.
+ */
+static void ABSTRACT_CALLBACK_UNITEX tokenize_chunk_thread(void* private_data,unsigned int) {
+struct tokenize_chunk* chunk=(struct tokenize_chunk*)private_data;
+const unichar* s=chunk->text;
+int length=chunk->length;
+const Alphabet* alph=chunk->alph;
+int n;
+int i=0;
+size_t token_buffer_size=TOKENIZE_ORIGINAL_TOKEN_BUFFER_SIZE;
+unichar* token_buffer=(unichar*)malloc(sizeof(unichar)*token_buffer_size);
+if (token_buffer==NULL) {
+   fatal_alloc_error("tokenize_chunk_thread");
+}
+while (i<length) {
+   unichar c=s[i];
+   if (is_separator(c)) {
+      int start=i;
+      char ENTER=0;
+      for (;i<length && is_separator(s[i]);i++) {
+         if (s[i]==0x0d || s[i]==0x0a) ENTER=1;
+      }
+      token_buffer[0]=' ';
+      token_buffer[1]='\0';
+      n=get_token_number(token_buffer,chunk->tokens,chunk->hashtable,chunk->n_occur);
+      if (i-start!=1) {
+         add_snt_offsets(chunk->snt_offsets,chunk->TOKENS_TOTAL,chunk->snt_offsets_shift,
+                         chunk->snt_offsets_shift+(i-start-1));
+         chunk->snt_offsets_shift+=(i-start-1);
+      }
+      if (ENTER==1) {
+         vector_int_add(chunk->n_enter_pos,chunk->TOKENS_TOTAL);
+      }
+   }
+   else if (c=='{') {
+      token_buffer[0]='{';
+      int z=1;
+      bool protected_char=false;
+      for (i++;i<length && ((s[i]!='}' && s[i]!='{' && s[i]!='\n') || protected_char);i++) {
+         protected_char=(s[i]=='\\');
+         enlarge_token_buffer_if_needed(&token_buffer,&token_buffer_size,z+2);
+         token_buffer[z++]=s[i];
+      }
+      enlarge_token_buffer_if_needed(&token_buffer,&token_buffer_size,z+2);
+      if (i==length || s[i]!='}') {
+         token_buffer[z]='\0';
+         chunk->error=CHUNK_TAG_WITHOUT_END;
+         chunk->error_tag=token_buffer;
+         return;
+      }
+      i++;
+      token_buffer[z]='}';
+      token_buffer[z+1]='\0';
+      if (!u_strcmp(token_buffer,"{S}")) {
+         chunk->SENTENCES++;
+      } else if (u_strcmp(token_buffer,"{STOP}") && !check_tag_token(token_buffer,0)) {
+         chunk->error=CHUNK_INVALID_TAG;
+         chunk->error_tag=token_buffer;
+         return;
+      }
+      n=get_token_number(token_buffer,chunk->tokens,chunk->hashtable,chunk->n_occur);
+   }
+   else if (!is_letter(c,alph) || chunk->char_by_char) {
+      token_buffer[0]=c;
+      token_buffer[1]='\0';
+      if (is_letter(c,alph)) chunk->WORDS_TOTAL++;
+      if (c>='0' && c<='9') chunk->DIGITS_TOTAL++;
+      n=get_token_number(token_buffer,chunk->tokens,chunk->hashtable,chunk->n_occur);
+      i++;
+   }
+   else {
+      int z=0;
+      for (;i<length && is_letter(s[i],alph);i++) {
+         enlarge_token_buffer_if_needed(&token_buffer,&token_buffer_size,z+2);
+         token_buffer[z++]=s[i];
+      }
+      token_buffer[z]='\0';
+      n=get_token_number(token_buffer,chunk->tokens,chunk->hashtable,chunk->n_occur);
+      chunk->WORDS_TOTAL++;
+   }
+   chunk->TOKENS_TOTAL++;
+   vector_int_add(chunk->codes,n);
+}
+free(token_buffer);
+}
+
+
+/**
+ * Replaces local token numbers by global ones.
+ */
+static void ABSTRACT_CALLBACK_UNITEX renumber_chunk_thread(void* private_data,unsigned int) {
+struct tokenize_chunk* chunk=(struct tokenize_chunk*)private_data;
+int* codes=chunk->codes->tab;
+for (int i=0;i<chunk->codes->nbelems;i++) {
+   codes[i]=chunk->renumber[codes[i]];
+}
+}
+
+
+/**
+ * Adds the tokens of a chunk to the global table. Since chunks are merged
+ * in text order and since local tokens are numbered by first occurrence,
+ * new tokens get the same numbers as in a sequential tokenization.
+ * 'token_base' and 'shift_base' are the number of tokens and the .snt shift
+ * before the chunk.
+ */
+static void merge_tokenize_chunk(struct tokenize_chunk* chunk,vector_ptr* tokens,struct hash_table* hashtable,
+                                 vector_int* n_occur,vector_int* n_enter_pos,vector_int* snt_offsets,
+                                 int token_base,int shift_base) {
+int n=chunk->tokens->nbelems;
+chunk->renumber=(int*)malloc((n+1)*sizeof(int));
+if (chunk->renumber==NULL) {
+   fatal_alloc_error("merge_tokenize_chunk");
+}
+for (int i=0;i<n;i++) {
+   unichar* token=(unichar*)chunk->tokens->tab[i];
+   int ret;
+   struct any* value=get_value(hashtable,token,HT_INSERT_IF_NEEDED,&ret);
+   if (ret==HT_KEY_ADDED) {
+      value->_int=vector_ptr_add(tokens,token);
+      vector_int_add(n_occur,0);
+      chunk->tokens->tab[i]=NULL;
+   }
+   chunk->renumber[i]=value->_int;
+   n_occur->tab[value->_int]+=chunk->n_occur->tab[i];
+}
+for (int i=0;i<chunk->n_enter_pos->nbelems;i++) {
+   vector_int_add(n_enter_pos,token_base+chunk->n_enter_pos->tab[i]);
+}
+for (int i=0;i<chunk->snt_offsets->nbelems;i+=3) {
+   add_snt_offsets(snt_offsets,token_base+chunk->snt_offsets->tab[i],
+                   shift_base+chunk->snt_offsets->tab[i+1],shift_base+chunk->snt_offsets->tab[i+2]);
+}
+}
+
+
+/**
+ * Reads up to 'size' chars. Returns the number of chars read.
+ */
+static int read_text_block(U_FILE* f,unichar* buffer,int size) {
+int total=0;
+while (total<size) {
+   int res=u_fget_unichars_raw(buffer+total,size-total,f);
+   if (res<=0) break;
+   total+=res;
+}
+return total;
+}
+
+
+/**
+ * Multi-threaded version of 'tokenization'. The text is read by rounds,
+ * and each round is cut into 'n_threads' chunks on separator sequences that
+ * are not inside tags. Chunks are tokenized concurrently, each one with its
+ * own token table, and then merged in text order into the global one, so
+ * that text.cod, tokens.txt, enter.pos and snt_offsets.pos are identical to
+ * the ones produced by a single thread.
+ */
+static int parallel_tokenization(U_FILE* f_read,U_FILE* coded_text,U_FILE* output,Alphabet* alph,
+                         vector_ptr* tokens,struct hash_table* hashtable,
+                         vector_int* n_occur,vector_int* n_enter_pos,
+                         vector_int* snt_offsets,
+                         int *SENTENCES,int *TOKENS_TOTAL,int *WORDS_TOTAL,
+                         int *DIGITS_TOTAL,int char_by_char,int n_threads,const U_MAPPED_TEXT* mapped) {
+int buffer_size=n_threads*TOKENIZE_CHUNK_SIZE;
+/* A mapped text is used in place, otherwise we read it into our own buffer */
+unichar* buffer=NULL;
+if (mapped==NULL) {
+   buffer=(unichar*)malloc(buffer_size*sizeof(unichar));
+   if (buffer==NULL) {
+      alloc_error("parallel_tokenization");
+      return ALLOC_ERROR_CODE;
+   }
+}
+struct tokenize_chunk* chunks=new_tokenize_chunks(n_threads,alph,char_by_char);
+void** chunk_ptr=(void**)malloc(n_threads*sizeof(void*));
+if (chunk_ptr==NULL) {
+   fatal_alloc_error("parallel_tokenization");
+}
+for (int i=0;i<n_threads;i++) {
+   chunk_ptr[i]=&(chunks[i]);
+}
+int result=SUCCESS_RETURN_CODE;
+int snt_offsets_shift=0;
+int current_megabyte=0;
+size_t consumed=0;
+int filled=0;
+for (;;) {
+   const unichar* window;
+   int eof;
+   if (mapped!=NULL) {
+      window=mapped->text+consumed;
+      size_t remaining=mapped->length-consumed;
+      eof=(remaining<=(size_t)buffer_size);
+      filled=eof?(int)remaining:buffer_size;
+   } else {
+      window=buffer;
+      filled+=read_text_block(f_read,buffer+filled,buffer_size-filled);
+      eof=(filled<buffer_size);
+   }
+   if (eof && filled==0) {
+      break;
+   }
+   int end=filled;
+   if (!eof) {
+      /* The end of the buffer may be continued by the next block, so we
+       * keep what follows a cut near the end for the next round */
+      end=find_chunk_boundary(window,0,filled-(filled/(4*n_threads)),filled,alph);
+      if (end==filled) {
+         end=find_chunk_boundary(window,0,1,filled,alph);
+      }
+      if (end==filled) {
+         /* No cut at all: we enlarge the buffer and read more */
+         buffer_size*=2;
+         if (mapped==NULL) {
+            unichar* tmp=(unichar*)realloc(buffer,buffer_size*sizeof(unichar));
+            if (tmp==NULL) {
+               fatal_alloc_error("parallel_tokenization");
+            }
+            buffer=tmp;
+         }
+         continue;
+      }
+   }
+   int start=0;
+   for (int i=0;i<n_threads;i++) {
+      int stop=(i==n_threads-1)?end:find_chunk_boundary(window,start,(int)(((long)end*(i+1))/n_threads),end,alph);
+      if (stop<start) stop=start;
+      reset_tokenize_chunk(&(chunks[i]),window+start,stop-start);
+      start=stop;
+   }
+   SyncRunThreads((unsigned int)n_threads,tokenize_chunk_thread,chunk_ptr);
+   int failed=-1;
+   for (int i=0;i<n_threads;i++) {
+      if (chunks[i].error!=CHUNK_NO_ERROR) {
+         failed=i;
+         break;
+      }
+      merge_tokenize_chunk(&(chunks[i]),tokens,hashtable,n_occur,n_enter_pos,snt_offsets,
+                           *TOKENS_TOTAL,snt_offsets_shift);
+      snt_offsets_shift+=chunks[i].snt_offsets_shift;
+      (*SENTENCES)+=chunks[i].SENTENCES;
+      (*TOKENS_TOTAL)+=chunks[i].TOKENS_TOTAL;
+      (*WORDS_TOTAL)+=chunks[i].WORDS_TOTAL;
+      (*DIGITS_TOTAL)+=chunks[i].DIGITS_TOTAL;
+   }
+   int n_merged=(failed==-1)?n_threads:failed;
+   SyncRunThreads((unsigned int)n_merged,renumber_chunk_thread,chunk_ptr);
+   for (int i=0;i<n_merged;i++) {
+      fwrite(chunks[i].codes->tab,sizeof(int),chunks[i].codes->nbelems,coded_text);
+   }
+   if (failed!=-1) {
+      if (chunks[failed].error==CHUNK_TAG_WITHOUT_END) {
+         error("Error: a tag without ending } has been found:\n%S\n",chunks[failed].error_tag);
+      } else {
+         /* We check the tag again to print the detailed error message */
+         check_tag_token(chunks[failed].error_tag,1);
+         error("The text contains an invalid tag. Unitex cannot process it.");
+      }
+      result=DEFAULT_ERROR_CODE;
+   }
+   for (int i=0;i<n_threads;i++) {
+      clear_tokenize_chunk(&(chunks[i]));
+   }
+   if (result!=SUCCESS_RETURN_CODE) {
+      break;
+   }
+   consumed+=end;
+   if ((consumed/(1024*512))!=(size_t)current_megabyte) {
+      current_megabyte=(int)(consumed/(1024*512));
+      u_printf("%d megabyte%s read...       \r",current_megabyte,(current_megabyte>1)?"s":"");
+   }
+   filled-=end;
+   if (mapped==NULL) {
+      memmove(buffer,buffer+end,filled*sizeof(unichar));
+   }
+}
+free(chunk_ptr);
+free_tokenize_chunks(chunks,n_threads);
+free(buffer);
+if (result!=SUCCESS_RETURN_CODE) {
+   return result;
+}
+for (int n=0;n<tokens->nbelems;n++) {
+   u_fprintf(output,"%S\n",tokens->tab[n]);
+}
+return SUCCESS_RETURN_CODE;
+}
+
+
 
 static int partition_pour_quicksort_by_frequence(int m, int n,vector_ptr* tokens,vector_int* n_occur) {
 int pivot;
@@ -911,7 +1411,7 @@ for (int i=0;i<tokens->nbelems;i++) {
 
 
 
-static void compute_statistics(U_FILE *f,vector_ptr* tokens,Alphabet* alph,
+static void compute_statistics(U_FILE *f,vector_ptr* tokens,const Alphabet* alph,
                         int SENTENCES,int TOKENS_TOTAL,int WORDS_TOTAL,int DIGITS_TOTAL) {
 int DIFFERENT_DIGITS=0;
 int DIFFERENT_WORDS=0;
@@ -933,4 +1433,375 @@ static void save_new_line_positions(U_FILE* f,vector_int* n_enter_pos) {
 fwrite(n_enter_pos->tab,sizeof(int),n_enter_pos->nbelems,f);
 }
 
+
+
+/**
+ * Loads a binary file of ints, like text.cod or enter.pos.
+ */
+static vector_int* load_int_file(const char* name) {
+U_FILE* f=u_fopen(BINARY,name,U_READ);
+if (f==NULL) {
+   error("Cannot open %s\n",name);
+   return NULL;
+}
+long size=get_file_size(f);
+int n=(int)(size/sizeof(int));
+vector_int* v=new_vector_int(n+1);
+v->nbelems=(int)fread(v->tab,sizeof(int),n,f);
+u_fclose(f);
+if (v->nbelems!=n) {
+   error("Read error on %s\n",name);
+   free_vector_int(v);
+   return NULL;
+}
+return v;
+}
+
+
+/**
+ * Counts the occurrences of each token in the text.
+ */
+static void count_token_occurrences(struct tokenized_text* t) {
+for (int i=0;i<t->n_occur->nbelems;i++) {
+   t->n_occur->tab[i]=0;
+}
+for (int i=0;i<t->codes->nbelems;i++) {
+   t->n_occur->tab[t->codes->tab[i]]++;
+}
+}
+
+
+/**
+ * Loads the tokenization of the given text from its snt directory.
+ * Returns NULL in case of error.
+ */
+struct tokenized_text* load_tokenized_text(const VersatileEncodingConfig* vec,const char* text,const Alphabet* alph) {
+struct tokenized_text* t=(struct tokenized_text*)malloc(sizeof(struct tokenized_text));
+if (t==NULL) {
+   fatal_alloc_error("load_tokenized_text");
+}
+t->alph=alph;
+t->tokens=new_vector_ptr(4096);
+t->n_occur=new_vector_int(4096);
+t->hashtable=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)((EQUAL_UNICHAR_FUNCTION)u_equal),
+                            (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
+t->codes=NULL;
+t->n_enter_pos=NULL;
+t->snt_offsets=NULL;
+char name[FILENAME_MAX];
+get_snt_path(text,name);
+strcat(name,"tokens.txt");
+if (load_token_file(name,vec,t->tokens,t->hashtable,t->n_occur)!=SUCCESS_RETURN_CODE) {
+   free_tokenized_text(t);
+   return NULL;
+}
+get_snt_path(text,name);
+strcat(name,"text.cod");
+t->codes=load_int_file(name);
+if (t->codes==NULL) {
+   free_tokenized_text(t);
+   return NULL;
+}
+for (int i=0;i<t->codes->nbelems;i++) {
+   if (t->codes->tab[i]<0 || t->codes->tab[i]>=t->tokens->nbelems) {
+      error("Invalid token number %d in %s\n",t->codes->tab[i],name);
+      free_tokenized_text(t);
+      return NULL;
+   }
+}
+get_snt_path(text,name);
+strcat(name,"enter.pos");
+t->n_enter_pos=load_int_file(name);
+if (t->n_enter_pos==NULL) {
+   free_tokenized_text(t);
+   return NULL;
+}
+get_snt_path(text,name);
+strcat(name,"snt_offsets.pos");
+t->snt_offsets=load_snt_offsets(name);
+if (t->snt_offsets==NULL) {
+   error("Cannot read snt offset file %s\n",name);
+   free_tokenized_text(t);
+   return NULL;
+}
+count_token_occurrences(t);
+return t;
+}
+
+
+void free_tokenized_text(struct tokenized_text* t) {
+if (t==NULL) return;
+free_vector_ptr(t->tokens,free);
+free_hash_table(t->hashtable);
+free_vector_int(t->n_occur);
+free_vector_int(t->codes);
+free_vector_int(t->n_enter_pos);
+free_vector_int(t->snt_offsets);
+free(t);
+}
+
+
+/**
+ * Saves the tokenization in the snt directory of the given text. The files
+ * are the same as the ones that Tokenize would produce for this text,
+ * including the statistics and the sorted token lists.
+ */
+int save_tokenized_text(const VersatileEncodingConfig* vec,struct tokenized_text* t,const char* text) {
+char name[FILENAME_MAX];
+get_snt_path(text,name);
+strcat(name,"text.cod");
+U_FILE* f=u_fopen(BINARY,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+   return DEFAULT_ERROR_CODE;
+}
+fwrite(t->codes->tab,sizeof(int),t->codes->nbelems,f);
+u_fclose(f);
+get_snt_path(text,name);
+strcat(name,"enter.pos");
+f=u_fopen(BINARY,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+   return DEFAULT_ERROR_CODE;
+}
+save_new_line_positions(f,t->n_enter_pos);
+u_fclose(f);
+get_snt_path(text,name);
+strcat(name,"snt_offsets.pos");
+if (!save_snt_offsets(t->snt_offsets,name)) {
+   error("Cannot save snt offsets in file %s\n",name);
+   return DEFAULT_ERROR_CODE;
+}
+get_snt_path(text,name);
+strcat(name,"tokens.txt");
+f=u_fopen(vec,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot create file %s\n",name);
+   return DEFAULT_ERROR_CODE;
+}
+u_fprintf(f,"0000000000\n");
+for (int i=0;i<t->tokens->nbelems;i++) {
+   u_fprintf(f,"%S\n",t->tokens->tab[i]);
+}
+u_fclose(f);
+write_number_of_tokens(vec,name,t->tokens->nbelems);
+/* We count what 'tokenization' counts while reading the text */
+int SENTENCES=0;
+int WORDS_TOTAL=0;
+int DIGITS_TOTAL=0;
+for (int i=0;i<t->tokens->nbelems;i++) {
+   const unichar* token=(const unichar*)t->tokens->tab[i];
+   if (!u_strcmp(token,"{S}")) {
+      SENTENCES+=t->n_occur->tab[i];
+   } else if (is_letter(token[0],t->alph)) {
+      WORDS_TOTAL+=t->n_occur->tab[i];
+   } else if (token[0]>='0' && token[0]<='9' && token[1]=='\0') {
+      DIGITS_TOTAL+=t->n_occur->tab[i];
+   }
+}
+get_snt_path(text,name);
+strcat(name,"stats.n");
+f=u_fopen(vec,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+} else {
+   compute_statistics(f,t->tokens,t->alph,SENTENCES,t->codes->nbelems,WORDS_TOTAL,DIGITS_TOTAL);
+   u_fclose(f);
+}
+/* The sorted lists are produced from a copy of the table, because
+ * the token numbers must be kept */
+vector_ptr* sorted=new_vector_ptr(t->tokens->nbelems);
+vector_int* sorted_occur=new_vector_int(t->tokens->nbelems);
+for (int i=0;i<t->tokens->nbelems;i++) {
+   vector_ptr_add(sorted,t->tokens->tab[i]);
+   vector_int_add(sorted_occur,t->n_occur->tab[i]);
+}
+get_snt_path(text,name);
+strcat(name,"tok_by_freq.txt");
+f=u_fopen(vec,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+} else {
+   sort_and_save_by_frequence(f,sorted,sorted_occur);
+   u_fclose(f);
+}
+get_snt_path(text,name);
+strcat(name,"tok_by_alph.txt");
+f=u_fopen(vec,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+} else {
+   sort_and_save_by_alph_order(f,sorted,sorted_occur);
+   u_fclose(f);
+}
+free_vector_ptr(sorted);
+free_vector_int(sorted_occur);
+return SUCCESS_RETURN_CODE;
+}
+
+
+/**
+ * Writes 's' in the merged text 'f', with new lines written as \r\n, as
+ * Concord does. If 'window' is not NULL, the written chars are also added
+ * to it.
+ */
+static void write_merged_string(U_FILE* f,const unichar* s,Ustring* window) {
+u_fputs_conv_lf_to_crlf_option(s,f,1);
+if (window==NULL) {
+   return;
+}
+for (int i=0;s[i]!='\0';i++) {
+   if (s[i]=='\n') {
+      u_strcat(window,(unichar)'\r');
+   }
+   u_strcat(window,s[i]);
+}
+}
+
+
+/**
+ * Tokenizes a rewritten part of the text, and adds its tokens at the end of
+ * 'codes'. 'shift' is the .snt shift before this part.
+ */
+static int tokenize_window(struct tokenize_chunk* chunk,Ustring* window,vector_int* codes,
+                           vector_int* n_enter_pos,vector_int* snt_offsets,int* shift) {
+chunk->text=window->str;
+chunk->length=(int)window->len;
+chunk->codes->nbelems=0;
+chunk->n_enter_pos->nbelems=0;
+chunk->snt_offsets->nbelems=0;
+chunk->snt_offsets_shift=0;
+chunk->TOKENS_TOTAL=0;
+chunk->error=CHUNK_NO_ERROR;
+tokenize_chunk_thread(chunk,0);
+empty(window);
+if (chunk->error!=CHUNK_NO_ERROR) {
+   free(chunk->error_tag);
+   chunk->error_tag=NULL;
+   return DEFAULT_ERROR_CODE;
+}
+int token_base=codes->nbelems;
+for (int i=0;i<chunk->n_enter_pos->nbelems;i++) {
+   vector_int_add(n_enter_pos,token_base+chunk->n_enter_pos->tab[i]);
+}
+for (int i=0;i<chunk->snt_offsets->nbelems;i+=3) {
+   add_snt_offsets(snt_offsets,token_base+chunk->snt_offsets->tab[i],
+                   (*shift)+chunk->snt_offsets->tab[i+1],(*shift)+chunk->snt_offsets->tab[i+2]);
+}
+(*shift)+=chunk->snt_offsets_shift;
+for (int i=0;i<chunk->codes->nbelems;i++) {
+   vector_int_add(codes,chunk->codes->tab[i]);
+}
+return SUCCESS_RETURN_CODE;
+}
+
+
+/**
+ * Replaces the token intervals [spans[2i];spans[2i+1]] by the strings
+ * outputs[i] (NULL for no output). The intervals must be sorted and must not
+ * overlap. The new text is written to 'text' exactly as Concord --merge
+ * would write it, and the tokenization is updated to the one Tokenize
+ * would produce for it, without reading it again: only the outputs and the
+ * tokens around them are tokenized, since a word that follows or precedes an
+ * output may be glued to it.
+ *
+ * If a rewritten part cannot be tokenized alone, because of a tag that is
+ * not closed in it, the text is still written but the function returns an
+ * error, and 't' must not be used anymore: Tokenize must be called on the
+ * new text, that will report the error if it is a real one.
+ */
+int replace_in_tokenized_text(const VersatileEncodingConfig* vec,struct tokenized_text* t,
+                              const vector_int* spans,const vector_ptr* outputs,const char* text) {
+static const unichar line_feed[]={'\n','\0'};
+U_FILE* f=u_fopen(vec,text,U_WRITE);
+if (f==NULL) {
+   fatal_error("Cannot write file %s\n",text);
+}
+int n=t->codes->nbelems;
+int n_spans=spans->nbelems/2;
+vector_int* codes=new_vector_int(n+1);
+vector_int* n_enter_pos=new_vector_int(t->n_enter_pos->nbelems+1);
+vector_int* snt_offsets=new_vector_int(t->snt_offsets->nbelems+1);
+/* The tokens are added to the table of the text, so that new tokens get
+ * the numbers that Tokenize would give them */
+struct tokenize_chunk chunk;
+memset(&chunk,0,sizeof(struct tokenize_chunk));
+chunk.alph=t->alph;
+chunk.char_by_char=0;
+chunk.tokens=t->tokens;
+chunk.hashtable=t->hashtable;
+chunk.n_occur=t->n_occur;
+chunk.codes=new_vector_int(64);
+chunk.n_enter_pos=new_vector_int(16);
+chunk.snt_offsets=new_vector_int(16);
+Ustring* window=new_Ustring(1024);
+int in_window=0;
+int shift=0;
+int result=SUCCESS_RETURN_CODE;
+int pos_in_enter_pos=0;
+int span=0;
+int after_span=0;
+int i=0;
+while (i<n) {
+   if (span<n_spans && spans->tab[2*span]==i) {
+      if (outputs->tab[span]!=NULL) {
+         write_merged_string(f,(const unichar*)outputs->tab[span],window);
+      }
+      in_window=1;
+      i=spans->tab[2*span+1]+1;
+      span++;
+      after_span=1;
+      continue;
+   }
+   while (pos_in_enter_pos<t->n_enter_pos->nbelems && t->n_enter_pos->tab[pos_in_enter_pos]<i) {
+      pos_in_enter_pos++;
+   }
+   int new_line=(pos_in_enter_pos<t->n_enter_pos->nbelems && t->n_enter_pos->tab[pos_in_enter_pos]==i);
+   const unichar* token=new_line?line_feed:(const unichar*)t->tokens->tab[t->codes->tab[i]];
+   if (after_span || (span<n_spans && spans->tab[2*span]==i+1)) {
+      /* The token is next to an output */
+      write_merged_string(f,token,window);
+   } else {
+      if (in_window) {
+         if (result==SUCCESS_RETURN_CODE) {
+            result=tokenize_window(&chunk,window,codes,n_enter_pos,snt_offsets,&shift);
+         }
+         in_window=0;
+      }
+      write_merged_string(f,token,NULL);
+      if (new_line) {
+         /* A new line is written as \r\n, so that it is a 2 char separator */
+         vector_int_add(n_enter_pos,codes->nbelems);
+         add_snt_offsets(snt_offsets,codes->nbelems,shift,shift+1);
+         shift++;
+      }
+      vector_int_add(codes,t->codes->tab[i]);
+   }
+   after_span=0;
+   i++;
+}
+if (in_window && result==SUCCESS_RETURN_CODE) {
+   result=tokenize_window(&chunk,window,codes,n_enter_pos,snt_offsets,&shift);
+}
+u_fclose(f);
+free_Ustring(window);
+free_vector_int(chunk.codes);
+free_vector_int(chunk.n_enter_pos);
+free_vector_int(chunk.snt_offsets);
+if (result!=SUCCESS_RETURN_CODE) {
+   free_vector_int(codes);
+   free_vector_int(n_enter_pos);
+   free_vector_int(snt_offsets);
+   return result;
+}
+free_vector_int(t->codes);
+free_vector_int(t->n_enter_pos);
+free_vector_int(t->snt_offsets);
+t->codes=codes;
+t->n_enter_pos=n_enter_pos;
+t->snt_offsets=snt_offsets;
+count_token_occurrences(t);
+return SUCCESS_RETURN_CODE;
+}
+
 } // namespace unitex
@@ -23,6 +23,10 @@
 #define TokenizeH
 
 #include "UnitexGetOpt.h"
+#include "Unicode.h"
+#include "Alphabet.h"
+#include "Vector.h"
+#include "HashTable.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -36,6 +40,34 @@ extern const char* usage_Tokenize;
 
 int main_Tokenize(int argc,char* const argv[]);
 
+
+/**
+ * The tokenization of a text, as Tokenize saves it in the snt directory of
+ * the text. It is used by Cassys to keep the text of a cascade in memory, so
+ * that each stage only has to tokenize again the parts of the text that have
+ * been rewritten by the previous one.
+ */
+struct tokenized_text {
+   const Alphabet* alph;
+
+   /* The token table, as in tokens.txt, and the number of occurrences
+    * of each token in the text */
+   vector_ptr* tokens;
+   struct hash_table* hashtable;
+   vector_int* n_occur;
+
+   /* The contents of text.cod, enter.pos and snt_offsets.pos */
+   vector_int* codes;
+   vector_int* n_enter_pos;
+   vector_int* snt_offsets;
+};
+
+struct tokenized_text* load_tokenized_text(const VersatileEncodingConfig*,const char* text,const Alphabet*);
+int save_tokenized_text(const VersatileEncodingConfig*,struct tokenized_text*,const char* text);
+void free_tokenized_text(struct tokenized_text*);
+int replace_in_tokenized_text(const VersatileEncodingConfig*,struct tokenized_text*,
+                              const vector_int* spans,const vector_ptr* outputs,const char* text);
+
 } // namespace unitex
 
 #endif
@@ -44,6 +44,7 @@
 #include "Korean.h"
 #include "HashTable.h"
 #include "TfstStats.h"
+#include "Tfst.h"
 #include "Offsets.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
@@ -116,6 +117,8 @@ const char* usage_Txt2Tfst =
          "  -t XXX/--tagset=XXX: use the XXX ELAG tagset file to normalize the dictionary entries\n"
          "  -K/--korean: tells Txt2Tfst that it works on Korean\n"
          "  -S/--no_statistics: do not produce statistics file\n"
+         "  -b/--binary: also saves the text automaton as a binary \"text.tfstb\" file, that\n"
+         "               can be used instead of \"text.tfst\" by the programs that read it\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -132,7 +135,7 @@ static void usage() {
 }
 
 
-const char* optstring_Txt2Tfst=":a:cn:t:KVhk:q:S";
+const char* optstring_Txt2Tfst=":a:cn:t:KVhk:q:Sb";
 const struct option_TS lopts_Txt2Tfst[]={
   {"alphabet", required_argument_TS, NULL, 'a'},
   {"clean", no_argument_TS, NULL, 'c'},
@@ -144,6 +147,7 @@ const struct option_TS lopts_Txt2Tfst[]={
   {"input_encoding",required_argument_TS,NULL,'k'},
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"no_statistics",no_argument_TS,NULL,'S'},
+  {"binary",no_argument_TS,NULL,'b'},
   {NULL, no_argument_TS, NULL, 0}
 };
 
@@ -155,6 +159,7 @@ if (argc==1) {
 }
 
 int save_statistics=1;
+int save_binary=0;
 char alphabet[FILENAME_MAX]="";
 char norm[FILENAME_MAX]="";
 char tagset[FILENAME_MAX]="";
@@ -189,6 +194,8 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Txt2Tfst,lopts_Txt2Tfst,
              break;
    case 'S': save_statistics = 0;
              break;
+   case 'b': save_binary=1;
+             break;
    case 'V': only_verify_arguments = true;
              break;
    case 'h': usage();
@@ -450,6 +457,15 @@ u_fclose(tind);
 // close tfst before call write_number_of_graphs()
 u_fclose(tfst);
 write_number_of_graphs(&vec,text_tfst,sentence_number-1,0);
+if (save_binary) {
+   char text_tfstb[FILENAME_MAX];
+   get_snt_path(argv[options.vars()->optind],text_tfstb);
+   strcat(text_tfstb,"text.tfstb");
+   u_printf("Saving binary text automaton...\n");
+   if (!save_binary_text_automaton(&vec,text_tfst,text_tfstb)) {
+      error("Cannot save %s\n",text_tfstb);
+   }
+}
 free_text_tokens(tokens);
 delete korean;
 free_alphabet(alph);
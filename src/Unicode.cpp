@@ -876,6 +876,55 @@ return ret;
 }
 
 
+/**
+ * Maps the text file 'f', that was opened for reading with the name 'name',
+ * from its current position, i.e. after its byte order mark if any. This is
+ * only possible if the file is encoded in UTF16-LE and if unichars are stored
+ * in little endian on this machine. Returns NULL otherwise, or if the file is
+ * empty or cannot be mapped, in which case it must be read through 'f'.
+ */
+U_MAPPED_TEXT* u_map_text(U_FILE* f,const char* name) {
+const unichar one=1;
+if (f==NULL || f->enc!=UTF16_LE || *((const unsigned char*)&one)!=1) {
+   return NULL;
+}
+long pos=ftell(f);
+if (pos<0 || (pos%sizeof(unichar))!=0) {
+   return NULL;
+}
+ABSTRACTMAPFILE* map=af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (map==NULL) {
+   return NULL;
+}
+size_t size=af_get_mapfile_size(map);
+const void* buffer=(size>(size_t)pos)?af_get_mapfile_pointer(map):NULL;
+if (buffer==NULL) {
+   af_close_mapfile(map);
+   return NULL;
+}
+U_MAPPED_TEXT* t=(U_MAPPED_TEXT*)malloc(sizeof(U_MAPPED_TEXT));
+if (t==NULL) {
+   fatal_alloc_error("u_map_text");
+}
+t->map=map;
+t->buffer=buffer;
+t->text=(const unichar*)((const char*)buffer+pos);
+t->length=(size-(size_t)pos)/sizeof(unichar);
+return t;
+}
+
+
+/**
+ * Unmaps a text mapped with u_map_text.
+ */
+void u_unmap_text(U_MAPPED_TEXT* t) {
+if (t==NULL) return;
+af_release_mapfile_pointer(t->map,t->buffer);
+af_close_mapfile(t->map);
+free(t);
+}
+
+
 /**
  * This function creates an empty Unicode file that just contains the
  * byte order mark, if any. It returns 0 if it fails; 1 otherwise.
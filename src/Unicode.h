@@ -218,6 +218,21 @@ void u_fsetsizereservation_by_bytes(U_FILE*, long size_planned);
 void u_fsetsizereservation_by_chars(U_FILE*, long size_planned);
 
 int u_fclose(U_FILE*);
+
+/**
+ * A UTF16-LE text file mapped in memory, so that its content can be scanned
+ * as an unichar array without any decoding or copy.
+ */
+typedef struct {
+    ABSTRACTMAPFILE* map;
+    const void* buffer;
+    const unichar* text;
+    size_t length;
+} U_MAPPED_TEXT;
+
+U_MAPPED_TEXT* u_map_text(U_FILE*,const char*);
+void u_unmap_text(U_MAPPED_TEXT*);
+
 int u_fempty(Encoding,int,const char*);
 int u_fempty(const VersatileEncodingConfig*,const char*);
 int u_is_UTF16(const char*);
@@ -43,6 +43,8 @@ typedef struct
 
 ULB_VFFUNC MINIMUTEX_OBJECT* ULIB_CALL BuildMutex();
 ULB_VFFUNC void ULIB_CALL GetMiniMutex(MINIMUTEX_OBJECT*);
+/* returns 1 if the mutex was taken, 0 if it is owned by another thread */
+ULB_VFFUNC int ULIB_CALL TryGetMiniMutex(MINIMUTEX_OBJECT*);
 ULB_VFFUNC void ULIB_CALL ReleaseMiniMutex(MINIMUTEX_OBJECT*);
 ULB_VFFUNC void ULIB_CALL DeleteMiniMutex(MINIMUTEX_OBJECT*);
 
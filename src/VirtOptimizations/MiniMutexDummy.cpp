@@ -41,6 +41,11 @@ ULB_VFFUNC void ULIB_CALL GetMiniMutex(MINIMUTEX_OBJECT*)
 {
 }
 
+ULB_VFFUNC int ULIB_CALL TryGetMiniMutex(MINIMUTEX_OBJECT*)
+{
+    return 1;
+}
+
 ULB_VFFUNC void ULIB_CALL ReleaseMiniMutex(MINIMUTEX_OBJECT*)
 {
 }
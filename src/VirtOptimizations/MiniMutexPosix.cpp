@@ -70,6 +70,14 @@ ULB_VFFUNC void ULIB_CALL GetMiniMutex(MINIMUTEX_OBJECT* pMut)
         pthread_mutex_lock(&pMoi->pmt);
 }
 
+ULB_VFFUNC int ULIB_CALL TryGetMiniMutex(MINIMUTEX_OBJECT* pMut)
+{
+    MINIMUTEX_OBJECT_INTERNAL* pMoi = (MINIMUTEX_OBJECT_INTERNAL*)pMut;
+    if (pMoi == NULL)
+        return 1;
+    return (pthread_mutex_trylock(&pMoi->pmt) == 0) ? 1 : 0;
+}
+
 ULB_VFFUNC void ULIB_CALL ReleaseMiniMutex(MINIMUTEX_OBJECT* pMut)
 {
     MINIMUTEX_OBJECT_INTERNAL* pMoi = (MINIMUTEX_OBJECT_INTERNAL*)pMut;
@@ -97,6 +97,14 @@ ULB_VFFUNC void ULIB_CALL GetMiniMutex(MINIMUTEX_OBJECT* pMut)
         EnterCriticalSection(&pMoi->cs);
 }
 
+ULB_VFFUNC int ULIB_CALL TryGetMiniMutex(MINIMUTEX_OBJECT* pMut)
+{
+    SYNC_MUTEX_OBJECT_VFS_INTERNAL* pMoi = (SYNC_MUTEX_OBJECT_VFS_INTERNAL*)pMut;
+    if (pMoi == NULL)
+        return 1;
+    return (TryEnterCriticalSection(&pMoi->cs) != 0) ? 1 : 0;
+}
+
 ULB_VFFUNC void ULIB_CALL ReleaseMiniMutex(MINIMUTEX_OBJECT* pMut)
 {
     SYNC_MUTEX_OBJECT_VFS_INTERNAL* pMoi = (SYNC_MUTEX_OBJECT_VFS_INTERNAL*)pMut;
@@ -47,6 +47,7 @@
 #include "VirtualSpaceManager.h"
 #include "VirtFileSystem.h"
 #include "MiniMutex.h"
+#include "base/compiler/intrinsic/atomic.h"    // unitex_atomic_*
 
 
 
@@ -192,6 +193,8 @@ typedef BOOL(DFSCALLBACK *tDestructorData) (LPCVOID lpElem);
 
 typedef void* ABSTRACTFILE_PTR;
 
+struct VIRTUALFILESHARD_STRUCT;
+
 typedef struct
 {
     afs_size_type dfFileSize;
@@ -202,6 +205,9 @@ typedef struct
     const void* pUserPtr;
     BOOL fIsPermanentPointer;
     int dfNbOpen;
+    /* the shard whose array contains this item, it only changes when the file
+       is renamed to another directory */
+    struct VIRTUALFILESHARD_STRUCT* pShard;
 } VIRTUALFILEITEMINFO;
 
 typedef struct
@@ -236,9 +242,25 @@ typedef struct
 #define STANDARD_OUT_STDOUT (0)
 #define STANDARD_OUT_STDERR (1)
 */
-typedef struct
+/* The file namespace is split into NB_VIRTUALFILESHARD sorted arrays, each
+   protected by its own mutex. All the files of a directory are in the same
+   shard, so jobs working in different virtual directories rarely wait for
+   each other. When several shards must be locked, they are always locked in
+   increasing order. */
+#define NB_VIRTUALFILESHARD (0x40)
+
+typedef struct VIRTUALFILESHARD_STRUCT
 {
     STATICARRAYC sacVirtualFileNameSpace;
+    MINIMUTEX_OBJECT* pMiniMutex;
+    /* number of times the mutex was taken, and number of times we had to wait for it */
+    afs_size_type dfNbLock;
+    afs_size_type dfNbLockContention;
+} VIRTUALFILESHARD;
+
+typedef struct
+{
+    VIRTUALFILESHARD shards[NB_VIRTUALFILESHARD];
     afs_size_type dfTotalSizeVirtualSpace;
     BOOL      fLimitSizeTotalVirtualSpace;
     afs_size_type dfMaxSizeTotalVirtualSpace;
@@ -249,6 +271,7 @@ typedef struct
     BOOL fTrashOutputErr;
     */
     //STANDARD_OUT_ARRAY std_out_array[2];
+    /* only protects dfTotalSizeVirtualSpace */
     MINIMUTEX_OBJECT* pMiniMutex;
 } VIRTUALFILESPACE ;
 
@@ -261,7 +284,11 @@ typedef struct
 static VIRTUALFILESPACE* pVirtualFileSpace=NULL;
 
 #define ALLOC_MUTEX \
-   { pVirtualFileSpace->pMiniMutex = BuildMutex(); } ;
+   { \
+            pVirtualFileSpace->pMiniMutex = BuildMutex(); \
+            for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++) \
+                pVirtualFileSpace->shards[iShard].pMiniMutex = BuildMutex(); \
+   } ;
 
 #define CLEAR_MUTEX \
    { \
@@ -270,6 +297,12 @@ static VIRTUALFILESPACE* pVirtualFileSpace=NULL;
                 DeleteMiniMutex(pVirtualFileSpace->pMiniMutex); \
                 pVirtualFileSpace->pMiniMutex = NULL; \
             } \
+            for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++) \
+                if (pVirtualFileSpace->shards[iShard].pMiniMutex!=NULL) \
+                { \
+                    DeleteMiniMutex(pVirtualFileSpace->shards[iShard].pMiniMutex); \
+                    pVirtualFileSpace->shards[iShard].pMiniMutex = NULL; \
+                } \
    } ;
 
 #define GET_MUTEX \
@@ -284,6 +317,69 @@ static VIRTUALFILESPACE* pVirtualFileSpace=NULL;
                 ReleaseMiniMutex(pVirtualFileSpace->pMiniMutex); \
    } ;
 
+static void LockVirtualFileShard(VIRTUALFILESHARD* pShard)
+{
+    if (pShard->pMiniMutex == NULL)
+        return;
+    if (!TryGetMiniMutex(pShard->pMiniMutex))
+    {
+        GetMiniMutex(pShard->pMiniMutex);
+        pShard->dfNbLockContention++;
+    }
+    pShard->dfNbLock++;
+}
+
+static void UnlockVirtualFileShard(VIRTUALFILESHARD* pShard)
+{
+    if (pShard->pMiniMutex != NULL)
+        ReleaseMiniMutex(pShard->pMiniMutex);
+}
+
+/* returns the shard of the file, which is chosen from its directory name */
+static VIRTUALFILESHARD* GetVirtualFileShard(const char* FileName)
+{
+    const char* lpEndDir = FileName;
+    const char* lpParc;
+    for (lpParc = FileName; (*lpParc) != '\0'; lpParc++)
+        if (((*lpParc) == '/') || ((*lpParc) == '\\'))
+            lpEndDir = lpParc;
+
+    /* FNV-1a hash */
+    DWORD dwHash = 2166136261UL;
+    for (lpParc = FileName; lpParc < lpEndDir; lpParc++)
+    {
+        dwHash ^= (unsigned char)(*lpParc);
+        dwHash = (dwHash * 16777619UL) & 0xffffffffUL;
+    }
+    return &(pVirtualFileSpace->shards[dwHash % NB_VIRTUALFILESHARD]);
+}
+
+/* locks the shard that contains the item. The item can move to another
+   shard while we wait for the mutex, so we check it again once we have it */
+static VIRTUALFILESHARD* LockVirtualFileShardOfItem(VIRTUALFILEITEMINFO* pVfii)
+{
+    for (;;)
+    {
+        VIRTUALFILESHARD* pShard = (VIRTUALFILESHARD*)unitex_atomic_load_ptr(&(pVfii->pShard));
+        LockVirtualFileShard(pShard);
+        if (unitex_atomic_load_ptr(&(pVfii->pShard)) == pShard)
+            return pShard;
+        UnlockVirtualFileShard(pShard);
+    }
+}
+
+static void LockAllVirtualFileShards()
+{
+    for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+        LockVirtualFileShard(&(pVirtualFileSpace->shards[iShard]));
+}
+
+static void UnlockAllVirtualFileShards()
+{
+    for (int iShard=NB_VIRTUALFILESHARD-1;iShard>=0;iShard--)
+        UnlockVirtualFileShard(&(pVirtualFileSpace->shards[iShard]));
+}
+
 BOOL DFSCALLBACK fncDestructorVirtualItem(LPCVOID lpElem)
 {
     VIRTUALFILEITEM* pvfi=(VIRTUALFILEITEM*)lpElem;
@@ -294,7 +390,9 @@ BOOL DFSCALLBACK fncDestructorVirtualItem(LPCVOID lpElem)
             if (pvfi->pvfii->Buf!=NULL)
             {
                 DfsFree(pvfi->pvfii->Buf);
+                GET_MUTEX;
                 pVirtualFileSpace->dfTotalSizeVirtualSpace -= pvfi->pvfii->dfFileSize;
+                RELEASE_MUTEX;
             }
             pvfi->pvfii->Buf = NULL;
             pvfi->pvfii->posLastWrite = 0;
@@ -321,15 +419,22 @@ long DFSCALLBACK fncCmpVirtualItem(LPCVOID lpElem1, LPCVOID lpElem2)
 
 BOOL InitStaticArrayVirtualFileNameSpace()
 {
-  if (pVirtualFileSpace->sacVirtualFileNameSpace!=NULL)
+  if (pVirtualFileSpace->shards[NB_VIRTUALFILESHARD-1].sacVirtualFileNameSpace!=NULL)
       return TRUE;
 
-    pVirtualFileSpace->sacVirtualFileNameSpace = InitStaticArrayC(sizeof(VIRTUALFILEITEM),0x100);
-    if (pVirtualFileSpace->sacVirtualFileNameSpace ==NULL)
-        return FALSE;
+    for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+    {
+        VIRTUALFILESHARD* pShard = &(pVirtualFileSpace->shards[iShard]);
+        if (pShard->sacVirtualFileNameSpace!=NULL)
+            continue;
+
+        pShard->sacVirtualFileNameSpace = InitStaticArrayC(sizeof(VIRTUALFILEITEM),0x10);
+        if (pShard->sacVirtualFileNameSpace ==NULL)
+            return FALSE;
 
-    SetFuncDestructor(pVirtualFileSpace->sacVirtualFileNameSpace,&fncDestructorVirtualItem);
-    SetFuncCompareData(pVirtualFileSpace->sacVirtualFileNameSpace,&fncCmpVirtualItem);
+        SetFuncDestructor(pShard->sacVirtualFileNameSpace,&fncDestructorVirtualItem);
+        SetFuncCompareData(pShard->sacVirtualFileNameSpace,&fncCmpVirtualItem);
+    }
 
     return TRUE;
 }
@@ -347,9 +452,15 @@ ULB_VFFUNC BOOL ULIB_CALL InitVirtualFileNameSpace()
         return FALSE;
     }
 
+    for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+    {
+        pVirtualFileSpace->shards[iShard].sacVirtualFileNameSpace = NULL;
+        pVirtualFileSpace->shards[iShard].dfNbLock = 0;
+        pVirtualFileSpace->shards[iShard].dfNbLockContention = 0;
+    }
+
     ALLOC_MUTEX;
 
-    pVirtualFileSpace->sacVirtualFileNameSpace = NULL;
     pVirtualFileSpace->dfTotalSizeVirtualSpace = 0;
     pVirtualFileSpace->dfMaxSizeTotalVirtualSpace = 0;
     pVirtualFileSpace->fLimitSizeTotalVirtualSpace = FALSE;
@@ -372,13 +483,38 @@ ULB_VFFUNC BOOL ULIB_CALL SetVirtualFileNameMaximumMemory(BOOL fLimitSize, afs_s
     return TRUE;
 }
 
-STATICARRAYC GetSacVirtualFileNameSpace()
+STATICARRAYC GetSacVirtualFileNameSpace(VIRTUALFILESHARD* pShard)
 {
     if (!(InitVirtualFileNameSpace()))
         return FALSE;
     if (pVirtualFileSpace==NULL)
         return NULL;
-    return pVirtualFileSpace->sacVirtualFileNameSpace;
+    return pShard->sacVirtualFileNameSpace;
+}
+
+ULB_VFFUNC BOOL ULIB_CALL GetVirtualFileNameSpaceLockStatistics(afs_size_type* p_nb_lock, afs_size_type* p_nb_contention)
+{
+    afs_size_type dfNbLock = 0;
+    afs_size_type dfNbLockContention = 0;
+    if (!InitVirtualFileNameSpace())
+        return FALSE;
+
+    for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+    {
+        VIRTUALFILESHARD* pShard = &(pVirtualFileSpace->shards[iShard]);
+        if (pShard->pMiniMutex != NULL)
+            GetMiniMutex(pShard->pMiniMutex);
+        dfNbLock += pShard->dfNbLock;
+        dfNbLockContention += pShard->dfNbLockContention;
+        if (pShard->pMiniMutex != NULL)
+            ReleaseMiniMutex(pShard->pMiniMutex);
+    }
+
+    if (p_nb_lock != NULL)
+        *p_nb_lock = dfNbLock;
+    if (p_nb_contention != NULL)
+        *p_nb_contention = dfNbLockContention;
+    return TRUE;
 }
 
 ULB_VFFUNC BOOL ULIB_CALL UnInitVirtualFileNameSpace(BOOL fClearMaximumMemoryValue)
@@ -388,13 +524,17 @@ ULB_VFFUNC BOOL ULIB_CALL UnInitVirtualFileNameSpace(BOOL fClearMaximumMemoryVal
         //SetStdOutFile(NULL,FALSE);
         //SetStdErrFile(NULL,FALSE);
 
-        if (pVirtualFileSpace->sacVirtualFileNameSpace != NULL)
+        for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
         {
-            //DeleteElem(pVirtualFileSpace->sacVirtualFileNameSpace, 0, GetNbElem(pVirtualFileSpace->sacVirtualFileNameSpace));
+            VIRTUALFILESHARD* pShard = &(pVirtualFileSpace->shards[iShard]);
+            if (pShard->sacVirtualFileNameSpace != NULL)
+            {
+                //DeleteElem(pShard->sacVirtualFileNameSpace, 0, GetNbElem(pShard->sacVirtualFileNameSpace));
 
-             DeleteStaticArrayC(pVirtualFileSpace->sacVirtualFileNameSpace);//+++
+                 DeleteStaticArrayC(pShard->sacVirtualFileNameSpace);//+++
+            }
+            pShard->sacVirtualFileNameSpace = NULL;
         }
-        pVirtualFileSpace->sacVirtualFileNameSpace = NULL;
 
         pVirtualFileSpace->dfTotalSizeVirtualSpace = 0;
 
@@ -419,12 +559,14 @@ static void CleanVirtualFileNameSpaceAtExit()
 		//SetStdOutFile(NULL,FALSE);
 		//SetStdErrFile(NULL,FALSE);
 
-		if (pVirtualFileSpace->sacVirtualFileNameSpace != NULL)
+		DWORD dwNbElem = 0;
+		for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+			if (pVirtualFileSpace->shards[iShard].sacVirtualFileNameSpace != NULL)
+				dwNbElem += GetNbElem(pVirtualFileSpace->shards[iShard].sacVirtualFileNameSpace);
+
+		if (dwNbElem == 0)
 		{
-			if (GetNbElem(pVirtualFileSpace->sacVirtualFileNameSpace) == 0)
-			{
-				UnInitVirtualFileNameSpace(TRUE);
-			}
+			UnInitVirtualFileNameSpace(TRUE);
 		}
 	}
 }
@@ -468,6 +610,7 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
     LOWLEVELINTERNAL* pLowLevelIntern;
     BOOL fCreatingFile = FALSE;
     STATICARRAYC sacVirtualFileNameSpace;
+    VIRTUALFILESHARD* pShard;
     BOOL fItemFound;
     BOOL fReadOnlyAccess = (TypeOpen == OPEN_READ_MF);
     afs_size_type dfProjectedSize=0;
@@ -475,9 +618,10 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
     if (!InitVirtualFileNameSpace())
         return NULL;
 
-    GET_MUTEX;
+    pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
-    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
+    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace(pShard);
 
 
 
@@ -488,7 +632,7 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
 
     if ((!fItemFound) && (TypeOpen!=OPEN_CREATE_MF))
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return NULL;
     }
 
@@ -502,7 +646,7 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
         BOOL fRetDel = DeleteElem(sacVirtualFileNameSpace,dwPosItem,1);
         if (!fRetDel)
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return NULL;
         }
         fItemFound=FALSE;
@@ -521,23 +665,24 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
         vfiAdd.pvfii->fIsPermanentPointer = FALSE;
         vfiAdd.pvfii->pUserPtr = NULL;
         vfiAdd.pvfii->dfNbOpen = 0;
+        vfiAdd.pvfii->pShard = pShard;
         //pVirtualFileSpace->dfTotalSize += dfProjectedSize;
 
         if (vfiAdd.pvfii->Buf == NULL)
         {  // mem error
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return NULL;
         }
 
         fCreatingFile = InsertSorted(sacVirtualFileNameSpace,&vfiAdd);
         if (!fCreatingFile )
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return NULL;
         }
         if (!FindSameElemPos(sacVirtualFileNameSpace, &vfiSearch, &dwPosItem))
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return NULL;
         }
     }
@@ -546,7 +691,7 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
     pLowLevelIntern=(LOWLEVELINTERNAL*)DfsMalloc(sizeof(LOWLEVELINTERNAL));
     if (pLowLevelIntern==NULL)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return NULL;
     }
     pLowLevelIntern->dfFileName = strcpyAlloc(FileName);
@@ -555,7 +700,7 @@ ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName,
     pLowLevelIntern->pvfio->pvfi = pVfiFile->pvfii;
     pLowLevelIntern->pvfio->pos = 0;
     pLowLevelIntern->pvfio->pvfi->dfNbOpen++;
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
     return (ABSTRACTFILE_PTR) pLowLevelIntern;
 }
 
@@ -577,16 +722,20 @@ int ABSTRACT_CALLBACK_UNITEX DeleteMemFilePrivParam(const char* lpFileName,void*
             free(fileNameDeletePrefix);
             return (fRetDeletePrefix != FALSE) ? 0 : -1;
         }
-    STATICARRAYC sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
+    if (!InitVirtualFileNameSpace())
+        return -1;
+
+    VIRTUALFILESHARD* pShard=GetVirtualFileShard(lpFileName);
+    STATICARRAYC sacVirtualFileNameSpace=GetSacVirtualFileNameSpace(pShard);
 
     vfiSearchInfo.dfVirtualFileName = lpFileName;
     vfiSearch.pvfii = &vfiSearchInfo;
 
-    GET_MUTEX;
+    LockVirtualFileShard(pShard);
 
     if (!FindSameElemPos(sacVirtualFileNameSpace, &vfiSearch, &dwPosItem))
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return -1;
     }
 
@@ -632,7 +781,7 @@ int ABSTRACT_CALLBACK_UNITEX DeleteMemFilePrivParam(const char* lpFileName,void*
         }
     }
 
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
     return (fRet != FALSE) ? 0 : -1;
 }
 
@@ -859,12 +1008,12 @@ int ABSTRACT_CALLBACK_UNITEX memLowLevelClose(ABSTRACTFILE_PTR llFile,void*)
           TryAutoLoadPersistent(dfFileName);
 #endif
 
-  GET_MUTEX;
+  VIRTUALFILESHARD* pShard = LockVirtualFileShardOfItem(pLowLevelIntern->pvfio->pvfi);
 #ifdef DEBUG_ASSERT_USED
   DEBUG_ASSERT(pLowLevelIntern->pvfio->pvfi->dfNbOpen>0,"VFS Warning: NB opened is not positive!",pLowLevelIntern->pvfio->pvfi->dfVirtualFileName);
 #endif
   pLowLevelIntern->pvfio->pvfi->dfNbOpen--;
-  RELEASE_MUTEX;
+  UnlockVirtualFileShard(pShard);
 
   if (pLowLevelIntern->dfFileName!=NULL)
     DfsFree(pLowLevelIntern->dfFileName);
@@ -886,6 +1035,7 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
     DWORD dwPosItem=0;
     BOOL fCreatingFile = FALSE;
     STATICARRAYC sacVirtualFileNameSpace;
+    VIRTUALFILESHARD* pShard;
     BOOL fItemFound;
     if (!InitVirtualFileNameSpace())
         return FALSE;
@@ -893,9 +1043,10 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
     if ((fIsPermanentPointer) && (size_FilePrefix != 0))
         return FALSE;
 
-    GET_MUTEX;
+    pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
-    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
+    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace(pShard);
 
     vfiSearchInfo.dfVirtualFileName = FileName;
     vfiSearch.pvfii = &vfiSearchInfo;
@@ -913,7 +1064,7 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
         BOOL fRetDel = DeleteElem(sacVirtualFileNameSpace,dwPosItem,1);
         if (!fRetDel)
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return FALSE;
         }
     }
@@ -930,6 +1081,7 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
         vfiAdd.pvfii->fIsPermanentPointer = fIsPermanentPointer;
         vfiAdd.pvfii->pUserPtr = pUserPtr;
         vfiAdd.pvfii->dfNbOpen = 0;
+        vfiAdd.pvfii->pShard = pShard;
 
         if (fIsPermanentPointer)
         {
@@ -944,7 +1096,7 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
 
             if (vfiAdd.pvfii->Buf == NULL)
             {  // mem error
-                RELEASE_MUTEX;
+                UnlockVirtualFileShard(pShard);
                 return FALSE;
             }
 
@@ -962,24 +1114,26 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferUsrPtrWithPrefixOrPermanen
 
             vfiAdd.pvfii->posLastWrite = posWriteBuf;
 
+            GET_MUTEX;
             pVirtualFileSpace->dfTotalSizeVirtualSpace += posWriteBuf;
+            RELEASE_MUTEX;
         }
 
         fCreatingFile = InsertSorted(sacVirtualFileNameSpace,&vfiAdd);
         if (!fCreatingFile )
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return FALSE;
         }
 
         if (!FindSameElemPos(sacVirtualFileNameSpace, &vfiSearch, &dwPosItem))
         {
-            RELEASE_MUTEX;
+            UnlockVirtualFileShard(pShard);
             return FALSE;
         }
     }
 
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
     return TRUE;
 }
 
@@ -1014,6 +1168,7 @@ ULB_VFFUNC BOOL ULIB_CALL BuildMemFileFromMemoryBufferWithPrefixUsrPtr(const cha
         pBufPrefix,size_FilePrefix,pBuf,size_File,FALSE,pUserPtr);
 }
 
+/* the shard of the file must be locked by the caller */
 static VIRTUALFILEITEM* GetpVfiFileFromFileName(const char* FileName)
 {
     VIRTUALFILEITEM vfiSearch;
@@ -1025,7 +1180,7 @@ static VIRTUALFILEITEM* GetpVfiFileFromFileName(const char* FileName)
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
+    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace(GetVirtualFileShard(FileName));
 
     vfiSearchInfo.dfVirtualFileName = FileName;
     vfiSearch.pvfii = &vfiSearchInfo;
@@ -1074,12 +1229,13 @@ ULB_VFFUNC BOOL ULIB_CALL GetMemoryBufferFromMemFileUsrPtr(const char* FileName,
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    GET_MUTEX;
+    VIRTUALFILESHARD* pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
     pVfiiFile=GetpVfiiFileFromFileName(FileName);
     if (pVfiiFile == NULL)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return FALSE;
     }
 
@@ -1097,7 +1253,7 @@ ULB_VFFUNC BOOL ULIB_CALL GetMemoryBufferFromMemFileUsrPtr(const char* FileName,
     }
     if (ppUserPtr!=NULL)
         *ppUserPtr = pVfiiFile->pUserPtr;
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
     return TRUE;
 }
 
@@ -1113,25 +1269,26 @@ ULB_VFFUNC BOOL ULIB_CALL ZeroMemFile(const char* FileName)
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    GET_MUTEX;
+    VIRTUALFILESHARD* pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
     pVfiFile=GetpVfiFileFromFileName(FileName);
     if (pVfiFile == NULL)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return FALSE;
     }
 
     if (pVfiFile->pvfii->fIsPermanentPointer)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return FALSE;
     }
 
     pVfiFile->pvfii->dfFileSize = 0;
     pVfiFile->pvfii->posLastWrite = 0;
 
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
 
     return TRUE;
 }
@@ -1143,17 +1300,29 @@ int ABSTRACT_CALLBACK_UNITEX RenameMemFilePrivParam(const char * _OldFilename, c
     DWORD dwPosItem;
     BOOL fDeletingFile;
     VIRTUALFILEITEM* pVfiFileToRename;
-    STATICARRAYC sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
     VIRTUALFILEITEMINFO * pvfiiFileRenamed;
 
+    if (!InitVirtualFileNameSpace())
+        return -1;
+
+    VIRTUALFILESHARD* pShardOld = GetVirtualFileShard(_OldFilename);
+    VIRTUALFILESHARD* pShardNew = GetVirtualFileShard(_NewFilename);
+    STATICARRAYC sacVirtualFileNameSpace=GetSacVirtualFileNameSpace(pShardOld);
+
     vfiSearchInfo.dfVirtualFileName = _OldFilename;
     vfiSearch.pvfii = &vfiSearchInfo;
 
-    GET_MUTEX;
+    /* we lock the two shards in increasing order */
+    LockVirtualFileShard((pShardOld < pShardNew) ? pShardOld : pShardNew);
+    if (pShardOld != pShardNew)
+        LockVirtualFileShard((pShardOld < pShardNew) ? pShardNew : pShardOld);
+
     if ((GetpVfiFileFromFileName(_NewFilename) != NULL) ||
         (!FindSameElemPos(sacVirtualFileNameSpace, &vfiSearch, &dwPosItem)))
     {
-        RELEASE_MUTEX;
+        if (pShardOld != pShardNew)
+            UnlockVirtualFileShard(pShardNew);
+        UnlockVirtualFileShard(pShardOld);
         return -1;
     }
 
@@ -1177,9 +1346,12 @@ int ABSTRACT_CALLBACK_UNITEX RenameMemFilePrivParam(const char * _OldFilename, c
 
     VIRTUALFILEITEM vfiAdd;
     vfiAdd.pvfii = pvfiiFileRenamed;
-    BOOL fInsertingFile = InsertSorted(sacVirtualFileNameSpace,&vfiAdd);
+    BOOL fInsertingFile = InsertSorted(GetSacVirtualFileNameSpace(pShardNew),&vfiAdd);
+    unitex_atomic_store_ptr(&(pvfiiFileRenamed->pShard), pShardNew);
 
-    RELEASE_MUTEX;
+    if (pShardOld != pShardNew)
+        UnlockVirtualFileShard(pShardNew);
+    UnlockVirtualFileShard(pShardOld);
     return (((fInsertingFile != FALSE) && (fDeletingFile != FALSE)) ? 0 : -1);
 }
 
@@ -1195,19 +1367,20 @@ ULB_VFFUNC BOOL ULIB_CALL SetUserPtrFile(const char* FileName,const void*pUserPt
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    GET_MUTEX;
+    VIRTUALFILESHARD* pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
     pVfiFile=GetpVfiFileFromFileName(FileName);
     if (pVfiFile == NULL)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return FALSE;
     }
 
 
     pVfiFile->pvfii->pUserPtr = pUserPtr;
 
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
 
     return TRUE;
 }
@@ -1221,26 +1394,27 @@ ULB_VFFUNC const void* ULIB_CALL GetUserPtrFile(const char* FileName)
     if (!InitVirtualFileNameSpace())
         return NULL;
 
-    GET_MUTEX;
+    VIRTUALFILESHARD* pShard = GetVirtualFileShard(FileName);
+    LockVirtualFileShard(pShard);
 
     pVfiFile=GetpVfiFileFromFileName(FileName);
     if (pVfiFile == NULL)
     {
-        RELEASE_MUTEX;
+        UnlockVirtualFileShard(pShard);
         return NULL;
     }
 
 
     ret = pVfiFile->pvfii->pUserPtr ;
 
-    RELEASE_MUTEX;
+    UnlockVirtualFileShard(pShard);
 
     return ret;
 }
 
 ULB_VFFUNC void ULIB_CALL ClearVirtualFiles()
 {
-    GetSacVirtualFileNameSpace();
+    InitVirtualFileNameSpace();
     UnInitVirtualFileNameSpace(TRUE);
 }
 
@@ -1379,6 +1553,24 @@ BOOL SetStdErrFile(const char* FileName, BOOL fTrashOutput)
 }
 */
 
+/* the enumeration locks all the shards, and numbers their items one after
+   the other: this returns the array and the position of the item dwNum */
+static STATICARRAYC GetSacOfEnumeratedItem(DWORD dwNum, DWORD* pdwPosItem)
+{
+    for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+    {
+        STATICARRAYC sacVirtualFileNameSpace=pVirtualFileSpace->shards[iShard].sacVirtualFileNameSpace;
+        DWORD dwNbElem=GetNbElem(sacVirtualFileNameSpace);
+        if (dwNum < dwNbElem)
+        {
+            *pdwPosItem = dwNum;
+            return sacVirtualFileNameSpace;
+        }
+        dwNum -= dwNbElem;
+    }
+    return NULL;
+}
+
 ULB_VFFUNC BOOL ULIB_CALL InitMemFileEnumerationEx(ENUM_VIRTUAL_FILE* pevf, afs_size_type* p_nb_item )
 {
     if (p_nb_item != NULL)
@@ -1387,11 +1579,11 @@ ULB_VFFUNC BOOL ULIB_CALL InitMemFileEnumerationEx(ENUM_VIRTUAL_FILE* pevf, afs_
         return FALSE;
 
     pevf->dwReservedMagicValue = 0;
-    GET_MUTEX;
+    LockAllVirtualFileShards();
     if (p_nb_item != NULL)
     {
-        STATICARRAYC sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
-        *p_nb_item = (afs_size_type) GetNbElem(sacVirtualFileNameSpace);
+        for (int iShard=0;iShard<NB_VIRTUALFILESHARD;iShard++)
+            *p_nb_item += (afs_size_type) GetNbElem(pVirtualFileSpace->shards[iShard].sacVirtualFileNameSpace);
     }
     return TRUE;
 }
@@ -1411,8 +1603,11 @@ ULB_VFFUNC BOOL ULIB_CALL GetNextMemFileEnumeration(ENUM_VIRTUAL_FILE* pevf)
         return FALSE;
 
 
-    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
-    pVfiFile = (VIRTUALFILEITEM*)GetElemPtr(sacVirtualFileNameSpace,pevf->dwReservedMagicValue);
+    DWORD dwPosItem=0;
+    sacVirtualFileNameSpace=GetSacOfEnumeratedItem(pevf->dwReservedMagicValue,&dwPosItem);
+    if (sacVirtualFileNameSpace == NULL)
+        return FALSE;
+    pVfiFile = (VIRTUALFILEITEM*)GetElemPtr(sacVirtualFileNameSpace,dwPosItem);
     if (pVfiFile == NULL)
         return FALSE;
     pVfiiFile = pVfiFile->pvfii;
@@ -1435,7 +1630,7 @@ ULB_VFFUNC BOOL ULIB_CALL CloseMemFileEnumeration(ENUM_VIRTUAL_FILE*)
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    RELEASE_MUTEX;
+    UnlockAllVirtualFileShards();
     return TRUE;
 }
 
@@ -1576,14 +1771,17 @@ ULB_VFFUNC BOOL ULIB_CALL DeleteMemFileCurrentlyEnumerated(ENUM_VIRTUAL_FILE* pe
     if (!InitVirtualFileNameSpace())
         return FALSE;
 
-    sacVirtualFileNameSpace=GetSacVirtualFileNameSpace();
+    DWORD dwPosItem=0;
+    sacVirtualFileNameSpace=GetSacOfEnumeratedItem(pevf->dwReservedMagicValue-1,&dwPosItem);
+    if (sacVirtualFileNameSpace == NULL)
+        return FALSE;
 
 #ifdef DEBUG_ASSERT_USED
-    VIRTUALFILEITEM* pVfiFileToDeleteCheck=(VIRTUALFILEITEM*)GetElemPtr(sacVirtualFileNameSpace,pevf->dwReservedMagicValue-1);
+    VIRTUALFILEITEM* pVfiFileToDeleteCheck=(VIRTUALFILEITEM*)GetElemPtr(sacVirtualFileNameSpace,dwPosItem);
     DEBUG_ASSERT(pVfiFileToDeleteCheck->pvfii->dfNbOpen == 0,"VFS Warning: try delete opened file",pVfiFileToDeleteCheck->pvfii->dfVirtualFileName);
 #endif
 
-    fRet = DeleteElem(sacVirtualFileNameSpace,pevf->dwReservedMagicValue-1,1);
+    fRet = DeleteElem(sacVirtualFileNameSpace,dwPosItem,1);
     if (fRet)
         pevf->dwReservedMagicValue--;
     return fRet;
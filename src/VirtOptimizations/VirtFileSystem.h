@@ -39,6 +39,10 @@ ULB_VFFUNC BOOL ULIB_CALL InitVirtualFileNameSpace();
 ULB_VFFUNC BOOL ULIB_CALL UnInitVirtualFileNameSpace(BOOL fClearMaximumMemoryValue);
 ULB_VFFUNC BOOL ULIB_CALL SetVirtualFileNameMaximumMemory(BOOL fLimitSize, afs_size_type dfMaxSize);
 
+/* number of times a lock of the file namespace was taken, and number of times
+   a thread had to wait for it because another thread owned it */
+ULB_VFFUNC BOOL ULIB_CALL GetVirtualFileNameSpaceLockStatistics(afs_size_type* p_nb_lock, afs_size_type* p_nb_contention);
+
 ABSTRACTFILE_PTR ABSTRACT_CALLBACK_UNITEX memOpenLowLevel(const char* FileName, TYPEOPEN_MF TypeOpen, BOOL fProjectedSize, afs_size_type dfProjectedSize,void*);
 size_t ABSTRACT_CALLBACK_UNITEX memLowLevelWrite(ABSTRACTFILE_PTR llFile, void const *Buf, size_t size,void*);
 size_t ABSTRACT_CALLBACK_UNITEX memLowLevelRead(ABSTRACTFILE_PTR llFile, void *Buf, size_t size,void*);
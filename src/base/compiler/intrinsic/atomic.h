@@ -0,0 +1,100 @@
+/*
+ * Unitex
+ *
+ * Copyright (C) 2001-2021 Université Paris-Est Marne-la-Vallée <unitex-devel@univ-mlv.fr>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ *
+ */
+/**
+ * @file      atomic.h
+ * @brief     Minimal atomic operations on pointers and counters
+ *
+ * @attention Do not include this file directly, rather include the base/common.h
+ *            header file to gain this file's functionality
+ *
+ * @note      Use cpplint.py tool to detect style errors:
+ *            `cpplint.py --linelength=120 atomic.h`
+ *
+ * @date      October 2026
+ */
+/* ************************************************************************** */
+#ifndef UNITEX_BASE_COMPILER_INTRINSICS_ATOMIC_H_                   // NOLINT
+#define UNITEX_BASE_COMPILER_INTRINSICS_ATOMIC_H_                   // NOLINT
+/* ************************************************************************** */
+// Unitex headers
+#include "base/compiler/version.h"            // UNITEX_COMPILER_AT_LEAST
+/* ************************************************************************** */
+/**
+ * @def    unitex_atomic_load_ptr
+ * @brief  Reads a pointer with acquire semantics: what was written before
+ *         the pointer was published is visible to the reader
+ */
+/**
+ * @def    unitex_atomic_store_ptr
+ * @brief  Publishes a pointer with release semantics
+ */
+/**
+ * @def    unitex_atomic_cas_ptr
+ * @brief  Replaces `*ptr` by `desired` if it is equal to `expected`.
+ *         Evaluates to non-zero on success
+ */
+/**
+ * @def    unitex_atomic_add_long
+ * @brief  Adds `n` to the long pointed by `ptr` and returns the new value
+ */
+/**
+ * @def    unitex_atomic_load_long
+ * @brief  Reads a long that may be modified by other threads
+ */
+#if   UNITEX_COMPILER_AT_LEAST(GCC,4,7)                                 ||\
+      UNITEX_COMPILER_AT_LEAST(CLANG,3,1)
+#  define unitex_atomic_load_ptr(ptr)                                   \
+      __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#  define unitex_atomic_store_ptr(ptr, value)                           \
+      __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#  define unitex_atomic_cas_ptr(ptr, expected, desired)                 \
+      __sync_bool_compare_and_swap((ptr), (expected), (desired))
+#  define unitex_atomic_add_long(ptr, n)                                \
+      __atomic_add_fetch((ptr), (long)(n), __ATOMIC_RELAXED)
+#  define unitex_atomic_load_long(ptr)                                  \
+      __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#  define UNITEX_HAS_BUILTIN_ATOMIC                   1
+// Visual Studio 2008 and later: volatile accesses have acquire/release
+// semantics on x86 and x64
+# elif UNITEX_COMPILER_AT_LEAST(MSVC,15,0)
+#  include <intrin.h>
+#  define unitex_atomic_load_ptr(ptr)                                   \
+      (*(void* volatile*)(ptr))
+#  define unitex_atomic_store_ptr(ptr, value)                           \
+      (*(void* volatile*)(ptr) = (value))
+#  define unitex_atomic_cas_ptr(ptr, expected, desired)                 \
+      (_InterlockedCompareExchangePointer((void* volatile*)(ptr),       \
+                                          (desired), (expected)) == (expected))
+#  define unitex_atomic_add_long(ptr, n)                                \
+      (_InterlockedExchangeAdd((long volatile*)(ptr), (long)(n)) + (long)(n))
+#  define unitex_atomic_load_long(ptr)        (*(long volatile*)(ptr))
+#  define UNITEX_HAS_BUILTIN_ATOMIC                   1
+#else  // No built-in atomic support: only safe with a single thread
+#  define unitex_atomic_load_ptr(ptr)             (*(ptr))
+#  define unitex_atomic_store_ptr(ptr, value)     (*(ptr) = (value))
+#  define unitex_atomic_cas_ptr(ptr, expected, desired)                 \
+      ((*(ptr) == (expected)) ? ((*(ptr) = (desired)), 1) : 0)
+#  define unitex_atomic_add_long(ptr, n)          (*(ptr) += (long)(n))
+#  define unitex_atomic_load_long(ptr)            (*(ptr))
+#  define UNITEX_HAS_BUILTIN_ATOMIC                   0
+#endif  // UNITEX_COMPILER_AT_LEAST(GCC,4,7)
+/* ************************************************************************** */
+#endif  // UNITEX_BASE_COMPILER_INTRINSICS_ATOMIC_H_                // NOLINT
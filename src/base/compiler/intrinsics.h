@@ -42,6 +42,7 @@
 #define UNITEX_BASE_COMPILER_INTRINSICS_H_                          // NOLINT
 /* ************************************************************************** */
 #include "base/compiler/intrinsic/assume_aligned.h"
+#include "base/compiler/intrinsic/atomic.h"
 #include "base/compiler/intrinsic/clz.h"
 #include "base/compiler/intrinsic/ctz.h"
 #include "base/compiler/intrinsic/likely.h"